@@ -0,0 +1,74 @@
+
+#import <Foundation/Foundation.h>
+
+#import "LXYVideoHistogram.h"
+#import "LXYVideoLockProfiler.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * result of one concurrency level
+ */
+@interface LXYVideoConcurrencyBenchmarkResult : NSObject
+
+/// number of simulated players and prefetchers
+@property (nonatomic, assign, readonly) NSUInteger playerCount;
+@property (nonatomic, assign, readonly) NSUInteger prefetcherCount;
+
+/// wall time of the level. second
+@property (nonatomic, assign, readonly) NSTimeInterval duration;
+
+/// latency of one step of a player, and of a prefetcher. us
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *playerLatency;
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *prefetcherLatency;
+
+/// contention of each lock and queue during the level, the worst tail wait first
+@property (nonatomic, copy, readonly) NSArray<LXYVideoLockContention *> *contentions;
+
+/**
+ * @brief plain values for JSON
+ */
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * stress harness of the synchronization of the player: the cache queue, the delete manager, the hit recorder,
+ * the object pool, the URL transformer and the prefetch queue, under growing numbers of players and prefetchers.
+ *
+ * a player step transforms its URL, marks its cache in use, appends a chunk and reads one back.
+ * a prefetcher step appends a chunk, records it in the hit recorder and hops through the prefetch queue.
+ * LXYVideoLockProfiler is enabled during the run, and its report is taken for each level.
+ * Attention: it clears the disk cache
+ */
+@interface LXYVideoConcurrencyBenchmark : NSObject
+
+/// players and prefetchers of each level, in pairs: @[@[players, prefetchers], ...]. 1+2, 2+4 and 4+8 by default
+@property (nonatomic, copy) NSArray<NSArray<NSNumber *> *> *levels;
+
+/// duration of each level. second. 2 by default
+@property (nonatomic, assign) NSTimeInterval levelDuration;
+
+/// bytes appended and read by each step. 64K by default
+@property (nonatomic, assign) NSUInteger chunkSize;
+
+/**
+ * @brief run the levels synchronously. not on main queue
+ */
+- (NSArray<LXYVideoConcurrencyBenchmarkResult *> *)run;
+
+/**
+ * @brief JSON of @results, with sorted keys
+ */
++ (NSData *)JSONDataWithResults:(NSArray<LXYVideoConcurrencyBenchmarkResult *> *)results;
+
+/**
+ * @brief the contention report of @results, as a table for each level
+ */
++ (NSString *)reportWithResults:(NSArray<LXYVideoConcurrencyBenchmarkResult *> *)results;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,245 @@
+
+#import "LXYVideoConcurrencyBenchmark.h"
+#import "LXYVideoDiskCache.h"
+#import "LXYVideoDiskCache+Private.h"
+#import "LXYVideoDiskCacheDeleteManager.h"
+#import "LXYVideoPrefetchHitRecorder.h"
+#import "LXYVideoPrefetchTaskManager.h"
+#import "LXYVideoURLTransformer.h"
+
+// the chunks of a worker wrap around in a file of it
+static const NSUInteger kLXYConcurrencyFileLength = 4 * 1024 * 1024;
+
+static inline NSTimeInterval p_now(void)
+{
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+static inline uint64_t p_microsecondsSince(NSTimeInterval startTime)
+{
+    return (uint64_t)MAX((p_now() - startTime) * USEC_PER_SEC, 0);
+}
+
+static NSDictionary<NSString *, NSNumber *> *p_dictionaryWithSnapshot(LXYVideoHistogramSnapshot *snapshot)
+{
+    return @{@"count" : @(snapshot.totalCount),
+             @"p50"   : @([snapshot valueAtPercentile:50]),
+             @"p99"   : @([snapshot valueAtPercentile:99]),
+             @"p999"  : @([snapshot valueAtPercentile:99.9]),
+             @"max"   : @(snapshot.max)};
+}
+
+@interface LXYVideoPrefetchHitRecorder ()
+
+- (void)startPrefetchWithKey:(NSString *)key;
+
+- (void)prefetchingWithKey:(NSString *)key size:(NSUInteger)size;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoConcurrencyBenchmarkResult ()
+
+@property (nonatomic, assign, readwrite) NSUInteger playerCount;
+@property (nonatomic, assign, readwrite) NSUInteger prefetcherCount;
+@property (nonatomic, assign, readwrite) NSTimeInterval duration;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *playerLatency;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *prefetcherLatency;
+@property (nonatomic, copy, readwrite) NSArray<LXYVideoLockContention *> *contentions;
+
+@end
+
+@implementation LXYVideoConcurrencyBenchmarkResult
+
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation
+{
+    NSMutableArray *contentions = [NSMutableArray arrayWithCapacity:self.contentions.count];
+    for (LXYVideoLockContention *contention in self.contentions) {
+        [contentions addObject:[contention dictionaryRepresentation]];
+    }
+    
+    return @{@"players"             : @(self.playerCount),
+             @"prefetchers"         : @(self.prefetcherCount),
+             @"seconds"             : @(self.duration),
+             @"playerLatencyUs"     : p_dictionaryWithSnapshot(self.playerLatency),
+             @"prefetcherLatencyUs" : p_dictionaryWithSnapshot(self.prefetcherLatency),
+             @"contentions"         : contentions};
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"players = %@, prefetchers = %@, player steps = %@ p99 = %@us, prefetcher steps = %@ p99 = %@us, dominant = %@",
+            @(self.playerCount), @(self.prefetcherCount),
+            @(self.playerLatency.totalCount), @([self.playerLatency valueAtPercentile:99]),
+            @(self.prefetcherLatency.totalCount), @([self.prefetcherLatency valueAtPercentile:99]),
+            self.contentions.firstObject.name ?: @"-"];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation LXYVideoConcurrencyBenchmark
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _levels = @[@[@1, @2], @[@2, @4], @[@4, @8]];
+        _levelDuration = 2;
+        _chunkSize = 64 * 1024;
+    }
+    
+    return self;
+}
+
+#pragma mark - Public
+
+- (NSArray<LXYVideoConcurrencyBenchmarkResult *> *)run
+{
+    BOOL profiling = [LXYVideoLockProfiler sharedInstance].enabled;
+    [LXYVideoLockProfiler sharedInstance].enabled = YES;
+    
+    NSMutableArray<LXYVideoConcurrencyBenchmarkResult *> *results = [NSMutableArray arrayWithCapacity:self.levels.count];
+    for (NSArray<NSNumber *> *level in self.levels) {
+        if (level.count < 2) {
+            continue;
+        }
+        [results addObject:[self _runWithPlayerCount:level[0].unsignedIntegerValue prefetcherCount:level[1].unsignedIntegerValue]];
+    }
+    
+    [LXYVideoLockProfiler sharedInstance].enabled = profiling;
+    [LXYVideoDiskCache clear];
+    
+    return results;
+}
+
++ (NSData *)JSONDataWithResults:(NSArray<LXYVideoConcurrencyBenchmarkResult *> *)results
+{
+    NSMutableArray *levels = [NSMutableArray arrayWithCapacity:results.count];
+    for (LXYVideoConcurrencyBenchmarkResult *result in results) {
+        [levels addObject:[result dictionaryRepresentation]];
+    }
+    
+    NSJSONWritingOptions options = NSJSONWritingPrettyPrinted;
+    if (@available(iOS 11.0, macOS 10.13, *)) {
+        options |= NSJSONWritingSortedKeys;
+    }
+    
+    return [NSJSONSerialization dataWithJSONObject:@{@"version" : @1, @"levels" : levels} options:options error:NULL];
+}
+
++ (NSString *)reportWithResults:(NSArray<LXYVideoConcurrencyBenchmarkResult *> *)results
+{
+    NSMutableString *report = [NSMutableString string];
+    for (LXYVideoConcurrencyBenchmarkResult *result in results) {
+        [report appendFormat:@"%@\n%-48s %10s  (us)\n", result, "primitive", "acquired"];
+        for (LXYVideoLockContention *contention in result.contentions) {
+            [report appendFormat:@"%@\n", contention];
+        }
+        [report appendString:@"\n"];
+    }
+    
+    return report;
+}
+
+#pragma mark - Private
+
+- (LXYVideoConcurrencyBenchmarkResult *)_runWithPlayerCount:(NSUInteger)playerCount prefetcherCount:(NSUInteger)prefetcherCount
+{
+    [LXYVideoDiskCache clear];
+    [self _waitForCacheQueue];
+    [[LXYVideoLockProfiler sharedInstance] reset];
+    
+    NSData *chunk = [NSMutableData dataWithLength:self.chunkSize];
+    LXYVideoHistogram *playerHistogram = [LXYVideoHistogram new];
+    LXYVideoHistogram *prefetcherHistogram = [LXYVideoHistogram new];
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_queue_t workerQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    
+    NSTimeInterval startTime = p_now();
+    NSTimeInterval deadline = startTime + self.levelDuration;
+    for (NSUInteger i = 0; i < playerCount + prefetcherCount; ++i) {
+        BOOL isPlayer = i < playerCount;
+        NSString *name = [NSString stringWithFormat:@"concurrency-%@-%@", isPlayer ? @"player" : @"prefetcher", @(i)];
+        NSURL *URL = [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1/%@.mp4", name]];
+        
+        dispatch_group_async(group, workerQueue, ^{
+            NSString *key = LXYVideoURLStringToCacheKey(URL.absoluteString);
+            for (NSUInteger step = 0; p_now() < deadline; ++step) {
+                NSUInteger offset = (step * chunk.length) % kLXYConcurrencyFileLength;
+                NSTimeInterval stepTime = p_now();
+                if (isPlayer) {
+                    [self _playerStepWithURL:URL key:key chunk:chunk offset:offset];
+                    [playerHistogram recordValue:p_microsecondsSince(stepTime)];
+                } else {
+                    [self _prefetcherStepWithURL:URL key:key chunk:chunk offset:offset first:step == 0];
+                    [prefetcherHistogram recordValue:p_microsecondsSince(stepTime)];
+                }
+            }
+        });
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    
+    LXYVideoConcurrencyBenchmarkResult *result = [LXYVideoConcurrencyBenchmarkResult new];
+    result.playerCount = playerCount;
+    result.prefetcherCount = prefetcherCount;
+    result.duration = p_now() - startTime;
+    result.playerLatency = [playerHistogram snapshot];
+    result.prefetcherLatency = [prefetcherHistogram snapshot];
+    result.contentions = [[LXYVideoLockProfiler sharedInstance] report];
+    
+    return result;
+}
+
+- (void)_playerStepWithURL:(NSURL *)URL key:(NSString *)key chunk:(NSData *)chunk offset:(NSUInteger)offset
+{
+    NSURL *customURL = [LXYVideoURLTransformer customURLForOriginURL:URL];
+    [LXYVideoURLTransformer originURLForCustomURL:customURL];
+    
+    LXYVideoDiskCacheLease *lease = [LXYVideoDiskCacheDeleteManager leaseCacheForKey:key];
+    [self _appendData:chunk offset:offset forKey:key];
+    
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    [LXYVideoDiskCache cacheDataForKey:key offset:offset length:chunk.length completion:^(NSError * _Nullable error, NSData * _Nullable data) {
+        dispatch_semaphore_signal(semaphore);
+    }];
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    [lease invalidate];
+}
+
+- (void)_prefetcherStepWithURL:(NSURL *)URL key:(NSString *)key chunk:(NSData *)chunk offset:(NSUInteger)offset first:(BOOL)first
+{
+    if (first) {
+        [[LXYVideoPrefetchHitRecorder sharedInstance] startPrefetchWithKey:URL.absoluteString];
+    }
+    
+    [self _appendData:chunk offset:offset forKey:key];
+    [[LXYVideoPrefetchHitRecorder sharedInstance] prefetchingWithKey:URL.absoluteString size:chunk.length];
+    
+    // a hop through the prefetch queue. nothing to cancel
+    [LXYVideoPrefetchTaskManager cancelForURLString:URL.absoluteString];
+}
+
+- (void)_appendData:(NSData *)data offset:(NSUInteger)offset forKey:(NSString *)key
+{
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    [LXYVideoDiskCache appendCacheData:data
+                                offset:offset
+                                forKey:key
+                              mimeType:@"video/mp4"
+                            fileLength:kLXYConcurrencyFileLength
+                            completion:^(NSError *error) {
+        dispatch_semaphore_signal(semaphore);
+    }];
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+}
+
+- (void)_waitForCacheQueue
+{
+    // writes are barriers on the cache queue
+    dispatch_barrier_sync([LXYVideoDiskCache cacheQueue], ^{});
+}
+
+@end
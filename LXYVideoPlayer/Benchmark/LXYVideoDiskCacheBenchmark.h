@@ -0,0 +1,97 @@
+
+#import <Foundation/Foundation.h>
+
+#import "LXYVideoHistogram.h"
+#import "LXYVideoDiskCacheProtocol.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * result of one workload
+ */
+@interface LXYVideoDiskCacheBenchmarkResult : NSObject
+
+/// workload name, e.g. "append-64K"
+@property (nonatomic, copy, readonly) NSString *name;
+
+/// number of timed operations
+@property (nonatomic, assign, readonly) uint64_t operationCount;
+
+/// bytes written or read by the timed operations
+@property (nonatomic, assign, readonly) uint64_t byteCount;
+
+/// wall time of the workload. second
+@property (nonatomic, assign, readonly) NSTimeInterval duration;
+
+/// latency of each operation. us
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *latency;
+
+/**
+ * @brief plain values for JSON: name, operations, bytes, seconds, opsPerSecond, bytesPerSecond and latencyUs
+ */
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * microbenchmark of a LXYVideoDiskCacheProtocol implementation with synthetic workloads:
+ * sequential appends, random reads, meta lookups, trims under quota pressure and mixed reads and writes.
+ * the cache key derivations of the prefetch enqueue path are measured as well, at feed scale.
+ *
+ * Foundation only, so that it runs headless, e.g. under GNUstep with libdispatch.
+ * Attention: it clears the cache. set LXYVideoDiskCacheConfiguration.cacheRootPath to a scratch directory
+ *            before the first disk cache access, i.e. run it in a process of its own.
+ */
+@interface LXYVideoDiskCacheBenchmark : NSObject
+
+/// the implementation under test. LXYVideoDiskCacheFile by default
+@property (nonatomic, strong) Class<LXYVideoDiskCacheProtocol> cacheClass;
+
+/// chunk sizes of the sequential append workloads. 16K, 64K, 256K and 1M by default
+@property (nonatomic, copy) NSArray<NSNumber *> *appendChunkSizes;
+
+/// bytes appended for each chunk size. 8MB by default
+@property (nonatomic, assign) NSUInteger appendFileSize;
+
+/// number of random reads, and the length of each. 2000 of 64K by default
+@property (nonatomic, assign) NSUInteger readCount;
+@property (nonatomic, assign) NSUInteger readLength;
+
+/// cache entries for the meta lookup workloads. 10k and 100k by default. populating is reported as a workload too
+@property (nonatomic, copy) NSArray<NSNumber *> *metaEntryCounts;
+
+/// number of meta lookups for each entry count. 10000 by default
+@property (nonatomic, assign) NSUInteger lookupCount;
+
+/// entries appended beyond the quota in the trim workload, and the size of each. 200 of 256K by default
+@property (nonatomic, assign) NSUInteger trimEntryCount;
+@property (nonatomic, assign) NSUInteger trimEntrySize;
+
+/// operations and readers of the mixed workload. 5000 operations, 80% reads, on 4 threads by default
+@property (nonatomic, assign) NSUInteger mixedOperationCount;
+@property (nonatomic, assign) double mixedReadRatio;
+@property (nonatomic, assign) NSUInteger mixedThreadCount;
+
+/// videos of the feed in the enqueue key workloads, and videos enqueued ahead of the one on screen. 10000 and 5 by default.
+/// the feed is scrolled through once, so that each url is enqueued @feedPrefetchWindow times
+@property (nonatomic, assign) NSUInteger feedURLCount;
+@property (nonatomic, assign) NSUInteger feedPrefetchWindow;
+
+/// seed of the workload randomness, so that runs are comparable. 1 by default
+@property (nonatomic, assign) uint64_t seed;
+
+/**
+ * @brief run all workloads in order. blocks the calling thread, which must not be the cache queue
+ */
+- (NSArray<LXYVideoDiskCacheBenchmarkResult *> *)run;
+
+/**
+ * @brief JSON of @results with sorted keys, one run per file, to diff between versions
+ */
++ (NSData *)JSONDataWithResults:(NSArray<LXYVideoDiskCacheBenchmarkResult *> *)results;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,464 @@
+
+#import "LXYVideoDiskCacheBenchmark.h"
+#import "LXYVideoDiskCache.h"
+#import "LXYVideoDiskCacheFile.h"
+#import "LXYVideoPlayerDefines.h"
+
+static const NSUInteger kLXYBenchmarkMetaEntrySize = 1024;
+static const NSUInteger kLXYBenchmarkMixedFileCount = 8;
+static const NSUInteger kLXYBenchmarkMixedFileSize = 1024 * 1024;
+static const NSUInteger kLXYBenchmarkMixedChunkSize = 64 * 1024;
+// key derivations of one prefetch enqueue: the trace record and the cache lookup of LXYVideoPrefetchTaskManager,
+// LXYVideoPrefetchTask, and the LXYVideoCachePrefetchTask of it
+static const NSUInteger kLXYBenchmarkKeysPerEnqueue = 4;
+
+static inline NSTimeInterval p_now(void)
+{
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+static inline uint64_t p_microsecondsSince(NSTimeInterval startTime)
+{
+    return (uint64_t)MAX((p_now() - startTime) * USEC_PER_SEC, 0);
+}
+
+// xorshift64*, reproducible on every platform
+static inline uint64_t p_random(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoDiskCacheBenchmarkResult ()
+
+@property (nonatomic, copy, readwrite) NSString *name;
+@property (nonatomic, assign, readwrite) uint64_t operationCount;
+@property (nonatomic, assign, readwrite) uint64_t byteCount;
+@property (nonatomic, assign, readwrite) NSTimeInterval duration;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *latency;
+
+@end
+
+@implementation LXYVideoDiskCacheBenchmarkResult
+
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation
+{
+    NSTimeInterval duration = MAX(self.duration, 1e-6);
+    
+    return @{@"name"           : self.name,
+             @"operations"     : @(self.operationCount),
+             @"bytes"          : @(self.byteCount),
+             @"seconds"        : @(self.duration),
+             @"opsPerSecond"   : @(self.operationCount / duration),
+             @"bytesPerSecond" : @(self.byteCount / duration),
+             @"latencyUs"      : @{@"mean" : @(self.latency.mean),
+                                   @"p50"  : @([self.latency valueAtPercentile:50]),
+                                   @"p99"  : @([self.latency valueAtPercentile:99]),
+                                   @"p999" : @([self.latency valueAtPercentile:99.9]),
+                                   @"max"  : @(self.latency.max)}};
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"%@: ops = %@, %.0f ops/s, p50 = %@us, p99 = %@us, p999 = %@us",
+            self.name, @(self.operationCount), self.operationCount / MAX(self.duration, 1e-6),
+            @([self.latency valueAtPercentile:50]), @([self.latency valueAtPercentile:99]), @([self.latency valueAtPercentile:99.9])];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoDiskCacheBenchmark ()
+
+// workload randomness
+@property (nonatomic, assign) uint64_t randomState;
+
+@end
+
+@implementation LXYVideoDiskCacheBenchmark
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _cacheClass = [LXYVideoDiskCacheFile class];
+        _appendChunkSizes = @[@(16 * 1024), @(64 * 1024), @(256 * 1024), @(1024 * 1024)];
+        _appendFileSize = 8 * 1024 * 1024;
+        _readCount = 2000;
+        _readLength = 64 * 1024;
+        _metaEntryCounts = @[@10000, @100000];
+        _lookupCount = 10000;
+        _trimEntryCount = 200;
+        _trimEntrySize = 256 * 1024;
+        _mixedOperationCount = 5000;
+        _mixedReadRatio = 0.8;
+        _mixedThreadCount = 4;
+        _feedURLCount = 10000;
+        _feedPrefetchWindow = 5;
+        _seed = 1;
+    }
+    
+    return self;
+}
+
+#pragma mark - Public
+
+- (NSArray<LXYVideoDiskCacheBenchmarkResult *> *)run
+{
+    self.randomState = self.seed ?: 1;
+    
+    NSMutableArray<LXYVideoDiskCacheBenchmarkResult *> *results = [NSMutableArray array];
+    for (NSNumber *chunkSize in self.appendChunkSizes) {
+        [results addObject:[self _runAppendWithChunkSize:chunkSize.unsignedIntegerValue]];
+    }
+    [results addObject:[self _runRandomRead]];
+    for (NSNumber *entryCount in self.metaEntryCounts) {
+        [results addObjectsFromArray:[self _runMetaLookupWithEntryCount:entryCount.unsignedIntegerValue]];
+    }
+    [results addObject:[self _runTrim]];
+    [results addObject:[self _runMixed]];
+    [results addObjectsFromArray:[self _runEnqueueKeys]];
+    
+    [self.cacheClass clear];
+    [self _waitForCacheQueue];
+    
+    return results;
+}
+
++ (NSData *)JSONDataWithResults:(NSArray<LXYVideoDiskCacheBenchmarkResult *> *)results
+{
+    NSMutableArray *workloads = [NSMutableArray arrayWithCapacity:results.count];
+    for (LXYVideoDiskCacheBenchmarkResult *result in results) {
+        [workloads addObject:[result dictionaryRepresentation]];
+    }
+    
+    NSJSONWritingOptions options = NSJSONWritingPrettyPrinted;
+    if (@available(iOS 11.0, macOS 10.13, *)) {
+        options |= NSJSONWritingSortedKeys;
+    }
+    
+    return [NSJSONSerialization dataWithJSONObject:@{@"version" : @1, @"workloads" : workloads} options:options error:NULL];
+}
+
+#pragma mark - Workloads
+
+- (LXYVideoDiskCacheBenchmarkResult *)_runAppendWithChunkSize:(NSUInteger)chunkSize
+{
+    [self _resetCache];
+    
+    NSString *key = [self _nameWithPrefix:@"append" size:chunkSize];
+    NSData *chunk = [self _dataWithLength:chunkSize];
+    LXYVideoHistogram *histogram = [LXYVideoHistogram new];
+    uint64_t byteCount = 0;
+    
+    NSTimeInterval startTime = p_now();
+    for (NSUInteger offset = 0; offset + chunkSize <= self.appendFileSize; offset += chunkSize) {
+        NSTimeInterval operationTime = p_now();
+        [self _appendData:chunk offset:offset forKey:key fileLength:self.appendFileSize];
+        [histogram recordValue:p_microsecondsSince(operationTime)];
+        byteCount += chunkSize;
+    }
+    
+    return [self _resultWithName:key
+                       histogram:histogram
+                       byteCount:byteCount
+                        duration:p_now() - startTime];
+}
+
+- (LXYVideoDiskCacheBenchmarkResult *)_runRandomRead
+{
+    [self _resetCache];
+    
+    NSString *key = @"read";
+    [self _populateKey:key length:self.appendFileSize];
+    
+    NSUInteger maxOffset = self.appendFileSize > self.readLength ? self.appendFileSize - self.readLength : 0;
+    LXYVideoHistogram *histogram = [LXYVideoHistogram new];
+    __block uint64_t byteCount = 0;
+    
+    NSTimeInterval startTime = p_now();
+    for (NSUInteger i = 0; i < self.readCount; ++i) {
+        uint64_t state = self.randomState;
+        NSUInteger offset = (NSUInteger)(p_random(&state) % (maxOffset + 1));
+        self.randomState = state;
+        
+        NSTimeInterval operationTime = p_now();
+        [self.cacheClass cacheDataForKeySync:key offset:offset length:self.readLength completion:^(NSError * _Nullable error, NSData * _Nullable data) {
+            byteCount += data.length;
+        }];
+        [histogram recordValue:p_microsecondsSince(operationTime)];
+    }
+    
+    return [self _resultWithName:[self _nameWithPrefix:@"read-random" size:self.readLength]
+                       histogram:histogram
+                       byteCount:byteCount
+                        duration:p_now() - startTime];
+}
+
+- (NSArray<LXYVideoDiskCacheBenchmarkResult *> *)_runMetaLookupWithEntryCount:(NSUInteger)entryCount
+{
+    [self _resetCache];
+    
+    NSData *entry = [self _dataWithLength:kLXYBenchmarkMetaEntrySize];
+    LXYVideoHistogram *populateHistogram = [LXYVideoHistogram new];
+    
+    NSTimeInterval startTime = p_now();
+    for (NSUInteger i = 0; i < entryCount; ++i) {
+        NSTimeInterval operationTime = p_now();
+        [self _appendData:entry offset:0 forKey:[self _metaKeyAtIndex:i] fileLength:kLXYBenchmarkMetaEntrySize];
+        [populateHistogram recordValue:p_microsecondsSince(operationTime)];
+    }
+    LXYVideoDiskCacheBenchmarkResult *populateResult = [self _resultWithName:[NSString stringWithFormat:@"meta-populate-%@", @(entryCount)]
+                                                                   histogram:populateHistogram
+                                                                   byteCount:(uint64_t)entryCount * kLXYBenchmarkMetaEntrySize
+                                                                    duration:p_now() - startTime];
+    
+    LXYVideoHistogram *lookupHistogram = [LXYVideoHistogram new];
+    startTime = p_now();
+    for (NSUInteger i = 0; i < self.lookupCount && entryCount > 0; ++i) {
+        uint64_t state = self.randomState;
+        NSString *key = [self _metaKeyAtIndex:(NSUInteger)(p_random(&state) % entryCount)];
+        self.randomState = state;
+        
+        NSTimeInterval operationTime = p_now();
+        [self.cacheClass metaDataForKeySync:key completion:^(NSError * _Nullable error, NSString * _Nullable mimeType, NSUInteger fileLength, NSUInteger cacheLength) {
+        }];
+        [lookupHistogram recordValue:p_microsecondsSince(operationTime)];
+    }
+    LXYVideoDiskCacheBenchmarkResult *lookupResult = [self _resultWithName:[NSString stringWithFormat:@"meta-lookup-%@", @(entryCount)]
+                                                                 histogram:lookupHistogram
+                                                                 byteCount:0
+                                                                  duration:p_now() - startTime];
+    
+    return @[populateResult, lookupResult];
+}
+
+- (LXYVideoDiskCacheBenchmarkResult *)_runTrim
+{
+    [self _resetCache];
+    
+    // every new entry pushes the cache over the quota by one entry
+    NSUInteger quota = self.trimEntryCount / 2 * self.trimEntrySize;
+    for (NSUInteger i = 0; i < self.trimEntryCount / 2; ++i) {
+        [self _populateKey:[NSString stringWithFormat:@"trim-%@", @(i)] length:self.trimEntrySize];
+    }
+    
+    LXYVideoHistogram *histogram = [LXYVideoHistogram new];
+    NSTimeInterval startTime = p_now();
+    for (NSUInteger i = self.trimEntryCount / 2; i < self.trimEntryCount; ++i) {
+        [self _populateKey:[NSString stringWithFormat:@"trim-%@", @(i)] length:self.trimEntrySize];
+        
+        NSTimeInterval operationTime = p_now();
+        [self.cacheClass trimDiskCacheToSize:quota];
+        [self _waitForCacheQueue];
+        [histogram recordValue:p_microsecondsSince(operationTime)];
+    }
+    
+    return [self _resultWithName:@"trim-under-quota" histogram:histogram byteCount:0 duration:p_now() - startTime];
+}
+
+- (LXYVideoDiskCacheBenchmarkResult *)_runMixed
+{
+    [self _resetCache];
+    
+    for (NSUInteger i = 0; i < kLXYBenchmarkMixedFileCount; ++i) {
+        [self _populateKey:[NSString stringWithFormat:@"mixed-%@", @(i)] length:kLXYBenchmarkMixedFileSize];
+    }
+    
+    NSData *chunk = [self _dataWithLength:kLXYBenchmarkMixedChunkSize];
+    NSUInteger threadCount = MAX(self.mixedThreadCount, 1);
+    NSUInteger operationsPerThread = self.mixedOperationCount / threadCount;
+    NSUInteger chunkCount = kLXYBenchmarkMixedFileSize / kLXYBenchmarkMixedChunkSize;
+    uint64_t seed = self.randomState;
+    
+    LXYVideoHistogram *histogram = [LXYVideoHistogram new];
+    __block int64_t byteCount = 0;
+    NSObject *byteCountLock = [NSObject new];
+    
+    NSTimeInterval startTime = p_now();
+    dispatch_apply(threadCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t index) {
+        uint64_t state = seed + index * 0x9E3779B97F4A7C15ULL;
+        int64_t threadByteCount = 0;
+        for (NSUInteger i = 0; i < operationsPerThread; ++i) {
+            NSString *key = [NSString stringWithFormat:@"mixed-%@", @(p_random(&state) % kLXYBenchmarkMixedFileCount)];
+            NSUInteger offset = (NSUInteger)(p_random(&state) % chunkCount) * kLXYBenchmarkMixedChunkSize;
+            BOOL isRead = (double)(p_random(&state) >> 11) / (double)(1ULL << 53) < self.mixedReadRatio;
+            
+            NSTimeInterval operationTime = p_now();
+            if (isRead) {
+                __block NSUInteger readLength = 0;
+                [self.cacheClass cacheDataForKeySync:key offset:offset length:kLXYBenchmarkMixedChunkSize completion:^(NSError * _Nullable error, NSData * _Nullable data) {
+                    readLength = data.length;
+                }];
+                threadByteCount += readLength;
+            } else {
+                [self _appendData:chunk offset:offset forKey:key fileLength:kLXYBenchmarkMixedFileSize];
+                threadByteCount += chunk.length;
+            }
+            [histogram recordValue:p_microsecondsSince(operationTime)];
+        }
+        
+        @synchronized (byteCountLock) {
+            byteCount += threadByteCount;
+        }
+    });
+    
+    return [self _resultWithName:[NSString stringWithFormat:@"mixed-%.0f%%-read-%@-threads", self.mixedReadRatio * 100, @(threadCount)]
+                       histogram:histogram
+                       byteCount:(uint64_t)byteCount
+                        duration:p_now() - startTime];
+}
+
+- (NSArray<LXYVideoDiskCacheBenchmarkResult *> *)_runEnqueueKeys
+{
+    NSMutableArray<NSString *> *feed = [NSMutableArray arrayWithCapacity:self.feedURLCount];
+    for (NSUInteger i = 0; i < self.feedURLCount; ++i) {
+        [feed addObject:[self _feedURLAtIndex:i]];
+    }
+    
+    // the key before the key version 2, the hash alone, and LXYVideoURLStringToCacheKey() from an empty table
+    LXYVideoDiskCacheBenchmarkResult *MD5Result = [self _runEnqueueKeysWithName:@"enqueue-keys-md5" feed:feed keyBlock:^NSString *(NSString *urlString) {
+        return LXY_MD5(urlString);
+    }];
+    LXYVideoDiskCacheBenchmarkResult *hashResult = [self _runEnqueueKeysWithName:@"enqueue-keys-murmur3" feed:feed keyBlock:^NSString *(NSString *urlString) {
+        return LXYVideoCacheKeyWithString(urlString);
+    }];
+    LXYVideoPurgeInternedCacheKeys();
+    LXYVideoDiskCacheBenchmarkResult *internedResult = [self _runEnqueueKeysWithName:@"enqueue-keys-interned" feed:feed keyBlock:^NSString *(NSString *urlString) {
+        return LXYVideoURLStringToCacheKey(urlString);
+    }];
+    
+    return @[MD5Result, hashResult, internedResult];
+}
+
+- (LXYVideoDiskCacheBenchmarkResult *)_runEnqueueKeysWithName:(NSString *)name
+                                                         feed:(NSArray<NSString *> *)feed
+                                                     keyBlock:(NSString *(^)(NSString *urlString))keyBlock
+{
+    LXYVideoHistogram *histogram = [LXYVideoHistogram new];
+    
+    NSTimeInterval startTime = p_now();
+    for (NSUInteger i = 0; i < feed.count; ++i) {
+        @autoreleasepool {
+            // the video at @i is on screen, the next ones are enqueued again
+            for (NSUInteger j = i + 1; j <= i + self.feedPrefetchWindow && j < feed.count; ++j) {
+                NSTimeInterval operationTime = p_now();
+                for (NSUInteger k = 0; k < kLXYBenchmarkKeysPerEnqueue; ++k) {
+                    keyBlock(feed[j]);
+                }
+                [histogram recordValue:p_microsecondsSince(operationTime)];
+            }
+        }
+    }
+    
+    return [self _resultWithName:name
+                       histogram:histogram
+                       byteCount:0
+                        duration:p_now() - startTime];
+}
+
+#pragma mark - Private
+
+- (void)_resetCache
+{
+    [self.cacheClass clear];
+    [self _waitForCacheQueue];
+}
+
+- (void)_waitForCacheQueue
+{
+    // writes and trims are barriers on the cache queue
+    dispatch_barrier_sync([LXYVideoDiskCache cacheQueue], ^{});
+}
+
+- (void)_appendData:(NSData *)data offset:(NSUInteger)offset forKey:(NSString *)key fileLength:(NSUInteger)fileLength
+{
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    [self.cacheClass appendCacheData:data
+                              offset:offset
+                              forKey:key
+                            mimeType:@"video/mp4"
+                          fileLength:fileLength
+                          completion:^(NSError *error) {
+        dispatch_semaphore_signal(semaphore);
+    }];
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+}
+
+- (void)_populateKey:(NSString *)key length:(NSUInteger)length
+{
+    NSUInteger chunkSize = 1024 * 1024;
+    NSData *chunk = [self _dataWithLength:chunkSize];
+    for (NSUInteger offset = 0; offset < length; offset += chunkSize) {
+        NSData *data = offset + chunkSize <= length ? chunk : [chunk subdataWithRange:NSMakeRange(0, length - offset)];
+        [self _appendData:data offset:offset forKey:key fileLength:length];
+    }
+}
+
+- (NSData *)_dataWithLength:(NSUInteger)length
+{
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    uint8_t *bytes = data.mutableBytes;
+    for (NSUInteger i = 0; i < length; ++i) {
+        bytes[i] = (uint8_t)(i * 31);
+    }
+    
+    return data;
+}
+
+- (NSString *)_metaKeyAtIndex:(NSUInteger)index
+{
+    return [NSString stringWithFormat:@"meta-%08lx", (unsigned long)index];
+}
+
+// a CDN play url of about 250 characters, mostly a signed query
+- (NSString *)_feedURLAtIndex:(NSUInteger)index
+{
+    uint64_t state = self.randomState;
+    uint64_t objectID = p_random(&state);
+    uint64_t signature = p_random(&state);
+    uint64_t logID = p_random(&state);
+    self.randomState = state;
+    
+    return [NSString stringWithFormat:@"https://v%02lu.video-cdn.example.com/obj/tos-ve-%04lx/%016llx/?a=1128&br=%lu&bt=%lu&cd=0%%7C0%%7C0&cr=0&cs=0&dr=0&ds=3&er=&ft=%08lx&l=%016llx&lr=all&mime_type=video_mp4&net=0&pl=0&qs=0&rc=%016llx%016llx&vl=&vr=",
+            (unsigned long)(index % 32), (unsigned long)(index % 0xFFFF), objectID,
+            (unsigned long)(1000 + index % 2000), (unsigned long)(500 + index % 1000), (unsigned long)index,
+            logID, signature, signature ^ objectID];
+}
+
+- (NSString *)_nameWithPrefix:(NSString *)prefix size:(NSUInteger)size
+{
+    if (size >= 1024 * 1024 && size % (1024 * 1024) == 0) {
+        return [NSString stringWithFormat:@"%@-%@M", prefix, @(size / (1024 * 1024))];
+    }
+    if (size >= 1024 && size % 1024 == 0) {
+        return [NSString stringWithFormat:@"%@-%@K", prefix, @(size / 1024)];
+    }
+    
+    return [NSString stringWithFormat:@"%@-%@", prefix, @(size)];
+}
+
+- (LXYVideoDiskCacheBenchmarkResult *)_resultWithName:(NSString *)name
+                                            histogram:(LXYVideoHistogram *)histogram
+                                            byteCount:(uint64_t)byteCount
+                                             duration:(NSTimeInterval)duration
+{
+    LXYVideoDiskCacheBenchmarkResult *result = [LXYVideoDiskCacheBenchmarkResult new];
+    result.name = name;
+    result.latency = [histogram snapshot];
+    result.operationCount = result.latency.totalCount;
+    result.byteCount = byteCount;
+    result.duration = duration;
+    
+    return result;
+}
+
+@end
@@ -0,0 +1,29 @@
+
+#import <Foundation/Foundation.h>
+
+#import "LXYVideoHistogram.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * microbenchmark of the latency from a network chunk arriving to the resource loader handling it,
+ * with the queues of LXYVideoCacheRequestTask: the session delegate queue, @taskQueue and the disk cache queue.
+ *
+ * no network or disk I/O is done, only the dispatch hops are measured.
+ */
+@interface LXYVideoDispatchBenchmark : NSObject
+
+/**
+ * @brief run the benchmark. chunks are delivered one by one, each after the previous one is handled
+ *
+ * @param chunkCount    number of chunks for each delivery model
+ * @param completion    called on the main queue, latencies in microseconds.
+ *                      @mainQueueLatency: the session delegate on the main queue, then a hop to @taskQueue.
+ *                      @taskQueueLatency: the session delegate on @taskQueue directly
+ */
++ (void)runWithChunkCount:(NSUInteger)chunkCount
+               completion:(void(^)(LXYVideoHistogramSnapshot *mainQueueLatency, LXYVideoHistogramSnapshot *taskQueueLatency))completion;
+
+@end
+
+NS_ASSUME_NONNULL_END
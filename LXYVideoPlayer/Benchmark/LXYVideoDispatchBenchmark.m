@@ -0,0 +1,98 @@
+
+#import "LXYVideoDispatchBenchmark.h"
+#import "LXYVideoDiskCache.h"
+
+#import <mach/mach_time.h>
+
+@implementation LXYVideoDispatchBenchmark
+
+#pragma mark - Public
+
++ (void)runWithChunkCount:(NSUInteger)chunkCount
+               completion:(void(^)(LXYVideoHistogramSnapshot *mainQueueLatency, LXYVideoHistogramSnapshot *taskQueueLatency))completion
+{
+    dispatch_queue_t taskQueue = dispatch_queue_create("com.LXYVideoPlayer.LXYVideoDispatchBenchmark", DISPATCH_QUEUE_SERIAL);
+    
+    LXYVideoHistogram *mainQueueHistogram = [LXYVideoHistogram new];
+    [self _runWithSessionQueue:[NSOperationQueue mainQueue]
+                     taskQueue:taskQueue
+                    chunkCount:chunkCount
+                     histogram:mainQueueHistogram
+                    completion:^{
+        LXYVideoHistogram *taskQueueHistogram = [LXYVideoHistogram new];
+        [self _runWithSessionQueue:[self _sessionQueueWithTaskQueue:taskQueue]
+                         taskQueue:taskQueue
+                        chunkCount:chunkCount
+                         histogram:taskQueueHistogram
+                        completion:^{
+            dispatch_async(dispatch_get_main_queue(), ^{
+                !completion ? : completion([mainQueueHistogram snapshot], [taskQueueHistogram snapshot]);
+            });
+        }];
+    }];
+}
+
+#pragma mark - Private
+
++ (NSOperationQueue *)_sessionQueueWithTaskQueue:(dispatch_queue_t)taskQueue
+{
+    // the same as LXYVideoCacheRequestTask
+    NSOperationQueue *queue = [NSOperationQueue new];
+    queue.maxConcurrentOperationCount = 1;
+    if ([NSOperationQueue instancesRespondToSelector:@selector(setUnderlyingQueue:)]) {
+        queue.underlyingQueue = taskQueue;
+    }
+    
+    return queue;
+}
+
++ (void)_runWithSessionQueue:(NSOperationQueue *)sessionQueue
+                   taskQueue:(dispatch_queue_t)taskQueue
+                  chunkCount:(NSUInteger)chunkCount
+                   histogram:(LXYVideoHistogram *)histogram
+                  completion:(dispatch_block_t)completion
+{
+    if (chunkCount == 0) {
+        completion();
+        return;
+    }
+    
+    BOOL callbacksOnTaskQueue = sessionQueue != [NSOperationQueue mainQueue];
+    uint64_t startTime = mach_absolute_time();
+    
+    // session delegate -> @taskQueue -> disk write barrier -> @taskQueue, where the loader is notified
+    [sessionQueue addOperationWithBlock:^{
+        dispatch_block_t didReceiveData = ^{
+            dispatch_barrier_async([LXYVideoDiskCache cacheQueue], ^{
+                dispatch_async(taskQueue, ^{
+                    [histogram recordValue:[self _microsecondsSince:startTime]];
+                    
+                    [self _runWithSessionQueue:sessionQueue
+                                     taskQueue:taskQueue
+                                    chunkCount:chunkCount - 1
+                                     histogram:histogram
+                                    completion:completion];
+                });
+            });
+        };
+        
+        if (callbacksOnTaskQueue) {
+            didReceiveData();
+        } else {
+            dispatch_async(taskQueue, didReceiveData);
+        }
+    }];
+}
+
++ (uint64_t)_microsecondsSince:(uint64_t)startTime
+{
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    
+    return (mach_absolute_time() - startTime) * timebase.numer / timebase.denom / NSEC_PER_USEC;
+}
+
+@end
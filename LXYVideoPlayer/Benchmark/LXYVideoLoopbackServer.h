@@ -0,0 +1,94 @@
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * network conditions of LXYVideoLoopbackServer. applied to each connection accepted afterwards
+ */
+@interface LXYVideoLoopbackServerConditions : NSObject <NSCopying>
+
+/// bytes per second of each connection. 0 for no limit, by default
+@property (nonatomic, assign) NSUInteger bandwidth;
+
+/// delay before each response. second. 0 by default
+@property (nonatomic, assign) NSTimeInterval RTT;
+
+/// max random delay added to @RTT. second. 0 by default
+@property (nonatomic, assign) NSTimeInterval jitter;
+
+/// probability that a response body is cut by a connection reset, at a random point. 0 by default
+@property (nonatomic, assign) double resetProbability;
+
+/// probability that a request is answered with 503. 0 by default
+@property (nonatomic, assign) double serverErrorProbability;
+
+/// seed of the randomness above. 1 by default
+@property (nonatomic, assign) uint64_t seed;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * HTTP/1.1 server on 127.0.0.1 for tests and benchmarks, serving a synthetic MP4 corpus.
+ * Range requests are answered with 206 and Content-Range, others with 200; keep-alive is supported.
+ *
+ * the videos are an ftyp box and an mdat box of deterministic bytes: enough for the cache and loader pipeline,
+ * not decodable.
+ */
+@interface LXYVideoLoopbackServer : NSObject
+
+/// network conditions. default to no limit and no failure
+@property (nonatomic, copy) LXYVideoLoopbackServerConditions *conditions;
+
+/// listening port. 0 if not started
+@property (nonatomic, assign, readonly) uint16_t port;
+
+/// number of requests answered
+@property (nonatomic, assign, readonly) NSUInteger requestCount;
+
+/// number of connections reset on purpose
+@property (nonatomic, assign, readonly) NSUInteger resetCount;
+
+/// number of 503 answered on purpose
+@property (nonatomic, assign, readonly) NSUInteger serverErrorCount;
+
+/**
+ * @brief start listening on an ephemeral port of 127.0.0.1
+ */
+- (BOOL)start:(NSError * __autoreleasing *)error;
+
+/**
+ * @brief stop listening and close all connections
+ */
+- (void)stop;
+
+/**
+ * @brief add a synthetic video of @length bytes, served at "/@name.mp4"
+ */
+- (void)addVideoWithName:(NSString *)name length:(NSUInteger)length;
+
+/**
+ * @brief URL of the video @name. nil if not started
+ */
+- (NSURL * _Nullable)URLForVideoWithName:(NSString *)name;
+
+/**
+ * @brief body bytes sent for the video @name
+ */
+- (NSUInteger)servedBytesForVideoWithName:(NSString *)name;
+
+/**
+ * @brief body bytes sent for the video @name, at offsets which had been sent before
+ */
+- (NSUInteger)redundantBytesForVideoWithName:(NSString *)name;
+
+/**
+ * @brief clear the counters and the byte statistics
+ */
+- (void)resetStatistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
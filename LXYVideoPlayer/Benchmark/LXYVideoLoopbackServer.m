@@ -0,0 +1,561 @@
+
+#import "LXYVideoLoopbackServer.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const NSUInteger kLXYLoopbackHeaderMaxLength = 16 * 1024;
+static const NSUInteger kLXYLoopbackChunkSize = 16 * 1024;
+// boxes at the head of each video: ftyp of 24 bytes, then the mdat header of 8 bytes
+static const NSUInteger kLXYLoopbackFtypLength = 24;
+static const NSUInteger kLXYLoopbackMdatHeaderLength = 8;
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// xorshift64*, as LXYVideoDiskCacheBenchmark
+static inline uint64_t p_random(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline void p_writeUInt32(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t)(value >> 24);
+    bytes[1] = (uint8_t)(value >> 16);
+    bytes[2] = (uint8_t)(value >> 8);
+    bytes[3] = (uint8_t)value;
+}
+
+// the bytes of a synthetic video of @length at [@offset, @offset + @count)
+static void p_fillVideoBytes(uint8_t *buffer, NSUInteger offset, NSUInteger count, NSUInteger length)
+{
+    uint8_t header[kLXYLoopbackFtypLength + kLXYLoopbackMdatHeaderLength];
+    p_writeUInt32(header, (uint32_t)kLXYLoopbackFtypLength);
+    memcpy(header + 4, "ftypisom", 8);
+    p_writeUInt32(header + 12, 0x200);
+    memcpy(header + 16, "isomiso2", 8);
+    uint64_t mdatLength = length > kLXYLoopbackFtypLength ? length - kLXYLoopbackFtypLength : 0;
+    p_writeUInt32(header + kLXYLoopbackFtypLength, (uint32_t)MIN(mdatLength, UINT32_MAX));
+    memcpy(header + kLXYLoopbackFtypLength + 4, "mdat", 4);
+    
+    for (NSUInteger i = 0; i < count; ++i) {
+        NSUInteger position = offset + i;
+        buffer[i] = position < sizeof(header) ? header[position] : (uint8_t)(position * 31 + (position >> 13));
+    }
+}
+
+static BOOL p_sendAll(int fd, const void *bytes, size_t length)
+{
+    const uint8_t *cursor = bytes;
+    while (length > 0) {
+        ssize_t sent = send(fd, cursor, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return NO;
+        }
+        cursor += sent;
+        length -= (size_t)sent;
+    }
+    
+    return YES;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation LXYVideoLoopbackServerConditions
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _seed = 1;
+    }
+    
+    return self;
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    LXYVideoLoopbackServerConditions *conditions = [[[self class] allocWithZone:zone] init];
+    conditions.bandwidth = self.bandwidth;
+    conditions.RTT = self.RTT;
+    conditions.jitter = self.jitter;
+    conditions.resetProbability = self.resetProbability;
+    conditions.serverErrorProbability = self.serverErrorProbability;
+    conditions.seed = self.seed;
+    
+    return conditions;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoLoopbackServer ()
+
+@property (nonatomic, assign, readwrite) uint16_t port;
+@property (nonatomic, assign, readwrite) NSUInteger requestCount;
+@property (nonatomic, assign, readwrite) NSUInteger resetCount;
+@property (nonatomic, assign, readwrite) NSUInteger serverErrorCount;
+
+// the listening socket. -1 if not started
+@property (nonatomic, assign) int listenSocket;
+
+// accepts connections from @listenSocket
+@property (nonatomic, strong) dispatch_source_t acceptSource;
+
+// sockets of the open connections, to be shut down by @stop
+@property (nonatomic, strong) NSMutableSet<NSNumber *> *connectionSockets;
+
+// <name, length> of the corpus
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *videoLengths;
+
+// <name, offsets sent>
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSMutableIndexSet *> *servedRanges;
+
+// <name, bytes sent>, and the part of them sent before
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *servedBytes;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *redundantBytes;
+
+// randomness of @conditions
+@property (nonatomic, assign) uint64_t randomState;
+
+@end
+
+@implementation LXYVideoLoopbackServer
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _conditions = [LXYVideoLoopbackServerConditions new];
+        _randomState = _conditions.seed;
+        _listenSocket = -1;
+        _connectionSockets = [NSMutableSet set];
+        _videoLengths = [NSMutableDictionary dictionary];
+        _servedRanges = [NSMutableDictionary dictionary];
+        _servedBytes = [NSMutableDictionary dictionary];
+        _redundantBytes = [NSMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    [self stop];
+}
+
+#pragma mark - Public
+
+- (void)setConditions:(LXYVideoLoopbackServerConditions *)conditions
+{
+    @synchronized (self) {
+        _conditions = [conditions copy];
+        _randomState = _conditions.seed ?: 1;
+    }
+}
+
+- (LXYVideoLoopbackServerConditions *)conditions
+{
+    @synchronized (self) {
+        return _conditions;
+    }
+}
+
+- (BOOL)start:(NSError * __autoreleasing *)error
+{
+    if (self.listenSocket >= 0) {
+        return YES;
+    }
+    
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return [self _failWithErrno:errno socket:-1 error:error];
+    }
+    
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 16) != 0) {
+        return [self _failWithErrno:errno socket:fd error:error];
+    }
+    
+    socklen_t addressLength = sizeof(address);
+    if (getsockname(fd, (struct sockaddr *)&address, &addressLength) != 0) {
+        return [self _failWithErrno:errno socket:fd error:error];
+    }
+    
+    self.listenSocket = fd;
+    self.port = ntohs(address.sin_port);
+    
+    __weak typeof(self) weakSelf = self;
+    dispatch_queue_t acceptQueue = dispatch_queue_create("com.LXYVideoPlayer.LXYVideoLoopbackServer.accept", DISPATCH_QUEUE_SERIAL);
+    self.acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, (uintptr_t)fd, 0, acceptQueue);
+    dispatch_source_set_event_handler(self.acceptSource, ^{
+        [weakSelf _acceptOnSocket:fd];
+    });
+    dispatch_source_set_cancel_handler(self.acceptSource, ^{
+        close(fd);
+    });
+    dispatch_resume(self.acceptSource);
+    
+    return YES;
+}
+
+- (void)stop
+{
+    if (self.acceptSource) {
+        dispatch_source_cancel(self.acceptSource);
+        self.acceptSource = nil;
+    }
+    self.listenSocket = -1;
+    self.port = 0;
+    
+    // the connection loops fail on their next read or write, and close the sockets
+    @synchronized (self) {
+        for (NSNumber *connectionSocket in self.connectionSockets) {
+            shutdown(connectionSocket.intValue, SHUT_RDWR);
+        }
+    }
+}
+
+- (void)addVideoWithName:(NSString *)name length:(NSUInteger)length
+{
+    @synchronized (self) {
+        self.videoLengths[name] = @(length);
+    }
+}
+
+- (NSURL *)URLForVideoWithName:(NSString *)name
+{
+    if (self.port == 0) {
+        return nil;
+    }
+    
+    return [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%@/%@.mp4", @(self.port), name]];
+}
+
+- (NSUInteger)servedBytesForVideoWithName:(NSString *)name
+{
+    @synchronized (self) {
+        return self.servedBytes[name].unsignedIntegerValue;
+    }
+}
+
+- (NSUInteger)redundantBytesForVideoWithName:(NSString *)name
+{
+    @synchronized (self) {
+        return self.redundantBytes[name].unsignedIntegerValue;
+    }
+}
+
+- (void)resetStatistics
+{
+    @synchronized (self) {
+        self.requestCount = 0;
+        self.resetCount = 0;
+        self.serverErrorCount = 0;
+        [self.servedRanges removeAllObjects];
+        [self.servedBytes removeAllObjects];
+        [self.redundantBytes removeAllObjects];
+    }
+}
+
+#pragma mark - Private
+
+- (BOOL)_failWithErrno:(int)code socket:(int)fd error:(NSError * __autoreleasing *)error
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (error) {
+        *error = [NSError errorWithDomain:NSPOSIXErrorDomain
+                                     code:code
+                                 userInfo:@{NSLocalizedDescriptionKey : [NSString stringWithUTF8String:strerror(code)]}];
+    }
+    
+    return NO;
+}
+
+- (void)_acceptOnSocket:(int)listenSocket
+{
+    int fd = accept(listenSocket, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    
+#ifdef SO_NOSIGPIPE
+    int noSigPipe = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+    
+    @synchronized (self) {
+        [self.connectionSockets addObject:@(fd)];
+    }
+    
+    // blocking I/O, one queue for each connection. the throttling sleeps there
+    dispatch_queue_t connectionQueue = dispatch_queue_create("com.LXYVideoPlayer.LXYVideoLoopbackServer.connection", DISPATCH_QUEUE_SERIAL);
+    dispatch_async(connectionQueue, ^{
+        [self _serveConnection:fd];
+        
+        @synchronized (self) {
+            [self.connectionSockets removeObject:@(fd)];
+        }
+    });
+}
+
+- (void)_serveConnection:(int)fd
+{
+    NSMutableData *buffer = [NSMutableData data];
+    uint8_t readBuffer[4096];
+    BOOL keepAlive = YES;
+    
+    while (keepAlive) {
+        NSRange headerEnd = NSMakeRange(NSNotFound, 0);
+        while ((headerEnd = [buffer rangeOfData:[NSData dataWithBytes:"\r\n\r\n" length:4] options:0 range:NSMakeRange(0, buffer.length)]).location == NSNotFound) {
+            ssize_t received = recv(fd, readBuffer, sizeof(readBuffer), 0);
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received <= 0 || buffer.length > kLXYLoopbackHeaderMaxLength) {
+                close(fd);
+                return;
+            }
+            [buffer appendBytes:readBuffer length:(NSUInteger)received];
+        }
+        
+        NSUInteger headerLength = NSMaxRange(headerEnd);
+        NSString *header = [[NSString alloc] initWithData:[buffer subdataWithRange:NSMakeRange(0, headerLength)] encoding:NSUTF8StringEncoding];
+        [buffer replaceBytesInRange:NSMakeRange(0, headerLength) withBytes:NULL length:0];
+        
+        BOOL reset = NO;
+        keepAlive = [self _respondToHeader:header socket:fd reset:&reset];
+        if (reset) {
+            // RST instead of FIN
+            struct linger linger = {1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+            break;
+        }
+    }
+    
+    close(fd);
+}
+
+- (BOOL)_respondToHeader:(NSString *)header socket:(int)fd reset:(BOOL *)reset
+{
+    NSArray<NSString *> *lines = [header componentsSeparatedByString:@"\r\n"];
+    NSArray<NSString *> *requestLine = [lines.firstObject componentsSeparatedByString:@" "];
+    if (requestLine.count < 3) {
+        [self _sendStatus:400 reason:@"Bad Request" headers:nil socket:fd];
+        return NO;
+    }
+    
+    NSString *method = requestLine[0];
+    NSString *rangeValue = nil;
+    BOOL keepAlive = YES;
+    for (NSString *line in lines) {
+        NSRange colon = [line rangeOfString:@":"];
+        if (colon.location == NSNotFound) {
+            continue;
+        }
+        NSString *field = [line substringToIndex:colon.location].lowercaseString;
+        NSString *value = [[line substringFromIndex:NSMaxRange(colon)] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        if ([field isEqualToString:@"range"]) {
+            rangeValue = value;
+        } else if ([field isEqualToString:@"connection"] && [value.lowercaseString isEqualToString:@"close"]) {
+            keepAlive = NO;
+        }
+    }
+    
+    LXYVideoLoopbackServerConditions *conditions = nil;
+    double errorRoll = 0, resetRoll = 0, jitterRoll = 0, cutRoll = 0;
+    NSNumber *videoLength = nil;
+    NSString *name = [requestLine[1].lastPathComponent stringByDeletingPathExtension];
+    @synchronized (self) {
+        conditions = _conditions;
+        uint64_t state = _randomState;
+        errorRoll = (double)(p_random(&state) >> 11) / (double)(1ULL << 53);
+        resetRoll = (double)(p_random(&state) >> 11) / (double)(1ULL << 53);
+        jitterRoll = (double)(p_random(&state) >> 11) / (double)(1ULL << 53);
+        cutRoll = (double)(p_random(&state) >> 11) / (double)(1ULL << 53);
+        _randomState = state;
+        videoLength = self.videoLengths[name];
+        self.requestCount += 1;
+    }
+    
+    NSTimeInterval delay = conditions.RTT + conditions.jitter * jitterRoll;
+    if (delay > 0) {
+        usleep((useconds_t)(delay * USEC_PER_SEC));
+    }
+    
+    if (errorRoll < conditions.serverErrorProbability) {
+        @synchronized (self) {
+            self.serverErrorCount += 1;
+        }
+        return [self _sendStatus:503 reason:@"Service Unavailable" headers:nil socket:fd] && keepAlive;
+    }
+    
+    if (!videoLength || !([method isEqualToString:@"GET"] || [method isEqualToString:@"HEAD"])) {
+        return [self _sendStatus:404 reason:@"Not Found" headers:nil socket:fd] && keepAlive;
+    }
+    
+    NSUInteger length = videoLength.unsignedIntegerValue;
+    NSRange range = NSMakeRange(0, length);
+    NSMutableDictionary<NSString *, NSString *> *headers = [NSMutableDictionary dictionary];
+    headers[@"Content-Type"] = @"video/mp4";
+    headers[@"Accept-Ranges"] = @"bytes";
+    NSInteger status = 200;
+    if (rangeValue) {
+        if (![self _parseRange:rangeValue length:length range:&range]) {
+            headers[@"Content-Range"] = [NSString stringWithFormat:@"bytes */%@", @(length)];
+            return [self _sendStatus:416 reason:@"Range Not Satisfiable" headers:headers socket:fd] && keepAlive;
+        }
+        status = 206;
+        headers[@"Content-Range"] = [NSString stringWithFormat:@"bytes %@-%@/%@", @(range.location), @(NSMaxRange(range) - 1), @(length)];
+    }
+    headers[@"Content-Length"] = [NSString stringWithFormat:@"%@", @(range.length)];
+    
+    if (![self _sendStatus:status reason:status == 206 ? @"Partial Content" : @"OK" headers:headers socket:fd]) {
+        return NO;
+    }
+    if ([method isEqualToString:@"HEAD"]) {
+        return keepAlive;
+    }
+    
+    // a reset cuts the body at a random point
+    NSUInteger bodyLength = range.length;
+    if (resetRoll < conditions.resetProbability) {
+        bodyLength = (NSUInteger)(range.length * cutRoll);
+        *reset = YES;
+    }
+    
+    BOOL succeed = [self _sendBodyOfVideo:name length:length range:NSMakeRange(range.location, bodyLength) bandwidth:conditions.bandwidth socket:fd];
+    if (*reset) {
+        @synchronized (self) {
+            self.resetCount += 1;
+        }
+        return NO;
+    }
+    
+    return succeed && keepAlive;
+}
+
+- (BOOL)_parseRange:(NSString *)value length:(NSUInteger)length range:(NSRange *)range
+{
+    // "bytes=a-b", "bytes=a-" or "bytes=-n". a single range only
+    if (![value hasPrefix:@"bytes="] || [value containsString:@","] || length == 0) {
+        return NO;
+    }
+    
+    NSArray<NSString *> *bounds = [[value substringFromIndex:6] componentsSeparatedByString:@"-"];
+    if (bounds.count != 2) {
+        return NO;
+    }
+    
+    unsigned long long start = 0;
+    unsigned long long end = length - 1;
+    if (bounds[0].length == 0) {
+        unsigned long long suffixLength = strtoull(bounds[1].UTF8String, NULL, 10);
+        if (suffixLength == 0) {
+            return NO;
+        }
+        start = suffixLength >= length ? 0 : length - suffixLength;
+    } else {
+        start = strtoull(bounds[0].UTF8String, NULL, 10);
+        if (bounds[1].length > 0) {
+            end = MIN(strtoull(bounds[1].UTF8String, NULL, 10), (unsigned long long)length - 1);
+        }
+    }
+    if (start >= length || start > end) {
+        return NO;
+    }
+    
+    *range = NSMakeRange((NSUInteger)start, (NSUInteger)(end - start + 1));
+    
+    return YES;
+}
+
+- (BOOL)_sendStatus:(NSInteger)status reason:(NSString *)reason headers:(NSDictionary<NSString *, NSString *> *)headers socket:(int)fd
+{
+    NSMutableString *response = [NSMutableString stringWithFormat:@"HTTP/1.1 %@ %@\r\n", @(status), reason];
+    if (!headers[@"Content-Length"]) {
+        [response appendString:@"Content-Length: 0\r\n"];
+    }
+    [headers enumerateKeysAndObjectsUsingBlock:^(NSString *field, NSString *value, BOOL *stop) {
+        [response appendFormat:@"%@: %@\r\n", field, value];
+    }];
+    [response appendString:@"\r\n"];
+    
+    NSData *data = [response dataUsingEncoding:NSUTF8StringEncoding];
+    
+    return p_sendAll(fd, data.bytes, data.length);
+}
+
+- (BOOL)_sendBodyOfVideo:(NSString *)name length:(NSUInteger)length range:(NSRange)range bandwidth:(NSUInteger)bandwidth socket:(int)fd
+{
+    // 20 writes a second at most when throttled, so that the pacing stays smooth
+    NSUInteger chunkSize = bandwidth > 0 ? MAX(MIN(kLXYLoopbackChunkSize, bandwidth / 20), 1) : kLXYLoopbackChunkSize;
+    uint8_t *chunk = malloc(chunkSize);
+    NSTimeInterval startTime = [NSDate timeIntervalSinceReferenceDate];
+    NSUInteger sentLength = 0;
+    BOOL succeed = YES;
+    
+    while (sentLength < range.length) {
+        NSUInteger count = MIN(chunkSize, range.length - sentLength);
+        NSUInteger offset = range.location + sentLength;
+        p_fillVideoBytes(chunk, offset, count, length);
+        if (!p_sendAll(fd, chunk, count)) {
+            succeed = NO;
+            break;
+        }
+        sentLength += count;
+        [self _recordServedRange:NSMakeRange(offset, count) forVideoWithName:name];
+        
+        if (bandwidth > 0) {
+            NSTimeInterval ahead = (double)sentLength / bandwidth - ([NSDate timeIntervalSinceReferenceDate] - startTime);
+            if (ahead > 0) {
+                usleep((useconds_t)(ahead * USEC_PER_SEC));
+            }
+        }
+    }
+    
+    free(chunk);
+    
+    return succeed;
+}
+
+- (void)_recordServedRange:(NSRange)range forVideoWithName:(NSString *)name
+{
+    @synchronized (self) {
+        NSMutableIndexSet *servedRanges = self.servedRanges[name];
+        if (!servedRanges) {
+            servedRanges = [NSMutableIndexSet indexSet];
+            self.servedRanges[name] = servedRanges;
+        }
+        
+        NSUInteger redundantLength = [servedRanges countOfIndexesInRange:range];
+        [servedRanges addIndexesInRange:range];
+        self.servedBytes[name] = @(self.servedBytes[name].unsignedIntegerValue + range.length);
+        self.redundantBytes[name] = @(self.redundantBytes[name].unsignedIntegerValue + redundantLength);
+    }
+}
+
+@end
@@ -0,0 +1,91 @@
+
+#import <Foundation/Foundation.h>
+
+#import "LXYVideoHistogram.h"
+#import "LXYVideoLoopbackServer.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// scenarios of LXYVideoStartupBenchmark
+FOUNDATION_EXTERN NSString * const LXYVideoStartupScenarioCold;
+FOUNDATION_EXTERN NSString * const LXYVideoStartupScenarioPrefetched;
+FOUNDATION_EXTERN NSString * const LXYVideoStartupScenarioWarm;
+
+/**
+ * result of one scenario
+ */
+@interface LXYVideoStartupBenchmarkResult : NSObject
+
+/// LXYVideoStartupScenarioCold, LXYVideoStartupScenarioPrefetched or LXYVideoStartupScenarioWarm
+@property (nonatomic, copy, readonly) NSString *scenario;
+
+/// number of playbacks measured
+@property (nonatomic, assign, readonly) NSUInteger iterationCount;
+
+/// time from a playback start to the first response. ms. no value for a playback served from the cache only
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *timeToFirstByte;
+
+/// time from a playback start to the first loading request of AVFoundation satisfied. ms
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *timeToFirstLoadingRequestFinished;
+
+/// body bytes the server sent during the playbacks
+@property (nonatomic, assign, readonly) uint64_t servedBytes;
+
+/// the part of @servedBytes not persisted by the disk cache, e.g. cut by a cancel or a reset
+@property (nonatomic, assign, readonly) uint64_t wastedBytes;
+
+/// the part of @servedBytes the server had sent before
+@property (nonatomic, assign, readonly) uint64_t redownloadedBytes;
+
+/**
+ * @brief plain values for JSON
+ */
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * end-to-end startup benchmark: LXYVideoResourceLoader and the disk cache against LXYVideoLoopbackServer,
+ * driven by an AVURLAsset loading "playable" as AVPlayer does before the first frame.
+ *
+ * the corpus is synthetic and not decodable, so a playback ends where AVFoundation gives up parsing it.
+ * the content information request and the first data requests are real, which is what startup is made of.
+ * Attention: it clears the disk cache and resets LXYVideoPlaybackMetrics
+ */
+@interface LXYVideoStartupBenchmark : NSObject
+
+/// network conditions of the server. 2MB/s and 50ms RTT by default
+@property (nonatomic, copy) LXYVideoLoopbackServerConditions *conditions;
+
+/// scenarios to run. cold, prefetched and warm by default
+@property (nonatomic, copy) NSArray<NSString *> *scenarios;
+
+/// playbacks for each scenario. 5 by default
+@property (nonatomic, assign) NSUInteger iterationCount;
+
+/// size of each video. 4MB by default
+@property (nonatomic, assign) NSUInteger videoLength;
+
+/// bytes prefetched before a playback of the prefetched scenario. 512KB by default
+@property (nonatomic, assign) NSUInteger prefetchSize;
+
+/// max duration of a playback. second. 10 by default
+@property (nonatomic, assign) NSTimeInterval timeout;
+
+/**
+ * @brief run the scenarios in background
+ *
+ * @param completion    block to execute on main queue, with the results, or the error of the server start
+ */
+- (void)runWithCompletion:(void(^)(NSArray<LXYVideoStartupBenchmarkResult *> * _Nullable results, NSError * _Nullable error))completion;
+
+/**
+ * @brief JSON of @results, with sorted keys
+ */
++ (NSData *)JSONDataWithResults:(NSArray<LXYVideoStartupBenchmarkResult *> *)results;
+
+@end
+
+NS_ASSUME_NONNULL_END
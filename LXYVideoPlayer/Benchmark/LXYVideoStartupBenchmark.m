@@ -0,0 +1,274 @@
+
+#import "LXYVideoStartupBenchmark.h"
+
+#import <AVFoundation/AVFoundation.h>
+
+#import "LXYVideoDiskCache.h"
+#import "LXYVideoDiskCache+Private.h"
+#import "LXYVideoPlaybackMetrics.h"
+#import "LXYVideoPlayerDefines.h"
+#import "LXYVideoPrefetchTaskManager.h"
+#import "LXYVideoResourceLoader.h"
+#import "LXYVideoURLTransformer.h"
+
+NSString * const LXYVideoStartupScenarioCold = @"cold";
+NSString * const LXYVideoStartupScenarioPrefetched = @"prefetched";
+NSString * const LXYVideoStartupScenarioWarm = @"warm";
+
+static const NSTimeInterval kLXYStartupPollInterval = 0.05;
+
+@interface LXYVideoStartupBenchmarkResult ()
+
+@property (nonatomic, copy, readwrite) NSString *scenario;
+@property (nonatomic, assign, readwrite) NSUInteger iterationCount;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *timeToFirstByte;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *timeToFirstLoadingRequestFinished;
+@property (nonatomic, assign, readwrite) uint64_t servedBytes;
+@property (nonatomic, assign, readwrite) uint64_t wastedBytes;
+@property (nonatomic, assign, readwrite) uint64_t redownloadedBytes;
+
+@end
+
+@implementation LXYVideoStartupBenchmarkResult
+
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation
+{
+    return @{@"scenario"                            : self.scenario,
+             @"iterations"                          : @(self.iterationCount),
+             @"timeToFirstByteMs"                   : [self _dictionaryWithSnapshot:self.timeToFirstByte],
+             @"timeToFirstLoadingRequestFinishedMs" : [self _dictionaryWithSnapshot:self.timeToFirstLoadingRequestFinished],
+             @"servedBytes"                         : @(self.servedBytes),
+             @"wastedBytes"                         : @(self.wastedBytes),
+             @"redownloadedBytes"                   : @(self.redownloadedBytes)};
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"%@: iterations = %@, TTFB p50 = %@ms, firstLoadingRequest p50 = %@ms, p99 = %@ms, served = %@, wasted = %@, redownloaded = %@",
+            self.scenario, @(self.iterationCount),
+            @([self.timeToFirstByte valueAtPercentile:50]),
+            @([self.timeToFirstLoadingRequestFinished valueAtPercentile:50]),
+            @([self.timeToFirstLoadingRequestFinished valueAtPercentile:99]),
+            @(self.servedBytes), @(self.wastedBytes), @(self.redownloadedBytes)];
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)_dictionaryWithSnapshot:(LXYVideoHistogramSnapshot *)snapshot
+{
+    return @{@"count" : @(snapshot.totalCount),
+             @"mean"  : @(snapshot.mean),
+             @"p50"   : @([snapshot valueAtPercentile:50]),
+             @"p99"   : @([snapshot valueAtPercentile:99]),
+             @"max"   : @(snapshot.max)};
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoStartupBenchmark ()
+
+// the server of the running benchmark
+@property (nonatomic, strong) LXYVideoLoopbackServer *server;
+
+@end
+
+@implementation LXYVideoStartupBenchmark
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _conditions = [LXYVideoLoopbackServerConditions new];
+        _conditions.bandwidth = 2 * 1024 * 1024;
+        _conditions.RTT = 0.05;
+        _scenarios = @[LXYVideoStartupScenarioCold, LXYVideoStartupScenarioPrefetched, LXYVideoStartupScenarioWarm];
+        _iterationCount = 5;
+        _videoLength = 4 * 1024 * 1024;
+        _prefetchSize = 512 * 1024;
+        _timeout = 10;
+    }
+    
+    return self;
+}
+
+#pragma mark - Public
+
+- (void)runWithCompletion:(void(^)(NSArray<LXYVideoStartupBenchmarkResult *> * _Nullable results, NSError * _Nullable error))completion
+{
+    dispatch_queue_t benchmarkQueue = dispatch_queue_create("com.LXYVideoPlayer.LXYVideoStartupBenchmark", DISPATCH_QUEUE_SERIAL);
+    dispatch_async(benchmarkQueue, ^{
+        self.server = [LXYVideoLoopbackServer new];
+        self.server.conditions = self.conditions;
+        
+        NSError *error = nil;
+        if (![self.server start:&error]) {
+            self.server = nil;
+            dispatch_async_on_main_queue(^{
+                !completion ? : completion(nil, error);
+            });
+            return;
+        }
+        
+        BOOL enablePrefetchWIFIOnly = [LXYVideoPrefetchTaskManager enablePrefetchWIFIOnly];
+        [LXYVideoPrefetchTaskManager setEnablePrefetchWIFIOnly:NO];
+        [LXYVideoDiskCache clear];
+        [self _waitForCacheQueue];
+        [[LXYVideoPlaybackMetrics sharedInstance] resetStatistics];
+        
+        NSMutableArray<LXYVideoStartupBenchmarkResult *> *results = [NSMutableArray array];
+        for (NSString *scenario in self.scenarios) {
+            [results addObject:[self _runScenario:scenario]];
+        }
+        
+        [LXYVideoPrefetchTaskManager setEnablePrefetchWIFIOnly:enablePrefetchWIFIOnly];
+        [LXYVideoDiskCache clear];
+        [self.server stop];
+        self.server = nil;
+        
+        dispatch_async_on_main_queue(^{
+            !completion ? : completion(results, nil);
+        });
+    });
+}
+
++ (NSData *)JSONDataWithResults:(NSArray<LXYVideoStartupBenchmarkResult *> *)results
+{
+    NSMutableArray *scenarios = [NSMutableArray arrayWithCapacity:results.count];
+    for (LXYVideoStartupBenchmarkResult *result in results) {
+        [scenarios addObject:[result dictionaryRepresentation]];
+    }
+    
+    NSJSONWritingOptions options = NSJSONWritingPrettyPrinted;
+    if (@available(iOS 11.0, macOS 10.13, *)) {
+        options |= NSJSONWritingSortedKeys;
+    }
+    
+    return [NSJSONSerialization dataWithJSONObject:@{@"version" : @1, @"scenarios" : scenarios} options:options error:NULL];
+}
+
+#pragma mark - Scenarios
+
+- (LXYVideoStartupBenchmarkResult *)_runScenario:(NSString *)scenario
+{
+    LXYVideoHistogram *timeToFirstByteHistogram = [LXYVideoHistogram new];
+    LXYVideoHistogram *timeToFirstLoadingRequestHistogram = [LXYVideoHistogram new];
+    uint64_t servedBytes = 0;
+    uint64_t wastedBytes = 0;
+    uint64_t redownloadedBytes = 0;
+    
+    for (NSUInteger i = 0; i < self.iterationCount; ++i) {
+        // a video of its own for each playback, so that the scenarios do not share cache
+        NSString *name = [NSString stringWithFormat:@"%@-%@", scenario, @(i)];
+        [self.server addVideoWithName:name length:self.videoLength];
+        NSURL *URL = [self.server URLForVideoWithName:name];
+        NSString *key = LXYVideoURLStringToCacheKey(URL.absoluteString);
+        
+        if ([scenario isEqualToString:LXYVideoStartupScenarioPrefetched]) {
+            [self _prefetchURL:URL key:key];
+        } else if ([scenario isEqualToString:LXYVideoStartupScenarioWarm]) {
+            [self _playURL:URL];
+        }
+        
+        NSUInteger servedBefore = [self.server servedBytesForVideoWithName:name];
+        NSUInteger redundantBefore = [self.server redundantBytesForVideoWithName:name];
+        NSUInteger persistedBefore = [self _persistedLengthForKey:key];
+        
+        NSDictionary<NSString *, NSNumber *> *events = [self _playURL:URL];
+        
+        NSUInteger served = [self.server servedBytesForVideoWithName:name] - servedBefore;
+        NSUInteger persisted = [self _persistedLengthForKey:key] - persistedBefore;
+        servedBytes += served;
+        wastedBytes += served > persisted ? served - persisted : 0;
+        redownloadedBytes += [self.server redundantBytesForVideoWithName:name] - redundantBefore;
+        
+        NSNumber *response = events[LXYVideoMetricsEventResponse];
+        if (response) {
+            [timeToFirstByteHistogram recordValue:(uint64_t)MAX(response.doubleValue, 0)];
+        }
+        NSNumber *firstLoadingRequestFinished = events[LXYVideoMetricsEventFirstLoadingRequestFinished];
+        if (firstLoadingRequestFinished) {
+            [timeToFirstLoadingRequestHistogram recordValue:(uint64_t)MAX(firstLoadingRequestFinished.doubleValue, 0)];
+        }
+        
+        [LXYVideoDiskCache clearForURLString:URL.absoluteString];
+        [self _waitForCacheQueue];
+    }
+    
+    LXYVideoStartupBenchmarkResult *result = [LXYVideoStartupBenchmarkResult new];
+    result.scenario = scenario;
+    result.iterationCount = self.iterationCount;
+    result.timeToFirstByte = [timeToFirstByteHistogram snapshot];
+    result.timeToFirstLoadingRequestFinished = [timeToFirstLoadingRequestHistogram snapshot];
+    result.servedBytes = servedBytes;
+    result.wastedBytes = wastedBytes;
+    result.redownloadedBytes = redownloadedBytes;
+    LXY_VIDEO_INFO(@"LXYVideoStartupBenchmark %@", result);
+    
+    return result;
+}
+
+#pragma mark - Private
+
+/**
+ * @brief play @URL until AVFoundation is done with "playable", and return the events of the playback timeline
+ */
+- (NSDictionary<NSString *, NSNumber *> *)_playURL:(NSURL *)URL
+{
+    dispatch_queue_t loaderQueue = dispatch_queue_create("com.LXYVideoPlayer.LXYVideoStartupBenchmark.loader", DISPATCH_QUEUE_SERIAL);
+    LXYVideoResourceLoader *loader = [LXYVideoResourceLoader resourceLoaderWithURL:URL queue:loaderQueue internalDelegate:nil];
+    AVURLAsset *asset = [AVURLAsset URLAssetWithURL:[LXYVideoURLTransformer customURLForOriginURL:URL] options:nil];
+    [asset.resourceLoader setDelegate:loader queue:loaderQueue];
+    
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    [asset loadValuesAsynchronouslyForKeys:@[@"playable"] completionHandler:^{
+        dispatch_semaphore_signal(semaphore);
+    }];
+    dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.timeout * NSEC_PER_SEC)));
+    [asset cancelLoading];
+    
+    // the timeline is finished on the loader queue, and the cancelled requests persist on the cache queue
+    [loader stopLoading];
+    dispatch_sync(loaderQueue, ^{});
+    [self _waitForCacheQueue];
+    
+    NSString *key = LXYVideoURLStringToCacheKey(URL.absoluteString);
+    for (LXYVideoMetricsTimeline *timeline in [[LXYVideoPlaybackMetrics sharedInstance].recentTimelines reverseObjectEnumerator]) {
+        if ([timeline.name isEqualToString:@"playback"] && [timeline.key isEqualToString:key]) {
+            return [timeline events];
+        }
+    }
+    
+    return @{};
+}
+
+- (void)_prefetchURL:(NSURL *)URL key:(NSString *)key
+{
+    [LXYVideoPrefetchTaskManager prefetchWithURLString:URL.absoluteString size:self.prefetchSize];
+    
+    NSTimeInterval deadline = [NSDate timeIntervalSinceReferenceDate] + self.timeout;
+    while (   [self _persistedLengthForKey:key] < MIN(self.prefetchSize, self.videoLength)
+           && [NSDate timeIntervalSinceReferenceDate] < deadline) {
+        [NSThread sleepForTimeInterval:kLXYStartupPollInterval];
+    }
+    
+    [LXYVideoPrefetchTaskManager cancelForURLString:URL.absoluteString];
+    [self _waitForCacheQueue];
+}
+
+- (NSUInteger)_persistedLengthForKey:(NSString *)key
+{
+    __block NSUInteger length = 0;
+    [LXYVideoDiskCache cachedRangesForKeySync:key completion:^(NSIndexSet * _Nullable cachedRanges, NSUInteger fileLength) {
+        length = cachedRanges.count;
+    }];
+    
+    return length;
+}
+
+- (void)_waitForCacheQueue
+{
+    // writes are barriers on the cache queue
+    dispatch_barrier_sync([LXYVideoDiskCache cacheQueue], ^{});
+}
+
+@end
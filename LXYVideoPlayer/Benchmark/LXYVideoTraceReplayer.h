@@ -0,0 +1,88 @@
+
+#import <Foundation/Foundation.h>
+
+#import "LXYVideoHistogram.h"
+#import "LXYVideoDiskCacheProtocol.h"
+#import "LXYVideoTraceRecorder.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * result of a replay
+ */
+@interface LXYVideoTraceReplayResult : NSObject
+
+/// number of operations replayed
+@property (nonatomic, assign, readonly) uint64_t eventCount;
+
+/// wall time of the replay. second
+@property (nonatomic, assign, readonly) NSTimeInterval duration;
+
+/// latency of the disk cache operations. us
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *appendLatency;
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *readLatency;
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *trimLatency;
+
+/// latency of the cache lookup made for each loading request. us
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *lookupLatency;
+
+/// number of loading requests, content information requests included, and number of cancels
+@property (nonatomic, assign, readonly) uint64_t loadingRequestCount;
+@property (nonatomic, assign, readonly) uint64_t loadingRequestCancelCount;
+
+/// bytes requested by the loading requests, and the part not cached when requested
+@property (nonatomic, assign, readonly) uint64_t requestedBytes;
+@property (nonatomic, assign, readonly) uint64_t missedBytes;
+
+/// number of prefetch enqueues and cancels
+@property (nonatomic, assign, readonly) uint64_t prefetchCount;
+@property (nonatomic, assign, readonly) uint64_t prefetchCancelCount;
+
+/**
+ * @brief plain values for JSON
+ */
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * replays a trace of LXYVideoTraceRecorder against a disk cache implementation.
+ *
+ * the network is stood in by the trace itself: the downloads of the session are its cache appends,
+ * replayed with synthetic bytes. loading requests become cache lookups, counting the bytes they would wait for.
+ * prefetches are counted only, their downloads being appends as well.
+ *
+ * Foundation only, so that it runs headless.
+ * Attention: it clears the cache, as LXYVideoDiskCacheBenchmark
+ */
+@interface LXYVideoTraceReplayer : NSObject
+
+/// the implementation under test. LXYVideoDiskCacheFile by default
+@property (nonatomic, strong) Class<LXYVideoDiskCacheProtocol> cacheClass;
+
+/// keep the recorded pace instead of full speed. NO by default
+@property (nonatomic, assign) BOOL realTime;
+
+/**
+ * @brief create a replayer of @events, e.g. from eventsWithContentsOfFile:error: of LXYVideoTraceRecorder
+ */
+- (instancetype)initWithEvents:(NSArray<LXYVideoTraceEvent *> *)events NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
++ (instancetype)new UNAVAILABLE_ATTRIBUTE;
+
+/**
+ * @brief replay the trace synchronously
+ */
+- (LXYVideoTraceReplayResult *)run;
+
+/**
+ * @brief JSON of @result, with sorted keys
+ */
++ (NSData *)JSONDataWithResult:(LXYVideoTraceReplayResult *)result;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,248 @@
+
+#import "LXYVideoTraceReplayer.h"
+#import "LXYVideoDiskCache.h"
+#import "LXYVideoDiskCacheFile.h"
+
+static inline NSTimeInterval p_now(void)
+{
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+static inline uint64_t p_microsecondsSince(NSTimeInterval startTime)
+{
+    return (uint64_t)MAX((p_now() - startTime) * USEC_PER_SEC, 0);
+}
+
+static NSDictionary<NSString *, NSNumber *> *p_dictionaryWithSnapshot(LXYVideoHistogramSnapshot *snapshot)
+{
+    return @{@"count" : @(snapshot.totalCount),
+             @"mean"  : @(snapshot.mean),
+             @"p50"   : @([snapshot valueAtPercentile:50]),
+             @"p99"   : @([snapshot valueAtPercentile:99]),
+             @"p999"  : @([snapshot valueAtPercentile:99.9]),
+             @"max"   : @(snapshot.max)};
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoTraceReplayResult ()
+
+@property (nonatomic, assign, readwrite) uint64_t eventCount;
+@property (nonatomic, assign, readwrite) NSTimeInterval duration;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *appendLatency;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *readLatency;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *trimLatency;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *lookupLatency;
+@property (nonatomic, assign, readwrite) uint64_t loadingRequestCount;
+@property (nonatomic, assign, readwrite) uint64_t loadingRequestCancelCount;
+@property (nonatomic, assign, readwrite) uint64_t requestedBytes;
+@property (nonatomic, assign, readwrite) uint64_t missedBytes;
+@property (nonatomic, assign, readwrite) uint64_t prefetchCount;
+@property (nonatomic, assign, readwrite) uint64_t prefetchCancelCount;
+
+@end
+
+@implementation LXYVideoTraceReplayResult
+
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation
+{
+    return @{@"events"                : @(self.eventCount),
+             @"seconds"               : @(self.duration),
+             @"appendLatencyUs"       : p_dictionaryWithSnapshot(self.appendLatency),
+             @"readLatencyUs"         : p_dictionaryWithSnapshot(self.readLatency),
+             @"trimLatencyUs"         : p_dictionaryWithSnapshot(self.trimLatency),
+             @"lookupLatencyUs"       : p_dictionaryWithSnapshot(self.lookupLatency),
+             @"loadingRequests"       : @(self.loadingRequestCount),
+             @"loadingRequestCancels" : @(self.loadingRequestCancelCount),
+             @"requestedBytes"        : @(self.requestedBytes),
+             @"missedBytes"           : @(self.missedBytes),
+             @"prefetches"            : @(self.prefetchCount),
+             @"prefetchCancels"       : @(self.prefetchCancelCount)};
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"events = %@, %.3fs, append p99 = %@us, read p99 = %@us, trim p99 = %@us, requested = %@, missed = %@",
+            @(self.eventCount), self.duration,
+            @([self.appendLatency valueAtPercentile:99]), @([self.readLatency valueAtPercentile:99]), @([self.trimLatency valueAtPercentile:99]),
+            @(self.requestedBytes), @(self.missedBytes)];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoTraceReplayer ()
+
+// the trace
+@property (nonatomic, copy) NSArray<LXYVideoTraceEvent *> *events;
+
+// <key, end of the furthest append>, taken as the file length of each video
+@property (nonatomic, strong) NSDictionary<NSString *, NSNumber *> *fileLengths;
+
+@end
+
+@implementation LXYVideoTraceReplayer
+
+- (instancetype)initWithEvents:(NSArray<LXYVideoTraceEvent *> *)events
+{
+    self = [super init];
+    if (self) {
+        _events = [events copy];
+        _cacheClass = [LXYVideoDiskCacheFile class];
+        
+        NSMutableDictionary<NSString *, NSNumber *> *fileLengths = [NSMutableDictionary dictionary];
+        for (LXYVideoTraceEvent *event in events) {
+            if (event.key && (event.op == LXYVideoTraceOpCacheAppend || event.op == LXYVideoTraceOpLoadingRequest)) {
+                uint64_t end = event.offset + event.length;
+                fileLengths[event.key] = @(MAX(fileLengths[event.key].unsignedLongLongValue, end));
+            }
+        }
+        _fileLengths = fileLengths;
+    }
+    
+    return self;
+}
+
+#pragma mark - Public
+
+- (LXYVideoTraceReplayResult *)run
+{
+    [self.cacheClass clear];
+    [self _waitForCacheQueue];
+    
+    LXYVideoHistogram *appendHistogram = [LXYVideoHistogram new];
+    LXYVideoHistogram *readHistogram = [LXYVideoHistogram new];
+    LXYVideoHistogram *trimHistogram = [LXYVideoHistogram new];
+    LXYVideoHistogram *lookupHistogram = [LXYVideoHistogram new];
+    LXYVideoTraceReplayResult *result = [LXYVideoTraceReplayResult new];
+    NSMutableData *buffer = [NSMutableData data];
+    
+    NSTimeInterval startTime = p_now();
+    for (LXYVideoTraceEvent *event in self.events) {
+        if (self.realTime) {
+            NSTimeInterval ahead = event.timestamp - (p_now() - startTime);
+            if (ahead > 0) {
+                [NSThread sleepForTimeInterval:ahead];
+            }
+        }
+        
+        NSTimeInterval operationTime = p_now();
+        switch (event.op) {
+            case LXYVideoTraceOpLoadingRequest:
+            case LXYVideoTraceOpContentInfoRequest: {
+                result.loadingRequestCount += 1;
+                result.requestedBytes += event.length;
+                result.missedBytes += [self _missedLengthForEvent:event];
+                [lookupHistogram recordValue:p_microsecondsSince(operationTime)];
+                break;
+            }
+            case LXYVideoTraceOpLoadingRequestCancel:
+                result.loadingRequestCancelCount += 1;
+                break;
+            case LXYVideoTraceOpPrefetchEnqueue:
+                result.prefetchCount += 1;
+                break;
+            case LXYVideoTraceOpPrefetchCancel:
+                result.prefetchCancelCount += 1;
+                break;
+            case LXYVideoTraceOpCacheAppend: {
+                if (!event.key || event.length == 0) {
+                    break;
+                }
+                if (buffer.length < event.length) {
+                    buffer.length = (NSUInteger)event.length;
+                }
+                NSData *data = [NSData dataWithBytesNoCopy:buffer.mutableBytes length:(NSUInteger)event.length freeWhenDone:NO];
+                [self _appendData:data offset:(NSUInteger)event.offset forKey:event.key];
+                [appendHistogram recordValue:p_microsecondsSince(operationTime)];
+                break;
+            }
+            case LXYVideoTraceOpCacheRead: {
+                if (!event.key) {
+                    break;
+                }
+                [self.cacheClass cacheDataForKeySync:event.key offset:(NSUInteger)event.offset length:(NSUInteger)event.length completion:^(NSError * _Nullable error, NSData * _Nullable data) {
+                }];
+                [readHistogram recordValue:p_microsecondsSince(operationTime)];
+                break;
+            }
+            case LXYVideoTraceOpCacheTrim:
+                [self.cacheClass trimDiskCacheToSize:(NSUInteger)event.length];
+                [self _waitForCacheQueue];
+                [trimHistogram recordValue:p_microsecondsSince(operationTime)];
+                break;
+            case LXYVideoTraceOpCacheClear:
+                if (event.key) {
+                    [self.cacheClass clearForKeys:@[event.key]];
+                } else {
+                    [self.cacheClass clear];
+                }
+                [self _waitForCacheQueue];
+                break;
+            default:
+                break;
+        }
+        result.eventCount += 1;
+    }
+    result.duration = p_now() - startTime;
+    
+    result.appendLatency = [appendHistogram snapshot];
+    result.readLatency = [readHistogram snapshot];
+    result.trimLatency = [trimHistogram snapshot];
+    result.lookupLatency = [lookupHistogram snapshot];
+    
+    [self.cacheClass clear];
+    [self _waitForCacheQueue];
+    
+    return result;
+}
+
++ (NSData *)JSONDataWithResult:(LXYVideoTraceReplayResult *)result
+{
+    NSJSONWritingOptions options = NSJSONWritingPrettyPrinted;
+    if (@available(iOS 11.0, macOS 10.13, *)) {
+        options |= NSJSONWritingSortedKeys;
+    }
+    
+    return [NSJSONSerialization dataWithJSONObject:@{@"version" : @1, @"replay" : [result dictionaryRepresentation]} options:options error:NULL];
+}
+
+#pragma mark - Private
+
+- (NSUInteger)_missedLengthForEvent:(LXYVideoTraceEvent *)event
+{
+    if (!event.key || event.length == 0) {
+        return 0;
+    }
+    
+    __block NSUInteger cachedLength = 0;
+    NSRange range = NSMakeRange((NSUInteger)event.offset, (NSUInteger)event.length);
+    [self.cacheClass cachedRangesForKeySync:event.key completion:^(NSIndexSet * _Nullable cachedRanges, NSUInteger fileLength) {
+        cachedLength = [cachedRanges countOfIndexesInRange:range];
+    }];
+    
+    return range.length - cachedLength;
+}
+
+- (void)_appendData:(NSData *)data offset:(NSUInteger)offset forKey:(NSString *)key
+{
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    [self.cacheClass appendCacheData:data
+                              offset:offset
+                              forKey:key
+                            mimeType:@"video/mp4"
+                          fileLength:self.fileLengths[key].unsignedIntegerValue
+                          completion:^(NSError *error) {
+        dispatch_semaphore_signal(semaphore);
+    }];
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+}
+
+- (void)_waitForCacheQueue
+{
+    // writes and trims are barriers on the cache queue
+    dispatch_barrier_sync([LXYVideoDiskCache cacheQueue], ^{});
+}
+
+@end
@@ -0,0 +1,152 @@
+
+/*
+ * headless runner of LXYVideoDiskCacheBenchmark, or of LXYVideoTraceReplayer. prints the JSON results to stdout.
+ * builds a cache pack as well, from a manifest of videos.
+ *
+ *      usage: LXYVideoDiskCacheBenchmark [scratch directory] [seed]
+ *             LXYVideoDiskCacheBenchmark --replay <trace> [--realtime] [scratch directory]
+ *             LXYVideoDiskCacheBenchmark --build-pack <manifest> <pack directory>
+ *
+ *      manifest: a JSON array of {"url": play url string, "cacheKey": ..., "file": video path, "mimeType": ..., "bytes": head length},
+ *      "bytes" omitted for the whole file, "mimeType" for "video/mp4".
+ *      "cacheKey" is what URLStringToCacheKey of the app maps "url" to, omitted if the app sets none: the mapping
+ *      of the app is not run here. the keys are hashed with LXYVideoCacheKeyWithString(), no disk cache is touched
+ *
+ * Foundation and libdispatch are needed, and <CommonCrypto/CommonDigest.h> for the MD5 of the cache key version 1,
+ * which LXYVideoDiskCacheFile.m migrates from.
+ * built from Classes/Cache, Classes/Utilities, Classes/Log/System, Classes/Network/LXYVideoNetworkDelegate.h,
+ * LXYVideoDiskCacheBenchmark.m and LXYVideoTraceReplayer.m of the Benchmark directory, e.g. with GNUstep:
+ *
+ *      clang `gnustep-config --objc-flags` -fobjc-arc -fblocks -I... *.m `gnustep-config --base-libs` -ldispatch
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "LXYVideoDiskCacheBenchmark.h"
+#import "LXYVideoDiskCacheConfiguration.h"
+#import "LXYVideoTraceReplayer.h"
+#import "LXYVideoCachePack.h"
+#import "LXYVideoPlayerDefines.h"
+
+static int p_replay(NSString *tracePath, BOOL realTime)
+{
+    NSError *error = nil;
+    NSArray<LXYVideoTraceEvent *> *events = [LXYVideoTraceRecorder eventsWithContentsOfFile:tracePath error:&error];
+    if (!events) {
+        fprintf(stderr, "bad trace: %s\n", error.description.UTF8String);
+        return 1;
+    }
+    
+    LXYVideoTraceReplayer *replayer = [[LXYVideoTraceReplayer alloc] initWithEvents:events];
+    replayer.realTime = realTime;
+    LXYVideoTraceReplayResult *result = [replayer run];
+    fprintf(stderr, "%s\n", result.description.UTF8String);
+    
+    NSData *JSONData = [LXYVideoTraceReplayer JSONDataWithResult:result];
+    fwrite(JSONData.bytes, 1, JSONData.length, stdout);
+    fprintf(stdout, "\n");
+    
+    return 0;
+}
+
+static int p_buildPack(NSString *manifestPath, NSString *packPath)
+{
+    NSData *manifestData = [NSData dataWithContentsOfFile:manifestPath];
+    NSArray *manifest = manifestData ? [NSJSONSerialization JSONObjectWithData:manifestData options:0 error:NULL] : nil;
+    if (![manifest isKindOfClass:NSArray.class]) {
+        fprintf(stderr, "bad manifest: %s\n", manifestPath.UTF8String);
+        return 1;
+    }
+    
+    NSError *error = nil;
+    LXYVideoCachePackWriter *writer = [[LXYVideoCachePackWriter alloc] initWithPath:packPath error:&error];
+    for (NSDictionary *item in manifest) {
+        if (!writer) {
+            break;
+        }
+        
+        NSString *URLString = [item isKindOfClass:NSDictionary.class] ? item[@"url"] : nil;
+        NSString *videoPath = [item isKindOfClass:NSDictionary.class] ? item[@"file"] : nil;
+        if (![URLString isKindOfClass:NSString.class] || ![videoPath isKindOfClass:NSString.class]) {
+            fprintf(stderr, "bad manifest item: %s\n", [item description].UTF8String);
+            return 1;
+        }
+        
+        // not LXYVideoURLStringToCacheKey(): the URLStringToCacheKey of the app is not set in this process
+        NSString *cacheKey = [item[@"cacheKey"] isKindOfClass:NSString.class] ? item[@"cacheKey"] : URLString;
+        NSString *mimeType = [item[@"mimeType"] isKindOfClass:NSString.class] ? item[@"mimeType"] : @"video/mp4";
+        NSUInteger bytes = [item[@"bytes"] isKindOfClass:NSNumber.class] ? [item[@"bytes"] unsignedIntegerValue] : NSUIntegerMax;
+        NSUInteger fileLength = (NSUInteger)[[[NSFileManager defaultManager] attributesOfItemAtPath:videoPath error:NULL] fileSize];
+        NSIndexSet *cachedRanges = [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, MIN(bytes, fileLength))];
+        if (![writer addEntryWithKey:LXYVideoCacheKeyWithString(cacheKey)
+                            mimeType:mimeType
+                          fileLength:fileLength
+                           videoPath:videoPath
+                        cachedRanges:cachedRanges
+                               error:&error]) {
+            break;
+        }
+    }
+    
+    if (!writer || error || ![writer finishWithError:&error]) {
+        fprintf(stderr, "build pack failed: %s\n", error.description.UTF8String);
+        return 1;
+    }
+    fprintf(stderr, "pack built: %lu entries, %s\n", (unsigned long)manifest.count, packPath.UTF8String);
+    
+    return 0;
+}
+
+int main(int argc, const char * argv[])
+{
+    @autoreleasepool {
+        if (argc > 3 && strcmp(argv[1], "--build-pack") == 0) {
+            return p_buildPack([NSString stringWithUTF8String:argv[2]], [NSString stringWithUTF8String:argv[3]]);
+        }
+        
+        NSString *tracePath = nil;
+        BOOL realTime = NO;
+        if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+            tracePath = [NSString stringWithUTF8String:argv[2]];
+            realTime = argc > 3 && strcmp(argv[3], "--realtime") == 0;
+            // the rest as the arguments of the benchmark
+            int consumed = realTime ? 3 : 2;
+            argv += consumed;
+            argc -= consumed;
+        }
+        
+        NSString *rootPath = nil;
+        if (argc > 1) {
+            rootPath = [NSString stringWithUTF8String:argv[1]];
+        } else {
+            rootPath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"LXYVideoDiskCacheBenchmark-%d", [NSProcessInfo processInfo].processIdentifier]];
+        }
+        
+        // before any disk cache access
+        [LXYVideoDiskCacheConfiguration sharedInstance].cacheRootPath = rootPath;
+        
+        if (tracePath) {
+            int status = p_replay(tracePath, realTime);
+            [[NSFileManager defaultManager] removeItemAtPath:rootPath error:NULL];
+            return status;
+        }
+        
+        LXYVideoDiskCacheBenchmark *benchmark = [LXYVideoDiskCacheBenchmark new];
+        if (argc > 2) {
+            benchmark.seed = strtoull(argv[2], NULL, 10);
+        }
+        
+        NSArray<LXYVideoDiskCacheBenchmarkResult *> *results = [benchmark run];
+        for (LXYVideoDiskCacheBenchmarkResult *result in results) {
+            fprintf(stderr, "%s\n", result.description.UTF8String);
+        }
+        
+        NSData *JSONData = [LXYVideoDiskCacheBenchmark JSONDataWithResults:results];
+        fwrite(JSONData.bytes, 1, JSONData.length, stdout);
+        fprintf(stdout, "\n");
+        
+        [[NSFileManager defaultManager] removeItemAtPath:rootPath error:NULL];
+    }
+    
+    return 0;
+}
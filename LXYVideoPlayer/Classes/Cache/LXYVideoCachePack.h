@@ -0,0 +1,94 @@
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * a cache entry in a cache pack
+ */
+@interface LXYVideoCachePackEntry : NSObject
+
+/// cache key
+@property (nonatomic, copy, readonly) NSString *key;
+
+/// video mimeType
+@property (nonatomic, copy, readonly) NSString *mimeType;
+
+/// the file size for the whole video, not the cached size
+@property (nonatomic, assign, readonly) NSUInteger fileLength;
+
+/// cached byte ranges. the data file holds them at the same offsets as the video
+@property (nonatomic, copy, readonly) NSIndexSet *cachedRanges;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * a cache pack: disk cache entries built offline, e.g. the heads of the first feed videos shipped with the app,
+ * adopted by the disk cache at launch for warm starts.
+ *
+ * a pack is a directory of an index and one data file per entry. a data file has the layout of a disk cache
+ * data file, so that it is renamed or cloned into the cache as is, never copied through the write path.
+ */
+@interface LXYVideoCachePack : NSObject
+
+/// the pack directory
+@property (nonatomic, copy, readonly) NSString *path;
+
+/// entries in the index
+@property (nonatomic, copy, readonly) NSArray<LXYVideoCachePackEntry *> *entries;
+
+/// the cache key version of the entries. 1 for the MD5 keys of older packs, which the disk cache migrates as its own
+@property (nonatomic, assign, readonly) NSInteger keyVersion;
+
+/**
+ * @brief read the index of the pack at @path. nil with LXYVideoCacheErrorPackInvalid if it is not a pack
+ */
++ (instancetype _Nullable)packWithContentsOfPath:(NSString *)path error:(NSError * __autoreleasing *)error;
+
+/**
+ * @brief the data file of @entry
+ */
+- (NSString *)dataPathForEntry:(LXYVideoCachePackEntry *)entry;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * builds a cache pack. not thread safe
+ */
+@interface LXYVideoCachePackWriter : NSObject
+
+/**
+ * @brief start a pack at @path. the directory is replaced if it exists
+ */
+- (instancetype _Nullable)initWithPath:(NSString *)path error:(NSError * __autoreleasing *)error;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ * @brief add an entry for @key, of which @cachedRanges are read from the video file at @videoPath
+ *
+ * @param key           cache key, LXYVideoURLStringToCacheKey() of the play url string
+ * @param mimeType      video mimeType
+ * @param fileLength    the whole video size. 0 for the size of @videoPath
+ * @param videoPath     the whole video, or a head of it
+ * @param cachedRanges  ranges to pack. clipped to the video file
+ */
+- (BOOL)addEntryWithKey:(NSString *)key
+               mimeType:(NSString *)mimeType
+             fileLength:(NSUInteger)fileLength
+              videoPath:(NSString *)videoPath
+           cachedRanges:(NSIndexSet *)cachedRanges
+                  error:(NSError * __autoreleasing *)error;
+
+/**
+ * @brief write the index. no entry can be added afterwards
+ */
+- (BOOL)finishWithError:(NSError * __autoreleasing *)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
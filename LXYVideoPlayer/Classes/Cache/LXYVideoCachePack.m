@@ -0,0 +1,340 @@
+
+#import "LXYVideoCachePack.h"
+#import "LXYVideoPlayerDefines.h"
+
+/*
+ * cache pack directory:
+ *      index: magic "LXYPACK\0", version uint32 little endian, reserved uint32, then entries of varints
+ *          UTF-8 length, UTF-8 key, UTF-8 length, UTF-8 mimeType, file length, range count, (location, length) * count
+ *      data/<key>: cached ranges at their offsets in the video
+ *
+ *      version 1 keys are MD5, version 2 keys MurmurHash3, as the cache key versions of LXYVideoURLStringToCacheKey()
+ */
+
+static const char kLXYPackMagic[8] = {'L', 'X', 'Y', 'P', 'A', 'C', 'K', '\0'};
+static const uint32_t kLXYPackVersion = 2;
+// the oldest version read
+static const uint32_t kLXYPackMinVersion = 1;
+static const NSUInteger kLXYPackHeaderLength = 16;
+static NSString * const kLXYPackIndexFilename = @"index";
+static NSString * const kLXYPackDataDirectory = @"data";
+// bytes copied at a time from a video file
+static const NSUInteger kLXYPackCopyLength = 1024 * 1024;
+
+static inline void p_appendVarint(NSMutableData *data, uint64_t value)
+{
+    uint8_t bytes[10];
+    NSUInteger count = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        bytes[count++] = value ? (byte | 0x80) : byte;
+    } while (value);
+    [data appendBytes:bytes length:count];
+}
+
+static inline BOOL p_readVarint(const uint8_t *bytes, NSUInteger length, NSUInteger *cursor, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (NSUInteger shift = 0; shift < 64 && *cursor < length; shift += 7) {
+        uint8_t byte = bytes[(*cursor)++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return YES;
+        }
+    }
+    
+    return NO;
+}
+
+static inline void p_appendString(NSMutableData *data, NSString *string)
+{
+    NSData *stringData = [string dataUsingEncoding:NSUTF8StringEncoding];
+    p_appendVarint(data, stringData.length);
+    [data appendData:stringData];
+}
+
+static inline NSString *p_readString(const uint8_t *bytes, NSUInteger length, NSUInteger *cursor)
+{
+    uint64_t stringLength = 0;
+    if (!p_readVarint(bytes, length, cursor, &stringLength) || stringLength > length - *cursor) {
+        return nil;
+    }
+    
+    NSString *string = [[NSString alloc] initWithBytes:bytes + *cursor length:(NSUInteger)stringLength encoding:NSUTF8StringEncoding];
+    *cursor += (NSUInteger)stringLength;
+    
+    return string;
+}
+
+// a key is a file name in the cache directory
+static inline BOOL p_isValidKey(NSString *key)
+{
+    return (   !LXYVideo_isEmptyString(key)
+            && ![key hasPrefix:@"."]
+            && [key rangeOfString:@"/"].location == NSNotFound);
+}
+
+@interface LXYVideoCachePackEntry ()
+
+@property (nonatomic, copy, readwrite) NSString *key;
+@property (nonatomic, copy, readwrite) NSString *mimeType;
+@property (nonatomic, assign, readwrite) NSUInteger fileLength;
+@property (nonatomic, copy, readwrite) NSIndexSet *cachedRanges;
+
+@end
+
+@implementation LXYVideoCachePackEntry
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %p, key = %@, mimeType = %@, fileLength = %@, cachedRanges = %@>",
+            NSStringFromClass(self.class), self, self.key, self.mimeType, @(self.fileLength), self.cachedRanges];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoCachePack ()
+
+@property (nonatomic, copy, readwrite) NSString *path;
+@property (nonatomic, copy, readwrite) NSArray<LXYVideoCachePackEntry *> *entries;
+@property (nonatomic, assign, readwrite) NSInteger keyVersion;
+
+@end
+
+@implementation LXYVideoCachePack
+
+#pragma mark - Public
+
++ (instancetype)packWithContentsOfPath:(NSString *)path error:(NSError * __autoreleasing *)error
+{
+    NSString *indexPath = [path stringByAppendingPathComponent:kLXYPackIndexFilename];
+    NSData *data = [NSData dataWithContentsOfFile:indexPath options:NSDataReadingMappedIfSafe error:NULL];
+    
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    uint32_t version = 0;
+    if (length >= kLXYPackHeaderLength) {
+        const uint8_t *versionBytes = bytes + sizeof(kLXYPackMagic);
+        version = versionBytes[0] | versionBytes[1] << 8 | versionBytes[2] << 16 | (uint32_t)versionBytes[3] << 24;
+    }
+    if (   length < kLXYPackHeaderLength
+        || memcmp(bytes, kLXYPackMagic, sizeof(kLXYPackMagic)) != 0
+        || version < kLXYPackMinVersion || version > kLXYPackVersion) {
+        if (error) {
+            *error = LXYError(LXYVideoCacheErrorPackInvalid, indexPath);
+        }
+        return nil;
+    }
+    
+    NSMutableArray<LXYVideoCachePackEntry *> *entries = [NSMutableArray array];
+    NSUInteger cursor = kLXYPackHeaderLength;
+    while (cursor < length) {
+        NSString *key = p_readString(bytes, length, &cursor);
+        NSString *mimeType = key ? p_readString(bytes, length, &cursor) : nil;
+        uint64_t fileLength = 0, rangeCount = 0;
+        BOOL valid = (   p_isValidKey(key)
+                      && mimeType
+                      && p_readVarint(bytes, length, &cursor, &fileLength)
+                      && fileLength <= NSUIntegerMax
+                      && p_readVarint(bytes, length, &cursor, &rangeCount));
+        
+        NSMutableIndexSet *cachedRanges = [NSMutableIndexSet indexSet];
+        for (uint64_t i = 0; valid && i < rangeCount; i++) {
+            uint64_t location = 0, rangeLength = 0;
+            valid = (   p_readVarint(bytes, length, &cursor, &location)
+                     && p_readVarint(bytes, length, &cursor, &rangeLength)
+                     && rangeLength > 0
+                     // no overflow: location + rangeLength may wrap around
+                     && location <= fileLength
+                     && rangeLength <= fileLength - location);
+            if (valid) {
+                [cachedRanges addIndexesInRange:NSMakeRange((NSUInteger)location, (NSUInteger)rangeLength)];
+            }
+        }
+        
+        // unlike a trace, a pack is written at once, so a bad entry means a bad pack
+        if (!valid) {
+            if (error) {
+                *error = LXYError(LXYVideoCacheErrorPackInvalid, [NSString stringWithFormat:@"%@ at %@", indexPath, @(cursor)]);
+            }
+            return nil;
+        }
+        
+        LXYVideoCachePackEntry *entry = [LXYVideoCachePackEntry new];
+        entry.key = key;
+        entry.mimeType = mimeType;
+        entry.fileLength = (NSUInteger)fileLength;
+        entry.cachedRanges = cachedRanges;
+        [entries addObject:entry];
+    }
+    
+    LXYVideoCachePack *pack = [LXYVideoCachePack new];
+    pack.path = path;
+    pack.entries = entries;
+    pack.keyVersion = version;
+    
+    return pack;
+}
+
+- (NSString *)dataPathForEntry:(LXYVideoCachePackEntry *)entry
+{
+    return [[self.path stringByAppendingPathComponent:kLXYPackDataDirectory] stringByAppendingPathComponent:entry.key];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoCachePackWriter ()
+
+// the pack directory
+@property (nonatomic, copy) NSString *path;
+
+// the encoded entries
+@property (nonatomic, strong) NSMutableData *index;
+
+// keys added, which must be unique
+@property (nonatomic, strong) NSMutableSet<NSString *> *keys;
+
+@end
+
+@implementation LXYVideoCachePackWriter
+
+#pragma mark - Public
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError * __autoreleasing *)error
+{
+    self = [super init];
+    if (self) {
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        [fileManager removeItemAtPath:path error:NULL];
+        NSString *dataDirectory = [path stringByAppendingPathComponent:kLXYPackDataDirectory];
+        if (![fileManager createDirectoryAtPath:dataDirectory withIntermediateDirectories:YES attributes:nil error:NULL]) {
+            if (error) {
+                *error = LXYError(LXYVideoCacheErrorCreateFileFailed, dataDirectory);
+            }
+            return nil;
+        }
+        
+        _path = [path copy];
+        _index = [NSMutableData dataWithBytes:kLXYPackMagic length:sizeof(kLXYPackMagic)];
+        // version, then the reserved uint32
+        uint8_t version[8] = {kLXYPackVersion & 0xFF, (kLXYPackVersion >> 8) & 0xFF, (kLXYPackVersion >> 16) & 0xFF, kLXYPackVersion >> 24};
+        [_index appendBytes:version length:sizeof(version)];
+        _keys = [NSMutableSet set];
+    }
+    
+    return self;
+}
+
+- (BOOL)addEntryWithKey:(NSString *)key
+               mimeType:(NSString *)mimeType
+             fileLength:(NSUInteger)fileLength
+              videoPath:(NSString *)videoPath
+           cachedRanges:(NSIndexSet *)cachedRanges
+                  error:(NSError * __autoreleasing *)error
+{
+    if (!self.index || !p_isValidKey(key) || [self.keys containsObject:key]) {
+        if (error) {
+            *error = LXYError(LXYVideoCacheErrorEmptyKey, key ?: @"");
+        }
+        return NO;
+    }
+    
+    NSFileHandle *readHandle = [NSFileHandle fileHandleForReadingAtPath:videoPath];
+    if (!readHandle) {
+        if (error) {
+            *error = LXYError(LXYVideoCacheErrorReadFileHandleNil, videoPath);
+        }
+        return NO;
+    }
+    unsigned long long videoLength = [readHandle seekToEndOfFile];
+    if (fileLength == 0) {
+        fileLength = (NSUInteger)videoLength;
+    }
+    
+    NSMutableIndexSet *packedRanges = [cachedRanges mutableCopy];
+    [packedRanges removeIndexesInRange:NSMakeRange((NSUInteger)MIN(videoLength, fileLength), NSUIntegerMax - (NSUInteger)MIN(videoLength, fileLength))];
+    
+    NSString *dataPath = [[self.path stringByAppendingPathComponent:kLXYPackDataDirectory] stringByAppendingPathComponent:key];
+    NSFileHandle *writeHandle = nil;
+    if ([[NSFileManager defaultManager] createFileAtPath:dataPath contents:nil attributes:nil]) {
+        writeHandle = [NSFileHandle fileHandleForWritingAtPath:dataPath];
+    }
+    if (!writeHandle) {
+        [readHandle closeFile];
+        if (error) {
+            *error = LXYError(LXYVideoCacheErrorCreateFileFailed, dataPath);
+        }
+        return NO;
+    }
+    
+    // the gaps between ranges are left as holes, as they are in the disk cache
+    __block BOOL succeed = YES;
+    [packedRanges enumerateRangesUsingBlock:^(NSRange range, BOOL * _Nonnull stop) {
+        @try {
+            [readHandle seekToFileOffset:range.location];
+            [writeHandle seekToFileOffset:range.location];
+            NSUInteger remaining = range.length;
+            while (remaining > 0) {
+                @autoreleasepool {
+                    NSData *data = [readHandle readDataOfLength:MIN(remaining, kLXYPackCopyLength)];
+                    if (data.length == 0) {
+                        succeed = NO;
+                        break;
+                    }
+                    [writeHandle writeData:data];
+                    remaining -= data.length;
+                }
+            }
+        } @catch (NSException *exception) {
+            succeed = NO;
+        }
+        *stop = !succeed;
+    }];
+    [readHandle closeFile];
+    [writeHandle closeFile];
+    
+    if (!succeed) {
+        [[NSFileManager defaultManager] removeItemAtPath:dataPath error:NULL];
+        if (error) {
+            *error = LXYError(LXYVideoCacheErrorWriteFileFailed, dataPath);
+        }
+        return NO;
+    }
+    
+    p_appendString(self.index, key);
+    p_appendString(self.index, mimeType ?: @"");
+    p_appendVarint(self.index, fileLength);
+    __block uint64_t rangeCount = 0;
+    [packedRanges enumerateRangesUsingBlock:^(NSRange range, BOOL * _Nonnull stop) {
+        rangeCount++;
+    }];
+    p_appendVarint(self.index, rangeCount);
+    [packedRanges enumerateRangesUsingBlock:^(NSRange range, BOOL * _Nonnull stop) {
+        p_appendVarint(self.index, range.location);
+        p_appendVarint(self.index, range.length);
+    }];
+    [self.keys addObject:key];
+    
+    return YES;
+}
+
+- (BOOL)finishWithError:(NSError * __autoreleasing *)error
+{
+    NSString *indexPath = [self.path stringByAppendingPathComponent:kLXYPackIndexFilename];
+    // written last, so that a pack cut by a crash is no pack
+    BOOL succeed = [self.index writeToFile:indexPath atomically:YES];
+    if (!succeed && error) {
+        *error = LXYError(LXYVideoCacheErrorWriteFileFailed, indexPath);
+    }
+    self.index = nil;
+    
+    return succeed;
+}
+
+@end
@@ -72,20 +72,76 @@ NS_ASSUME_NONNULL_BEGIN
 + (void)trimDiskCacheToQuota;
 
 /**
- * @brief whether there is enough free disk space for cache.
+ * @brief adopt the entries of a cache pack built offline by LXYVideoCachePackWriter, for warm starts.
+ *        the data files are not copied through the write path: they are renamed into the cache if @moving,
+ *        which consumes the pack, or cloned otherwise. entries cached already are skipped.
+ *        imported entries are ordinary cache entries, subject to the quota and eviction.
+ *        block is executed on main queue
+ *
+ * @param packPath      the pack directory
+ * @param moving        rename the data files instead of cloning. the pack must be writable and on the cache volume
+ */
++ (void)importCachePackAtPath:(NSString *)packPath
+                       moving:(BOOL)moving
+                   completion:(void(^ _Nullable)(NSError * _Nullable error, NSUInteger importedCount))block;
+
+/**
+ * @brief whether there is enough free disk space for cache, i.e. the storage pressure is not critical.
+ *        no file system access, see LXYVideoStorageMonitor
  */
 + (BOOL)hasEnoughFreeDiskSize;
 
 /**
- * @brief whether there is enough disk cache for play smoothly
+ * @brief whether there is enough disk cache for play smoothly. block is executed on main queue
  *
  * @param urlString     play url string
  * @param duration      video duration. second
  * @param networkSpeed  current network speed. KB/s
  */
++ (void)hasEnoughCacheForURLString:(NSString *)urlString
+                     videoDuration:(CGFloat)duration
+                      networkSpeed:(CGFloat)networkSpeed
+                        completion:(void(^)(BOOL hasEnoughCache))block;
+
+/**
+ * @brief the blocking form of the above. it waits for the pending cache writes, so avoid it on main thread
+ */
 + (BOOL)hasEnoughCacheForURLString:(NSString *)urlString
                      videoDuration:(CGFloat)duration
-                      networkSpeed:(CGFloat)networkSpeed;
+                      networkSpeed:(CGFloat)networkSpeed __deprecated_msg("Blocks behind cache writes. Use hasEnoughCacheForURLString:videoDuration:networkSpeed:completion: instead.");
+
+/**
+ * @brief contiguous cached bytes from the beginning, for each of @urlStrings. 0 if there is no cache.
+ *        block is executed on main queue
+ *
+ * @param urlStrings    play url strings
+ */
++ (void)cacheLengthsForURLStrings:(NSArray<NSString *> *)urlStrings
+                       completion:(void(^)(NSArray<NSNumber *> *cacheLengths))block;
+
+/**
+ * @brief how many seconds can be played from @time with the disk cache, mapped by the MP4 sample tables.
+ *        @hasIndex is NO until moov of @urlString is cached and parsed. block is executed on main queue
+ *
+ * @param urlString     play url string
+ * @param time          play position. second
+ */
++ (void)playableDurationForURLString:(NSString *)urlString
+                            fromTime:(NSTimeInterval)time
+                          completion:(void(^)(BOOL hasIndex, NSTimeInterval playableDuration))block;
+
+/**
+ * @brief bytes to load beyond the disk cache, so that [@time, @time + @duration) of @urlString can be played.
+ *        @hasIndex is NO until moov of @urlString is cached and parsed. block is executed on main queue
+ *
+ * @param urlString     play url string
+ * @param time          play position. second
+ * @param duration      play duration. second
+ */
++ (void)bytesNeededForURLString:(NSString *)urlString
+                       fromTime:(NSTimeInterval)time
+                       duration:(NSTimeInterval)duration
+                     completion:(void(^)(BOOL hasIndex, NSUInteger bytesNeeded))block;
 
 /**
  * @brief get the free file system size. MB
@@ -6,6 +6,13 @@
 #import "NSTimer+LXYVideoBlockAddition.h"
 #import "LXYVideoDiskCacheDeleteManager.h"
 #import "LXYVideoDiskCacheProtocol.h"
+#import "LXYVideoTimeIndex.h"
+#import "LXYVideoTraceRecorder.h"
+#import "LXYVideoStorageMonitor.h"
+
+#if TARGET_OS_IPHONE
+#import <UIKit/UIKit.h>
+#endif
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -81,9 +88,11 @@ NS_ASSUME_NONNULL_END
 
 -(void)_addNotificationObservers
 {
+#if TARGET_OS_IPHONE
     [[NSNotificationCenter defaultCenter] addObserverForName:UIApplicationDidEnterBackgroundNotification object:nil queue:[NSOperationQueue mainQueue] usingBlock:^(NSNotification * _Nonnull note) {
         [LXYVideoDiskCache trimDiskCacheToQuota];
     }];
+#endif
 }
 
 #pragma mark - Public
@@ -93,8 +102,11 @@ NS_ASSUME_NONNULL_END
     static NSString *cachePath = nil;
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
-        NSArray *paths = NSSearchPathForDirectoriesInDomains(NSLibraryDirectory, NSUserDomainMask, YES);
-        cachePath = [[paths objectAtIndex:0] stringByAppendingPathComponent:@"LXYVideoCache"];
+        cachePath = [LXYVideoDiskCacheConfiguration sharedInstance].cacheRootPath;
+        if (LXYVideo_isEmptyString(cachePath)) {
+            NSArray *paths = NSSearchPathForDirectoriesInDomains(NSLibraryDirectory, NSUserDomainMask, YES);
+            cachePath = [[paths objectAtIndex:0] stringByAppendingPathComponent:@"LXYVideoCache"];
+        }
     });
     
     if (![[NSFileManager defaultManager] fileExistsAtPath:cachePath]) {
@@ -145,6 +157,8 @@ NS_ASSUME_NONNULL_END
 
 + (void)clearForURLString:(NSString * _Nonnull)urlString
 {
+    LXY_VIDEO_TRACE_RECORD(LXYVideoTraceOpCacheClear, LXYVideoURLStringToCacheKey(urlString), 0, 0);
+    
     [LXYVideoDiskCacheDeleteManager shouldDeleteCacheForKey:LXYVideoURLStringToCacheKey(urlString)];
 }
 
@@ -155,12 +169,26 @@ NS_ASSUME_NONNULL_END
 
 + (BOOL)hasEnoughFreeDiskSize
 {
-    BOOL enough = [self freeFileSystemSize] > 20;
-    if (!enough) {
-        [self clear];
+    // sampled in background, and evicted step by step under pressure instead of cleared at once
+    return [LXYVideoStorageMonitor sharedInstance].pressure < LXYVideoStoragePressureCritical;
+}
+
++ (void)hasEnoughCacheForURLString:(NSString *)urlString
+                     videoDuration:(CGFloat)duration
+                      networkSpeed:(CGFloat)networkSpeed
+                        completion:(void(^)(BOOL hasEnoughCache))block
+{
+    if (!block) {
+        return;
     }
     
-    return enough;
+    NSString *key = LXYVideoURLStringToCacheKey(urlString);
+    dispatch_async([self cacheQueue], ^{
+        BOOL result = [self _hasEnoughCacheForKey:key videoDuration:duration networkSpeed:networkSpeed];
+        dispatch_async_on_main_queue(^{
+            block(result);
+        });
+    });
 }
 
 + (BOOL)hasEnoughCacheForURLString:(NSString *)urlString
@@ -170,15 +198,44 @@ NS_ASSUME_NONNULL_END
     __block BOOL result = NO;
     
     NSString *key = LXYVideoURLStringToCacheKey(urlString);
+    dispatch_sync([self cacheQueue], ^{
+        result = [self _hasEnoughCacheForKey:key videoDuration:duration networkSpeed:networkSpeed];
+    });
+    
+    return result;
+}
+
+// run on cacheQueue
++ (BOOL)_hasEnoughCacheForKey:(NSString *)key
+                videoDuration:(CGFloat)duration
+                 networkSpeed:(CGFloat)networkSpeed
+{
+    __block BOOL result = NO;
+    
     [self metaDataForKeySync:key completion:^(NSError * _Nullable error, NSString * _Nullable mimeType, NSUInteger fileLength, NSUInteger cacheLength) {
         if (!error) {
             NSUInteger speed = networkSpeed * 1024;
             if (speed == 0 || fileLength == 0 || cacheLength == 0) {
                 return;
             }
+            
+            __block NSUInteger neededLength = fileLength - cacheLength;
+            __block CGFloat playableDuration = (CGFloat)cacheLength * duration / fileLength;
+            [self timeIndexForKeySync:key completion:^(LXYVideoTimeIndex * _Nullable timeIndex, NSIndexSet * _Nullable cachedRanges) {
+                // bytes are far from linear to time for VBR content or a large moov
+                if (timeIndex) {
+                    playableDuration = [timeIndex cachedDurationFromTime:0 cachedRanges:cachedRanges];
+                    neededLength = [timeIndex bytesNeededFromTime:playableDuration
+                                                         duration:MAX(duration - playableDuration, 0)
+                                                     cachedRanges:cachedRanges];
+                }
+            }];
+            if (playableDuration <= 0) {
+                return;
+            }
             // ms
-            NSUInteger downloadTime = (fileLength - cacheLength) * 1000 / (speed * 0.75);
-            NSUInteger canPlayTime = cacheLength * duration * 1000 / fileLength;
+            NSUInteger downloadTime = neededLength * 1000 / (speed * 0.75);
+            NSUInteger canPlayTime = playableDuration * 1000;
             
             result = downloadTime <= canPlayTime;
         }
@@ -187,6 +244,64 @@ NS_ASSUME_NONNULL_END
     return result;
 }
 
++ (void)cacheLengthsForURLStrings:(NSArray<NSString *> *)urlStrings
+                       completion:(void(^)(NSArray<NSNumber *> *cacheLengths))block
+{
+    if (!block) {
+        return;
+    }
+    
+    dispatch_async([self cacheQueue], ^{
+        NSMutableArray<NSNumber *> *cacheLengths = [NSMutableArray arrayWithCapacity:urlStrings.count];
+        for (NSString *urlString in urlStrings) {
+            __block NSUInteger length = 0;
+            [self metaDataForKeySync:LXYVideoURLStringToCacheKey(urlString) completion:^(NSError * _Nullable error, NSString * _Nullable mimeType, NSUInteger fileLength, NSUInteger cacheLength) {
+                if (!error) {
+                    length = cacheLength;
+                }
+            }];
+            [cacheLengths addObject:@(length)];
+        }
+        
+        dispatch_async_on_main_queue(^{
+            block(cacheLengths);
+        });
+    });
+}
+
++ (void)playableDurationForURLString:(NSString *)urlString
+                            fromTime:(NSTimeInterval)time
+                          completion:(void(^)(BOOL hasIndex, NSTimeInterval playableDuration))block
+{
+    if (!block) {
+        return;
+    }
+    
+    [CACHE_CLASS timeIndexForKey:LXYVideoURLStringToCacheKey(urlString) completion:^(LXYVideoTimeIndex * _Nullable timeIndex, NSIndexSet * _Nullable cachedRanges) {
+        NSTimeInterval playableDuration = [timeIndex cachedDurationFromTime:time cachedRanges:cachedRanges];
+        dispatch_async_on_main_queue(^{
+            block(timeIndex != nil, playableDuration);
+        });
+    }];
+}
+
++ (void)bytesNeededForURLString:(NSString *)urlString
+                       fromTime:(NSTimeInterval)time
+                       duration:(NSTimeInterval)duration
+                     completion:(void(^)(BOOL hasIndex, NSUInteger bytesNeeded))block
+{
+    if (!block) {
+        return;
+    }
+    
+    [CACHE_CLASS timeIndexForKey:LXYVideoURLStringToCacheKey(urlString) completion:^(LXYVideoTimeIndex * _Nullable timeIndex, NSIndexSet * _Nullable cachedRanges) {
+        NSUInteger bytesNeeded = [timeIndex bytesNeededFromTime:time duration:duration cachedRanges:cachedRanges];
+        dispatch_async_on_main_queue(^{
+            block(timeIndex != nil, bytesNeeded);
+        });
+    }];
+}
+
 + (uint64_t)freeFileSystemSize
 {
     NSDictionary *dict = [[NSFileManager defaultManager]
@@ -209,6 +324,8 @@ NS_ASSUME_NONNULL_END
              fileLength:(NSUInteger)fileLength
              completion:(void(^)(NSError *error))block
 {
+    LXY_VIDEO_TRACE_RECORD(LXYVideoTraceOpCacheAppend, key, offset, data.length);
+    
     [CACHE_CLASS appendCacheData:data
                           offset:(NSUInteger)offset
                           forKey:key
@@ -217,6 +334,19 @@ NS_ASSUME_NONNULL_END
                       completion:block];
 }
 
++ (void)reserveCacheForKey:(NSString *)key
+                  mimeType:(NSString *)mimeType
+                fileLength:(NSUInteger)fileLength
+                    length:(NSUInteger)length
+                completion:(void(^)(NSError * _Nullable error))block
+{
+    [CACHE_CLASS reserveCacheForKey:key
+                           mimeType:mimeType
+                         fileLength:fileLength
+                             length:length
+                         completion:block];
+}
+
 + (void)finishCacheForKey:(NSString *)key
           originURLString:(NSString *)urlString
                completion:(void(^)(NSError *error, NSString *extra))block
@@ -231,6 +361,8 @@ NS_ASSUME_NONNULL_END
                  length:(NSUInteger)length
              completion:(void(^)(NSError *error, NSData* data))block
 {
+    LXY_VIDEO_TRACE_RECORD(LXYVideoTraceOpCacheRead, key, offset, length);
+    
     [CACHE_CLASS cacheDataForKey:key
                           offset:offset
                           length:length
@@ -242,6 +374,8 @@ NS_ASSUME_NONNULL_END
                      length:(NSUInteger)length
                  completion:(void(^)(NSError * _Nullable error, NSData* _Nullable data))block
 {
+    LXY_VIDEO_TRACE_RECORD(LXYVideoTraceOpCacheRead, key, offset, length);
+    
     [CACHE_CLASS cacheDataForKeySync:key
                               offset:offset
                               length:length
@@ -262,6 +396,40 @@ NS_ASSUME_NONNULL_END
                          completion:block];
 }
 
++ (void)cachedRangesForKey:(NSString *)key
+                completion:(void(^)(NSIndexSet * _Nullable cachedRanges, NSUInteger fileLength))block
+{
+    [CACHE_CLASS cachedRangesForKey:key
+                         completion:block];
+}
+
++ (void)cachedRangesForKeySync:(NSString *)key
+                    completion:(void(^)(NSIndexSet * _Nullable cachedRanges, NSUInteger fileLength))block
+{
+    [CACHE_CLASS cachedRangesForKeySync:key
+                             completion:block];
+}
+
++ (void)setTimeIndex:(LXYVideoTimeIndex *)timeIndex forKey:(NSString *)key
+{
+    [CACHE_CLASS setTimeIndex:timeIndex
+                       forKey:key];
+}
+
++ (void)timeIndexForKey:(NSString *)key
+             completion:(void(^)(LXYVideoTimeIndex * _Nullable timeIndex, NSIndexSet * _Nullable cachedRanges))block
+{
+    [CACHE_CLASS timeIndexForKey:key
+                      completion:block];
+}
+
++ (void)timeIndexForKeySync:(NSString *)key
+                 completion:(void(^)(LXYVideoTimeIndex * _Nullable timeIndex, NSIndexSet * _Nullable cachedRanges))block
+{
+    [CACHE_CLASS timeIndexForKeySync:key
+                          completion:block];
+}
+
 + (void)hasCacheForKey:(NSString *)key
             completion:(void(^)(BOOL))block
 {
@@ -283,17 +451,45 @@ NS_ASSUME_NONNULL_END
 
 + (void)clear
 {
+    LXY_VIDEO_TRACE_RECORD(LXYVideoTraceOpCacheClear, nil, 0, 0);
+    
     [CACHE_CLASS clear];
 }
 
 + (void)clearForKeys:(NSArray<NSString *> *)keys
 {
+    if (LXYVideoTraceRecording) {
+        for (NSString *key in keys) {
+            LXYVideoTraceRecord(LXYVideoTraceOpCacheClear, key, 0, 0);
+        }
+    }
+    
     [CACHE_CLASS clearForKeys:keys];
 }
 
 + (void)trimDiskCacheToSize:(NSUInteger)size
 {
+    LXY_VIDEO_TRACE_RECORD(LXYVideoTraceOpCacheTrim, nil, 0, size);
+    
     [CACHE_CLASS trimDiskCacheToSize:size];
 }
 
++ (void)evictBytes:(NSUInteger)bytes
+       keepingSize:(NSUInteger)size
+        completion:(void(^ _Nullable)(NSUInteger evictedBytes))block
+{
+    [CACHE_CLASS evictBytes:bytes keepingSize:size completion:block];
+}
+
++ (void)importCachePackAtPath:(NSString *)packPath
+                       moving:(BOOL)moving
+                   completion:(void(^ _Nullable)(NSError * _Nullable error, NSUInteger importedCount))block
+{
+    [CACHE_CLASS importCachePackAtPath:packPath
+                                moving:moving
+                            completion:block];
+    // a pack larger than the room left is cut back by the ordinary eviction
+    [self trimDiskCacheToQuota];
+}
+
 @end
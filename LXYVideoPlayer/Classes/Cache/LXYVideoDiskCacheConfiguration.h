@@ -19,9 +19,31 @@ NS_ASSUME_NONNULL_BEGIN
 /// the size limit of the disk cache. MB
 @property (nonatomic, assign) NSUInteger costLimit;
 
+/// play time kept at the head of an entry when the disk cache is over quota. second. 10 by default
+/// the cold tails beyond it are cut before any whole entry is removed, so that the heads keep giving instant starts.
+/// 0 to remove whole entries only
+@property (nonatomic, assign) NSTimeInterval trimKeepsHeadDuration;
+
+/// free disk space under which no new prefetch is admitted. MB. 200 by default
+@property (nonatomic, assign) NSUInteger freeSpaceHighWatermark;
+
+/// free disk space under which playback does not cache either, and the disk cache is evicted step by step. MB. 20 by default
+@property (nonatomic, assign) NSUInteger freeSpaceLowWatermark;
+
+/// the disk cache kept by the eviction under storage pressure, whatever the free space. MB. 50 by default
+@property (nonatomic, assign) NSUInteger evictionKeepsCacheSize;
+
+/// reserve the extent of a cache file on the first response: the whole video for playback, the target for prefetch.
+/// keeps the file contiguous, and a prefetch out of space fails before downloading. NO by default
+@property (nonatomic, assign) BOOL preallocatesCacheFiles;
+
 /// auto trim interval of disk cache. second
 @property (nonatomic, assign) NSUInteger autoTrimInterval;
 
+/// the root directory of the disk cache. Library/LXYVideoCache if nil, by default.
+/// Attention: takes effect only if set before the first disk cache access
+@property (nonatomic, copy, nullable) NSString *cacheRootPath;
+
 /// whether use file log or not
 @property (nonatomic, assign) BOOL fileLogEnabled;
 
@@ -29,6 +51,7 @@ NS_ASSUME_NONNULL_BEGIN
 /// Note: the cache key should be unique for the same video.
 /// If two different urlStrings are mapped to ONE video, one can map them to the same cache key.
 /// In this way, the cache hit rate and disk usage efficiency will be improved, and so do the video play performance.
+/// The result is interned for each urlString, so the mapping should be a pure function. Setting it drops the interned keys.
 @property (nonatomic, copy) NSString *(^URLStringToCacheKey)(NSString *urlString);
 
 /// report the underlying status
@@ -1,4 +1,5 @@
 #import "LXYVideoDiskCacheConfiguration.h"
+#import "LXYVideoPlayerDefines.h"
 
 @implementation LXYVideoDiskCacheConfiguration
 
@@ -19,6 +20,14 @@
     if (self) {
         // 200 MB
         _costLimit = 200;
+        // 10 s
+        _trimKeepsHeadDuration = 10;
+        // 200 MB, 20 MB
+        _freeSpaceHighWatermark = 200;
+        _freeSpaceLowWatermark = 20;
+        // 50 MB
+        _evictionKeepsCacheSize = 50;
+        _preallocatesCacheFiles = NO;
         // 5 min
         _autoTrimInterval = 5 * 60;
         //
@@ -28,4 +37,11 @@
     return self;
 }
 
+- (void)setURLStringToCacheKey:(NSString *(^)(NSString *))URLStringToCacheKey
+{
+    _URLStringToCacheKey = [URLStringToCacheKey copy];
+    // the interned keys were made by the previous mapping
+    LXYVideoPurgeInternedCacheKeys();
+}
+
 @end
@@ -3,35 +3,54 @@
 NS_ASSUME_NONNULL_BEGIN
 
 /**
- * delete disk cache safely
+ * a lease on a cache item. the item is not removed while any lease on it is valid
  */
-@interface LXYVideoDiskCacheDeleteManager : NSObject
+@interface LXYVideoDiskCacheLease : NSObject
+
+/// identifier for the cache item
+@property (nonatomic, copy, readonly) NSString *key;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ * @brief release the lease. idempotent, and done on dealloc if not yet
+ */
+- (void)invalidate;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 /**
- * @brief mark a cache item with key as being used.
+ * delete disk cache safely.
  *
- * @param key   identifier for the cache item
+ * a cache item is reference counted by its leases. an item marked to be removed is removed as soon as
+ * it is not leased, immediately or when its last lease is released.
  */
-+ (void)startUseCacheForKey:(NSString *)key;
+@interface LXYVideoDiskCacheDeleteManager : NSObject
 
 /**
- * @brief mark a cache item with key as not being used.
+ * @brief lease a cache item with key, which is used until the lease is released.
  *
  * @param key   identifier for the cache item
+ *
+ * @return nil for an empty key
  */
-+ (void)endUseCacheForKey:(NSString *)key;
++ (LXYVideoDiskCacheLease * _Nullable)leaseCacheForKey:(NSString *)key;
 
 /**
- * @brief mark a cache item with key, which will be removed afterwards.
+ * @brief mark a cache item with key, which will be removed once it is not leased.
  *
  * @param key   identifier for the cache item
  */
 + (void)shouldDeleteCacheForKey:(NSString *)key;
 
 /**
- * @brief get all cache items which are beging used currently.
+ * @brief whether a cache item with key is leased currently.
+ *
+ * @param key   identifier for the cache item
  */
-+ (NSArray<NSString *> *)usingCacheItems;
++ (BOOL)isUsingCacheForKey:(NSString *)key;
 
 @end
 
@@ -1,19 +1,55 @@
 #import "LXYVideoDiskCacheDeleteManager.h"
 #import "LXYVideoPlayerDefines.h"
-#import "NSTimer+LXYVideoBlockAddition.h"
 #import "LXYVideoDiskCache.h"
 #import "LXYVideoDiskCache+Private.h"
+#import "LXYVideoLockProfiler.h"
 
 @interface LXYVideoDiskCacheDeleteManager ()
 
+// keys to remove once not leased
 @property (nonatomic, strong) NSMutableSet<NSString *> *shouldDeleteCacheSet;
 
-@property (nonatomic, strong) NSMutableSet<NSString *> *usingCacheSet;
+// valid leases counted by key
+@property (nonatomic, strong) NSCountedSet<NSString *> *usingCacheSet;
 
-@property (nonatomic, strong) NSTimer *deleteTimer;
++ (void)_releaseLease:(LXYVideoDiskCacheLease *)lease;
 
 @end
 
+@interface LXYVideoDiskCacheLease ()
+
+@property (nonatomic, copy, readwrite) NSString *key;
+
+// released yet. guarded by the manager
+@property (nonatomic, assign) BOOL invalidated;
+
+@end
+
+@implementation LXYVideoDiskCacheLease
+
+- (instancetype)initWithKey:(NSString *)key
+{
+    self = [super init];
+    if (self) {
+        _key = [key copy];
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    [LXYVideoDiskCacheDeleteManager _releaseLease:self];
+}
+
+- (void)invalidate
+{
+    [LXYVideoDiskCacheDeleteManager _releaseLease:self];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 @implementation LXYVideoDiskCacheDeleteManager
 
@@ -33,91 +69,94 @@
     self = [super init];
     if (self) {
         self.shouldDeleteCacheSet = [NSMutableSet set];
-        self.usingCacheSet = [NSMutableSet set];
-        //
-        self.deleteTimer = [NSTimer lxy_video_scheduledTimerWithTimeInterval:5 repeats:YES block:^(NSTimer *timer) {
-            [LXYVideoDiskCacheDeleteManager _deleteCachesSafely];
-        }];
+        self.usingCacheSet = [NSCountedSet set];
     }
     
     return self;
 }
 
-- (void)dealloc
-{
-    if (self.deleteTimer) {
-        [self.deleteTimer invalidate];
-        self.deleteTimer = nil;
-    }
-}
-
 #pragma mark - Public
 
-+ (void)startUseCacheForKey:(NSString *)key
++ (LXYVideoDiskCacheLease *)leaseCacheForKey:(NSString *)key
 {
     if (LXYVideo_isEmptyString(key)) {
-        return;
+        return nil;
     }
     
+    LXYVideoDiskCacheLease *lease = [[LXYVideoDiskCacheLease alloc] initWithKey:key];
+    
     LXYVideoDiskCacheDeleteManager *instance = [LXYVideoDiskCacheDeleteManager sharedInstance];
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
     @synchronized(instance)
     {
-        [instance.usingCacheSet addObject:key];
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoDiskCacheDeleteManager", waitStart);
+        
+        [instance.usingCacheSet addObject:lease.key];
     }
+    
+    return lease;
 }
 
-+ (void)endUseCacheForKey:(NSString *)key
++ (void)shouldDeleteCacheForKey:(NSString *)key
 {
     if (LXYVideo_isEmptyString(key)) {
         return;
     }
     
     LXYVideoDiskCacheDeleteManager *instance = [LXYVideoDiskCacheDeleteManager sharedInstance];
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
     @synchronized(instance)
     {
-        [instance.usingCacheSet removeObject:key];
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoDiskCacheDeleteManager", waitStart);
+        
+        // under the lock, so that no lease is taken between the check and the removal
+        if ([instance.usingCacheSet countForObject:key] > 0) {
+            [instance.shouldDeleteCacheSet addObject:key];
+        } else {
+            [LXYVideoDiskCache clearForKeys:@[key]];
+        }
     }
 }
 
-+ (void)shouldDeleteCacheForKey:(NSString *)key
++ (BOOL)isUsingCacheForKey:(NSString *)key
 {
     if (LXYVideo_isEmptyString(key)) {
-        return;
+        return NO;
     }
     
     LXYVideoDiskCacheDeleteManager *instance = [LXYVideoDiskCacheDeleteManager sharedInstance];
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
     @synchronized(instance)
     {
-        [instance.shouldDeleteCacheSet addObject:key];
-    }
-}
-
-+ (NSArray<NSString *> *)usingCacheItems
-{
-    LXYVideoDiskCacheDeleteManager *instance = [LXYVideoDiskCacheDeleteManager sharedInstance];
-    @synchronized(instance)
-    {
-        return [instance.usingCacheSet allObjects];
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoDiskCacheDeleteManager", waitStart);
+        
+        return [instance.usingCacheSet countForObject:key] > 0;
     }
 }
 
 #pragma mark - Private
 
-+ (void)_deleteCachesSafely
++ (void)_releaseLease:(LXYVideoDiskCacheLease *)lease
 {
+    NSString *key = lease.key;
+    
     LXYVideoDiskCacheDeleteManager *instance = [LXYVideoDiskCacheDeleteManager sharedInstance];
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
     @synchronized(instance)
     {
-        if (instance.shouldDeleteCacheSet.count == 0) {
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoDiskCacheDeleteManager", waitStart);
+        
+        if (lease.invalidated) {
             return;
         }
+        lease.invalidated = YES;
         
-        NSMutableSet<NSString *> *shouldDeleteCacheSet = [instance.shouldDeleteCacheSet mutableCopy];
-        [shouldDeleteCacheSet minusSet:instance.usingCacheSet];
-        //
-        [LXYVideoDiskCache clearForKeys:[shouldDeleteCacheSet allObjects]];
-        //
-        [instance.shouldDeleteCacheSet minusSet:shouldDeleteCacheSet];
+        [instance.usingCacheSet removeObject:key];
+        // the last lease is released: a pending deletion is due
+        if ([instance.usingCacheSet countForObject:key] == 0 && [instance.shouldDeleteCacheSet containsObject:key]) {
+            [instance.shouldDeleteCacheSet removeObject:key];
+            [LXYVideoDiskCache clearForKeys:@[key]];
+        }
     }
 }
 
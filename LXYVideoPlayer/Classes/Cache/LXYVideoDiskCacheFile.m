@@ -4,6 +4,113 @@
 #import "LXYVideoDiskCacheConfiguration.h"
 #import "LXYVideoPlayerDefines.h"
 #import "LXYVideoDiskCacheDeleteManager.h"
+#import "LXYVideoTimeIndex.h"
+#import "LXYVideoMP4Parser.h"
+#import "LXYVideoLockProfiler.h"
+#import "LXYVideoCachePack.h"
+#include <stdatomic.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if __has_include(<sys/clonefile.h>)
+#include <sys/clonefile.h>
+#endif
+
+// bytes read for each top-level box scan when building the time index
+static const NSUInteger kLXYTimeIndexScanSize = 64 * 1024;
+// max top-level box scans when building the time index
+static const NSUInteger kLXYTimeIndexScanMax = 8;
+// the cache key version. 1: MD5, 2: MurmurHash3, see LXYVideoURLStringToCacheKey()
+static const NSInteger kLXYCacheKeyVersion = 2;
+// whether entries of an older key version may be left. YES until the meta data is loaded
+static atomic_bool s_keyMigrationNeeded = true;
+// a copy of the legacy keys for the entry points, which run off the cache queue. nil until the meta data is loaded
+static NSSet<NSString *> *s_legacyKeys = nil;
+static pthread_mutex_t s_legacyKeysMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// reads and barrier writes of the cache queue, profiled apart
+static inline void p_cacheQueueAsync(dispatch_block_t block)
+{
+    dispatch_async([LXYVideoDiskCache cacheQueue], LXYVideoLockProfilerWrapBlock(LXY_VIDEO_LOCK_PROFILE(@"LXYVideoDiskCache.cacheQueue"), block));
+}
+
+static inline void p_cacheQueueBarrierAsync(dispatch_block_t block)
+{
+    dispatch_barrier_async([LXYVideoDiskCache cacheQueue], LXYVideoLockProfilerWrapBlock(LXY_VIDEO_LOCK_PROFILE(@"LXYVideoDiskCache.cacheQueue.barrier"), block));
+}
+
+static long long p_allocatedSizeAtPath(NSString *path)
+{
+    struct stat st;
+    if (stat(path.fileSystemRepresentation, &st) != 0) {
+        return 0;
+    }
+    
+    return (long long)st.st_blocks * 512;
+}
+
+// the file has another name, e.g. the hard link of a local playback. the data must not change in place then
+static BOOL p_isLinkedAtPath(NSString *path)
+{
+    struct stat st;
+    if (stat(path.fileSystemRepresentation, &st) != 0) {
+        return NO;
+    }
+    
+    return st.st_nlink > 1;
+}
+
+// allocate the blocks up to @length and extend the file to it. the file is left as it was on failure
+static BOOL p_preallocateFile(int fd, off_t length)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return NO;
+    }
+    if (st.st_size >= length) {
+        return YES;
+    }
+    
+#ifdef F_PREALLOCATE
+    // contiguous if possible, then any blocks
+    fstore_t store = {F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, length - st.st_size, 0};
+    BOOL allocated = fcntl(fd, F_PREALLOCATE, &store) == 0;
+    if (!allocated) {
+        store.fst_flags = F_ALLOCATEALL;
+        allocated = fcntl(fd, F_PREALLOCATE, &store) == 0;
+    }
+    if (allocated && ftruncate(fd, length) == 0) {
+        return YES;
+    }
+#else
+    if (posix_fallocate(fd, 0, length) == 0) {
+        return YES;
+    }
+#endif
+    
+    ftruncate(fd, st.st_size);
+    return NO;
+}
+
+// rename, or clone on APFS, where the clone shares the blocks until either side is written
+static BOOL p_adoptFile(NSString *fromPath, NSString *toPath, BOOL moving)
+{
+    if (moving) {
+        return rename(fromPath.fileSystemRepresentation, toPath.fileSystemRepresentation) == 0;
+    }
+    
+#if __has_include(<sys/clonefile.h>)
+    if (@available(iOS 10.0, macOS 10.12, *)) {
+        if (clonefile(fromPath.fileSystemRepresentation, toPath.fileSystemRepresentation, 0) == 0) {
+            return YES;
+        }
+    }
+#endif
+    
+    // another volume, or no clone on the file system
+    return [[NSFileManager defaultManager] copyItemAtPath:fromPath toPath:toPath error:NULL];
+}
 
 @interface LXYVideoCacheMetaData : NSObject <NSCoding>
 
@@ -13,6 +120,21 @@
 // video mimeType
 @property (nonatomic, copy) NSString *mimeType;
 
+// cached byte ranges. nil for entries written before ranges were recorded, which are cached from 0 to the file size
+@property (nonatomic, strong) NSMutableIndexSet *cachedRanges;
+
+// play time to bytes index. nil until moov is cached and parsed
+@property (nonatomic, strong) LXYVideoTimeIndex *timeIndex;
+
+// cached bytes when the time index was last tried to build. not archived
+@property (nonatomic, assign) NSUInteger timeIndexTriedBytes;
+
+// the data file extent reserved ahead of the cached ranges, thus the file size. 0 if not reserved, or all used
+@property (nonatomic, assign) NSUInteger allocatedLength;
+
+// the key version the entry is named by. 1 for entries archived without it
+@property (nonatomic, assign) NSInteger keyVersion;
+
 @end
 
 @implementation LXYVideoCacheMetaData
@@ -23,6 +145,8 @@
     if (self) {
         _fileLength = 0;
         _mimeType = nil;
+        _cachedRanges = [NSMutableIndexSet indexSet];
+        _keyVersion = kLXYCacheKeyVersion;
     }
     
     return self;
@@ -34,6 +158,10 @@
 {
     [encoder encodeInteger:self.fileLength forKey:@"fileLength"];
     [encoder encodeObject:self.mimeType forKey:@"mimeType"];
+    [encoder encodeObject:self.cachedRanges forKey:@"cachedRanges"];
+    [encoder encodeObject:self.timeIndex forKey:@"timeIndex"];
+    [encoder encodeInteger:self.allocatedLength forKey:@"allocatedLength"];
+    [encoder encodeInteger:self.keyVersion forKey:@"keyVersion"];
 }
 
 - (instancetype)initWithCoder:(NSCoder *)decoder
@@ -42,6 +170,16 @@
     if (self) {
         self.fileLength = [decoder decodeIntegerForKey:@"fileLength"];
         self.mimeType = [decoder decodeObjectForKey:@"mimeType"];
+        NSIndexSet *cachedRanges = [decoder decodeObjectForKey:@"cachedRanges"];
+        if ([cachedRanges isKindOfClass:NSIndexSet.class]) {
+            self.cachedRanges = [cachedRanges mutableCopy];
+        }
+        LXYVideoTimeIndex *timeIndex = [decoder decodeObjectForKey:@"timeIndex"];
+        if ([timeIndex isKindOfClass:LXYVideoTimeIndex.class]) {
+            self.timeIndex = timeIndex;
+        }
+        self.allocatedLength = [decoder decodeIntegerForKey:@"allocatedLength"];
+        self.keyVersion = [decoder containsValueForKey:@"keyVersion"] ? [decoder decodeIntegerForKey:@"keyVersion"] : 1;
     }
     
     return self;
@@ -49,7 +187,7 @@
 
 - (NSString *)description
 {
-    return [NSString stringWithFormat:@"fileLength = %@, mimeType = %@", @(self.fileLength), self.mimeType];
+    return [NSString stringWithFormat:@"fileLength = %@, mimeType = %@, cachedRanges = %@, timeIndex = { %@ }", @(self.fileLength), self.mimeType, self.cachedRanges, self.timeIndex];
 }
 
 @end
@@ -66,6 +204,15 @@
 // meta data for all disk cache
 @property (nonatomic, strong) NSMutableDictionary<NSString *, LXYVideoCacheMetaData *> *metaData;
 
+// meta data changed but not synced to disk yet
+@property (nonatomic, assign) BOOL metaDataDirty;
+
+// keys of the entries of an older key version, renamed at the first sight of their urls
+@property (nonatomic, strong) NSMutableSet<NSString *> *legacyKeys;
+
+// whether the cached ranges of the loaded meta have been checked against the data files
+@property (nonatomic, assign) BOOL rangesVerified;
+
 @end
 
 @implementation LXYVideoDiskCacheFile
@@ -88,8 +235,23 @@
     self = [super init];
     if (self) {
         _metaData = [NSMutableDictionary dictionary];
+        _legacyKeys = [NSMutableSet set];
         
         [self _initializeMetaData];
+        // off the first access: it stats every data file. until it runs, readers clip a copy of the ranges
+        p_cacheQueueBarrierAsync(^{
+            [self _verifyCachedRanges];
+        });
+        
+        for (NSString *key in _metaData) {
+            if (_metaData[key].keyVersion < kLXYCacheKeyVersion) {
+                [_legacyKeys addObject:key];
+            }
+        }
+        [self _publishLegacyKeys];
+        if (_legacyKeys.count > 0) {
+            LXY_VIDEO_INFO(@"cache key migration: %@ entries of an older key version", @(_legacyKeys.count));
+        }
     }
     
     return self;
@@ -136,7 +298,8 @@
              fileLength:(NSUInteger)fileLength
              completion:(void(^)(NSError *error))block
 {
-    dispatch_barrier_async([LXYVideoDiskCache cacheQueue], ^{
+    [self _migrateLegacyKeyIfNeeded:key];
+    p_cacheQueueBarrierAsync(^{
         [SINGLETON _appendCacheData:data
                              offset:offset
                              forKey:key
@@ -172,6 +335,9 @@
         [self _syncMetaData];
     }
     
+    // before writing: a legacy entry takes the current file size as its cached range
+    NSMutableIndexSet *cachedRanges = [self _mutableCachedRangesForKey:key];
+    
     NSString *filePath = [LXYVideoDiskCacheFile dataPathWithKey:key];
     if (![FILE_MANAGER fileExistsAtPath:filePath]) {
         if (![FILE_MANAGER createFileAtPath:filePath contents:nil attributes:nil]) {
@@ -199,6 +365,85 @@
         return;
     }
     
+    BOOL isContiguous = (offset <= [self _contiguousLengthOfRanges:cachedRanges fromOffset:0]);
+    [cachedRanges addIndexesInRange:NSMakeRange(offset, data.length)];
+    if (isContiguous) {
+        // losing a sequential append on crash only costs a re-download
+        [self _setNeedsSyncMetaData];
+    } else {
+        // a hole in the file must never be mistaken for data
+        [self _syncMetaData];
+    }
+    
+    block(nil);
+}
+
++ (void)reserveCacheForKey:(NSString *)key
+                  mimeType:(NSString *)mimeType
+                fileLength:(NSUInteger)fileLength
+                    length:(NSUInteger)length
+                completion:(void(^)(NSError * _Nullable error))block
+{
+    [self _migrateLegacyKeyIfNeeded:key];
+    p_cacheQueueBarrierAsync(^{
+        [SINGLETON _reserveCacheForKey:key
+                              mimeType:mimeType
+                            fileLength:fileLength
+                                length:length
+                            completion:block];
+    });
+}
+
+- (void)_reserveCacheForKey:(NSString *)key
+                   mimeType:(NSString *)mimeType
+                 fileLength:(NSUInteger)fileLength
+                     length:(NSUInteger)length
+                 completion:(void(^)(NSError * _Nullable error))block
+{
+    if (!block) {
+        return;
+    }
+    
+    if (LXYVideo_isEmptyString(key)) {
+        block(LXYError(LXYVideoCacheErrorEmptyKey, @"Reserve cache with empty key"));
+        return;
+    }
+    
+    LXYVideoCacheMetaData *metaData = self.metaData[key];
+    if (!metaData) {
+        metaData = [LXYVideoCacheMetaData new];
+        metaData.fileLength = fileLength;
+        metaData.mimeType = mimeType;
+        self.metaData[key] = metaData;
+    }
+    
+    length = MIN(length, fileLength);
+    if (length == 0 || metaData.allocatedLength >= length) {
+        block(nil);
+        return;
+    }
+    
+    NSString *filePath = [LXYVideoDiskCacheFile dataPathWithKey:key];
+    int fd = open(filePath.fileSystemRepresentation, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        block(LXYError(LXYVideoCacheErrorCreateFileFailed, @"Create new file failed"));
+        return;
+    }
+    BOOL reserved = p_preallocateFile(fd, (off_t)length);
+    int reserveErrno = errno;
+    close(fd);
+    
+    if (!reserved) {
+        LXY_VIDEO_INFO(@"%@ reserveCache failed: length = %@, errno = %d", key, @(length), reserveErrno);
+        block(LXYError(LXYVideoCacheErrorReserveFailed, [NSString stringWithFormat:@"Reserve %@ bytes failed: %s", @(length), strerror(reserveErrno)]));
+        return;
+    }
+    
+    // the file size is no longer the cached extent. the ranges were exact already, the reservation is recorded
+    // so that the trim can give back what is not used
+    metaData.allocatedLength = MAX(metaData.allocatedLength, length);
+    [self _syncMetaData];
+    
     block(nil);
 }
 
@@ -206,7 +451,8 @@
           originURLString:(NSString *)urlString
                completion:(void(^)(NSError *error, NSString *extra))block
 {
-    dispatch_barrier_async([LXYVideoDiskCache cacheQueue], ^{
+    [self _migrateLegacyKeyIfNeeded:key];
+    p_cacheQueueBarrierAsync(^{
         [SINGLETON _finishCacheForKey:key originURLString:urlString completion:block];
     });
 }
@@ -225,16 +471,23 @@
         return;
     }
     
-    // the consistency check of file size
-    NSString *filePath = [LXYVideoDiskCacheFile dataPathWithKey:key];
-    long long cacheLength = [self _fileSizeAtPath:filePath];
+    // the consistency check of cached ranges
     LXYVideoCacheMetaData *metaData = self.metaData[key];
-    if (cacheLength == 0 || metaData.fileLength == 0 || metaData.fileLength != cacheLength) {
+    NSIndexSet *cachedRanges = [self _cachedRangesForKey:key];
+    if (metaData.fileLength == 0 || ![cachedRanges containsIndexesInRange:NSMakeRange(0, metaData.fileLength)]) {
 //        LXY_VIDEO_ERROR(@"%@ finishCache error: File size not consistent", key);
         [LXYVideoDiskCacheDeleteManager shouldDeleteCacheForKey:key];
         //
         block(LXYError(LXYVideoCacheErrorCheckFailed, @"File size not consistent"), @"finish check fail");
     } else {
+        // all of the reservation is used
+        if (metaData.allocatedLength > 0) {
+            metaData.allocatedLength = 0;
+            self.metaDataDirty = YES;
+        }
+        if (self.metaDataDirty) {
+            [self _syncMetaData];
+        }
         block(nil, nil);
     }
 }
@@ -244,7 +497,8 @@
                  length:(NSUInteger)length
              completion:(void(^)(NSError * _Nullable error, NSData* _Nullable data))block
 {
-    dispatch_async([LXYVideoDiskCache cacheQueue], ^{
+    [self _migrateLegacyKeyIfNeeded:key];
+    p_cacheQueueAsync(^{
         [SINGLETON _cacheDataForKey:key offset:offset length:length completion:block];
     });
 }
@@ -298,7 +552,8 @@
 + (void)metaDataForKey:(NSString *)key
             completion:(void(^)(NSError * _Nullable error, NSString * _Nullable mimeType, NSUInteger fileLength, NSUInteger cacheLength))block
 {
-    dispatch_async([LXYVideoDiskCache cacheQueue], ^{
+    [self _migrateLegacyKeyIfNeeded:key];
+    p_cacheQueueAsync(^{
         [SINGLETON _metaDataForKey:key completion:block];
     });
 }
@@ -335,14 +590,102 @@
         return;
     }
     
-    long long cacheLength = [self _fileSizeAtPath:filePath];
-    block(nil, self.metaData[key].mimeType, self.metaData[key].fileLength, (NSUInteger)cacheLength);
+    NSUInteger cacheLength = [self _contiguousLengthOfRanges:[self _cachedRangesForKey:key] fromOffset:0];
+    block(nil, self.metaData[key].mimeType, self.metaData[key].fileLength, cacheLength);
+}
+
++ (void)cachedRangesForKey:(NSString *)key
+                completion:(void(^)(NSIndexSet * _Nullable cachedRanges, NSUInteger fileLength))block
+{
+    [self _migrateLegacyKeyIfNeeded:key];
+    p_cacheQueueAsync(^{
+        [SINGLETON _cachedRangesForKey:key completion:block];
+    });
+}
+
++ (void)cachedRangesForKeySync:(NSString *)key
+                    completion:(void(^)(NSIndexSet * _Nullable cachedRanges, NSUInteger fileLength))block
+{
+    [SINGLETON _cachedRangesForKey:key completion:block];
+}
+
+- (void)_cachedRangesForKey:(NSString *)key
+                 completion:(void(^)(NSIndexSet * _Nullable cachedRanges, NSUInteger fileLength))block
+{
+    if (!block) {
+        return;
+    }
+    
+    if (LXYVideo_isEmptyString(key) || !self.metaData[key]) {
+        block(nil, 0);
+        return;
+    }
+    
+    block([[self _cachedRangesForKey:key] copy], self.metaData[key].fileLength);
+}
+
++ (void)setTimeIndex:(LXYVideoTimeIndex *)timeIndex forKey:(NSString *)key
+{
+    [self _migrateLegacyKeyIfNeeded:key];
+    p_cacheQueueBarrierAsync(^{
+        [SINGLETON _setTimeIndex:timeIndex forKey:key];
+    });
+}
+
+- (void)_setTimeIndex:(LXYVideoTimeIndex *)timeIndex forKey:(NSString *)key
+{
+    if (LXYVideo_isEmptyString(key) || !timeIndex || !self.metaData[key]) {
+        return;
+    }
+    
+    self.metaData[key].timeIndex = timeIndex;
+    [self _setNeedsSyncMetaData];
+}
+
++ (void)timeIndexForKey:(NSString *)key
+             completion:(void(^)(LXYVideoTimeIndex * _Nullable timeIndex, NSIndexSet * _Nullable cachedRanges))block
+{
+    [self _migrateLegacyKeyIfNeeded:key];
+    p_cacheQueueAsync(^{
+        [SINGLETON _timeIndexForKey:key completion:block];
+    });
+}
+
++ (void)timeIndexForKeySync:(NSString *)key
+                 completion:(void(^)(LXYVideoTimeIndex * _Nullable timeIndex, NSIndexSet * _Nullable cachedRanges))block
+{
+    [SINGLETON _timeIndexForKey:key completion:block];
+}
+
+- (void)_timeIndexForKey:(NSString *)key
+              completion:(void(^)(LXYVideoTimeIndex * _Nullable timeIndex, NSIndexSet * _Nullable cachedRanges))block
+{
+    if (!block) {
+        return;
+    }
+    
+    LXYVideoCacheMetaData *metaData = LXYVideo_isEmptyString(key) ? nil : self.metaData[key];
+    if (!metaData) {
+        block(nil, nil);
+        return;
+    }
+    
+    NSIndexSet *cachedRanges = [self _cachedRangesForKey:key];
+    if (!metaData.timeIndex && cachedRanges.count > metaData.timeIndexTriedBytes) {
+        // more bytes since the last try, moov may be there now
+        p_cacheQueueBarrierAsync(^{
+            [self _buildTimeIndexForKey:key];
+        });
+    }
+    
+    block(metaData.timeIndex, [cachedRanges copy]);
 }
 
 + (void)hasCacheForKey:(NSString *)key
             completion:(void(^)(BOOL))block
 {
-    dispatch_async([LXYVideoDiskCache cacheQueue], ^{
+    [self _migrateLegacyKeyIfNeeded:key];
+    p_cacheQueueAsync(^{
         [SINGLETON _hasCacheForKey:key completion:block];
     });
 }
@@ -370,7 +713,8 @@
 + (void)getCacheInfoForKey:(NSString *)key
                 completion:(void(^)(BOOL hasCache, BOOL isComplete, NSString *cachePath, NSInteger fileSize))block
 {
-    dispatch_async([LXYVideoDiskCache cacheQueue], ^{
+    [self _migrateLegacyKeyIfNeeded:key];
+    p_cacheQueueAsync(^{
         [SINGLETON _getCacheInfoForKey:key completion:block];
     });
 }
@@ -389,15 +733,15 @@
     
     NSString *filePath = [LXYVideoDiskCacheFile dataPathWithKey:key];
     BOOL hasCache = [FILE_MANAGER fileExistsAtPath:filePath];
-    long long cacheSize = [self _fileSizeAtPath:filePath];
     NSInteger fileSize = self.metaData[key] ? self.metaData[key].fileLength : 0;
+    BOOL isComplete = fileSize > 0 && [[self _cachedRangesForKey:key] containsIndexesInRange:NSMakeRange(0, fileSize)];
     
-    block(hasCache, fileSize == cacheSize, filePath, fileSize);
+    block(hasCache, isComplete, filePath, fileSize);
 }
 
 + (void)sizeWithCompletion:(void(^)(NSInteger))block
 {
-    dispatch_async([LXYVideoDiskCache cacheQueue], ^{
+    p_cacheQueueAsync(^{
         [SINGLETON _sizeWithCompletion:block];
     });
 }
@@ -416,7 +760,7 @@
 
 + (void)clear
 {
-    dispatch_barrier_async([LXYVideoDiskCache cacheQueue], ^{
+    p_cacheQueueBarrierAsync(^{
         [SINGLETON _clear];
     });
 }
@@ -430,12 +774,10 @@
 
 - (void)_clearCacheSafely
 {
-    NSArray<NSString *> *usingCacheItems = [LXYVideoDiskCacheDeleteManager usingCacheItems];
-    
     NSArray<NSString *> *childFiles = [FILE_MANAGER subpathsAtPath:[LXYVideoDiskCacheFile cachePath]];
     for (NSString *filename in childFiles) {
         NSString *absolutePath = [[LXYVideoDiskCacheFile cachePath] stringByAppendingPathComponent:filename];
-        if ([usingCacheItems containsObject:filename] || [filename isEqualToString:kMetaFilename]) {
+        if ([LXYVideoDiskCacheDeleteManager isUsingCacheForKey:filename] || [filename isEqualToString:kMetaFilename]) {
             continue;
         }
         
@@ -472,7 +814,7 @@
 
 + (void)clearForKeys:(NSArray<NSString *> *)keys
 {
-    dispatch_barrier_async([LXYVideoDiskCache cacheQueue], ^{
+    p_cacheQueueBarrierAsync(^{
         [SINGLETON _clearForKeys:keys];
     });
 }
@@ -492,12 +834,27 @@
 
 + (void)trimDiskCacheToSize:(NSUInteger)size
 {
-    dispatch_barrier_async([LXYVideoDiskCache cacheQueue], ^{
-        [SINGLETON _trimDiskCacheToSize:size];
+    p_cacheQueueBarrierAsync(^{
+        [SINGLETON _trimDiskCacheToSize:size evictingAtMost:NSUIntegerMax];
+    });
+}
+
++ (void)evictBytes:(NSUInteger)bytes
+       keepingSize:(NSUInteger)size
+        completion:(void(^ _Nullable)(NSUInteger evictedBytes))block
+{
+    p_cacheQueueBarrierAsync(^{
+        NSUInteger evictedBytes = [SINGLETON _trimDiskCacheToSize:size evictingAtMost:bytes];
+        if (block) {
+            dispatch_async_on_main_queue(^{
+                block(evictedBytes);
+            });
+        }
     });
 }
 
-- (void)_trimDiskCacheToSize:(NSUInteger)size
+// trim to @size, or by @bytes if less. returns the bytes trimmed
+- (NSUInteger)_trimDiskCacheToSize:(NSUInteger)size evictingAtMost:(NSUInteger)bytes
 {
 //    LXY_VIDEO_INFO(@"trimDiskCacheToSize start");
     
@@ -522,8 +879,10 @@
         [cacheFiles setObject:resourceValues forKey:fileURL];
     }
     
+    NSUInteger originalCacheSize = cacheSize;
+    size = MAX(size, cacheSize - MIN(cacheSize, bytes));
     if (cacheSize <= size) {
-        return;
+        return 0;
     }
     
     NSArray *sortedFiles =
@@ -532,30 +891,278 @@
                                  return [obj1[NSURLContentAccessDateKey] compare:obj2[NSURLContentAccessDateKey]];
                              }];
     
-    NSArray<NSString *> *usingCacheItems = [LXYVideoDiskCacheDeleteManager usingCacheItems];
+    // unused reservations and cold tails first. a video watched once should not displace the heads of dozens of others
+    NSTimeInterval headDuration = [LXYVideoDiskCacheConfiguration sharedInstance].trimKeepsHeadDuration;
     for (NSURL *fileURL in sortedFiles) {
         NSString *filename = [[fileURL path] lastPathComponent];
-        if ([usingCacheItems containsObject:filename] || [kMetaFilename isEqualToString:filename]) {
+        if ([LXYVideoDiskCacheDeleteManager isUsingCacheForKey:filename] || [kMetaFilename isEqualToString:filename]) {
+            continue;
+        }
+        
+        long long trimmedSize = [self _releaseReservationForKey:filename];
+        if (headDuration > 0) {
+            trimmedSize += [self _trimTailForKey:filename headDuration:headDuration];
+        }
+        if (trimmedSize <= 0) {
+            continue;
+        }
+        
+        NSMutableDictionary *resourceValues = [cacheFiles[fileURL] mutableCopy];
+        NSUInteger allocatedSize = [resourceValues[NSURLTotalFileAllocatedSizeKey] unsignedIntegerValue];
+        resourceValues[NSURLTotalFileAllocatedSizeKey] = @(allocatedSize - MIN(allocatedSize, (NSUInteger)trimmedSize));
+        cacheFiles[fileURL] = resourceValues;
+        cacheSize -= MIN(cacheSize, (NSUInteger)trimmedSize);
+        LXY_VIDEO_DEBUG(@"trimDiskCacheToSize, tail of key: %@, size: %@", filename, @(trimmedSize));
+        //
+        if (cacheSize <= size) {
+            break;
+        }
+    }
+    
+    for (NSURL *fileURL in sortedFiles) {
+        if (cacheSize <= size) {
+            break;
+        }
+        
+        NSString *filename = [[fileURL path] lastPathComponent];
+        if ([LXYVideoDiskCacheDeleteManager isUsingCacheForKey:filename] || [kMetaFilename isEqualToString:filename]) {
             continue;
         }
         
         if ([FILE_MANAGER removeItemAtURL:fileURL error:NULL]) {
             NSDictionary *resourceValues = cacheFiles[fileURL];
-            cacheSize -= [resourceValues[NSURLTotalFileAllocatedSizeKey] unsignedIntegerValue];
+            cacheSize -= MIN(cacheSize, [resourceValues[NSURLTotalFileAllocatedSizeKey] unsignedIntegerValue]);
             //
             NSString *key = fileURL.absoluteString.lastPathComponent;
             if (self.metaData[key]) {
                 [self.metaData removeObjectForKey:key];
                 LXY_VIDEO_DEBUG(@"trimDiskCacheToSize, key: %@", key);
             }
-            //
-            if (cacheSize <= size) {
-                break;
-            }
         }
     }
     
     [self _syncMetaData];
+    
+    return originalCacheSize - cacheSize;
+}
+
+// give back the reserved extent of @key beyond its cached bytes, e.g. of a cancelled prefetch. returns the bytes freed on disk
+- (long long)_releaseReservationForKey:(NSString *)key
+{
+    LXYVideoCacheMetaData *metaData = self.metaData[key];
+    if (metaData.allocatedLength == 0) {
+        return 0;
+    }
+    
+    NSIndexSet *cachedRanges = [self _cachedRangesForKey:key];
+    NSUInteger cachedEnd = cachedRanges.count > 0 ? cachedRanges.lastIndex + 1 : 0;
+    NSString *filePath = [LXYVideoDiskCacheFile dataPathWithKey:key];
+    if (p_isLinkedAtPath(filePath)) {
+        return 0;
+    }
+    long long allocatedSize = p_allocatedSizeAtPath(filePath);
+    if (cachedEnd < metaData.allocatedLength && truncate(filePath.fileSystemRepresentation, (off_t)cachedEnd) != 0) {
+        return 0;
+    }
+    metaData.allocatedLength = 0;
+    
+    return allocatedSize - p_allocatedSizeAtPath(filePath);
+}
+
+// drop the cached bytes of @key beyond the first @headDuration seconds, keeping moov wherever it is.
+// the meta keeps the head, so the entry still starts instantly and the download resumes from the cut.
+// returns the bytes freed on disk
+- (long long)_trimTailForKey:(NSString *)key headDuration:(NSTimeInterval)headDuration
+{
+    // without the index, neither the head nor moov is known
+    LXYVideoTimeIndex *timeIndex = self.metaData[key].timeIndex;
+    if (!timeIndex) {
+        return 0;
+    }
+    
+    NSRange headRange = [timeIndex byteRangeFromTime:0 duration:headDuration];
+    NSRange sampleRange = [timeIndex byteRangeFromTime:0 duration:timeIndex.duration];
+    if (headRange.length == 0 || sampleRange.length == 0 || NSMaxRange(sampleRange) <= NSMaxRange(headRange)) {
+        return 0;
+    }
+    
+    NSUInteger headEnd = NSMaxRange(headRange);
+    NSUInteger samplesEnd = NSMaxRange(sampleRange);
+    NSMutableIndexSet *cachedRanges = [self _mutableCachedRangesForKey:key];
+    if (![cachedRanges intersectsIndexesInRange:NSMakeRange(headEnd, samplesEnd - headEnd)]) {
+        return 0;
+    }
+    
+    // leased entries are skipped by the caller. a link left over, e.g. by a crash during local playback, is respected too
+    NSString *filePath = [LXYVideoDiskCacheFile dataPathWithKey:key];
+    if (p_isLinkedAtPath(filePath)) {
+        return 0;
+    }
+    long long allocatedSize = p_allocatedSizeAtPath(filePath);
+    if (cachedRanges.lastIndex < samplesEnd) {
+        // moov at the head. cut the file
+        if (truncate(filePath.fileSystemRepresentation, (off_t)headEnd) != 0) {
+            return 0;
+        }
+        [cachedRanges removeIndexesInRange:NSMakeRange(headEnd, NSUIntegerMax - headEnd)];
+        self.metaData[key].allocatedLength = 0;
+    } else {
+        // moov, or other boxes, at the tail. free the samples between as a hole
+#ifdef F_PUNCHHOLE
+        int fd = open(filePath.fileSystemRepresentation, O_RDWR);
+        if (fd < 0) {
+            return 0;
+        }
+        struct stat st;
+        off_t blockSize = fstat(fd, &st) == 0 && st.st_blksize > 0 ? st.st_blksize : 4096;
+        off_t holeStart = ((off_t)headEnd + blockSize - 1) / blockSize * blockSize;
+        off_t holeEnd = (off_t)samplesEnd / blockSize * blockSize;
+        fpunchhole_t punchHole = {0, 0, holeStart, holeEnd - holeStart};
+        int result = holeEnd > holeStart ? fcntl(fd, F_PUNCHHOLE, &punchHole) : -1;
+        close(fd);
+        if (result != 0) {
+            return 0;
+        }
+        [cachedRanges removeIndexesInRange:NSMakeRange(headEnd, samplesEnd - headEnd)];
+#else
+        return 0;
+#endif
+    }
+    
+    return allocatedSize - p_allocatedSizeAtPath(filePath);
+}
+
++ (void)importCachePackAtPath:(NSString *)packPath
+                       moving:(BOOL)moving
+                   completion:(void(^ _Nullable)(NSError * _Nullable error, NSUInteger importedCount))block
+{
+    p_cacheQueueBarrierAsync(^{
+        [SINGLETON _importCachePackAtPath:packPath moving:moving completion:block];
+    });
+}
+
+- (void)_importCachePackAtPath:(NSString *)packPath
+                        moving:(BOOL)moving
+                    completion:(void(^ _Nullable)(NSError * _Nullable error, NSUInteger importedCount))block
+{
+    NSError *error = nil;
+    LXYVideoCachePack *pack = [LXYVideoCachePack packWithContentsOfPath:packPath error:&error];
+    
+    NSMutableDictionary<NSString *, LXYVideoCacheMetaData *> *importedMetaData = [NSMutableDictionary dictionary];
+    for (LXYVideoCachePackEntry *entry in pack.entries) {
+        if (self.metaData[entry.key] || entry.cachedRanges.count == 0) {
+            continue;
+        }
+        
+        // the index is trusted only as far as the data file goes
+        NSString *fromPath = [pack dataPathForEntry:entry];
+        if ([self _fileSizeAtPath:fromPath] <= (long long)entry.cachedRanges.lastIndex) {
+            LXY_VIDEO_ERROR(@"%@ cache pack entry short of data: %@", entry.key, fromPath);
+            continue;
+        }
+        
+        // a data file without meta is left by a crash between a write and the meta sync
+        NSString *toPath = [LXYVideoDiskCacheFile dataPathWithKey:entry.key];
+        [FILE_MANAGER removeItemAtPath:toPath error:NULL];
+        if (!p_adoptFile(fromPath, toPath, moving)) {
+            LXY_VIDEO_ERROR(@"%@ cache pack entry adopt failed: %@", entry.key, toPath);
+            continue;
+        }
+        // as recent as a download, not as old as the pack, for the LRU trim
+        utimes(toPath.fileSystemRepresentation, NULL);
+        
+        LXYVideoCacheMetaData *metaData = [LXYVideoCacheMetaData new];
+        metaData.fileLength = entry.fileLength;
+        metaData.mimeType = entry.mimeType;
+        metaData.cachedRanges = [entry.cachedRanges mutableCopy];
+        metaData.keyVersion = pack.keyVersion;
+        importedMetaData[entry.key] = metaData;
+    }
+    
+    // one meta sync for the whole pack
+    if (importedMetaData.count > 0) {
+        [self.metaData addEntriesFromDictionary:importedMetaData];
+        if (pack.keyVersion < kLXYCacheKeyVersion) {
+            [self.legacyKeys addObjectsFromArray:importedMetaData.allKeys];
+            [self _publishLegacyKeys];
+        }
+        [self _syncMetaData];
+    }
+    LXY_VIDEO_INFO(@"cache pack imported: %@ of %@ entries, %@", @(importedMetaData.count), @(pack.entries.count), packPath);
+    
+    if (block) {
+        NSUInteger importedCount = importedMetaData.count;
+        dispatch_async_on_main_queue(^{
+            block(error, importedCount);
+        });
+    }
+}
+
+#pragma mark - Key Migration
+
+/*
+ * an entry of the key version 1 is named by the MD5 of what its key is hashed from. it is renamed at the first
+ * access through its new key, by a barrier queued ahead of the access. the source of a key is known while the key
+ * is interned, i.e. shortly after LXYVideoURLStringToCacheKey() made it. cheap once no legacy entry is left.
+ */
++ (void)_migrateLegacyKeyIfNeeded:(NSString *)key
+{
+    if (!atomic_load_explicit(&s_keyMigrationNeeded, memory_order_relaxed)) {
+        return;
+    }
+    
+    NSString *sourceString = LXYVideoCacheKeySourceString(key);
+    if (!sourceString) {
+        return;
+    }
+    NSString *legacyKey = LXY_MD5(sourceString);
+    
+    // not loaded yet: decided on the cache queue
+    pthread_mutex_lock(&s_legacyKeysMutex);
+    BOOL mayBeLegacy = !s_legacyKeys || [s_legacyKeys containsObject:legacyKey];
+    pthread_mutex_unlock(&s_legacyKeysMutex);
+    
+    if (mayBeLegacy) {
+        p_cacheQueueBarrierAsync(^{
+            [SINGLETON _migrateLegacyKey:legacyKey toKey:key];
+        });
+    }
+}
+
+// barrier only
+- (void)_publishLegacyKeys
+{
+    NSSet<NSString *> *legacyKeys = [self.legacyKeys copy];
+    pthread_mutex_lock(&s_legacyKeysMutex);
+    s_legacyKeys = legacyKeys;
+    pthread_mutex_unlock(&s_legacyKeysMutex);
+    
+    atomic_store(&s_keyMigrationNeeded, legacyKeys.count > 0);
+}
+
+- (void)_migrateLegacyKey:(NSString *)legacyKey toKey:(NSString *)key
+{
+    if (LXYVideo_isEmptyString(legacyKey) || LXYVideo_isEmptyString(key) || ![self.legacyKeys containsObject:legacyKey]) {
+        return;
+    }
+    [self.legacyKeys removeObject:legacyKey];
+    [self _publishLegacyKeys];
+    
+    LXYVideoCacheMetaData *metaData = self.metaData[legacyKey];
+    [self.metaData removeObjectForKey:legacyKey];
+    NSString *legacyPath = [LXYVideoDiskCacheFile dataPathWithKey:legacyKey];
+    
+    // dropped if cached under the new key already, e.g. by a play before the migration
+    if (metaData && !self.metaData[key] && p_adoptFile(legacyPath, [LXYVideoDiskCacheFile dataPathWithKey:key], YES)) {
+        metaData.keyVersion = kLXYCacheKeyVersion;
+        self.metaData[key] = metaData;
+        LXY_VIDEO_DEBUG(@"cache key migrated: %@ -> %@", legacyKey, key);
+    } else {
+        [FILE_MANAGER removeItemAtPath:legacyPath error:NULL];
+    }
+    
+    // the entries of a launch are migrated one by one: coalesced
+    [self _setNeedsSyncMetaData];
 }
 
 #pragma mark - Private
@@ -604,8 +1211,188 @@ static NSString * const kMetaFilename = @"meta";
     return [[LXYVideoDiskCacheFile cachePath] stringByAppendingPathComponent:key];
 }
 
+// safe on concurrent readers: the meta is not changed
+- (NSIndexSet *)_cachedRangesForKey:(NSString *)key
+{
+    LXYVideoCacheMetaData *metaData = self.metaData[key];
+    if (!metaData || self.rangesVerified) {
+        return metaData.cachedRanges;
+    }
+    
+    // the verification is still queued
+    return [self _verifiedRanges:metaData.cachedRanges forKey:key];
+}
+
+// barrier only: the ranges are changed in place by the caller
+- (NSMutableIndexSet *)_mutableCachedRangesForKey:(NSString *)key
+{
+    LXYVideoCacheMetaData *metaData = self.metaData[key];
+    if (metaData && !self.rangesVerified) {
+        metaData.cachedRanges = [self _verifiedRanges:metaData.cachedRanges forKey:key];
+    }
+    
+    return metaData.cachedRanges;
+}
+
+// @cachedRanges clipped to the data file, which is the upper bound whatever the meta says
+- (NSMutableIndexSet *)_verifiedRanges:(NSIndexSet *)cachedRanges forKey:(NSString *)key
+{
+    struct stat fileStat;
+    NSUInteger fileSize = 0;
+    if (stat([LXYVideoDiskCacheFile dataPathWithKey:key].fileSystemRepresentation, &fileStat) == 0 && S_ISREG(fileStat.st_mode)) {
+        fileSize = (NSUInteger)fileStat.st_size;
+    }
+    
+    // a legacy entry takes the current file size as its cached range
+    if (!cachedRanges) {
+        return [NSMutableIndexSet indexSetWithIndexesInRange:NSMakeRange(0, fileSize)];
+    }
+    
+    NSMutableIndexSet *verifiedRanges = [cachedRanges mutableCopy];
+    if (verifiedRanges.lastIndex != NSNotFound && verifiedRanges.lastIndex >= fileSize) {
+        [verifiedRanges removeIndexesInRange:NSMakeRange(fileSize, verifiedRanges.lastIndex + 1 - fileSize)];
+    }
+    
+    return verifiedRanges;
+}
+
+// check the cached ranges of the loaded meta against the data files, once. barrier only
+- (void)_verifyCachedRanges
+{
+    if (self.rangesVerified) {
+        return;
+    }
+    
+    for (NSString *key in self.metaData) {
+        LXYVideoCacheMetaData *metaData = self.metaData[key];
+        metaData.cachedRanges = [self _verifiedRanges:metaData.cachedRanges forKey:key];
+    }
+    self.rangesVerified = YES;
+}
+
+// locate moov in the cached top-level boxes and build the time index from it
+- (void)_buildTimeIndexForKey:(NSString *)key
+{
+    LXYVideoCacheMetaData *metaData = self.metaData[key];
+    NSIndexSet *cachedRanges = [self _cachedRangesForKey:key];
+    if (!metaData || metaData.timeIndex || cachedRanges.count <= metaData.timeIndexTriedBytes) {
+        return;
+    }
+    metaData.timeIndexTriedBytes = cachedRanges.count;
+    
+    uint64_t scanOffset = 0;
+    for (NSUInteger i = 0; i < kLXYTimeIndexScanMax; ++i) {
+        NSUInteger availableLength = [self _contiguousLengthOfRanges:cachedRanges fromOffset:(NSUInteger)scanOffset];
+        if (availableLength < 16) {
+            return;
+        }
+        
+        NSData *data = [self _readDataForKey:key range:NSMakeRange((NSUInteger)scanOffset, MIN(availableLength, kLXYTimeIndexScanSize))];
+        NSRange moovRange = NSMakeRange(0, 0);
+        uint64_t nextBoxOffset = scanOffset;
+        LXYVideoMP4ScanResult result = [LXYVideoMP4Parser scanTopLevelBoxesInData:data ? : [NSData data]
+                                                                       dataOffset:scanOffset
+                                                                       fileLength:metaData.fileLength
+                                                                        moovRange:&moovRange
+                                                                    nextBoxOffset:&nextBoxOffset];
+        if (!data || result == LXYVideoMP4ScanResultInvalid) {
+            // not MP4, never try again
+            metaData.timeIndexTriedBytes = NSUIntegerMax;
+            return;
+        }
+        
+        if (result == LXYVideoMP4ScanResultNeedMoreData) {
+            scanOffset = nextBoxOffset;
+            continue;
+        }
+        
+        if (![cachedRanges containsIndexesInRange:moovRange]) {
+            return;
+        }
+        
+        NSError *error = nil;
+        NSData *moovData = [self _readDataForKey:key range:moovRange];
+        LXYVideoMP4Movie *movie = moovData ? [LXYVideoMP4Parser movieWithMoovData:moovData error:&error] : nil;
+        LXYVideoTimeIndex *timeIndex = movie ? [LXYVideoTimeIndex indexWithMovie:movie] : nil;
+        if (!timeIndex) {
+            LXY_VIDEO_INFO(@"%@ buildTimeIndex error: %@", key, error);
+            metaData.timeIndexTriedBytes = NSUIntegerMax;
+            return;
+        }
+        
+        LXY_VIDEO_DEBUG(@"%@ buildTimeIndex: %@", key, timeIndex);
+        metaData.timeIndex = timeIndex;
+        [self _setNeedsSyncMetaData];
+        return;
+    }
+}
+
+- (NSData *)_readDataForKey:(NSString *)key range:(NSRange)range
+{
+    NSFileHandle *handle = [NSFileHandle fileHandleForReadingAtPath:[LXYVideoDiskCacheFile dataPathWithKey:key]];
+    if (!handle) {
+        return nil;
+    }
+    
+    NSData *data = nil;
+    @try {
+        [handle seekToFileOffset:range.location];
+        data = [handle readDataOfLength:range.length];
+    } @catch (NSException *exception) {
+        data = nil;
+    }
+    
+    return data.length == range.length ? data : nil;
+}
+
+- (NSUInteger)_contiguousLengthOfRanges:(NSIndexSet *)ranges fromOffset:(NSUInteger)offset
+{
+    __block NSUInteger length = 0;
+    [ranges enumerateRangesUsingBlock:^(NSRange range, BOOL * _Nonnull stop) {
+        if (NSLocationInRange(offset, range)) {
+            length = NSMaxRange(range) - offset;
+            *stop = YES;
+        } else if (range.location > offset) {
+            *stop = YES;
+        }
+    }];
+    
+    return length;
+}
+
+// coalesce meta syncs of sequential appends
+- (void)_setNeedsSyncMetaData
+{
+    if (self.metaDataDirty) {
+        return;
+    }
+    self.metaDataDirty = YES;
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(1 * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), ^{
+        p_cacheQueueBarrierAsync(^{
+            if (self.metaDataDirty) {
+                [self _syncMetaData];
+            }
+        });
+    });
+}
+
 - (BOOL)_syncMetaData
 {
+    self.metaDataDirty = NO;
+    
+    // entries of an older key version removed by a clear or a trim
+    if (self.legacyKeys.count > 0) {
+        NSMutableSet<NSString *> *removedKeys = [NSMutableSet set];
+        for (NSString *key in self.legacyKeys) {
+            if (!self.metaData[key]) {
+                [removedKeys addObject:key];
+            }
+        }
+        [self.legacyKeys minusSet:removedKeys];
+        [self _publishLegacyKeys];
+    }
+    
     BOOL succeed = [NSKeyedArchiver archiveRootObject:self.metaData toFile:[LXYVideoDiskCacheFile metaPath]];
     if (!succeed) {
         BOOL isDirectory = NO;
@@ -1,8 +1,9 @@
-#import <UIKit/UIKit.h>
+#import <Foundation/Foundation.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
 @class LXYVideoDiskCacheConfiguration;
+@class LXYVideoTimeIndex;
 
 /**
  * video disk cache protocol
@@ -25,6 +26,21 @@ NS_ASSUME_NONNULL_BEGIN
              fileLength:(NSUInteger)fileLength
              completion:(void(^)(NSError *error))block;
 
+/**
+ * @brief reserve the first @length bytes of the data file for @key, without changing the cached ranges.
+ *        block is executed on the disk cache queue
+ *
+ * @param key       video key
+ * @param mimeType  video mimeType
+ * @param fileLength video fileLength
+ * @param length    bytes to reserve, from 0. clipped to @fileLength
+ */
++ (void)reserveCacheForKey:(NSString *)key
+                  mimeType:(NSString *)mimeType
+                fileLength:(NSUInteger)fileLength
+                    length:(NSUInteger)length
+                completion:(void(^)(NSError * _Nullable error))block;
+
 /**
  * @brief execute @block when all data for @key is cached to disk
  */
@@ -64,6 +80,36 @@ NS_ASSUME_NONNULL_BEGIN
 + (void)metaDataForKeySync:(NSString *)key
                 completion:(void(^)(NSError * _Nullable error, NSString * _Nullable mimeType, NSUInteger fileLength, NSUInteger cacheLength))block;
 
+/**
+ * @brief get the cached byte ranges for @key. the cache may have holes, e.g. a tail moov prefetched ahead of mdat
+ */
++ (void)cachedRangesForKey:(NSString *)key
+                completion:(void(^)(NSIndexSet * _Nullable cachedRanges, NSUInteger fileLength))block;
+
+/**
+ * @brief get the cached byte ranges for @key synchronously
+ */
++ (void)cachedRangesForKeySync:(NSString *)key
+                    completion:(void(^)(NSIndexSet * _Nullable cachedRanges, NSUInteger fileLength))block;
+
+/**
+ * @brief keep @timeIndex with the meta data of @key. ignored if there is no cache for @key
+ */
++ (void)setTimeIndex:(LXYVideoTimeIndex *)timeIndex forKey:(NSString *)key;
+
+/**
+ * @brief get the time index and the cached byte ranges for @key.
+ *        the index is built in background once moov is cached, thus may be nil for a while
+ */
++ (void)timeIndexForKey:(NSString *)key
+             completion:(void(^)(LXYVideoTimeIndex * _Nullable timeIndex, NSIndexSet * _Nullable cachedRanges))block;
+
+/**
+ * @brief get the time index and the cached byte ranges for @key synchronously
+ */
++ (void)timeIndexForKeySync:(NSString *)key
+                 completion:(void(^)(LXYVideoTimeIndex * _Nullable timeIndex, NSIndexSet * _Nullable cachedRanges))block;
+
 /**
  * @brief whether there is disk cache for @urlString or not
  */
@@ -103,6 +149,25 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (void)trimDiskCacheToSize:(NSUInteger)size;
 
+/**
+ * @brief evict at most @bytes in the order of the trim, never below @size in total. the cache folder is walked once.
+ *        block is executed on main queue
+ *
+ *      @evictedBytes: the bytes evicted, 0 if nothing can be
+ */
++ (void)evictBytes:(NSUInteger)bytes
+       keepingSize:(NSUInteger)size
+        completion:(void(^ _Nullable)(NSUInteger evictedBytes))block;
+
+/**
+ * @brief adopt the entries of the cache pack at @packPath. the data files are renamed into the cache if @moving,
+ *        cloned otherwise, and the meta of all entries is synced once. entries cached already are skipped.
+ *        block is executed on main queue
+ */
++ (void)importCachePackAtPath:(NSString *)packPath
+                       moving:(BOOL)moving
+                   completion:(void(^ _Nullable)(NSError * _Nullable error, NSUInteger importedCount))block;
+
 @end
 
 NS_ASSUME_NONNULL_END
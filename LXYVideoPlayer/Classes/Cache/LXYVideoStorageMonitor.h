@@ -0,0 +1,48 @@
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * storage pressure levels, by the free disk space against the watermarks of LXYVideoDiskCacheConfiguration
+ */
+typedef NS_ENUM(NSInteger, LXYVideoStoragePressure)
+{
+    LXYVideoStoragePressureNone = 0,    // above the high watermark
+    LXYVideoStoragePressureWarning,     // under the high watermark: no new prefetch
+    LXYVideoStoragePressureCritical,    // under the low watermark: playback does not cache either, the disk cache is evicted step by step
+};
+
+/// posted on main queue when the pressure level changes
+FOUNDATION_EXPORT NSString * const LXYVideoStoragePressureDidChangeNotification;
+
+/**
+ * samples the free space of the disk cache volume in background, so that no caller stats the file system.
+ *
+ * a level is left upwards only with a margin above the watermark which entered it, so that the space
+ * freed by one eviction step does not flip the level back and forth. under critical pressure, the disk cache
+ * is evicted step by step through the ordinary trim, instead of being cleared at once. the eviction keeps
+ * evictionKeepsCacheSize of LXYVideoDiskCacheConfiguration, and stops until the level changes once a step
+ * frees less space than it evicted, e.g. when the space is taken by others.
+ */
+@interface LXYVideoStorageMonitor : NSObject
+
+/// the current pressure level
+@property (atomic, assign, readonly) LXYVideoStoragePressure pressure;
+
+/// the free space last sampled. byte
+@property (atomic, assign, readonly) uint64_t freeSize;
+
+/**
+ * @brief singleton. sampling starts with the first access
+ */
++ (instancetype)sharedInstance;
+
+/**
+ * @brief sample soon, e.g. after a large write
+ */
+- (void)setNeedsUpdate;
+
+@end
+
+NS_ASSUME_NONNULL_END
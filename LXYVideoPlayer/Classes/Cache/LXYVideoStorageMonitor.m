@@ -0,0 +1,191 @@
+
+#import "LXYVideoStorageMonitor.h"
+#import "LXYVideoDiskCache.h"
+#import "LXYVideoDiskCache+Private.h"
+#import "LXYVideoDiskCacheConfiguration.h"
+#import "LXYVideoPlayerDefines.h"
+#include <sys/statvfs.h>
+
+NSString * const LXYVideoStoragePressureDidChangeNotification = @"LXYVideoStoragePressureDidChangeNotification";
+
+// sampling interval without pressure. second
+static const NSTimeInterval kLXYStorageSampleInterval = 10;
+// sampling interval under pressure, which is also the pace of the eviction steps. second
+static const NSTimeInterval kLXYStoragePressureSampleInterval = 2;
+// a level is left upwards above its watermark by this ratio more
+static const double kLXYStorageHysteresisRatio = 0.1;
+// the most bytes evicted by one step
+static const uint64_t kLXYStorageEvictionStep = 64 * 1024 * 1024;
+
+@interface LXYVideoStorageMonitor ()
+
+@property (atomic, assign, readwrite) LXYVideoStoragePressure pressure;
+@property (atomic, assign, readwrite) uint64_t freeSize;
+
+// serial queue for sampling
+@property (nonatomic, strong) dispatch_queue_t queue;
+
+// sampling timer, on @queue
+@property (nonatomic, strong) dispatch_source_t timer;
+
+// an eviction step is running
+@property (nonatomic, assign) BOOL evicting;
+
+// the free space when the last eviction step started, and the bytes it evicted. 0 if none is to be checked
+@property (nonatomic, assign) uint64_t evictionFreeSize;
+@property (nonatomic, assign) uint64_t evictedBytes;
+
+// a step freed less than it evicted, or nothing could be evicted. no more steps until the level changes
+@property (nonatomic, assign) BOOL evictionStopped;
+
+@end
+
+@implementation LXYVideoStorageMonitor
+
+#pragma mark - Life Cycle
+
++ (instancetype)sharedInstance
+{
+    static LXYVideoStorageMonitor *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instance = [LXYVideoStorageMonitor new];
+    });
+    
+    return instance;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        dispatch_queue_attr_t attr = NULL;
+        if (@available(iOS 8.0, *)) {
+            attr = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0);
+        }
+        _queue = dispatch_queue_create("com.LXYVideoPlayer.LXYVideoStorageMonitor", attr);
+        
+        _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+        __weak typeof(self) weakSelf = self;
+        dispatch_source_set_event_handler(_timer, ^{
+            [weakSelf _update];
+        });
+        [self _scheduleTimer];
+        
+        // the level is None until the first sample, which does not block the first access
+        dispatch_async(_queue, ^{
+            [self _update];
+        });
+        dispatch_resume(_timer);
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_timer) {
+        dispatch_source_cancel(_timer);
+    }
+}
+
+#pragma mark - Public
+
+- (void)setNeedsUpdate
+{
+    dispatch_async(self.queue, ^{
+        [self _update];
+    });
+}
+
+#pragma mark - Private
+
+- (void)_scheduleTimer
+{
+    NSTimeInterval interval = self.pressure == LXYVideoStoragePressureNone ? kLXYStorageSampleInterval : kLXYStoragePressureSampleInterval;
+    uint64_t intervalNanoseconds = (uint64_t)(interval * NSEC_PER_SEC);
+    dispatch_source_set_timer(self.timer, dispatch_time(DISPATCH_TIME_NOW, intervalNanoseconds), intervalNanoseconds, intervalNanoseconds / 10);
+}
+
+- (void)_update
+{
+    struct statvfs stat;
+    if (statvfs([LXYVideoDiskCache cachePath].fileSystemRepresentation, &stat) != 0) {
+        return;
+    }
+    
+    uint64_t freeSize = (uint64_t)stat.f_bavail * stat.f_frsize;
+    self.freeSize = freeSize;
+    
+    LXYVideoDiskCacheConfiguration *config = [LXYVideoDiskCacheConfiguration sharedInstance];
+    uint64_t highWatermark = (uint64_t)config.freeSpaceHighWatermark * 1024 * 1024;
+    uint64_t lowWatermark = MIN((uint64_t)config.freeSpaceLowWatermark * 1024 * 1024, highWatermark);
+    
+    LXYVideoStoragePressure pressure = self.pressure;
+    LXYVideoStoragePressure newPressure = pressure;
+    if (freeSize < lowWatermark) {
+        newPressure = LXYVideoStoragePressureCritical;
+    } else if (freeSize < highWatermark) {
+        newPressure = MAX(pressure, LXYVideoStoragePressureWarning);
+        if (pressure == LXYVideoStoragePressureCritical && freeSize >= lowWatermark * (1 + kLXYStorageHysteresisRatio)) {
+            newPressure = LXYVideoStoragePressureWarning;
+        }
+    } else if (freeSize >= highWatermark * (1 + kLXYStorageHysteresisRatio)) {
+        newPressure = LXYVideoStoragePressureNone;
+    } else {
+        newPressure = MIN(pressure, LXYVideoStoragePressureWarning);
+    }
+    
+    if (newPressure != pressure) {
+        LXY_VIDEO_INFO(@"storage pressure: %@ -> %@, free size = %@", @(pressure), @(newPressure), @(freeSize));
+        self.pressure = newPressure;
+        self.evictionStopped = NO;
+        self.evictedBytes = 0;
+        [self _scheduleTimer];
+        dispatch_async_on_main_queue(^{
+            [[NSNotificationCenter defaultCenter] postNotificationName:LXYVideoStoragePressureDidChangeNotification object:self];
+        });
+    }
+    
+    // a warning only stops the prefetch admission
+    if (newPressure != LXYVideoStoragePressureCritical || self.evicting) {
+        return;
+    }
+    
+    // the space freed by the last step, sampled now that it is done
+    if (self.evictedBytes > 0) {
+        uint64_t freedSize = freeSize > self.evictionFreeSize ? freeSize - self.evictionFreeSize : 0;
+        if (freedSize < self.evictedBytes) {
+            LXY_VIDEO_WARN(@"storage eviction stopped: %@ bytes evicted, %@ bytes freed", @(self.evictedBytes), @(freedSize));
+            self.evictionStopped = YES;
+        }
+        self.evictedBytes = 0;
+    }
+    
+    // as far as the critical level is left, a step at a time
+    uint64_t target = lowWatermark * (1 + kLXYStorageHysteresisRatio);
+    if (!self.evictionStopped && target > freeSize) {
+        [self _evictBytes:MIN(target - freeSize, kLXYStorageEvictionStep) freeSize:freeSize];
+    }
+}
+
+- (void)_evictBytes:(uint64_t)bytes freeSize:(uint64_t)freeSize
+{
+    self.evicting = YES;
+    self.evictionFreeSize = freeSize;
+    
+    // the ordinary trim: cold tails first, then whole entries by LRU
+    NSUInteger keptSize = [LXYVideoDiskCacheConfiguration sharedInstance].evictionKeepsCacheSize * 1024 * 1024;
+    [LXYVideoDiskCache evictBytes:(NSUInteger)bytes keepingSize:keptSize completion:^(NSUInteger evictedBytes) {
+        dispatch_async(self.queue, ^{
+            self.evicting = NO;
+            self.evictedBytes = evictedBytes;
+            if (evictedBytes == 0) {
+                LXY_VIDEO_WARN(@"storage eviction stopped: nothing to evict above %@ bytes", @(keptSize));
+                self.evictionStopped = YES;
+            }
+        });
+    }];
+}
+
+@end
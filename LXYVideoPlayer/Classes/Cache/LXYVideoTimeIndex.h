@@ -0,0 +1,43 @@
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class LXYVideoMP4Movie;
+
+/**
+ * compact map from play time to the file bytes holding the samples, built from the MP4 sample tables.
+ * the timeline is split into fixed intervals, each keeping the byte span of its samples of all tracks.
+ * immutable, thus thread safe.
+ */
+@interface LXYVideoTimeIndex : NSObject <NSSecureCoding>
+
+/// movie duration. second
+@property (nonatomic, assign, readonly) NSTimeInterval duration;
+
+/// time interval of each index entry. second
+@property (nonatomic, assign, readonly) NSTimeInterval interval;
+
+/**
+ * @brief build from a parsed moov. nil if there is no sample
+ */
++ (instancetype _Nullable)indexWithMovie:(LXYVideoMP4Movie *)movie;
+
+/**
+ * @brief how many seconds can be played from @time with the bytes in @cachedRanges
+ */
+- (NSTimeInterval)cachedDurationFromTime:(NSTimeInterval)time cachedRanges:(NSIndexSet * _Nullable)cachedRanges;
+
+/**
+ * @brief bytes to load beyond @cachedRanges, so that [@time, @time + @duration) can be played
+ */
+- (NSUInteger)bytesNeededFromTime:(NSTimeInterval)time duration:(NSTimeInterval)duration cachedRanges:(NSIndexSet * _Nullable)cachedRanges;
+
+/**
+ * @brief the file range spanning the samples of [@time, @time + @duration). length 0 if there is no sample
+ */
+- (NSRange)byteRangeFromTime:(NSTimeInterval)time duration:(NSTimeInterval)duration;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,201 @@
+
+#import "LXYVideoTimeIndex.h"
+#import "LXYVideoMP4Parser.h"
+
+// the finest interval of index entries. second
+static const NSTimeInterval kLXYTimeIndexMinInterval = 0.25;
+// index entries are merged into coarser intervals beyond this count
+static const NSUInteger kLXYTimeIndexMaxEntryCount = 1024;
+
+// the byte span of the samples within one interval. end == 0 if there is no sample. little endian when archived
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+} LXYTimeIndexEntry;
+
+@interface LXYVideoTimeIndex ()
+
+@property (nonatomic, assign, readwrite) NSTimeInterval duration;
+@property (nonatomic, assign, readwrite) NSTimeInterval interval;
+
+// LXYTimeIndexEntry array
+@property (nonatomic, copy) NSData *entries;
+
+@end
+
+@implementation LXYVideoTimeIndex
+
++ (instancetype)indexWithMovie:(LXYVideoMP4Movie *)movie
+{
+    NSTimeInterval duration = movie.duration;
+    for (LXYVideoMP4Track *track in movie.tracks) {
+        duration = MAX(duration, track.duration);
+    }
+    if (duration <= 0) {
+        return nil;
+    }
+
+    NSTimeInterval interval = MAX(kLXYTimeIndexMinInterval, duration / kLXYTimeIndexMaxEntryCount);
+    NSUInteger count = MAX((NSUInteger)ceil(duration / interval), 1);
+    NSMutableData *entries = [NSMutableData dataWithLength:count * sizeof(LXYTimeIndexEntry)];
+    LXYTimeIndexEntry *entryBytes = entries.mutableBytes;
+
+    __block BOOL hasSample = NO;
+    for (LXYVideoMP4Track *track in movie.tracks) {
+        [track enumerateSamplesUsingBlock:^(uint64_t offset, uint32_t size, NSTimeInterval decodeTime, BOOL isSync, BOOL *stop) {
+            if (size == 0) {
+                return;
+            }
+
+            NSUInteger index = MIN((NSUInteger)MAX(decodeTime / interval, 0), count - 1);
+            LXYTimeIndexEntry *entry = &entryBytes[index];
+            if (entry->end == 0) {
+                entry->start = offset;
+                entry->end = offset + size;
+            } else {
+                entry->start = MIN(entry->start, offset);
+                entry->end = MAX(entry->end, offset + size);
+            }
+            hasSample = YES;
+        }];
+    }
+    if (!hasSample) {
+        return nil;
+    }
+
+    for (NSUInteger i = 0; i < count; ++i) {
+        entryBytes[i].start = CFSwapInt64HostToLittle(entryBytes[i].start);
+        entryBytes[i].end = CFSwapInt64HostToLittle(entryBytes[i].end);
+    }
+
+    LXYVideoTimeIndex *timeIndex = [LXYVideoTimeIndex new];
+    timeIndex.duration = duration;
+    timeIndex.interval = interval;
+    timeIndex.entries = entries;
+
+    return timeIndex;
+}
+
+#pragma mark - Public
+
+- (NSTimeInterval)cachedDurationFromTime:(NSTimeInterval)time cachedRanges:(NSIndexSet *)cachedRanges
+{
+    time = MAX(time, 0);
+    if (time >= self.duration) {
+        return 0;
+    }
+
+    NSUInteger count = [self _entryCount];
+    NSUInteger index = [self _entryIndexForTime:time];
+    for (; index < count; ++index) {
+        NSRange range = [self _byteRangeAtIndex:index];
+        if (range.length > 0 && ![cachedRanges containsIndexesInRange:range]) {
+            break;
+        }
+    }
+
+    return MAX(MIN(index * self.interval, self.duration) - time, 0);
+}
+
+- (NSUInteger)bytesNeededFromTime:(NSTimeInterval)time duration:(NSTimeInterval)duration cachedRanges:(NSIndexSet *)cachedRanges
+{
+    NSMutableIndexSet *neededRanges = [NSMutableIndexSet indexSet];
+    [self _enumerateByteRangesFromTime:time duration:duration usingBlock:^(NSRange range) {
+        [neededRanges addIndexesInRange:range];
+    }];
+
+    [cachedRanges enumerateRangesUsingBlock:^(NSRange range, BOOL * _Nonnull stop) {
+        [neededRanges removeIndexesInRange:range];
+    }];
+
+    return neededRanges.count;
+}
+
+- (NSRange)byteRangeFromTime:(NSTimeInterval)time duration:(NSTimeInterval)duration
+{
+    __block NSUInteger start = NSUIntegerMax;
+    __block NSUInteger end = 0;
+    [self _enumerateByteRangesFromTime:time duration:duration usingBlock:^(NSRange range) {
+        start = MIN(start, range.location);
+        end = MAX(end, NSMaxRange(range));
+    }];
+
+    return end > 0 ? NSMakeRange(start, end - start) : NSMakeRange(0, 0);
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"duration = %.2f, interval = %.2f, entries = %@", self.duration, self.interval, @([self _entryCount])];
+}
+
+#pragma mark - Private
+
+- (NSUInteger)_entryCount
+{
+    return self.entries.length / sizeof(LXYTimeIndexEntry);
+}
+
+- (NSUInteger)_entryIndexForTime:(NSTimeInterval)time
+{
+    return (NSUInteger)(MAX(time, 0) / self.interval);
+}
+
+- (NSRange)_byteRangeAtIndex:(NSUInteger)index
+{
+    const LXYTimeIndexEntry *entry = (const LXYTimeIndexEntry *)self.entries.bytes + index;
+    uint64_t start = CFSwapInt64LittleToHost(entry->start);
+    uint64_t end = CFSwapInt64LittleToHost(entry->end);
+    if (end <= start || end > NSUIntegerMax) {
+        return NSMakeRange(0, 0);
+    }
+
+    return NSMakeRange((NSUInteger)start, (NSUInteger)(end - start));
+}
+
+- (void)_enumerateByteRangesFromTime:(NSTimeInterval)time duration:(NSTimeInterval)duration usingBlock:(void(^)(NSRange range))block
+{
+    if (duration <= 0) {
+        return;
+    }
+
+    NSUInteger count = [self _entryCount];
+    NSUInteger endIndex = MIN((NSUInteger)ceil((MAX(time, 0) + duration) / self.interval), count);
+    for (NSUInteger index = [self _entryIndexForTime:time]; index < endIndex; ++index) {
+        NSRange range = [self _byteRangeAtIndex:index];
+        if (range.length > 0) {
+            block(range);
+        }
+    }
+}
+
+#pragma mark - NSSecureCoding
+
++ (BOOL)supportsSecureCoding
+{
+    return YES;
+}
+
+- (void)encodeWithCoder:(NSCoder *)encoder
+{
+    [encoder encodeDouble:self.duration forKey:@"duration"];
+    [encoder encodeDouble:self.interval forKey:@"interval"];
+    [encoder encodeObject:self.entries forKey:@"entries"];
+}
+
+- (instancetype)initWithCoder:(NSCoder *)decoder
+{
+    self = [super init];
+    if (self) {
+        _duration = [decoder decodeDoubleForKey:@"duration"];
+        _interval = [decoder decodeDoubleForKey:@"interval"];
+        NSData *entries = [decoder decodeObjectOfClass:NSData.class forKey:@"entries"];
+        if (_interval <= 0 || ![entries isKindOfClass:NSData.class] || entries.length % sizeof(LXYTimeIndexEntry) != 0) {
+            return nil;
+        }
+        _entries = [entries copy];
+    }
+
+    return self;
+}
+
+@end
@@ -13,9 +13,16 @@
 #import <LXYVideoPlayer/LXYVideoPlayerController+PlayControl.h>
 #import <LXYVideoPlayer/LXYVideoDiskCache.h>
 #import <LXYVideoPlayer/LXYVideoDiskCacheConfiguration.h>
+#import <LXYVideoPlayer/LXYVideoCachePack.h>
+#import <LXYVideoPlayer/LXYVideoStorageMonitor.h>
 #import <LXYVideoPlayer/LXYVideoPrefetchHitRecorder.h>
+#import <LXYVideoPlayer/LXYVideoHistogram.h>
+#import <LXYVideoPlayer/LXYVideoTraceRecorder.h>
+#import <LXYVideoPlayer/LXYVideoLockProfiler.h>
 #import <LXYVideoPlayer/LXYVideoPlayerControllerDelegate.h>
 #import <LXYVideoPlayer/LXYVideoPlayerEnumDefines.h>
+#import <LXYVideoPlayer/LXYVideoRenditionSelector.h>
+#import <LXYVideoPlayer/LXYVideoPlaybackMetrics.h>
 #import <LXYVideoPlayer/LXYVideoNetworkDelegate.h>
 #import <LXYVideoPlayer/LXYVideoLogger.h>
 
@@ -0,0 +1,310 @@
+
+#import "LXYVideoLogger.h"
+
+#import <pthread.h>
+#import <stdatomic.h>
+#import <mach/mach_time.h>
+
+#define LXY_BINARY_LOG_RING_CAPACITY    512             // records per thread, power of 2
+#define LXY_BINARY_LOG_DRAIN_INTERVAL   1               // second
+#define LXY_BINARY_LOG_MAGIC            0x4259584C      // "LXYB"
+#define LXY_BINARY_LOG_VERSION          1
+
+#if DEBUG
+LXYVideoLoggerLevel LXYVideoBinaryLogLevel = LXYVideoLoggerLevelDebug;
+#else
+LXYVideoLoggerLevel LXYVideoBinaryLogLevel = LXYVideoLoggerLevelInfo;
+#endif
+
+typedef struct {
+    uint64_t timestamp;         // mach_absolute_time
+    uint16_t event;
+    uint8_t level;
+    uint8_t reserved;
+    uint32_t threadID;
+    int64_t args[3];
+} LXYVideoBinaryRecord;
+
+// the dump starts with the header, followed by the records
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t timebaseNumer;
+    uint32_t timebaseDenom;
+    uint64_t baseTimestamp;
+    double baseTime;            // seconds since 1970 at @baseTimestamp
+    uint64_t droppedCount;
+} LXYVideoBinaryDumpHeader;
+
+// single producer: the thread owning the ring. single consumer: LXYVideoBinaryLogCopyRecords
+typedef struct LXYVideoBinaryRing {
+    _Atomic(uint64_t) head;
+    _Atomic(uint64_t) tail;
+    _Atomic(uint64_t) dropped;
+    atomic_bool inUse;          // owned by a live thread
+    uint32_t threadID;
+    struct LXYVideoBinaryRing *next;
+    LXYVideoBinaryRecord records[LXY_BINARY_LOG_RING_CAPACITY];
+} LXYVideoBinaryRing;
+
+// rings are never freed: the ring of an exited thread is adopted by the next new thread
+static _Atomic(LXYVideoBinaryRing *) s_rings = NULL;
+static __thread LXYVideoBinaryRing *t_ring = NULL;
+static pthread_key_t s_ringKey;
+static pthread_mutex_t s_consumerMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static mach_timebase_info_data_t s_timebase;
+static uint64_t s_baseTimestamp = 0;
+static double s_baseTime = 0;
+static dispatch_source_t s_drainTimer = nil;
+// the drain timer is suspended while there is nothing to drain, and resumed by the next record
+static atomic_bool s_drainSuspended = false;
+
+static void p_releaseRing(void *ring)
+{
+    atomic_store_explicit(&((LXYVideoBinaryRing *)ring)->inUse, false, memory_order_release);
+}
+
+static void p_drain(void);
+
+static void p_initializeIfNeeded(void)
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&s_timebase);
+        s_baseTimestamp = mach_absolute_time();
+        s_baseTime = [[NSDate date] timeIntervalSince1970];
+        pthread_key_create(&s_ringKey, p_releaseRing);
+        
+        dispatch_queue_t queue = dispatch_queue_create("com.LXYVideoPlayer.LXYVideoBinaryLog", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+        s_drainTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+        // no hurry to drain: a wide leeway lets the system coalesce the wakeups
+        dispatch_source_set_timer(s_drainTimer,
+                                  dispatch_time(DISPATCH_TIME_NOW, LXY_BINARY_LOG_DRAIN_INTERVAL * NSEC_PER_SEC),
+                                  LXY_BINARY_LOG_DRAIN_INTERVAL * NSEC_PER_SEC,
+                                  LXY_BINARY_LOG_DRAIN_INTERVAL * NSEC_PER_SEC / 2);
+        dispatch_source_set_event_handler(s_drainTimer, ^{
+            p_drain();
+        });
+        dispatch_resume(s_drainTimer);
+    });
+}
+
+static LXYVideoBinaryRing *p_ringForCurrentThread(void)
+{
+    LXYVideoBinaryRing *ring = t_ring;
+    if (ring) {
+        return ring;
+    }
+    
+    p_initializeIfNeeded();
+    
+    for (ring = atomic_load_explicit(&s_rings, memory_order_acquire); ring; ring = ring->next) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong_explicit(&ring->inUse, &expected, true, memory_order_acquire, memory_order_relaxed)) {
+            break;
+        }
+    }
+    
+    if (!ring) {
+        ring = calloc(1, sizeof(LXYVideoBinaryRing));
+        if (!ring) {
+            return NULL;
+        }
+        atomic_init(&ring->inUse, true);
+        
+        LXYVideoBinaryRing *first = atomic_load_explicit(&s_rings, memory_order_relaxed);
+        do {
+            ring->next = first;
+        } while (!atomic_compare_exchange_weak_explicit(&s_rings, &first, ring, memory_order_release, memory_order_relaxed));
+    }
+    
+    uint64_t threadID = 0;
+    pthread_threadid_np(NULL, &threadID);
+    ring->threadID = (uint32_t)threadID;
+    
+    t_ring = ring;
+    pthread_setspecific(s_ringKey, ring);
+    
+    return ring;
+}
+
+static NSString *p_formatForEvent(uint16_t event)
+{
+    switch (event) {
+        case LXYVideoLogEventRequestStart:
+            return @"startTaskWithRange: task = 0x%llx, range = (%lld, %lld)";
+        case LXYVideoLogEventRequestData:
+            return @"data: task = 0x%llx, length = %lld, offset = %lld";
+        case LXYVideoLogEventRequestComplete:
+            return @"didComplete: task = 0x%llx, cacheLength = %lld, fileLength = %lld";
+        case LXYVideoLogEventRequestFail:
+            return @"didCompleteWithError: task = 0x%llx, code = %lld";
+        case LXYVideoLogEventReadAheadSuspend:
+            return @"read-ahead suspend: loader = 0x%llx, offset = %lld, windowEnd = %lld";
+        case LXYVideoLogEventReadAheadResume:
+            return @"read-ahead resume: loader = 0x%llx, offset = %lld, windowEnd = %lld";
+        case LXYVideoLogEventSeekRangeDownload:
+            return @"range download for seek: loader = 0x%llx, offset = %lld, cacheLength = %lld";
+        default:
+            return nil;
+    }
+}
+
+static int p_compareRecords(const void *left, const void *right)
+{
+    uint64_t leftTimestamp = ((const LXYVideoBinaryRecord *)left)->timestamp;
+    uint64_t rightTimestamp = ((const LXYVideoBinaryRecord *)right)->timestamp;
+    
+    return leftTimestamp < rightTimestamp ? -1 : (leftTimestamp > rightTimestamp ? 1 : 0);
+}
+
+static BOOL p_enumerateDump(NSData *data, void(^block)(LXYVideoLoggerLevel level, NSString *line))
+{
+    if (data.length < sizeof(LXYVideoBinaryDumpHeader)) {
+        return NO;
+    }
+    
+    LXYVideoBinaryDumpHeader header;
+    [data getBytes:&header length:sizeof(header)];
+    if (   header.magic != LXY_BINARY_LOG_MAGIC
+        || header.version != LXY_BINARY_LOG_VERSION
+        || header.timebaseDenom == 0
+        || (data.length - sizeof(header)) % sizeof(LXYVideoBinaryRecord) != 0) {
+        return NO;
+    }
+    
+    if (header.droppedCount > 0) {
+        block(LXYVideoLoggerLevelWarn, [NSString stringWithFormat:@"binary log: %llu records dropped", header.droppedCount]);
+    }
+    
+    // the rings are drained one by one, order the records by time
+    NSUInteger count = (data.length - sizeof(header)) / sizeof(LXYVideoBinaryRecord);
+    NSMutableData *records = [[data subdataWithRange:NSMakeRange(sizeof(header), data.length - sizeof(header))] mutableCopy];
+    qsort(records.mutableBytes, count, sizeof(LXYVideoBinaryRecord), p_compareRecords);
+    
+    const LXYVideoBinaryRecord *record = records.bytes;
+    for (NSUInteger i = 0; i < count; ++i, ++record) {
+        double elapsed = ((double)record->timestamp - (double)header.baseTimestamp) * header.timebaseNumer / header.timebaseDenom / NSEC_PER_SEC;
+        NSString *format = p_formatForEvent(record->event);
+        NSString *message = nil;
+        if (format) {
+            message = [[NSString alloc] initWithFormat:format, record->args[0], record->args[1], record->args[2]];
+        } else {
+            message = [NSString stringWithFormat:@"event %u: %lld, %lld, %lld",
+                       record->event, record->args[0], record->args[1], record->args[2]];
+        }
+        
+        block((LXYVideoLoggerLevel)record->level,
+              [NSString stringWithFormat:@"[%.6f %u] %@", header.baseTime + elapsed, record->threadID, message]);
+    }
+    
+    return YES;
+}
+
+static BOOL p_hasPendingRecords(void)
+{
+    for (LXYVideoBinaryRing *ring = atomic_load_explicit(&s_rings, memory_order_acquire); ring; ring = ring->next) {
+        if (atomic_load(&ring->head) != atomic_load_explicit(&ring->tail, memory_order_relaxed)) {
+            return YES;
+        }
+    }
+    
+    return NO;
+}
+
+// on the drain timer queue
+static void p_drain(void)
+{
+    NSData *data = LXYVideoBinaryLogCopyRecords();
+    if (data.length > sizeof(LXYVideoBinaryDumpHeader)) {
+        p_enumerateDump(data, ^(LXYVideoLoggerLevel level, NSString *line) {
+            LXY_VIDEO_Log(level, __FILE__, __LINE__, @"%@", line);
+        });
+        return;
+    }
+    
+    // idle. suspended before the flag is set, so that a writer never resumes it unbalanced
+    dispatch_suspend(s_drainTimer);
+    atomic_store(&s_drainSuspended, true);
+    
+    // a record written before the flag was set has not seen it
+    if (p_hasPendingRecords() && atomic_exchange(&s_drainSuspended, false)) {
+        dispatch_resume(s_drainTimer);
+    }
+}
+
+#pragma mark - Public
+
+void LXY_VIDEO_BinaryLog(LXYVideoLoggerLevel level, LXYVideoLogEvent event, int64_t arg0, int64_t arg1, int64_t arg2)
+{
+    LXYVideoBinaryRing *ring = p_ringForCurrentThread();
+    if (!ring) {
+        return;
+    }
+    
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= LXY_BINARY_LOG_RING_CAPACITY) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    
+    LXYVideoBinaryRecord *record = &ring->records[head & (LXY_BINARY_LOG_RING_CAPACITY - 1)];
+    record->timestamp = mach_absolute_time();
+    record->event = event;
+    record->level = (uint8_t)level;
+    record->threadID = ring->threadID;
+    record->args[0] = arg0;
+    record->args[1] = arg1;
+    record->args[2] = arg2;
+    
+    // sequentially consistent against the suspension in p_drain, no dearer than release and acquire on arm64
+    atomic_store(&ring->head, head + 1);
+    if (atomic_load(&s_drainSuspended) && atomic_exchange(&s_drainSuspended, false)) {
+        dispatch_resume(s_drainTimer);
+    }
+}
+
+NSData *LXYVideoBinaryLogCopyRecords(void)
+{
+    p_initializeIfNeeded();
+    
+    LXYVideoBinaryDumpHeader header = {0};
+    header.magic = LXY_BINARY_LOG_MAGIC;
+    header.version = LXY_BINARY_LOG_VERSION;
+    header.timebaseNumer = s_timebase.numer;
+    header.timebaseDenom = s_timebase.denom;
+    header.baseTimestamp = s_baseTimestamp;
+    header.baseTime = s_baseTime;
+    
+    NSMutableData *data = [NSMutableData dataWithLength:sizeof(header)];
+    
+    pthread_mutex_lock(&s_consumerMutex);
+    for (LXYVideoBinaryRing *ring = atomic_load_explicit(&s_rings, memory_order_acquire); ring; ring = ring->next) {
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        for (; tail < head; ++tail) {
+            [data appendBytes:&ring->records[tail & (LXY_BINARY_LOG_RING_CAPACITY - 1)] length:sizeof(LXYVideoBinaryRecord)];
+        }
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        
+        header.droppedCount += atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&s_consumerMutex);
+    
+    [data replaceBytesInRange:NSMakeRange(0, sizeof(header)) withBytes:&header];
+    
+    return data;
+}
+
+NSString *LXYVideoBinaryLogDecode(NSData *data)
+{
+    NSMutableString *content = [NSMutableString string];
+    BOOL valid = p_enumerateDump(data, ^(LXYVideoLoggerLevel level, NSString *line) {
+        [content appendFormat:@"%@\n", line];
+    });
+    
+    return valid ? content : nil;
+}
@@ -47,4 +47,67 @@ FOUNDATION_EXTERN NSArray<NSString *> *LXYVideoSortedLogFilePaths();
 #define LXY_VIDEO_WARN(FMT, ...)    LXY_VIDEO_Log(LXYVideoLoggerLevelWarn,  __FILE__, __LINE__, @"%@", LXY_VIDEO_STRINGIFY(FMT, ##__VA_ARGS__))
 #define LXY_VIDEO_ERROR(FMT, ...)   LXY_VIDEO_Log(LXYVideoLoggerLevelError, __FILE__, __LINE__, @"%@", LXY_VIDEO_STRINGIFY(FMT, ##__VA_ARGS__))
 
+/*
+ * binary log for the hot paths, e.g. per task and per chunk.
+ *
+ * a record is an event id with up to 3 integer arguments, written into a lock-free ring buffer of the calling thread.
+ * no string is formatted at the call site: the records are formatted with the format of the event later,
+ * by the background drain into LXY_VIDEO_Log, or by LXYVideoBinaryLogDecode from a dump.
+ * a record is dropped if the buffer is full.
+ */
+
+typedef NS_ENUM(uint16_t, LXYVideoLogEvent)
+{
+    LXYVideoLogEventRequestStart = 1,       // task, location, length
+    LXYVideoLogEventRequestData,            // task, length, offset
+    LXYVideoLogEventRequestComplete,        // task, cacheLength, fileLength
+    LXYVideoLogEventRequestFail,            // task, error code
+    LXYVideoLogEventReadAheadSuspend,       // loader, offset, window end
+    LXYVideoLogEventReadAheadResume,        // loader, offset, window end
+    LXYVideoLogEventSeekRangeDownload,      // loader, offset, cacheLength
+    LXYVideoLogEventCount,
+};
+
+/**
+ * @brief the max level of binary records written. LXYVideoLoggerLevelInfo by default, LXYVideoLoggerLevelDebug for DEBUG
+ */
+FOUNDATION_EXTERN LXYVideoLoggerLevel LXYVideoBinaryLogLevel;
+
+/**
+ * @brief write a binary record. USE MACRO INSTEAD
+ */
+FOUNDATION_EXTERN void LXY_VIDEO_BinaryLog(LXYVideoLoggerLevel level, LXYVideoLogEvent event, int64_t arg0, int64_t arg1, int64_t arg2);
+
+/**
+ * @brief take the records not drained yet out of the ring buffers, as a dump for LXYVideoBinaryLogDecode
+ */
+FOUNDATION_EXTERN NSData * _Nonnull LXYVideoBinaryLogCopyRecords(void);
+
+/**
+ * @brief format a dump of LXYVideoBinaryLogCopyRecords, one line per record. nil if @data is not a dump
+ */
+FOUNDATION_EXTERN NSString * _Nullable LXYVideoBinaryLogDecode(NSData * _Nonnull data);
+
+// levels above it are compiled out
+#ifndef LXY_VIDEO_BINARY_LOG_MAX_LEVEL
+#if DEBUG
+#define LXY_VIDEO_BINARY_LOG_MAX_LEVEL  LXYVideoLoggerLevelTrace
+#else
+#define LXY_VIDEO_BINARY_LOG_MAX_LEVEL  LXYVideoLoggerLevelInfo
+#endif
+#endif
+
+#define LXY_VIDEO_BINARY_PTR(OBJ)   ((int64_t)(intptr_t)(__bridge void *)(OBJ))
+
+#define LXY_VIDEO_BINARY(LEVEL, EVENT, ARG0, ARG1, ARG2)                                                       \
+    do {                                                                                                        \
+        if ((LEVEL) <= LXY_VIDEO_BINARY_LOG_MAX_LEVEL && (LEVEL) <= LXYVideoBinaryLogLevel) {                  \
+            LXY_VIDEO_BinaryLog((LEVEL), (EVENT), (int64_t)(ARG0), (int64_t)(ARG1), (int64_t)(ARG2));          \
+        }                                                                                                       \
+    } while (0)
+
+#define LXY_VIDEO_BINARY_TRACE(EVENT, ARG0, ARG1, ARG2)     LXY_VIDEO_BINARY(LXYVideoLoggerLevelTrace, EVENT, ARG0, ARG1, ARG2)
+#define LXY_VIDEO_BINARY_DEBUG(EVENT, ARG0, ARG1, ARG2)     LXY_VIDEO_BINARY(LXYVideoLoggerLevelDebug, EVENT, ARG0, ARG1, ARG2)
+#define LXY_VIDEO_BINARY_INFO(EVENT, ARG0, ARG1, ARG2)      LXY_VIDEO_BINARY(LXYVideoLoggerLevelInfo,  EVENT, ARG0, ARG1, ARG2)
+
 #endif
@@ -0,0 +1,35 @@
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * estimate of the video download bandwidth, from the throughput samples of all the video requests.
+ *
+ * two exponentially weighted moving averages are kept: a fast one following drops quickly,
+ * and a slow one ignoring short bursts. the estimate is the smaller of the two.
+ * thread safe.
+ */
+@interface LXYVideoBandwidthEstimator : NSObject
+
+/**
+ * @brief add a throughput sample
+ *
+ * @param length    download size. Byte
+ * @param interval  time. second
+ */
++ (void)addSampleWithLength:(NSUInteger)length interval:(NSTimeInterval)interval;
+
+/**
+ * @brief the bandwidth estimate. Byte/s. 0 if there is no sample yet
+ */
++ (double)bandwidth;
+
+/**
+ * @brief drop all the samples, e.g. when the network changes
+ */
++ (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,91 @@
+
+#import "LXYVideoBandwidthEstimator.h"
+
+// half-life of the moving averages, in seconds of download
+static const double kLXYBandwidthFastHalfLife = 2.0;
+static const double kLXYBandwidthSlowHalfLife = 5.0;
+
+// the estimate is used only after this many bytes, as tiny samples are dominated by latency
+static const NSUInteger kLXYBandwidthMinTotalLength = 128 * 1024;
+
+@interface LXYVideoBandwidthEstimator ()
+
+// moving averages. Byte/s
+@property (nonatomic, assign) double fastAverage;
+@property (nonatomic, assign) double slowAverage;
+
+// the sum of the weights, which corrects the zero start of the averages
+@property (nonatomic, assign) double fastWeight;
+@property (nonatomic, assign) double slowWeight;
+
+// all the sampled bytes
+@property (nonatomic, assign) NSUInteger totalLength;
+
+@end
+
+@implementation LXYVideoBandwidthEstimator
+
++ (instancetype)sharedInstance
+{
+    static LXYVideoBandwidthEstimator *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instance = [LXYVideoBandwidthEstimator new];
+    });
+    
+    return instance;
+}
+
+#pragma mark - Public
+
++ (void)addSampleWithLength:(NSUInteger)length interval:(NSTimeInterval)interval
+{
+    if (length == 0 || interval <= 0) {
+        return;
+    }
+    
+    LXYVideoBandwidthEstimator *instance = [LXYVideoBandwidthEstimator sharedInstance];
+    @synchronized(instance)
+    {
+        double throughput = length / interval;
+        
+        // a sample weighs as much as the time it took
+        double fastAlpha = pow(0.5, interval / kLXYBandwidthFastHalfLife);
+        instance.fastAverage = fastAlpha * instance.fastAverage + (1 - fastAlpha) * throughput;
+        instance.fastWeight = fastAlpha * instance.fastWeight + (1 - fastAlpha);
+        
+        double slowAlpha = pow(0.5, interval / kLXYBandwidthSlowHalfLife);
+        instance.slowAverage = slowAlpha * instance.slowAverage + (1 - slowAlpha) * throughput;
+        instance.slowWeight = slowAlpha * instance.slowWeight + (1 - slowAlpha);
+        
+        instance.totalLength += length;
+    }
+}
+
++ (double)bandwidth
+{
+    LXYVideoBandwidthEstimator *instance = [LXYVideoBandwidthEstimator sharedInstance];
+    @synchronized(instance)
+    {
+        if (instance.totalLength < kLXYBandwidthMinTotalLength || instance.fastWeight <= 0 || instance.slowWeight <= 0) {
+            return 0;
+        }
+        
+        return MIN(instance.fastAverage / instance.fastWeight, instance.slowAverage / instance.slowWeight);
+    }
+}
+
++ (void)reset
+{
+    LXYVideoBandwidthEstimator *instance = [LXYVideoBandwidthEstimator sharedInstance];
+    @synchronized(instance)
+    {
+        instance.fastAverage = 0;
+        instance.slowAverage = 0;
+        instance.fastWeight = 0;
+        instance.slowWeight = 0;
+        instance.totalLength = 0;
+    }
+}
+
+@end
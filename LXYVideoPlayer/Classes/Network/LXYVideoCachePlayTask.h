@@ -22,7 +22,56 @@ NS_ASSUME_NONNULL_BEGIN
            internalDelegate:(id<LXYVideoPlayerInternalDelegate> _Nullable)internalDelegate;
 
 /**
- * @brief read cache data from disk
+ * @brief create a task which downloads a single range for play, e.g. from a seek point.
+ *        meta is taken from @playTask instead of the disk cache, and no request is made until started
+ *
+ * @param playTask      the task of the same resource, of which the meta has been loaded
+ * @param cachedRanges  ranges persisted already
+ */
++ (instancetype)rangeTaskWithPlayTask:(LXYVideoCachePlayTask *)playTask cachedRanges:(NSIndexSet *)cachedRanges;
+
+/**
+ * @brief download @range with high priority. no request is made if @range has been cached already
+ * Attention：should be run on @taskQueue
+ */
+- (BOOL)startWithAbsoluteRange:(NSRange)range;
+
+/**
+ * @brief take over the ranges @task persists, once its writes on the fly have completed, e.g. when a range task is cancelled.
+ *        @completion is called then, on @taskQueue
+ * Attention：should be run on @taskQueue
+ */
+- (void)adoptPersistedRangesOfTask:(LXYVideoCachePlayTask *)task completion:(dispatch_block_t _Nullable)completion;
+
+/**
+ * @brief the bytes the running request has yet to receive. length 0 if no request is on the fly
+ * Attention：should be run on @taskQueue
+ */
+- (NSRange)pendingRange;
+
+/**
+ * @brief all byte ranges persisted to disk
+ * Attention：should be run on @taskQueue
+ */
+- (NSIndexSet *)persistedRanges;
+
+/**
+ * @brief the length of data readable at @offset, including the bytes received but not persisted yet
+ *
+ * Attention：should be run on @taskQueue
+ */
+- (NSUInteger)availableLengthFromOffset:(NSUInteger)offset;
+
+/**
+ * @brief all byte ranges readable by @subdataWithRange:error:, including the bytes received but not persisted yet
+ *
+ * Attention：should be run on @taskQueue
+ */
+- (NSIndexSet *)readableRanges;
+
+/**
+ * @brief read cache data from disk, or from the bytes not persisted yet.
+ *        the result may be shorter than @range where disk and memory meet, read the rest again.
  * Attention：@subdataWithRange: should be run on @taskQueue
  *
  * @param range     data range
@@ -6,6 +6,7 @@
 #import "LXYVideoPlayerDefines.h"
 #import "LXYVideoDiskCacheConfiguration.h"
 #import "LXYVideoPrefetchHitRecorder.h"
+#import "LXYVideoPlaybackMetrics+Private.h"
 
 @interface LXYVideoPrefetchHitRecorder ()
 
@@ -36,7 +37,7 @@
            internalDelegate:(id<LXYVideoPlayerInternalDelegate> _Nullable)internalDelegate
 {
     LXYVideoCachePlayTask *task = [[LXYVideoCachePlayTask alloc] initWithURL:URL queue:queue internalDelegate:internalDelegate];
-    LXY_VIDEO_INFO(@"new LXYVideoCachePlayTask: %p", task);
+    LXY_VIDEO_INFO(@"%@ new LXYVideoCachePlayTask: %p", task.requestURLKey, task);
     
     return task;
 }
@@ -49,12 +50,18 @@
     if (self) {
         self.internalDelegate = internalDelegate;
         //
+        uint64_t lookupTimestamp = LXYVideoMetricsTimestamp();
         [LXYVideoDiskCache metaDataForKey:self.requestURLKey completion:^(NSError * _Nullable error, NSString * _Nullable mimeType, NSUInteger fileLength, NSUInteger cacheLength) {
+            if ([LXYVideoPlaybackMetrics sharedInstance].enabled) {
+                [[LXYVideoPlaybackMetrics sharedInstance].metaLookupTimeHistogram recordValue:LXYVideoMetricsMicrosecondsSince(lookupTimestamp) / 1000];
+            }
+            
             if (!error) {
                 self.mimeType = mimeType;
                 self.fileLength = fileLength;
                 self.cacheLength = cacheLength;
-                NSLog(@"url=%@  requestURLKey=%@",self.requestURL.absoluteString,self.requestURLKey);
+                LXY_VIDEO_DEBUG(@"%@ meta loaded: url = %@, fileLength = %@, cacheLength = %@",
+                                self.requestURLKey, self.requestURL.absoluteString, @(fileLength), @(cacheLength));
 ////                LXY_VIDEO_INFO(@"%@ metaDataForKey completion: mimeType = %@, fileLength = %@, cacheLength = %@",
 //                               self.requestURLKey,
 //                               mimeType,
@@ -68,6 +75,9 @@
                 }
 
                 dispatch_async(self.taskQueue, ^{
+                    if (self.cancelled) {
+                        return;
+                    }
                     if (self.delegate && [self.delegate respondsToSelector:@selector(requestTask:didReceiveData:)]) {
                         [self.delegate requestTask:nil didReceiveData:nil];
                     }
@@ -80,7 +90,24 @@
                 }
             }
 
+            // ranges cached beyond the head, e.g. a prefetched tail moov
+            __block NSIndexSet *cachedRanges = nil;
+            if (!error) {
+                [LXYVideoDiskCache cachedRangesForKeySync:self.requestURLKey completion:^(NSIndexSet * _Nullable ranges, NSUInteger length) {
+                    cachedRanges = ranges;
+                }];
+            }
+            
             dispatch_async(self.taskQueue, ^{
+                // cancelled while the meta was looked up: the download never starts
+                if (self.cancelled) {
+                    return;
+                }
+                
+                if (cachedRanges) {
+                    [self.cachedRanges addIndexes:cachedRanges];
+                }
+                
                 float priority = 0.5;
                 if (@available(iOS 8.0, *)) {
                     priority = NSURLSessionTaskPriorityDefault;
@@ -91,8 +118,6 @@
                     && self.internalDelegate
                     && [self.internalDelegate respondsToSelector:@selector(noVideoDataToDownloadForURL:)]) {
                     dispatch_async_on_main_queue(^{
-                        NSLog(@"url=startTaskWithRange=============");
-
                         [self.internalDelegate noVideoDataToDownloadForURL:URL];
                     });
                 }
@@ -105,8 +130,102 @@
     return self;
 }
 
++ (instancetype)rangeTaskWithPlayTask:(LXYVideoCachePlayTask *)playTask cachedRanges:(NSIndexSet *)cachedRanges
+{
+    LXYVideoCachePlayTask *task = [[LXYVideoCachePlayTask alloc] initWithURL:playTask.requestURL queue:playTask.taskQueue];
+    task.internalDelegate = playTask.internalDelegate;
+    task.mimeType = playTask.mimeType;
+    task.fileLength = playTask.fileLength;
+    [task.cachedRanges addIndexes:cachedRanges];
+    [cachedRanges enumerateRangesUsingBlock:^(NSRange range, BOOL * _Nonnull stop) {
+        task.cacheLength = range.location == 0 ? range.length : 0;
+        *stop = YES;
+    }];
+    LXY_VIDEO_INFO(@"%@ new LXYVideoCachePlayTask for range: %p", task.requestURLKey, task);
+    
+    return task;
+}
+
+- (BOOL)startWithAbsoluteRange:(NSRange)range
+{
+    float priority = 0.75;
+    if (@available(iOS 8.0, *)) {
+        priority = NSURLSessionTaskPriorityHigh;
+    }
+    
+    return [self startTaskWithAbsoluteRange:range priority:priority];
+}
+
+- (void)adoptPersistedRangesOfTask:(LXYVideoCachePlayTask *)task completion:(dispatch_block_t)completion
+{
+    [task performAfterPendingWrites:^{
+        [self.cachedRanges addIndexes:[task persistedRanges]];
+        self.cacheLength += [super availableLengthFromOffset:self.cacheLength];
+        
+        !completion ? : completion();
+    }];
+}
+
+- (NSIndexSet *)persistedRanges
+{
+    NSMutableIndexSet *persistedRanges = [self.cachedRanges mutableCopy];
+    if (self.cacheLength > 0) {
+        [persistedRanges addIndexesInRange:NSMakeRange(0, self.cacheLength)];
+    }
+    
+    return persistedRanges;
+}
+
+- (NSUInteger)availableLengthFromOffset:(NSUInteger)offset
+{
+    __block NSUInteger end = offset + [super availableLengthFromOffset:offset];
+    [self enumerateUnpersistedDataUsingBlock:^(NSUInteger dataOffset, NSData *data, BOOL *stop) {
+        if (dataOffset <= end && dataOffset + data.length > end) {
+            end = dataOffset + data.length;
+        }
+    }];
+    
+    return end - offset;
+}
+
+- (NSIndexSet *)readableRanges
+{
+    NSMutableIndexSet *readableRanges = [self.cachedRanges mutableCopy];
+    if (self.cacheLength > 0) {
+        [readableRanges addIndexesInRange:NSMakeRange(0, self.cacheLength)];
+    }
+    [self enumerateUnpersistedDataUsingBlock:^(NSUInteger dataOffset, NSData *data, BOOL *stop) {
+        [readableRanges addIndexesInRange:NSMakeRange(dataOffset, data.length)];
+    }];
+    
+    return readableRanges;
+}
+
 - (NSData *)subdataWithRange:(NSRange)range error:(NSError * __autoreleasing *)outError
 {
+    // disk first. the staged bytes take over where the disk copy ends
+    NSUInteger persistedLength = [super availableLengthFromOffset:range.location];
+    if (persistedLength > 0) {
+        range.length = MIN(range.length, persistedLength);
+    } else {
+        __block NSData *stagedData = nil;
+        [self enumerateUnpersistedDataUsingBlock:^(NSUInteger dataOffset, NSData *data, BOOL *stop) {
+            if (NSLocationInRange(range.location, NSMakeRange(dataOffset, data.length))) {
+                NSUInteger length = MIN(range.length, dataOffset + data.length - range.location);
+                stagedData = [data subdataWithRange:NSMakeRange(range.location - dataOffset, length)];
+                *stop = YES;
+            }
+        }];
+        if (stagedData) {
+            if (outError) {
+                *outError = nil;
+            }
+            return stagedData;
+        }
+    }
+    
+    BOOL metricsEnabled = [LXYVideoPlaybackMetrics sharedInstance].enabled;
+    uint64_t readTimestamp = metricsEnabled ? LXYVideoMetricsTimestamp() : 0;
     
     __block NSData *cacheData = nil;
     [LXYVideoDiskCache cacheDataForKeySync:self.requestURLKey offset:range.location length:range.length completion:^(NSError * _Nullable error, NSData * _Nullable data) {
@@ -116,6 +235,10 @@
         }
     }];
     
+    if (metricsEnabled) {
+        [[LXYVideoPlaybackMetrics sharedInstance].diskReadLatencyHistogram recordValue:LXYVideoMetricsMicrosecondsSince(readTimestamp)];
+    }
+    
     return cacheData;
 }
 
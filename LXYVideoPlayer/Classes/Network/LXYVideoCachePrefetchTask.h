@@ -3,6 +3,8 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class LXYVideoTimeIndex;
+
 /**
  * network request task for prefetch
  */
@@ -14,6 +16,9 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (instancetype)taskWithURL:(NSURL *)URL queue:(dispatch_queue_t)queue;
 
+/// play time to bytes index of the disk cache, loaded by loadCacheMetaSync. nil if not built yet
+@property (nonatomic, strong, readonly, nullable) LXYVideoTimeIndex *timeIndex;
+
 /**
  * @brief start to prefetch
  *
@@ -21,6 +26,34 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (BOOL)startWithSize:(NSUInteger)size;
 
+/**
+ * @brief start to prefetch with the given network priority
+ *
+ * @param size      prefetch range：0 ~ size
+ * @param priority  network priority. NSURLSessionTaskPriorityLow by default
+ */
+- (BOOL)startWithSize:(NSUInteger)size priority:(float)priority;
+
+/**
+ * @brief prefetch exactly @range, which may lie beyond the cached head, e.g. a moov box at the tail
+ *
+ * @param range     prefetch range. no request is made if it has been cached already
+ * @param priority  network priority
+ */
+- (BOOL)startWithAbsoluteRange:(NSRange)range priority:(float)priority;
+
+/**
+ * @brief restore mimeType, fileLength, cached ranges and time index from the disk cache, so that only missing bytes are requested.
+ * Attention: should be run on @taskQueue before starting. blocks on the disk cache queue
+ */
+- (void)loadCacheMetaSync;
+
+/**
+ * @brief read cached data at @range from disk. nil if any byte of @range is not cached
+ * Attention: should be run on @taskQueue
+ */
+- (NSData * _Nullable)cachedDataWithRange:(NSRange)range;
+
 @end
 
 NS_ASSUME_NONNULL_END
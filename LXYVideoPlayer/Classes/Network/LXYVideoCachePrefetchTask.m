@@ -1,13 +1,23 @@
 #import "LXYVideoCachePrefetchTask.h"
 #import "LXYVideoCacheRequestTask+Private.h"
 #import "LXYVideoPlayerDefines.h"
+#import "LXYVideoDiskCache.h"
+#import "LXYVideoDiskCache+Private.h"
+
+@interface LXYVideoCachePrefetchTask ()
+
+@property (nonatomic, strong, readwrite) LXYVideoTimeIndex *timeIndex;
+
+@end
 
 @implementation LXYVideoCachePrefetchTask
 
 + (instancetype)taskWithURL:(NSURL *)URL queue:(dispatch_queue_t)queue
 {
     LXYVideoCachePrefetchTask *task = [[LXYVideoCachePrefetchTask alloc] initWithURL:URL queue:queue];
-//    LXY_VIDEO_INFO(@"new LXYVideoCachePrefetchTask: %p", task);
+    // out of space, a prefetch is not admitted. playback streams anyway
+    task.requiresReservation = YES;
+    LXY_VIDEO_INFO(@"%@ new LXYVideoCachePrefetchTask: %p", task.requestURLKey, task);
     
     return task;
 }
@@ -19,7 +29,54 @@
         priority = NSURLSessionTaskPriorityLow;
     }
     
+    return [self startWithSize:size priority:priority];
+}
+
+- (BOOL)startWithSize:(NSUInteger)size priority:(float)priority
+{
     return [self startTaskWithRange:NSMakeRange(0, size) priority:priority];
 }
 
+- (BOOL)startWithAbsoluteRange:(NSRange)range priority:(float)priority
+{
+    return [self startTaskWithAbsoluteRange:range priority:priority];
+}
+
+- (void)loadCacheMetaSync
+{
+    dispatch_sync([LXYVideoDiskCache cacheQueue], ^{
+        [LXYVideoDiskCache metaDataForKeySync:self.requestURLKey completion:^(NSError * _Nullable error, NSString * _Nullable mimeType, NSUInteger fileLength, NSUInteger cacheLength) {
+            if (!error) {
+                self.mimeType = mimeType;
+                self.fileLength = fileLength;
+                self.cacheLength = cacheLength;
+            }
+        }];
+        [LXYVideoDiskCache cachedRangesForKeySync:self.requestURLKey completion:^(NSIndexSet * _Nullable cachedRanges, NSUInteger fileLength) {
+            if (cachedRanges) {
+                [self.cachedRanges addIndexes:cachedRanges];
+            }
+        }];
+        [LXYVideoDiskCache timeIndexForKeySync:self.requestURLKey completion:^(LXYVideoTimeIndex * _Nullable timeIndex, NSIndexSet * _Nullable cachedRanges) {
+            self.timeIndex = timeIndex;
+        }];
+    });
+}
+
+- (NSData *)cachedDataWithRange:(NSRange)range
+{
+    if (range.length == 0 || [self availableLengthFromOffset:range.location] < range.length) {
+        return nil;
+    }
+    
+    __block NSData *cacheData = nil;
+    dispatch_sync([LXYVideoDiskCache cacheQueue], ^{
+        [LXYVideoDiskCache cacheDataForKeySync:self.requestURLKey offset:range.location length:range.length completion:^(NSError * _Nullable error, NSData * _Nullable data) {
+            cacheData = (!error && data.length == range.length) ? data : nil;
+        }];
+    });
+    
+    return cacheData;
+}
+
 @end
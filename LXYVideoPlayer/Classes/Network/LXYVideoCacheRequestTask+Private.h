@@ -7,6 +7,13 @@
 // request URL key
 @property (nonatomic, copy) NSString *requestURLKey;
 
+// all cached byte ranges
+@property (nonatomic, strong) NSMutableIndexSet *cachedRanges;
+
+// with preallocatesCacheFiles, whether a refused reservation fails the request before any byte is downloaded.
+// otherwise the request goes on without it. NO by default
+@property (nonatomic, assign) BOOL requiresReservation;
+
 /**
  * @brief initializer
  * Attention: should be run on @queue (taskQueue)
@@ -26,4 +33,34 @@
  */
 - (BOOL)startTaskWithRange:(NSRange)range priority:(float)priority;
 
+/**
+ * @brief request exactly @range from network, which may lie beyond @cacheLength.
+ *        no network request will be made if @range has been cached already.
+ * Attention: should be run on @taskQueue
+ *
+ * @param range         data range of the request task. the length must be known
+ * @param priority      task priority
+ */
+- (BOOL)startTaskWithAbsoluteRange:(NSRange)range priority:(float)priority;
+
+/**
+ * @brief the bytes the running request has yet to receive. length 0 if no request is on the fly
+ * Attention: should be run on @taskQueue
+ */
+- (NSRange)pendingRange;
+
+/**
+ * @brief enumerate the bytes received from network but not persisted yet: disk writes on the fly, then the memory cache.
+ *        they leave this window at the moment they are added to @cachedRanges.
+ * Attention: should be run on @taskQueue. @data must not be retained, it may be mutated later
+ */
+- (void)enumerateUnpersistedDataUsingBlock:(void(^)(NSUInteger offset, NSData *data, BOOL *stop))block;
+
+/**
+ * @brief run @block once all the disk writes handed out so far have completed, at once if there is none.
+ *        a cancelled request runs it too: the writes on the fly are not cancelled with it.
+ * Attention: should be run on @taskQueue
+ */
+- (void)performAfterPendingWrites:(dispatch_block_t)block;
+
 @end
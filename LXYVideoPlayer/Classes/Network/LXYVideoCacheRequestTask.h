@@ -59,18 +59,59 @@ NS_ASSUME_NONNULL_BEGIN
 /// resource mimeType
 @property (nonatomic, copy) NSString *mimeType;
 
-/// cached length (into disk) of the resource
+/// cached length (into disk) of the resource, contiguous from the beginning
 @property (nonatomic, assign) NSUInteger cacheLength;
 
+/// the network request is suspended by @suspendNetworkRequest
+@property (nonatomic, assign, readonly) BOOL suspended;
+
+/// cancelled by @cancelNetworkRequest. a task cancelled before it starts never starts
+@property (nonatomic, assign, readonly) BOOL cancelled;
+
+/// when the network request was suspended, seconds since 1970. 0 if not suspended
+@property (nonatomic, assign, readonly) NSTimeInterval suspendTime;
+
+/// the running network request has been resumed after a suspension: the server may have dropped the idle connection meanwhile
+@property (nonatomic, assign, readonly) BOOL resumedFromSuspension;
+
 - (instancetype)init UNAVAILABLE_ATTRIBUTE;
 
 /**
- * @brief cancel network requext
+ * @brief the length of cached data starting at @offset. ranges cached beyond @cacheLength are counted too
+ *
+ * Attention：should be run on @taskQueue
+ */
+- (NSUInteger)availableLengthFromOffset:(NSUInteger)offset;
+
+/**
+ * @brief cancel network requext, or the request to come if not started yet
  *
  * Attention：should be run on @taskQueue
  */
 - (void)cancelNetworkRequest;
 
+/**
+ * @brief stop receiving data without closing the request, e.g. when enough has been read ahead.
+ *        a suspended request neither times out nor completes, until @resumeNetworkRequest
+ *
+ * Attention：should be run on @taskQueue
+ */
+- (void)suspendNetworkRequest;
+
+/**
+ * @brief resume the network request suspended by @suspendNetworkRequest
+ *
+ * Attention：should be run on @taskQueue
+ */
+- (void)resumeNetworkRequest;
+
+/**
+ * @brief change the priority of the running network request
+ *
+ * Attention：should be run on @taskQueue
+ */
+- (void)setNetworkPriority:(float)priority;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -5,8 +5,12 @@
 #import "LXYVideoPlayerDefines.h"
 #import "LXYVideoDiskCacheConfiguration.h"
 #import "LXYVideoDiskCacheDeleteManager.h"
+#import "LXYVideoBandwidthEstimator.h"
+#import "LXYVideoPlaybackMetrics+Private.h"
+#import <stdatomic.h>
 
 #define LXYVideoCacheRequestTimeout         60.0
+#define LXYVideoCacheRequestMetricsLength   100 * 1024
 
 /// video cache request task state
 typedef NS_ENUM(NSInteger, LXYVideoCacheRequestTaskState)
@@ -25,6 +29,25 @@ typedef NS_ENUM(NSInteger, LXYVideoCacheRequestTaskState)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * data handed to the disk cache, of which the write has not completed yet
+ */
+@interface LXYVideoPendingWrite : NSObject
+
+// file offset
+@property (nonatomic, assign) NSUInteger offset;
+
+// data
+@property (nonatomic, strong) NSData *data;
+
+@end
+
+@implementation LXYVideoPendingWrite
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 @interface LXYVideoCacheRequestTask () <NSURLConnectionDataDelegate, NSURLSessionDataDelegate>
 
 // resource URL
@@ -36,6 +59,9 @@ typedef NS_ENUM(NSInteger, LXYVideoCacheRequestTaskState)
 // request URL key
 @property (nonatomic, copy) NSString *requestURLKey;
 
+// all cached byte ranges
+@property (nonatomic, strong) NSMutableIndexSet *cachedRanges;
+
 // the queue on which LXYVideoCacheRequestTask is executed
 @property (nonatomic, strong) dispatch_queue_t taskQueue;
 
@@ -51,12 +77,33 @@ typedef NS_ENUM(NSInteger, LXYVideoCacheRequestTaskState)
 // state
 @property (nonatomic, assign) LXYVideoCacheRequestTaskState state;
 
+// suspended
+@property (nonatomic, assign) BOOL suspended;
+
+// when suspended
+@property (nonatomic, assign) NSTimeInterval suspendTime;
+
+// resumed after a suspension
+@property (nonatomic, assign) BOOL resumedFromSuspension;
+
+// session callbacks are executed on @taskQueue directly
+@property (nonatomic, assign) BOOL callbacksOnTaskQueue;
+
+// blocks to run once all the disk writes handed out so far have completed
+@property (nonatomic, strong) NSMutableArray<dispatch_block_t> *pendingWriteBlocks;
+
 // offset for mem
 @property (nonatomic, assign) NSUInteger memCacheOffset;
 
 // data cache for network data. avoid disk write frequently
 @property (nonatomic, strong) NSMutableData *dataCache;
 
+// disk writes on the fly, in offset order
+@property (nonatomic, strong) NSMutableArray<LXYVideoPendingWrite *> *pendingWrites;
+
+// timeline of the running request. nil if metrics are disabled
+@property (nonatomic, strong) LXYVideoMetricsTimeline *timeline;
+
 /**
  * @brief initializer
  * Attention: should be run on @queue (taskQueue)
@@ -76,6 +123,12 @@ typedef NS_ENUM(NSInteger, LXYVideoCacheRequestTaskState)
  */
 - (BOOL)startTaskWithRange:(NSRange)range priority:(float)priority;
 
+/**
+ * @brief request exactly @range from network, which may lie beyond @cacheLength.
+ * Attention: should be run on @taskQueue
+ */
+- (BOOL)startTaskWithAbsoluteRange:(NSRange)range priority:(float)priority;
+
 @end
 
 @implementation LXYVideoCacheRequestTask
@@ -89,11 +142,14 @@ typedef NS_ENUM(NSInteger, LXYVideoCacheRequestTaskState)
  * video download speed profiler
  */
 // time counter
-static NSTimeInterval s_dataReceiveStartTime = 0;
-// size counter
-static NSUInteger s_downloadSize = 0;
+static _Atomic(NSTimeInterval) s_dataReceiveStartTime = 0;
+// size counter. added on every received chunk without the lock
+static _Atomic(NSUInteger) s_downloadSize = 0;
 // video network request on the fly
 static int s_requestCountOnTheFly = 0;
+// the counters above are shared by the sessions, of which the callbacks run on different queues.
+// the lock is taken when a request starts or ends, not on the data path
+#define LXY_REQ_TASK_PROFILER_LOCK          @synchronized ([LXYVideoCacheRequestTask class])
 
 - (instancetype)initWithURL:(NSURL * _Nonnull)URL queue:(dispatch_queue_t)queue
 {
@@ -111,11 +167,14 @@ static int s_requestCountOnTheFly = 0;
         _fileLength = 0;
         _mimeType = nil;
         _cacheLength = 0;
+        _cachedRanges = [NSMutableIndexSet indexSet];
         _memCacheOffset = 0;
         
         _state = LXYVideoCacheRequestTaskStateInitialized;
         
         _dataCache = [NSMutableData dataWithCapacity:LXY_REQ_TASK_CACHE_SIZE];
+        _pendingWrites = [NSMutableArray array];
+        _pendingWriteBlocks = [NSMutableArray array];
     }
     
     return self;
@@ -123,9 +182,39 @@ static int s_requestCountOnTheFly = 0;
 
 - (NSOperationQueue *)sessionQueue
 {
+    // the session delegate runs on @taskQueue: no hop per callback, and no load on the main thread
+    if (   self.taskQueue != dispatch_get_main_queue()
+        && [NSOperationQueue instancesRespondToSelector:@selector(setUnderlyingQueue:)]) {
+        NSOperationQueue *queue = [NSOperationQueue new];
+        queue.maxConcurrentOperationCount = 1;
+        queue.underlyingQueue = self.taskQueue;
+        self.callbacksOnTaskQueue = YES;
+        
+        return queue;
+    }
+    
+    self.callbacksOnTaskQueue = NO;
     return [NSOperationQueue mainQueue];
 }
 
+- (void)_performOnTaskQueue:(dispatch_block_t)block
+{
+    if (self.callbacksOnTaskQueue) {
+        block();
+    } else {
+        dispatch_async(self.taskQueue, block);
+    }
+}
+
+- (void)performAfterPendingWrites:(dispatch_block_t)block
+{
+    if (self.pendingWrites.count == 0) {
+        block();
+    } else {
+        [self.pendingWriteBlocks addObject:block];
+    }
+}
+
 #pragma mark - Public
 
 - (BOOL)startTaskWithRange:(NSRange)range priority:(float)priority
@@ -143,15 +232,160 @@ static int s_requestCountOnTheFly = 0;
         return NO;
     }
     
-    self.memCacheOffset = self.cacheLength;
-    
     // ensure @range is continuous
     if (range.length != NSUIntegerMax) {
         range.length = range.location + range.length - self.cacheLength;
     }
     range.location = self.cacheLength;
     
+    return [self _startRequestWithRange:range priority:priority];
+}
+
+- (BOOL)startTaskWithAbsoluteRange:(NSRange)range priority:(float)priority
+{
+    if (self.state != LXYVideoCacheRequestTaskStateInitialized) {
+        return NO;
+    }
+    
+    if (   range.length == 0
+        || range.length == NSUIntegerMax
+        || [self.cachedRanges containsIndexesInRange:range]
+        || (self.fileLength != 0 && NSMaxRange(range) > self.fileLength)) {
+        return NO;
+    }
+    
+    return [self _startRequestWithRange:range priority:priority];
+}
+
+- (NSUInteger)availableLengthFromOffset:(NSUInteger)offset
+{
+    if (offset < self.cacheLength) {
+        return self.cacheLength - offset + [self _rangeLengthFromOffset:self.cacheLength];
+    }
+    
+    return [self _rangeLengthFromOffset:offset];
+}
+
+- (NSRange)pendingRange
+{
+    if (self.state != LXYVideoCacheRequestTaskStateRunning) {
+        return NSMakeRange(0, 0);
+    }
+    
+    NSUInteger start = self.memCacheOffset + self.dataCache.length;
+    NSUInteger end = NSMaxRange(self.requestRange);
+    if (self.requestRange.length == NSUIntegerMax) {
+        end = self.fileLength != 0 ? self.fileLength : NSUIntegerMax;
+    }
+    
+    return start < end ? NSMakeRange(start, end - start) : NSMakeRange(0, 0);
+}
+
+- (void)enumerateUnpersistedDataUsingBlock:(void(^)(NSUInteger offset, NSData *data, BOOL *stop))block
+{
+    BOOL stop = NO;
+    for (LXYVideoPendingWrite *pendingWrite in self.pendingWrites) {
+        block(pendingWrite.offset, pendingWrite.data, &stop);
+        if (stop) {
+            return;
+        }
+    }
+    
+    if (self.dataCache.length > 0) {
+        block(self.memCacheOffset, self.dataCache, &stop);
+    }
+}
+
+- (BOOL)cancelled
+{
+    return self.state == LXYVideoCacheRequestTaskStateCanceled;
+}
+
+- (void)cancelNetworkRequest
+{
+//    LXY_VIDEO_DEBUG(@"%@ cancelNetworkRequest: self = %p", self.requestURLKey, self);
+    
+    // e.g. a play task waiting on its meta lookup
+    if (self.state == LXYVideoCacheRequestTaskStateInitialized) {
+        self.state = LXYVideoCacheRequestTaskStateCanceled;
+        return;
+    }
+    
+    if (self.state != LXYVideoCacheRequestTaskStateRunning) {
+        return;
+    }
+    //
+    [self.runningTask cancel];
+    self.runningTask = nil;
+    //
+    [self.session invalidateAndCancel];
+    self.session = nil;
+    
+    self.state = LXYVideoCacheRequestTaskStateCanceled;
+    self.suspended = NO;
+    self.suspendTime = 0;
+    
+    [self _finishTimelineWithEvent:LXYVideoMetricsEventCancelled];
+}
+
+- (void)suspendNetworkRequest
+{
+    if (self.state != LXYVideoCacheRequestTaskStateRunning || self.suspended) {
+        return;
+    }
+    
+    [self.runningTask suspend];
+    self.suspended = YES;
+    self.suspendTime = [[NSDate date] timeIntervalSince1970];
+}
+
+- (void)setNetworkPriority:(float)priority
+{
+    if (self.state != LXYVideoCacheRequestTaskStateRunning) {
+        return;
+    }
+    
+    if (@available(iOS 8.0, *)) {
+        self.runningTask.priority = priority;
+    }
+}
+
+- (void)resumeNetworkRequest
+{
+    if (!self.suspended) {
+        return;
+    }
+    self.suspended = NO;
+    self.suspendTime = 0;
+    
+    if (self.state == LXYVideoCacheRequestTaskStateRunning) {
+        [self.runningTask resume];
+        self.resumedFromSuspension = YES;
+    }
+}
+
+#pragma mark - Private
+
+- (NSUInteger)_rangeLengthFromOffset:(NSUInteger)offset
+{
+    __block NSUInteger length = 0;
+    [self.cachedRanges enumerateRangesUsingBlock:^(NSRange range, BOOL * _Nonnull stop) {
+        if (NSLocationInRange(offset, range)) {
+            length = NSMaxRange(range) - offset;
+            *stop = YES;
+        } else if (range.location > offset) {
+            *stop = YES;
+        }
+    }];
+    
+    return length;
+}
+
+- (BOOL)_startRequestWithRange:(NSRange)range priority:(float)priority
+{
+    self.memCacheOffset = range.location;
     self.requestRange = range;
+    self.timeline = [LXYVideoMetricsTimeline timelineWithName:@"request" key:self.requestURLKey];
     
     NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
     self.session = [NSURLSession sessionWithConfiguration:configuration
@@ -183,45 +417,28 @@ static int s_requestCountOnTheFly = 0;
     
     self.state = LXYVideoCacheRequestTaskStateRunning;
     
-    LXY_VIDEO_INFO(@"%@ startTaskWithRange: self = %p, range = (%@, %@)",
-                   self.requestURLKey, self,
-                   @(self.requestRange.location), @(self.requestRange.length));
+    // the key is logged with the task creation
+    LXY_VIDEO_BINARY_INFO(LXYVideoLogEventRequestStart,
+                          LXY_VIDEO_BINARY_PTR(self), self.requestRange.location, self.requestRange.length);
     
     return YES;
 }
 
-- (void)cancelNetworkRequest
-{
-//    LXY_VIDEO_DEBUG(@"%@ cancelNetworkRequest: self = %p", self.requestURLKey, self);
-    
-    if (self.state != LXYVideoCacheRequestTaskStateRunning) {
-        return;
-    }
-    //
-    [self.runningTask cancel];
-    self.runningTask = nil;
-    //
-    [self.session invalidateAndCancel];
-    self.session = nil;
-    
-    self.state = LXYVideoCacheRequestTaskStateCanceled;
-}
-
 #pragma mark - NSURLSessionDataDelegate
 
 - (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
 {
-    if (LXY_VideoDownloadDelegate) {
+    LXY_REQ_TASK_PROFILER_LOCK {
         if (s_requestCountOnTheFly == 0) {
-            s_dataReceiveStartTime = [[NSDate date] timeIntervalSince1970];
-            s_downloadSize = 0;
+            atomic_store_explicit(&s_dataReceiveStartTime, [[NSDate date] timeIntervalSince1970], memory_order_relaxed);
+            atomic_store_explicit(&s_downloadSize, 0, memory_order_relaxed);
         }
         ++s_requestCountOnTheFly;
     }
     
-    dispatch_async(self.taskQueue, ^{
+    [self _performOnTaskQueue:^{
         [self __URLSession:session dataTask:dataTask didReceiveResponse:response completionHandler:completionHandler];
-    });
+    }];
 }
 
 - (void)__URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
@@ -231,14 +448,14 @@ static int s_requestCountOnTheFly = 0;
     if (self.state != LXYVideoCacheRequestTaskStateRunning) {
         return;
     }
+    
+    [self _markEvent:LXYVideoMetricsEventResponse histogram:[LXYVideoPlaybackMetrics sharedInstance].timeToFirstByteHistogram];
 
     NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)response;
     
-    dispatch_async(self.taskQueue, ^{
-        if (LXY_CDNTrackDelegate) {
-            [LXY_CDNTrackDelegate videoDidReceiveResponse:httpResponse forRequest:self.videoRequest];
-        }
-    });
+    if (LXY_CDNTrackDelegate) {
+        [LXY_CDNTrackDelegate videoDidReceiveResponse:httpResponse forRequest:self.videoRequest];
+    }
     
     // network error
     if (httpResponse.statusCode < 200 || httpResponse.statusCode >= 400) {
@@ -262,9 +479,26 @@ static int s_requestCountOnTheFly = 0;
         return;
     }
 
+    // the server ignored Range: the body starts at 0, and can not be written at @requestRange.location
+    if (httpResponse.statusCode != 206 && self.requestRange.location > 0) {
+        NSError *error = LXYError(LXYVideoPlayerErrorRangeNotSatisfied,
+                                  [NSString stringWithFormat:@"{status:%@, requestedOffset:%@}",
+                                       @(httpResponse.statusCode),
+                                       @(self.requestRange.location)]
+                                  );
+        [self __URLSession:session task:dataTask didCompleteWithError:error];
+        
+        completionHandler(NSURLSessionResponseCancel);
+        
+        return;
+    }
+    
     // inconsistent
     NSString *contentRange = httpResponse.allHeaderFields[@"Content-Range"];
     NSInteger contentRangeLength = [[[contentRange componentsSeparatedByString:@"/"] lastObject] integerValue];
+    if (!contentRange && httpResponse.statusCode == 200 && response.expectedContentLength > 0) {
+        contentRangeLength = (NSInteger)response.expectedContentLength;
+    }
     if (self.fileLength != 0 && self.fileLength != contentRangeLength) {
 //        LXY_VIDEO_ERROR(@"%@ bad length: self = %p, prevFileLength=%@, incomingFileLength=%@",
 //                        self.requestURLKey, self,
@@ -291,6 +525,11 @@ static int s_requestCountOnTheFly = 0;
     self.fileLength = contentRangeLength;
     self.mimeType = response.MIMEType;
 
+    if ([LXYVideoDiskCacheConfiguration sharedInstance].preallocatesCacheFiles && self.fileLength > 0) {
+        [self _reserveCacheWithSession:session dataTask:dataTask response:httpResponse completionHandler:completionHandler];
+        return;
+    }
+    
     completionHandler(NSURLSessionResponseAllow);
     
     if (self.delegate && [self.delegate respondsToSelector:@selector(requestTask:didReceiveResponse:)]) {
@@ -298,47 +537,84 @@ static int s_requestCountOnTheFly = 0;
     }
 }
 
+// the body is held back until the reservation is decided. it is queued before the first append on the cache queue
+- (void)_reserveCacheWithSession:(NSURLSession *)session
+                        dataTask:(NSURLSessionDataTask *)dataTask
+                        response:(NSHTTPURLResponse *)httpResponse
+               completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
+{
+    // the whole file for play, the target for prefetch
+    NSUInteger length = self.fileLength;
+    if (self.requestRange.length != NSUIntegerMax) {
+        length = MIN(NSMaxRange(self.requestRange), self.fileLength);
+    }
+    
+    [LXYVideoDiskCache reserveCacheForKey:self.requestURLKey
+                                 mimeType:self.mimeType
+                               fileLength:self.fileLength
+                                   length:length
+                               completion:^(NSError * _Nullable error) {
+                                   dispatch_async(self.taskQueue, ^{
+                                       if (self.state != LXYVideoCacheRequestTaskStateRunning) {
+                                           completionHandler(NSURLSessionResponseCancel);
+                                           return;
+                                       }
+                                       
+                                       if (error && self.requiresReservation) {
+                                           [self __URLSession:session task:dataTask didCompleteWithError:error];
+                                           completionHandler(NSURLSessionResponseCancel);
+                                           return;
+                                       }
+                                       
+                                       completionHandler(NSURLSessionResponseAllow);
+                                       
+                                       if (self.delegate && [self.delegate respondsToSelector:@selector(requestTask:didReceiveResponse:)]) {
+                                           [self.delegate requestTask:self didReceiveResponse:httpResponse];
+                                       }
+                                   });
+                               }];
+}
+
 - (void)URLSession:(NSURLSession *)session task:(nonnull NSURLSessionTask *)task willPerformHTTPRedirection:(nonnull NSHTTPURLResponse *)response newRequest:(nonnull NSURLRequest *)request completionHandler:(nonnull void (^)(NSURLRequest * _Nullable))completionHandler
 {
-    if (LXY_VideoDownloadDelegate) {
+    LXY_REQ_TASK_PROFILER_LOCK {
         if (s_requestCountOnTheFly == 1) {
-            s_dataReceiveStartTime = [[NSDate date] timeIntervalSince1970];
-            s_downloadSize = 0;
+            atomic_store_explicit(&s_dataReceiveStartTime, [[NSDate date] timeIntervalSince1970], memory_order_relaxed);
+            atomic_store_explicit(&s_downloadSize, 0, memory_order_relaxed);
         }
     }
     
-    dispatch_async(self.taskQueue, ^{
+    [self _performOnTaskQueue:^{
         if (LXY_CDNTrackDelegate) {
             [LXY_CDNTrackDelegate videoDidReceiveResponse:response forRequest:self.videoRequest];
             [LXY_CDNTrackDelegate videoWillRequest:request isRedirectRequest:YES];
         }
         self.videoRequest = request;
-    });
+    }];
     
     !completionHandler ?: completionHandler(request);
 }
 
 - (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data
 {
-    if (LXY_VideoDownloadDelegate) {
-        s_downloadSize += data.length;
-        if (s_downloadSize >= LXY_REQ_TASK_NETWORK_PROFILER_SIZE) {
-            [self _doVideoDownloadDelegate];
-        }
+    NSUInteger downloadSize = atomic_fetch_add_explicit(&s_downloadSize, data.length, memory_order_relaxed) + data.length;
+    if (downloadSize >= LXY_REQ_TASK_NETWORK_PROFILER_SIZE) {
+        [self _doVideoDownloadDelegate];
     }
     
-    dispatch_async(self.taskQueue, ^{
+    [self _performOnTaskQueue:^{
+        // staged first, so that the delegate can read it
+        [self __URLSession:session dataTask:dataTask didReceiveData:data];
+        
         if (self.delegate && [self.delegate respondsToSelector:@selector(requestTask:didReceiveWiredData:)]) {
             [self.delegate requestTask:self didReceiveWiredData:data];
         }
-        
-        [self __URLSession:session dataTask:dataTask didReceiveData:data];
-    });
+    }];
 }
 
 - (void)__URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data
 {
-//    LXY_VIDEO_TRACE(@"%@ data: self = %p, %@", self.requestURLKey, self, @(data.length));
+    LXY_VIDEO_BINARY_TRACE(LXYVideoLogEventRequestData, LXY_VIDEO_BINARY_PTR(self), data.length, self.memCacheOffset);
     
     if (self.state != LXYVideoCacheRequestTaskStateRunning) {
         return;
@@ -355,17 +631,43 @@ static int s_requestCountOnTheFly = 0;
 - (void)syncDataWithURLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask completion:(void(^)(NSError *))completion
 {
     NSUInteger dataLength = self.dataCache.length;
+    NSUInteger dataOffset = self.memCacheOffset;
     
     NSData *dataCache = self.dataCache;
+    LXYVideoPendingWrite *pendingWrite = [LXYVideoPendingWrite new];
+    pendingWrite.offset = dataOffset;
+    pendingWrite.data = dataCache;
+    [self.pendingWrites addObject:pendingWrite];
+    
+    LXYVideoMetricsTimeline *timeline = self.timeline;
+    NSUInteger requestOffset = self.requestRange.location;
+    uint64_t writeTimestamp = timeline ? LXYVideoMetricsTimestamp() : 0;
+    
     [LXYVideoDiskCache appendCacheData:self.dataCache
                                 offset:self.memCacheOffset
                                 forKey:self.requestURLKey
                               mimeType:self.mimeType
                             fileLength:self.fileLength
                             completion:^(NSError *error) {
+                                if (timeline) {
+                                    [[LXYVideoPlaybackMetrics sharedInstance].diskWriteLatencyHistogram recordValue:LXYVideoMetricsMicrosecondsSince(writeTimestamp)];
+                                }
+                                
                                 dispatch_async(self.taskQueue, ^{
+                                    // the bytes move from memory to disk at once, there is no gap for readers
+                                    [self.pendingWrites removeObjectIdenticalTo:pendingWrite];
                                     if (!error) {
-                                        self.cacheLength += dataLength;
+                                        if (timeline && dataOffset + dataLength - requestOffset >= LXYVideoCacheRequestMetricsLength) {
+                                            double elapsed = [timeline markEvent:LXYVideoMetricsEventFirst100KBPersisted];
+                                            if (elapsed >= 0) {
+                                                [[LXYVideoPlaybackMetrics sharedInstance].timeToFirst100KBPersistedHistogram recordValue:(uint64_t)elapsed];
+                                            }
+                                        }
+
+                                        [self.cachedRanges addIndexesInRange:NSMakeRange(dataOffset, dataLength)];
+                                        if (dataOffset <= self.cacheLength) {
+                                            self.cacheLength = MAX(self.cacheLength, dataOffset + [self _rangeLengthFromOffset:dataOffset]);
+                                        }
                                         //
                                         if (self.delegate && [self.delegate respondsToSelector:@selector(requestTask:didReceiveData:)]) {
                                             [self.delegate requestTask:self didReceiveData:dataCache];
@@ -381,6 +683,14 @@ static int s_requestCountOnTheFly = 0;
                                     }
                                     
                                     !completion ? : completion(error);
+                                    
+                                    if (self.pendingWrites.count == 0 && self.pendingWriteBlocks.count > 0) {
+                                        NSArray<dispatch_block_t> *blocks = [self.pendingWriteBlocks copy];
+                                        [self.pendingWriteBlocks removeAllObjects];
+                                        for (dispatch_block_t block in blocks) {
+                                            block();
+                                        }
+                                    }
                                 });
                             }];
 
@@ -391,16 +701,16 @@ static int s_requestCountOnTheFly = 0;
 
 - (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error
 {
-    if (LXY_VideoDownloadDelegate) {
+    LXY_REQ_TASK_PROFILER_LOCK {
         --s_requestCountOnTheFly;
-        if (s_requestCountOnTheFly == 0 && s_downloadSize != 0 && !error) {
+        if (s_requestCountOnTheFly == 0 && atomic_load_explicit(&s_downloadSize, memory_order_relaxed) != 0 && !error) {
             [self _doVideoDownloadDelegate];
         }
     }
     
-    dispatch_async(self.taskQueue, ^{
+    [self _performOnTaskQueue:^{
         [self __URLSession:session task:task didCompleteWithError:error];
-    });
+    }];
 }
 
 - (void)__URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error
@@ -422,69 +732,126 @@ static int s_requestCountOnTheFly = 0;
             return;
         }
         
-//        LXY_VIDEO_INFO(@"%@ didCompleteWithError: self = %p, error = %@",
-//                       self.requestURLKey, self,
-//                       error);
+        LXY_VIDEO_BINARY_INFO(LXYVideoLogEventRequestFail, LXY_VIDEO_BINARY_PTR(self), error.code, 0);
         
-        [LXYVideoDiskCacheDeleteManager shouldDeleteCacheForKey:self.requestURLKey];
-        
-        // delegate
-        dispatch_async([LXYVideoDiskCache cacheQueue], ^{
-            dispatch_async(self.taskQueue, ^{
-                if (self.delegate && [self.delegate respondsToSelector:@selector(requestTask:didFailWithError:)]) {
-                    [self.delegate requestTask:self didFailWithError:error];
-                }
-            });
-        });
-                
+        // a refused reservation has written nothing, the entry stays as it is
+        if (!([error.domain isEqualToString:LXYVideoPlayerErrorDomain] && error.code == LXYVideoCacheErrorReserveFailed)) {
+            [LXYVideoDiskCacheDeleteManager shouldDeleteCacheForKey:self.requestURLKey];
+        }
         
         self.state = LXYVideoCacheRequestTaskStateError;
+        [self _finishTimelineWithEvent:LXYVideoMetricsEventFailed];
+        
+        // delegate: after the writes on the fly, without a hop through the cache queue
+        [self performAfterPendingWrites:^{
+            if (self.delegate && [self.delegate respondsToSelector:@selector(requestTask:didFailWithError:)]) {
+                [self.delegate requestTask:self didFailWithError:error];
+            }
+        }];
         
     } else {
 //        LXY_VIDEO_INFO(@"%@ didComplete: self = %p", self.requestURLKey, self);
         
         if (self.dataCache.length > 0) {
-            [self syncDataWithURLSession:session dataTask:(NSURLSessionDataTask *)task completion:^(NSError *error) {
-                if (!error) {
-//                    LXY_VIDEO_INFO(@"%@ didCompleteToDisk: self = %p, cacheLength = %@, fileLength = %@",
-//                                   self.requestURLKey, self,
-//                                   @(self.cacheLength), @(self.fileLength));
-                }
-            }];
+            [self syncDataWithURLSession:session dataTask:(NSURLSessionDataTask *)task completion:nil];
         }
         
-        // delegate
-        dispatch_async([LXYVideoDiskCache cacheQueue], ^{
-            dispatch_async(self.taskQueue, ^{
-                if(self.delegate && [self.delegate respondsToSelector:@selector(requestTaskDidFinishLoading:)]) {
-                    [self.delegate requestTaskDidFinishLoading:self];
-                }
-            });
-        });
-        
         self.state = LXYVideoCacheRequestTaskStateCompleted;
+        [self _finishTimelineWithEvent:LXYVideoMetricsEventFinished];
+        
+        // delegate: once the cached ranges include the last write
+        [self performAfterPendingWrites:^{
+            LXY_VIDEO_BINARY_INFO(LXYVideoLogEventRequestComplete,
+                                  LXY_VIDEO_BINARY_PTR(self), self.cacheLength, self.fileLength);
+            
+            if(self.delegate && [self.delegate respondsToSelector:@selector(requestTaskDidFinishLoading:)]) {
+                [self.delegate requestTaskDidFinishLoading:self];
+            }
+        }];
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didFinishCollectingMetrics:(NSURLSessionTaskMetrics *)metrics API_AVAILABLE(ios(10.0))
+{
+    // delivered before the completion
+    NSURLSessionTaskTransactionMetrics *transactionMetrics = metrics.transactionMetrics.lastObject;
+    if (!transactionMetrics || transactionMetrics.resourceFetchType != NSURLSessionTaskMetricsResourceFetchTypeNetworkLoad) {
+        return;
     }
+    
+    BOOL reused = transactionMetrics.reusedConnection;
+    NSTimeInterval connectTime = [transactionMetrics.connectEndDate timeIntervalSinceDate:transactionMetrics.domainLookupStartDate ?: transactionMetrics.connectStartDate];
+    
+    [self _performOnTaskQueue:^{
+        if (!self.timeline || task != self.runningTask) {
+            return;
+        }
+        
+        [[LXYVideoPlaybackMetrics sharedInstance] recordConnectionReused:reused];
+        if (reused) {
+            [self.timeline markEvent:LXYVideoMetricsEventConnectionReused];
+        } else {
+            [self.timeline markEvent:LXYVideoMetricsEventConnected];
+            if (connectTime > 0) {
+                [[LXYVideoPlaybackMetrics sharedInstance].connectTimeHistogram recordValue:(uint64_t)(connectTime * 1000)];
+            }
+        }
+    }];
 }
 
+#pragma mark - Metrics
+
+- (void)_markEvent:(NSString *)event histogram:(LXYVideoHistogram *)histogram
+{
+    if (!self.timeline) {
+        return;
+    }
+    
+    double elapsed = [self.timeline markEvent:event];
+    if (elapsed >= 0) {
+        [histogram recordValue:(uint64_t)elapsed];
+    }
+}
+
+- (void)_finishTimelineWithEvent:(NSString *)event
+{
+    if (!self.timeline) {
+        return;
+    }
+    
+    [self.timeline markEvent:event];
+    [[LXYVideoPlaybackMetrics sharedInstance] finishTimeline:self.timeline];
+    self.timeline = nil;
+}
+
+#pragma mark - Profiler
+
 static const double kLXYVideoNetworkSpeedMax = 102400;   // 100MB/s
 static const double kLXYVideoNetworkSpeedMin = 10;       // 10 KB/s
 
+// may run on several data paths at once: the sample is taken by the one which swaps the size out
 - (void)_doVideoDownloadDelegate
 {
+    NSUInteger length = atomic_exchange_explicit(&s_downloadSize, 0, memory_order_relaxed);
+    if (length == 0) {
+        return;
+    }
+    
     NSTimeInterval currentTime = [[NSDate date] timeIntervalSince1970];
     //
-    NSTimeInterval duration = currentTime - s_dataReceiveStartTime;
-    NSUInteger length = s_downloadSize;
+    NSTimeInterval duration = currentTime - atomic_exchange_explicit(&s_dataReceiveStartTime, currentTime, memory_order_relaxed);
     
     double speed = length / duration / 1024;
     if (kLXYVideoNetworkSpeedMin <= speed && speed <= kLXYVideoNetworkSpeedMax ) {
-        dispatch_async(self.taskQueue, ^{
-            [LXY_VideoDownloadDelegate videoDidDownloadDataLength:length interval:duration];
-        });
+        // feeds the rendition selection of LXYVideoPlayerController
+        [LXYVideoBandwidthEstimator addSampleWithLength:length interval:duration];
+        
+        if (LXY_VideoDownloadDelegate) {
+            dispatch_async(self.taskQueue, ^{
+                [LXY_VideoDownloadDelegate videoDidDownloadDataLength:length interval:duration];
+            });
+        }
     }
-    //
-    s_dataReceiveStartTime = currentTime;
-    s_downloadSize = 0;
 }
 
 @end
@@ -0,0 +1,82 @@
+
+#import <Foundation/Foundation.h>
+#import <AVFoundation/AVFoundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * delivery state of a loading request
+ */
+@interface LXYVideoLoadingRequestCursor : NSObject
+
+/// the loading request sent by AVPlayer
+@property (nonatomic, strong, readonly) AVAssetResourceLoadingRequest *loadingRequest;
+
+/// next byte to deliver
+@property (nonatomic, assign) long long offset;
+
+/// the end of the requested range, exclusive
+@property (nonatomic, assign, readonly) long long endOffset;
+
+/// whether contentInformationRequest has been answered
+@property (nonatomic, assign) BOOL contentInformationFilled;
+
+/// when data was delivered last time, or when the request arrived. timeIntervalSince1970
+@property (nonatomic, assign) NSTimeInterval lastDeliveryTime;
+
+- (instancetype)initWithLoadingRequest:(AVAssetResourceLoadingRequest *)loadingRequest;
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
+
+@end
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * pending loading requests, ordered by the next byte they need.
+ * so that new data only wakes the requests waiting inside it.
+ * NOT thread safe. should be run on the resource loader's queue.
+ */
+@interface LXYVideoLoadingRequestIndex : NSObject
+
+/// number of cursors
+@property (nonatomic, assign, readonly) NSUInteger count;
+
+/**
+ * @brief add a cursor, filed under its current offset
+ */
+- (void)addCursor:(LXYVideoLoadingRequestCursor *)cursor;
+
+/**
+ * @brief remove @cursor
+ */
+- (void)removeCursor:(LXYVideoLoadingRequestCursor *)cursor;
+
+/**
+ * @brief refile @cursor after its offset has moved
+ */
+- (void)updateCursor:(LXYVideoLoadingRequestCursor *)cursor;
+
+/**
+ * @brief the cursor of @loadingRequest. nil if not found
+ */
+- (LXYVideoLoadingRequestCursor * _Nullable)cursorForLoadingRequest:(AVAssetResourceLoadingRequest *)loadingRequest;
+
+/**
+ * @brief cursors whose offset lies in @range, in offset order
+ */
+- (NSArray<LXYVideoLoadingRequestCursor *> *)cursorsWithOffsetInRange:(NSRange)range;
+
+/**
+ * @brief all cursors, in offset order
+ */
+- (NSArray<LXYVideoLoadingRequestCursor *> *)allCursors;
+
+/**
+ * @brief remove all cursors
+ */
+- (void)removeAllCursors;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,170 @@
+
+#import "LXYVideoLoadingRequestIndex.h"
+
+@interface LXYVideoLoadingRequestCursor ()
+
+// the offset under which the cursor is filed in the index
+@property (nonatomic, assign) long long indexedOffset;
+
+@end
+
+@implementation LXYVideoLoadingRequestCursor
+
+- (instancetype)initWithLoadingRequest:(AVAssetResourceLoadingRequest *)loadingRequest
+{
+    self = [super init];
+    if (self) {
+        _loadingRequest = loadingRequest;
+        _lastDeliveryTime = [[NSDate date] timeIntervalSince1970];
+        AVAssetResourceLoadingDataRequest *dataRequest = loadingRequest.dataRequest;
+        _offset = dataRequest.currentOffset != 0 ? dataRequest.currentOffset : dataRequest.requestedOffset;
+        _endOffset = dataRequest ? dataRequest.requestedOffset + dataRequest.requestedLength : 0;
+        _indexedOffset = _offset;
+    }
+    
+    return self;
+}
+
+@end
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoLoadingRequestIndex ()
+
+// cursors sorted by indexedOffset
+@property (nonatomic, strong) NSMutableArray<LXYVideoLoadingRequestCursor *> *sortedCursors;
+
+// <loadingRequest, cursor>, keyed by pointer
+@property (nonatomic, strong) NSMapTable<AVAssetResourceLoadingRequest *, LXYVideoLoadingRequestCursor *> *cursorMap;
+
+@end
+
+@implementation LXYVideoLoadingRequestIndex
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _sortedCursors = [NSMutableArray array];
+        _cursorMap = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality
+                                               valueOptions:NSPointerFunctionsStrongMemory
+                                                   capacity:8];
+    }
+    
+    return self;
+}
+
+#pragma mark - Public
+
+- (NSUInteger)count
+{
+    return self.sortedCursors.count;
+}
+
+- (void)addCursor:(LXYVideoLoadingRequestCursor *)cursor
+{
+    if ([self.cursorMap objectForKey:cursor.loadingRequest]) {
+        return;
+    }
+    
+    [self.cursorMap setObject:cursor forKey:cursor.loadingRequest];
+    [self _insertCursor:cursor];
+}
+
+- (void)removeCursor:(LXYVideoLoadingRequestCursor *)cursor
+{
+    NSUInteger index = [self _indexOfCursor:cursor];
+    if (index == NSNotFound) {
+        return;
+    }
+    
+    [self.sortedCursors removeObjectAtIndex:index];
+    [self.cursorMap removeObjectForKey:cursor.loadingRequest];
+}
+
+- (void)updateCursor:(LXYVideoLoadingRequestCursor *)cursor
+{
+    if (cursor.offset == cursor.indexedOffset) {
+        return;
+    }
+    
+    NSUInteger index = [self _indexOfCursor:cursor];
+    if (index == NSNotFound) {
+        return;
+    }
+    
+    [self.sortedCursors removeObjectAtIndex:index];
+    [self _insertCursor:cursor];
+}
+
+- (LXYVideoLoadingRequestCursor *)cursorForLoadingRequest:(AVAssetResourceLoadingRequest *)loadingRequest
+{
+    return [self.cursorMap objectForKey:loadingRequest];
+}
+
+- (NSArray<LXYVideoLoadingRequestCursor *> *)cursorsWithOffsetInRange:(NSRange)range
+{
+    NSUInteger begin = [self _lowerBoundForOffset:range.location];
+    NSUInteger end = [self _lowerBoundForOffset:NSMaxRange(range)];
+    if (begin >= end) {
+        return @[];
+    }
+    
+    return [self.sortedCursors subarrayWithRange:NSMakeRange(begin, end - begin)];
+}
+
+- (NSArray<LXYVideoLoadingRequestCursor *> *)allCursors
+{
+    return [self.sortedCursors copy];
+}
+
+- (void)removeAllCursors
+{
+    [self.sortedCursors removeAllObjects];
+    [self.cursorMap removeAllObjects];
+}
+
+#pragma mark - Private
+
+// the first index whose indexedOffset >= @offset
+- (NSUInteger)_lowerBoundForOffset:(long long)offset
+{
+    NSUInteger low = 0;
+    NSUInteger high = self.sortedCursors.count;
+    while (low < high) {
+        NSUInteger mid = low + (high - low) / 2;
+        if (self.sortedCursors[mid].indexedOffset < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    return low;
+}
+
+- (void)_insertCursor:(LXYVideoLoadingRequestCursor *)cursor
+{
+    cursor.indexedOffset = cursor.offset;
+    // after the cursors of the same offset, to keep the arrival order
+    NSUInteger index = [self _lowerBoundForOffset:cursor.indexedOffset + 1];
+    [self.sortedCursors insertObject:cursor atIndex:index];
+}
+
+- (NSUInteger)_indexOfCursor:(LXYVideoLoadingRequestCursor *)cursor
+{
+    NSUInteger count = self.sortedCursors.count;
+    for (NSUInteger index = [self _lowerBoundForOffset:cursor.indexedOffset]; index < count; ++index) {
+        LXYVideoLoadingRequestCursor *indexedCursor = self.sortedCursors[index];
+        if (indexedCursor.indexedOffset != cursor.indexedOffset) {
+            break;
+        }
+        if (indexedCursor == cursor) {
+            return index;
+        }
+    }
+    
+    return NSNotFound;
+}
+
+@end
@@ -0,0 +1,93 @@
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * decides whether a cached video can be handed to AVPlayer as a plain file, bypassing LXYVideoResourceLoader,
+ * and provides the file for it.
+ *
+ * the data file of the disk cache has no path extension, which AVFoundation needs to recognize the container.
+ * a hard link with the extension is made in a temporary directory instead of a copy. the link keeps the data
+ * alive even if the cache entry is removed during playback.
+ */
+@interface LXYVideoLocalPlayback : NSObject
+
+/**
+ * @brief whether a cache entry is complete and verified, thus playable as a file.
+ *        NO for a data file longer than the video, which an inconsistent write leaves as well
+ *
+ * @param hasCache      the data file exists
+ * @param isComplete    the cached ranges of the meta cover the whole video
+ * @param fileSize      the video size recorded in the meta
+ * @param dataFileSize  the size of the data file on disk
+ */
++ (BOOL)canPlayFileWithHasCache:(BOOL)hasCache
+                     isComplete:(BOOL)isComplete
+                       fileSize:(long long)fileSize
+                   dataFileSize:(long long)dataFileSize;
+
+/**
+ * @brief whether a data file found complete by an earlier link is still the same file, so it can be linked
+ *        without a meta lookup. NO once the size or the modification date differs: a trim, or any other write
+ *        to the data file, changes the modification date even if the size is kept
+ *
+ * @param recordedSize          the data file size when it was found complete
+ * @param recordedDate          the data file modification date when it was found complete
+ * @param size                  the current data file size
+ * @param date                  the current data file modification date. nil if the file is gone
+ */
++ (BOOL)isCompleteFileWithSize:(unsigned long long)recordedSize
+              modificationDate:(NSDate * _Nullable)recordedDate
+           unchangedAtFileSize:(unsigned long long)size
+              modificationDate:(NSDate * _Nullable)date;
+
+/**
+ * @brief the path extension for the file of @URL. the extension of @URL if it is a known container, "mp4" otherwise
+ */
++ (NSString *)pathExtensionForURL:(NSURL *)URL;
+
+/**
+ * @brief the link path for the cache entry of @key
+ */
++ (NSString *)linkPathForKey:(NSString *)key URL:(NSURL *)URL;
+
+/**
+ * @brief make the playable file for the cache entry of @key, if the entry can be played as a file.
+ *        nil if not, or if the link fails. a link left at the path by an earlier playback is replaced,
+ *        as it may point to an entry removed since.
+ * Attention: should be run in the completion block of getCacheInfoForURLString:, on the disk cache queue
+ *
+ * @param cachePath     the data file path of the cache entry
+ * @param key           the cache key
+ * @param URL           the origin URL
+ * @param hasCache      the data file exists
+ * @param isComplete    the cached ranges of the meta cover the whole video
+ * @param fileSize      the video size recorded in the meta
+ */
++ (NSString * _Nullable)linkFileAtPath:(NSString * _Nullable)cachePath
+                                forKey:(NSString *)key
+                                   URL:(NSURL *)URL
+                              hasCache:(BOOL)hasCache
+                            isComplete:(BOOL)isComplete
+                              fileSize:(long long)fileSize;
+
+/**
+ * @brief make the playable file for the cache entry of @key at once, if an earlier link found the entry complete
+ *        and the data file has not changed since, see isCompleteFileWithSize:modificationDate:unchangedAtFileSize:modificationDate:.
+ *        nil if not: look the entry up with getCacheInfoForURLString: then.
+ * Attention: only the data file is looked at, no hop through the disk cache queue
+ *
+ * @param key           the cache key
+ * @param URL           the origin URL
+ */
++ (NSString * _Nullable)linkKnownCompleteFileForKey:(NSString *)key URL:(NSURL *)URL;
+
+/**
+ * @brief remove the link made by @linkFileAtPath:forKey:URL:hasCache:isComplete:fileSize:
+ */
++ (void)removeLinkAtPath:(NSString *)linkPath;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,158 @@
+
+#import "LXYVideoLocalPlayback.h"
+#import "LXYVideoPlayerDefines.h"
+
+static NSString * const kLXYLocalPlaybackDirectory = @"LXYVideoLocalPlayback";
+// the data files found complete, by key
+static const NSUInteger kLXYLocalPlaybackCompleteFileCount = 64;
+static NSString * const kLXYLocalPlaybackPathKey = @"path";
+
+@implementation LXYVideoLocalPlayback
+
+#pragma mark - Public
+
++ (BOOL)canPlayFileWithHasCache:(BOOL)hasCache
+                     isComplete:(BOOL)isComplete
+                       fileSize:(long long)fileSize
+                   dataFileSize:(long long)dataFileSize
+{
+    // a data file longer than the video is left by an inconsistent write as well
+    return hasCache && isComplete && fileSize > 0 && dataFileSize == fileSize;
+}
+
++ (BOOL)isCompleteFileWithSize:(unsigned long long)recordedSize
+              modificationDate:(NSDate *)recordedDate
+           unchangedAtFileSize:(unsigned long long)size
+              modificationDate:(NSDate *)date
+{
+    // any write to the data file, a trim included, changes the modification date
+    return recordedDate && date && size == recordedSize && [date isEqualToDate:recordedDate];
+}
+
++ (NSString *)pathExtensionForURL:(NSURL *)URL
+{
+    static NSSet<NSString *> *knownExtensions = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        knownExtensions = [NSSet setWithObjects:@"mp4", @"m4v", @"mov", @"m4a", @"mp3", nil];
+    });
+    
+    NSString *pathExtension = URL.pathExtension.lowercaseString;
+    if (pathExtension && [knownExtensions containsObject:pathExtension]) {
+        return pathExtension;
+    }
+    
+    return @"mp4";
+}
+
++ (NSString *)linkPathForKey:(NSString *)key URL:(NSURL *)URL
+{
+    NSString *filename = [key stringByAppendingPathExtension:[self pathExtensionForURL:URL]];
+    
+    return [[self _directory] stringByAppendingPathComponent:filename];
+}
+
++ (NSString *)linkFileAtPath:(NSString *)cachePath
+                      forKey:(NSString *)key
+                         URL:(NSURL *)URL
+                    hasCache:(BOOL)hasCache
+                  isComplete:(BOOL)isComplete
+                    fileSize:(long long)fileSize
+{
+    if (LXYVideo_isEmptyString(cachePath) || LXYVideo_isEmptyString(key) || !URL) {
+        return nil;
+    }
+    
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSDictionary<NSFileAttributeKey, id> *attributes = [fileManager attributesOfItemAtPath:cachePath error:NULL];
+    if (![self canPlayFileWithHasCache:hasCache isComplete:isComplete fileSize:fileSize dataFileSize:[attributes fileSize]]) {
+        [[self _completeFiles] removeObjectForKey:key];
+        return nil;
+    }
+    
+    NSString *linkPath = [self _linkFileAtPath:cachePath forKey:key URL:URL];
+    if (linkPath && attributes.fileModificationDate) {
+        [[self _completeFiles] setObject:@{kLXYLocalPlaybackPathKey : cachePath,
+                                           NSFileSize : @([attributes fileSize]),
+                                           NSFileModificationDate : attributes.fileModificationDate}
+                                  forKey:key];
+    }
+    
+    return linkPath;
+}
+
++ (NSString *)linkKnownCompleteFileForKey:(NSString *)key URL:(NSURL *)URL
+{
+    if (LXYVideo_isEmptyString(key) || !URL) {
+        return nil;
+    }
+    
+    NSDictionary *completeFile = [[self _completeFiles] objectForKey:key];
+    if (!completeFile) {
+        return nil;
+    }
+    
+    NSString *cachePath = completeFile[kLXYLocalPlaybackPathKey];
+    NSDictionary<NSFileAttributeKey, id> *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:cachePath error:NULL];
+    if (![self isCompleteFileWithSize:[completeFile[NSFileSize] unsignedLongLongValue]
+                     modificationDate:completeFile[NSFileModificationDate]
+                  unchangedAtFileSize:[attributes fileSize]
+                     modificationDate:attributes.fileModificationDate]) {
+        [[self _completeFiles] removeObjectForKey:key];
+        return nil;
+    }
+    
+    return [self _linkFileAtPath:cachePath forKey:key URL:URL];
+}
+
++ (void)removeLinkAtPath:(NSString *)linkPath
+{
+    if (LXYVideo_isEmptyString(linkPath)) {
+        return;
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtPath:linkPath error:NULL];
+}
+
+#pragma mark - Private
+
++ (NSCache<NSString *, NSDictionary *> *)_completeFiles
+{
+    static NSCache<NSString *, NSDictionary *> *completeFiles = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        completeFiles = [NSCache new];
+        completeFiles.countLimit = kLXYLocalPlaybackCompleteFileCount;
+    });
+    
+    return completeFiles;
+}
+
++ (NSString *)_linkFileAtPath:(NSString *)cachePath forKey:(NSString *)key URL:(NSURL *)URL
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *directory = [self _directory];
+    if (![fileManager fileExistsAtPath:directory]) {
+        [fileManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:NULL];
+    }
+    
+    // a link left by a previous playback may point to a removed entry
+    NSString *linkPath = [self linkPathForKey:key URL:URL];
+    [fileManager removeItemAtPath:linkPath error:NULL];
+    
+    NSError *error = nil;
+    if (![fileManager linkItemAtPath:cachePath toPath:linkPath error:&error]) {
+        LXY_VIDEO_ERROR(@"%@ local playback link failed: error = %@", key, error);
+        return nil;
+    }
+    
+    return linkPath;
+}
+
++ (NSString *)_directory
+{
+    // NOT under the cache directory, of which all the files are taken as cache entries
+    return [NSTemporaryDirectory() stringByAppendingPathComponent:kLXYLocalPlaybackDirectory];
+}
+
+@end
@@ -0,0 +1,54 @@
+
+#import "LXYVideoPlaybackMetrics.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface LXYVideoMetricsTimeline ()
+
+/**
+ * @brief create a timeline starting now. nil if metrics are disabled
+ */
++ (instancetype _Nullable)timelineWithName:(NSString *)name key:(NSString *)key;
+
+/**
+ * @brief mark the first occurrence of @event. It can be called on any thread
+ *
+ * @return ms since the start, or a negative value if @event has been marked already
+ */
+- (double)markEvent:(NSString *)event;
+
+@end
+
+@interface LXYVideoPlaybackMetrics ()
+
+@property (nonatomic, strong, readonly) LXYVideoHistogram *metaLookupTimeHistogram;
+@property (nonatomic, strong, readonly) LXYVideoHistogram *connectTimeHistogram;
+@property (nonatomic, strong, readonly) LXYVideoHistogram *timeToFirstByteHistogram;
+@property (nonatomic, strong, readonly) LXYVideoHistogram *timeToFirst100KBPersistedHistogram;
+@property (nonatomic, strong, readonly) LXYVideoHistogram *timeToFirstLoadingRequestFinishedHistogram;
+@property (nonatomic, strong, readonly) LXYVideoHistogram *diskReadLatencyHistogram;
+@property (nonatomic, strong, readonly) LXYVideoHistogram *diskWriteLatencyHistogram;
+
+/**
+ * @brief count a request by its connection
+ */
+- (void)recordConnectionReused:(BOOL)reused;
+
+/**
+ * @brief keep @timeline for @recentTimelines
+ */
+- (void)finishTimeline:(LXYVideoMetricsTimeline * _Nullable)timeline;
+
+@end
+
+/**
+ * @brief a timestamp for LXYVideoMetricsMicrosecondsSince, cheap enough for the data path
+ */
+FOUNDATION_EXTERN uint64_t LXYVideoMetricsTimestamp(void);
+
+/**
+ * @brief us since @timestamp of LXYVideoMetricsTimestamp
+ */
+FOUNDATION_EXTERN uint64_t LXYVideoMetricsMicrosecondsSince(uint64_t timestamp);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,119 @@
+
+#import <Foundation/Foundation.h>
+#import "LXYVideoHistogram.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// events of a playback timeline
+FOUNDATION_EXTERN NSString * const LXYVideoMetricsEventMetaLoaded;
+FOUNDATION_EXTERN NSString * const LXYVideoMetricsEventFirstLoadingRequestFinished;
+FOUNDATION_EXTERN NSString * const LXYVideoMetricsEventStopped;
+
+/// events of a request timeline
+FOUNDATION_EXTERN NSString * const LXYVideoMetricsEventConnected;
+FOUNDATION_EXTERN NSString * const LXYVideoMetricsEventConnectionReused;
+FOUNDATION_EXTERN NSString * const LXYVideoMetricsEventFinished;
+FOUNDATION_EXTERN NSString * const LXYVideoMetricsEventFailed;
+FOUNDATION_EXTERN NSString * const LXYVideoMetricsEventCancelled;
+
+/// events of both
+FOUNDATION_EXTERN NSString * const LXYVideoMetricsEventResponse;
+FOUNDATION_EXTERN NSString * const LXYVideoMetricsEventFirst100KBPersisted;
+
+/**
+ * the timeline of a playback session, i.e. one LXYVideoResourceLoader, or of one network request
+ */
+@interface LXYVideoMetricsTimeline : NSObject
+
+/// "playback" or "request"
+@property (nonatomic, copy, readonly) NSString *name;
+
+/// cache key of the video
+@property (nonatomic, copy, readonly) NSString *key;
+
+/// start time. second since 1970
+@property (nonatomic, assign, readonly) NSTimeInterval startTime;
+
+/**
+ * @brief the first occurrence of each event. <event, ms since @startTime>
+ */
+- (NSDictionary<NSString *, NSNumber *> *)events;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * aggregated playback statistics
+ */
+@interface LXYVideoPlaybackStatistics : NSObject
+
+/// number of requests made on a new connection
+@property (nonatomic, assign, readonly) uint64_t newConnectionCount;
+
+/// number of requests made on a reused connection
+@property (nonatomic, assign, readonly) uint64_t reusedConnectionCount;
+
+/// time to read the meta of a video from the disk cache. ms
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *metaLookupTime;
+
+/// time to set up a new connection, DNS and TLS included. ms
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *connectTime;
+
+/// time from a request start to its response. ms
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *timeToFirstByte;
+
+/// time from a request start to 100KB of it persisted. ms
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *timeToFirst100KBPersisted;
+
+/// time from a playback start to the first loading request of AVPlayer satisfied. ms
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *timeToFirstLoadingRequestFinished;
+
+/// latency of a disk cache read for play. us
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *diskReadLatency;
+
+/// latency of a disk cache write for download. us
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *diskWriteLatency;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * playback and request metrics.
+ * recording is a few timestamps and lock-free histogram updates on the data path.
+ */
+@interface LXYVideoPlaybackMetrics : NSObject
+
+/// record metrics or not. default to YES
+@property (nonatomic, assign) BOOL enabled;
+
+/// log the statistics every @dumpInterval seconds. 0 to disable, by default
+@property (nonatomic, assign) NSTimeInterval dumpInterval;
+
+/// the max number of finished timelines kept. default to 20
+@property (nonatomic, assign) NSUInteger maxTimelineCount;
+
+/**
+ * @brief singleton
+ */
++ (instancetype)sharedInstance;
+
+/**
+ * @brief get the aggregated statistics since launch or the last reset. It can be called on any thread
+ */
+- (LXYVideoPlaybackStatistics *)statistics;
+
+/**
+ * @brief the last finished timelines, oldest first
+ */
+- (NSArray<LXYVideoMetricsTimeline *> *)recentTimelines;
+
+/**
+ * @brief reset the aggregated statistics and the timelines
+ */
+- (void)resetStatistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
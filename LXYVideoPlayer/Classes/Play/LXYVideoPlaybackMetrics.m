@@ -0,0 +1,277 @@
+
+#import "LXYVideoPlaybackMetrics.h"
+#import "LXYVideoPlaybackMetrics+Private.h"
+#import "LXYVideoLogger.h"
+
+#import <stdatomic.h>
+#import <mach/mach_time.h>
+
+NSString * const LXYVideoMetricsEventMetaLoaded                     = @"metaLoaded";
+NSString * const LXYVideoMetricsEventFirstLoadingRequestFinished    = @"firstLoadingRequestFinished";
+NSString * const LXYVideoMetricsEventStopped                        = @"stopped";
+NSString * const LXYVideoMetricsEventConnected                      = @"connected";
+NSString * const LXYVideoMetricsEventConnectionReused               = @"connectionReused";
+NSString * const LXYVideoMetricsEventFinished                       = @"finished";
+NSString * const LXYVideoMetricsEventFailed                         = @"failed";
+NSString * const LXYVideoMetricsEventCancelled                      = @"cancelled";
+NSString * const LXYVideoMetricsEventResponse                       = @"response";
+NSString * const LXYVideoMetricsEventFirst100KBPersisted            = @"first100KBPersisted";
+
+static double p_microsecondsPerTick(void)
+{
+    static double s_microsecondsPerTick = 0;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info(&timebase);
+        s_microsecondsPerTick = (double)timebase.numer / timebase.denom / NSEC_PER_USEC;
+    });
+    
+    return s_microsecondsPerTick;
+}
+
+uint64_t LXYVideoMetricsTimestamp(void)
+{
+    return mach_absolute_time();
+}
+
+uint64_t LXYVideoMetricsMicrosecondsSince(uint64_t timestamp)
+{
+    return (uint64_t)((mach_absolute_time() - timestamp) * p_microsecondsPerTick());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoMetricsTimeline ()
+
+@property (nonatomic, copy, readwrite) NSString *name;
+@property (nonatomic, copy, readwrite) NSString *key;
+@property (nonatomic, assign, readwrite) NSTimeInterval startTime;
+
+// mach_absolute_time at the start
+@property (nonatomic, assign) uint64_t startTimestamp;
+
+// <event, ms since the start>
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *mutableEvents;
+
+@end
+
+@implementation LXYVideoMetricsTimeline
+
++ (instancetype)timelineWithName:(NSString *)name key:(NSString *)key
+{
+    if (![LXYVideoPlaybackMetrics sharedInstance].enabled) {
+        return nil;
+    }
+    
+    LXYVideoMetricsTimeline *timeline = [LXYVideoMetricsTimeline new];
+    timeline.name = name;
+    timeline.key = key;
+    timeline.startTime = [[NSDate date] timeIntervalSince1970];
+    timeline.startTimestamp = LXYVideoMetricsTimestamp();
+    timeline.mutableEvents = [NSMutableDictionary dictionary];
+    
+    return timeline;
+}
+
+- (double)markEvent:(NSString *)event
+{
+    double elapsed = LXYVideoMetricsMicrosecondsSince(self.startTimestamp) / 1000.0;
+    
+    @synchronized (self) {
+        if (self.mutableEvents[event]) {
+            return -1;
+        }
+        self.mutableEvents[event] = @(elapsed);
+    }
+    
+    return elapsed;
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)events
+{
+    @synchronized (self) {
+        return [self.mutableEvents copy];
+    }
+}
+
+- (NSString *)description
+{
+    NSDictionary<NSString *, NSNumber *> *events = [self events];
+    NSArray<NSString *> *names = [events keysSortedByValueUsingSelector:@selector(compare:)];
+    NSMutableString *description = [NSMutableString stringWithFormat:@"%@ %@:", self.name, self.key];
+    for (NSString *name in names) {
+        [description appendFormat:@" %@ = %.1fms", name, events[name].doubleValue];
+    }
+    
+    return description;
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoPlaybackStatistics ()
+
+@property (nonatomic, assign, readwrite) uint64_t newConnectionCount;
+@property (nonatomic, assign, readwrite) uint64_t reusedConnectionCount;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *metaLookupTime;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *connectTime;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *timeToFirstByte;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *timeToFirst100KBPersisted;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *timeToFirstLoadingRequestFinished;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *diskReadLatency;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *diskWriteLatency;
+
+@end
+
+@implementation LXYVideoPlaybackStatistics
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"newConnection = %@, reusedConnection = %@, metaLookup = { %@ }, connect = { %@ }, TTFB = { %@ }, first100KB = { %@ }, firstLoadingRequest = { %@ }, diskRead = { %@ }, diskWrite = { %@ }",
+            @(self.newConnectionCount), @(self.reusedConnectionCount),
+            self.metaLookupTime, self.connectTime, self.timeToFirstByte, self.timeToFirst100KBPersisted,
+            self.timeToFirstLoadingRequestFinished, self.diskReadLatency, self.diskWriteLatency];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoPlaybackMetrics ()
+{
+    _Atomic(uint64_t) _newConnectionCount;
+    _Atomic(uint64_t) _reusedConnectionCount;
+}
+
+// finished timelines, oldest first
+@property (nonatomic, strong) NSMutableArray<LXYVideoMetricsTimeline *> *timelines;
+
+// dump timer
+@property (nonatomic, strong) dispatch_source_t dumpTimer;
+
+@end
+
+@implementation LXYVideoPlaybackMetrics
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _enabled = YES;
+        _maxTimelineCount = 20;
+        atomic_init(&_newConnectionCount, 0);
+        atomic_init(&_reusedConnectionCount, 0);
+        //
+        _metaLookupTimeHistogram = [LXYVideoHistogram new];
+        _connectTimeHistogram = [LXYVideoHistogram new];
+        _timeToFirstByteHistogram = [LXYVideoHistogram new];
+        _timeToFirst100KBPersistedHistogram = [LXYVideoHistogram new];
+        _timeToFirstLoadingRequestFinishedHistogram = [LXYVideoHistogram new];
+        _diskReadLatencyHistogram = [LXYVideoHistogram new];
+        _diskWriteLatencyHistogram = [LXYVideoHistogram new];
+        self.timelines = [NSMutableArray array];
+    }
+    
+    return self;
+}
+
++ (instancetype)sharedInstance
+{
+    static LXYVideoPlaybackMetrics *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instance = [LXYVideoPlaybackMetrics new];
+    });
+    
+    return instance;
+}
+
+#pragma mark - Public
+
+- (void)setDumpInterval:(NSTimeInterval)dumpInterval
+{
+    @synchronized (self) {
+        _dumpInterval = MAX(dumpInterval, 0);
+        
+        if (self.dumpTimer) {
+            dispatch_source_cancel(self.dumpTimer);
+            self.dumpTimer = nil;
+        }
+        
+        if (_dumpInterval > 0) {
+            uint64_t interval = (uint64_t)(_dumpInterval * NSEC_PER_SEC);
+            self.dumpTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+            dispatch_source_set_timer(self.dumpTimer, dispatch_time(DISPATCH_TIME_NOW, interval), interval, interval / 10);
+            __weak typeof(self) weakSelf = self;
+            dispatch_source_set_event_handler(self.dumpTimer, ^{
+                LXY_VIDEO_INFO(@"playback metrics: %@", [weakSelf statistics]);
+            });
+            dispatch_resume(self.dumpTimer);
+        }
+    }
+}
+
+- (LXYVideoPlaybackStatistics *)statistics
+{
+    LXYVideoPlaybackStatistics *statistics = [LXYVideoPlaybackStatistics new];
+    statistics.newConnectionCount = atomic_load_explicit(&_newConnectionCount, memory_order_relaxed);
+    statistics.reusedConnectionCount = atomic_load_explicit(&_reusedConnectionCount, memory_order_relaxed);
+    statistics.metaLookupTime = [self.metaLookupTimeHistogram snapshot];
+    statistics.connectTime = [self.connectTimeHistogram snapshot];
+    statistics.timeToFirstByte = [self.timeToFirstByteHistogram snapshot];
+    statistics.timeToFirst100KBPersisted = [self.timeToFirst100KBPersistedHistogram snapshot];
+    statistics.timeToFirstLoadingRequestFinished = [self.timeToFirstLoadingRequestFinishedHistogram snapshot];
+    statistics.diskReadLatency = [self.diskReadLatencyHistogram snapshot];
+    statistics.diskWriteLatency = [self.diskWriteLatencyHistogram snapshot];
+    
+    return statistics;
+}
+
+- (NSArray<LXYVideoMetricsTimeline *> *)recentTimelines
+{
+    @synchronized (self.timelines) {
+        return [self.timelines copy];
+    }
+}
+
+- (void)resetStatistics
+{
+    atomic_store_explicit(&_newConnectionCount, 0, memory_order_relaxed);
+    atomic_store_explicit(&_reusedConnectionCount, 0, memory_order_relaxed);
+    [self.metaLookupTimeHistogram reset];
+    [self.connectTimeHistogram reset];
+    [self.timeToFirstByteHistogram reset];
+    [self.timeToFirst100KBPersistedHistogram reset];
+    [self.timeToFirstLoadingRequestFinishedHistogram reset];
+    [self.diskReadLatencyHistogram reset];
+    [self.diskWriteLatencyHistogram reset];
+    
+    @synchronized (self.timelines) {
+        [self.timelines removeAllObjects];
+    }
+}
+
+#pragma mark - Record
+
+- (void)recordConnectionReused:(BOOL)reused
+{
+    atomic_fetch_add_explicit(reused ? &_reusedConnectionCount : &_newConnectionCount, 1, memory_order_relaxed);
+}
+
+- (void)finishTimeline:(LXYVideoMetricsTimeline *)timeline
+{
+    if (!timeline) {
+        return;
+    }
+    
+    @synchronized (self.timelines) {
+        [self.timelines addObject:timeline];
+        if (self.timelines.count > self.maxTimelineCount) {
+            [self.timelines removeObjectsInRange:NSMakeRange(0, self.timelines.count - self.maxTimelineCount)];
+        }
+    }
+}
+
+@end
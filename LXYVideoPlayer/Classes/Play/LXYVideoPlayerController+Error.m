@@ -3,7 +3,6 @@
 #import "LXYVideoPlayerController+Private.h"
 #import "LXYVideoPlayerController+PlayControl.h"
 #import "LXYVideoPlayerDefines.h"
-#import "LXYVideoDiskCacheDeleteManager.h"
 #import "LXYVideoDiskCacheConfiguration.h"
 #import "LXYVideoDiskCache.h"
 
@@ -51,7 +50,7 @@
     self.state = LXYVideoPlayerStateError;
     self.playbackState = LXYVideoPlaybackStateStopped;
     
-    [LXYVideoDiskCacheDeleteManager endUseCacheForKey:self.currentItemKey];
+    [self _releaseCacheLease];
     
     {
         NSString *logURLString = nil;
@@ -2,8 +2,8 @@
 #import "LXYVideoPlayerDefines.h"
 #import "LXYVideoPlayerController+Private.h"
 #import "LXYVideoDiskCache.h"
-#import "LXYVideoDiskCacheDeleteManager.h"
 #import "LXYVideoPlayerController+Error.h"
+#import "LXYVideoLocalPlayback.h"
 
 @implementation LXYVideoPlayerController (PlayControl)
 
@@ -45,15 +45,7 @@
     self.currentUseCacheFlag = useCache;
     if (useCache && !self.contentURL.isFileURL)
     {
-        self.resourceLoader = [LXYVideoResourceLoader resourceLoaderWithURL:self.contentURL
-                                                                      queue:self.resourceLoaderQueue
-                                                           internalDelegate:self.internalDelegate];
-        //
-        AVURLAsset *currentAsset = [AVURLAsset URLAssetWithURL:self.cachePlayURL options:nil];
-        [currentAsset.resourceLoader setDelegate:self.resourceLoader queue:self.resourceLoaderQueue];
-        [self reinitializePlayerWithAsset:currentAsset completion:completion];
-//        NSLog(@"self.contentURL=== %@",self.contentURL);
-
+        [self _prepareToPlayWithCacheCompletion:completion];
     }
     else
     {
@@ -66,6 +58,73 @@
     self.videoLoadBeginTime = [[NSDate date] timeIntervalSince1970];
 }
 
+- (void)_prepareToPlayWithCacheCompletion:(dispatch_block_t)completion
+{
+    NSURL *contentURL = self.contentURL;
+    NSString *key = self.currentItemKey;
+    NSInteger orderID = self.prepareOrderID;
+    
+    // keep the entry from the lookup on: a trim between the link and the play would cut the linked file in place.
+    // the resource loader path keeps it too, it downloads into the entry
+    [self _leaseCacheForKey:key];
+    
+    // an entry found complete before plays at once, without the lookup on the cache queue
+    NSString *knownPlayPath = [LXYVideoLocalPlayback linkKnownCompleteFileForKey:key URL:contentURL];
+    if (knownPlayPath) {
+        [self _prepareToPlayWithLocalPath:knownPlayPath key:key completion:completion];
+        return;
+    }
+    
+    // a complete cache is played from the file, without the resource loader
+    [LXYVideoDiskCache getCacheInfoForURLString:contentURL.absoluteString completion:^(BOOL hasCache, BOOL isComplete, NSString *cachePath, NSInteger fileSize) {
+        NSString *localPlayPath = [LXYVideoLocalPlayback linkFileAtPath:cachePath
+                                                                 forKey:key
+                                                                    URL:contentURL
+                                                               hasCache:hasCache
+                                                             isComplete:isComplete
+                                                               fileSize:fileSize];
+        dispatch_async_on_main_queue(^{
+            if (orderID != self.prepareOrderID) {
+                if (localPlayPath) {
+                    [LXYVideoLocalPlayback removeLinkAtPath:localPlayPath];
+                }
+                !completion ? : completion();
+                return;
+            }
+            
+            if (localPlayPath) {
+                [self _prepareToPlayWithLocalPath:localPlayPath key:key completion:completion];
+            } else {
+                [self _prepareToPlayWithResourceLoaderCompletion:completion];
+            }
+        });
+    }];
+}
+
+- (void)_prepareToPlayWithLocalPath:(NSString *)localPlayPath key:(NSString *)key completion:(dispatch_block_t)completion
+{
+    LXY_VIDEO_INFO(@"%@ play the complete cache from file", key);
+    
+    // the entry is leased by _prepareToPlayWithCacheCompletion:
+    self.localPlayPath = localPlayPath;
+    //
+    AVURLAsset *currentAsset = [AVURLAsset URLAssetWithURL:[NSURL fileURLWithPath:localPlayPath] options:nil];
+    [self reinitializePlayerWithAsset:currentAsset completion:completion];
+}
+
+- (void)_prepareToPlayWithResourceLoaderCompletion:(dispatch_block_t)completion
+{
+    self.resourceLoader = [LXYVideoResourceLoader resourceLoaderWithURL:self.contentURL
+                                                                  queue:self.resourceLoaderQueue
+                                                       internalDelegate:self.internalDelegate];
+    self.resourceLoader.readAheadDuration = self.readAheadDuration;
+    self.resourceLoader.readAheadLength = self.readAheadLength;
+    //
+    AVURLAsset *currentAsset = [AVURLAsset URLAssetWithURL:self.cachePlayURL options:nil];
+    [currentAsset.resourceLoader setDelegate:self.resourceLoader queue:self.resourceLoaderQueue];
+    [self reinitializePlayerWithAsset:currentAsset completion:completion];
+}
+
 - (void)reinitializePlayerWithAsset:(AVURLAsset *)asset completion:(dispatch_block_t)completion
 {
     if (!asset) {
@@ -189,7 +248,7 @@
     
     self.player.rate = self.playbackRate;
     
-    [LXYVideoDiskCacheDeleteManager startUseCacheForKey:self.currentItemKey];
+    [self _leaseCacheForKey:self.currentItemKey];
 }
 
 - (void)pause
@@ -241,7 +300,7 @@
         [audioPlayer stop];
     }];
     
-    [LXYVideoDiskCacheDeleteManager endUseCacheForKey:self.currentItemKey];
+    [self _releaseCacheLease];
     
     [self _resetPlayer];
 }
@@ -5,6 +5,8 @@
 #import "LXYVideoPlayerView.h"
 #import "LXYVideoResourceLoader.h"
 
+@class LXYVideoDiskCacheLease;
+
 NS_ASSUME_NONNULL_BEGIN
 
 @interface LXYVideoPlayerController () <AVAudioPlayerDelegate>
@@ -60,6 +62,9 @@ NS_ASSUME_NONNULL_BEGIN
 // current play URL key
 @property (nonatomic, copy)   NSString *currentItemKey;
 
+// lease on the cache item of @currentItemKey while playing
+@property (nonatomic, strong) LXYVideoDiskCacheLease * _Nullable cacheLease;
+
 // play URL list
 @property (nonatomic, copy)   NSArray<NSString *> * _Nullable contentURLStringList;
 
@@ -86,6 +91,12 @@ NS_ASSUME_NONNULL_BEGIN
 // whether the current play use cache or not
 @property (nonatomic, assign) BOOL currentUseCacheFlag;
 
+// the file link played directly, when the cache of the current play is complete
+@property (nonatomic, copy)   NSString * _Nullable localPlayPath;
+
+// prepare ID. To identify on-the-fly cache lookups of prepareToPlay
+@property (nonatomic, assign) NSInteger prepareOrderID;
+
 // the audio which will play simutaneously with the video
 // <AudioURL, [AudioPlayer, shouldPlayAudioWhileVideoPlay]>
 @property (nonatomic, strong) NSMutableDictionary<NSURL *, NSArray *> *audioMixDict;
@@ -104,6 +115,8 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)_initializePlayer;
 - (void)_setContentURLString:(NSString * _Nullable)urlString;
 - (void)_continuePlayFromWaiting;
+- (void)_leaseCacheForKey:(NSString *)key;
+- (void)_releaseCacheLease;
 //
 - (void)_enumerateAllAudioPlayersWithBlock:(void(^)(AVAudioPlayer *audioPlayer, BOOL shouldPlayWhileVideoPlay))block;
 
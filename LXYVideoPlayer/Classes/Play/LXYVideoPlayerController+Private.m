@@ -4,6 +4,7 @@
 #import "LXYVideoDiskCacheDeleteManager.h"
 #import "LXYVideoPlayerController+Error.h"
 #import "LXYVideoResourceDeallocManager.h"
+#import "LXYVideoLocalPlayback.h"
 
 #define GARBAGE_COLLECT(_obj_)          [[LXYVideoResourceDeallocManager sharedInstance] addResourceObject:(_obj_)]
 
@@ -29,6 +30,16 @@
         self.resourceLoader = nil;
     }
     
+    // any prepare on the fly is outdated
+    ++self.prepareOrderID;
+    
+    if (self.localPlayPath) {
+        [LXYVideoLocalPlayback removeLinkAtPath:self.localPlayPath];
+        self.localPlayPath = nil;
+    }
+    // also the lease taken by a prepare on the fly
+    [self _releaseCacheLease];
+    
     // KVO
     if (self.contentView.playerLayer) {
         LXYVideo_RemoveKVOObserverSafely(self.contentView.playerLayer, self, @"readyForDisplay");
@@ -107,6 +118,23 @@
     }
 }
 
+- (void)_leaseCacheForKey:(NSString *)key
+{
+    // one lease per item, however often play is called
+    if ([self.cacheLease.key isEqualToString:key]) {
+        return;
+    }
+    
+    [self.cacheLease invalidate];
+    self.cacheLease = [LXYVideoDiskCacheDeleteManager leaseCacheForKey:key];
+}
+
+- (void)_releaseCacheLease
+{
+    [self.cacheLease invalidate];
+    self.cacheLease = nil;
+}
+
 - (void)_setContentURLString:(NSString *)urlString
 {
     NSURL *url = nil;
@@ -265,7 +293,7 @@
         self.state = LXYVideoPlayerStateCompleted;
         self.playbackState = LXYVideoPlaybackStateStopped;
         
-        [LXYVideoDiskCacheDeleteManager endUseCacheForKey:self.currentItemKey];
+        [self _releaseCacheLease];
     }
     
     dispatch_async_on_main_queue(^{
@@ -4,6 +4,7 @@
 
 #import "LXYVideoPlayerControllerDelegate.h"
 #import "LXYVideoPlayerEnumDefines.h"
+#import "LXYVideoRenditionSelector.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -42,12 +43,21 @@ NS_ASSUME_NONNULL_BEGIN
 /// ignore audio interruption. e.g. earphone plug
 @property (nonatomic, assign) BOOL ignoreAudioInterruption;
 
+/// seconds to download ahead of the playback position when playing with cache, the download waits beyond. 0 for no limit, by default
+@property (nonatomic, assign) NSTimeInterval readAheadDuration;
+
+/// bytes to download ahead of the playback position when playing with cache. the larger window of the two applies. 0 for no limit, by default
+@property (nonatomic, assign) NSUInteger readAheadLength;
+
 /// video frame in view
 @property (nonatomic, assign, readonly) CGRect videoFrame;
 
 /// video origin size
 @property (nonatomic, assign, readonly) CGSize videoOriginSize;
 
+/// picks the starting rendition for @setContentRenditions:
+@property (nonatomic, strong) LXYVideoRenditionSelector *renditionSelector;
+
 /**
  * Delegates
  */
@@ -97,6 +107,25 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)setContentURLStringList:(NSArray<NSString *> * _Nullable)urlStringList;
 
+/**
+ * @brief set the renditions of the same video at different bitrates.
+ *        the rendition to start with is picked by @renditionSelector, from the bandwidth estimate and the disk cache.
+ *        the others are retried on failure like @setContentURLStringList:, nearest bitrates first, lower before higher.
+ *        the pick is made from the bandwidth at once, and refined with the disk cache unless prepareToPlay comes first.
+ *
+ * @param renditions    the bitrate ladder, in any order
+ */
+- (void)setContentRenditions:(NSArray<LXYVideoRendition *> * _Nullable)renditions;
+
+/**
+ * @brief the same as @setContentRenditions:. @completion is called on main queue once the disk cache has been looked at:
+ *        call prepareToPlay in it to start with the cached rendition
+ *
+ * @param renditions    the bitrate ladder, in any order
+ * @param completion    called on main queue
+ */
+- (void)setContentRenditions:(NSArray<LXYVideoRendition *> * _Nullable)renditions completion:(dispatch_block_t _Nullable)completion;
+
 /**
  * @brief whether is playing or not.
  *        It represents the real playback state.
@@ -10,6 +10,8 @@
 #import "NSTimer+LXYVideoBlockAddition.h"
 #import "LXYVideoPlayerControllerDefines.h"
 #import "LXYVideoURLTransformer.h"
+#import "LXYVideoDiskCache.h"
+#import "LXYVideoBandwidthEstimator.h"
 
 #define FLOAT_ZERO                      0.00001f
 #define FLOAT_EQUAL_ZERO(a)             (fabs(a) <= FLOAT_ZERO)
@@ -31,6 +33,7 @@
         _muted = NO;
         _playbackRate = 1.0f;
         _ignoreAudioInterruption = YES;
+        _renditionSelector = [LXYVideoRenditionSelector new];
         _playbackState = LXYVideoPlaybackStateStopped;
         
         // init settings: private
@@ -84,6 +87,64 @@
     }
 }
 
+- (void)setContentRenditions:(NSArray<LXYVideoRendition *> *)renditions
+{
+    [self setContentRenditions:renditions completion:nil];
+}
+
+- (void)setContentRenditions:(NSArray<LXYVideoRendition *> *)renditions completion:(dispatch_block_t)completion
+{
+    if (renditions.count == 0) {
+        self.contentURLStringList = @[];
+        !completion ? : completion();
+        return;
+    }
+    
+    // by the bandwidth at once: the cache lookup must not block the main thread
+    self.contentURLStringList = [self _urlStringListForRenditions:renditions cacheLengths:@[]];
+    if (!self.useCache) {
+        !completion ? : completion();
+        return;
+    }
+    
+    NSMutableArray<NSString *> *urlStrings = [NSMutableArray arrayWithCapacity:renditions.count];
+    for (LXYVideoRendition *rendition in renditions) {
+        [urlStrings addObject:rendition.URLString];
+    }
+    
+    NSArray<NSString *> *urlStringList = self.contentURLStringList;
+    NSInteger orderID = self.prepareOrderID;
+    [LXYVideoDiskCache cacheLengthsForURLStrings:urlStrings completion:^(NSArray<NSNumber *> *cacheLengths) {
+        // too late once the list has been replaced or played
+        if (self.contentURLStringList == urlStringList && self.prepareOrderID == orderID) {
+            NSArray<NSString *> *cachedURLStringList = [self _urlStringListForRenditions:renditions cacheLengths:cacheLengths];
+            if (![cachedURLStringList isEqualToArray:urlStringList]) {
+                self.contentURLStringList = cachedURLStringList;
+            }
+        }
+        !completion ? : completion();
+    }];
+}
+
+- (NSArray<NSString *> *)_urlStringListForRenditions:(NSArray<LXYVideoRendition *> *)renditions cacheLengths:(NSArray<NSNumber *> *)cacheLengths
+{
+    double bandwidth = [LXYVideoBandwidthEstimator bandwidth];
+    
+    NSUInteger index = [self.renditionSelector indexOfRenditionToStartFrom:renditions
+                                                             cachedLengths:cacheLengths
+                                                                 bandwidth:bandwidth];
+    NSArray<LXYVideoRendition *> *order = [self.renditionSelector failoverOrderOfRenditions:renditions startingAtIndex:index];
+    
+    LXY_VIDEO_INFO(@"setContentRenditions: bandwidth = %.0f, cached = %@, start with %@", bandwidth, @(cacheLengths.count > 0), order.firstObject);
+    
+    NSMutableArray<NSString *> *urlStringList = [NSMutableArray arrayWithCapacity:order.count];
+    for (LXYVideoRendition *rendition in order) {
+        [urlStringList addObject:rendition.URLString];
+    }
+    
+    return urlStringList;
+}
+
 - (void)setContentURLString:(NSString *)urlString
 {
     if (LXYVideo_isEmptyString(urlString)) {
@@ -266,7 +327,7 @@
             }
             
         } else if ([path isEqualToString:NSStringFromSelector(@selector(isPlaybackBufferEmpty))]){
-            NSLog(@"------------------------------isPlaybackBufferEmpty");
+            LXY_VIDEO_DEBUG(@"%@ isPlaybackBufferEmpty", self.currentItemKey);
         }
         else if ([path isEqualToString:NSStringFromSelector(@selector(isPlaybackBufferFull))]) {
             
@@ -321,7 +382,13 @@ __unused inline static NSString *stringForLoadedTimeRanges(NSArray<NSValue *> *l
         if (   strongSelf.currentItem
             && strongSelf.isPreparedToPlay) {
             strongSelf.currentPlaybackRate = CMTimebaseGetRate(strongSelf.currentItem.timebase);
-            NSLog(@"strongSelf.currentPlaybackRate =%@",@(strongSelf.currentPlaybackRate));
+            LXY_VIDEO_TRACE(@"%@ currentPlaybackRate = %.2f", strongSelf.currentItemKey, strongSelf.currentPlaybackRate);
+            
+            // move the read-ahead window of the cache download
+            if (   strongSelf.resourceLoader
+                && (strongSelf.readAheadDuration > 0 || strongSelf.readAheadLength > 0)) {
+                [strongSelf.resourceLoader updatePlaybackTime:strongSelf.currentPlaybackTime duration:strongSelf.duration];
+            }
         }
     }];
     [[NSRunLoop mainRunLoop] addTimer:self.pollingTimer forMode:NSRunLoopCommonModes];
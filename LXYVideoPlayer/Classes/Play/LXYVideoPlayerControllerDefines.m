@@ -1,4 +1,5 @@
 #import "LXYVideoPlayerControllerDefines.h"
+#import "LXYVideoLogger.h"
 
 void *KVO_Context_LXYVideoPlayerController = &KVO_Context_LXYVideoPlayerController;
 
@@ -16,6 +17,6 @@ void LXYVideo_RemoveKVOObserverSafely(id target, id observer, NSString *keyPath)
     }
     @catch (NSException *exception)
     {
-        NSLog(@"Exception removing observer: %@", exception);
+        LXY_VIDEO_WARN(@"exception removing observer: keyPath = %@, exception = %@", keyPath, exception);
     }
 }
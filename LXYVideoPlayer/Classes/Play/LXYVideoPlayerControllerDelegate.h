@@ -100,4 +100,17 @@
  */
 - (void)noVideoDataToDownloadForURL:(NSURL *)URL;
 
+/**
+ * @brief The loading requests of the player have waited too long for data, and the play download escalates.
+ *
+ * @param URL           video URL
+ * @param escalation    the step taken
+ * @param waitTime      how long the oldest loading request has waited. second
+ * @param throughput    recent download throughput. Byte/s
+ */
+- (void)loadingStallForURL:(NSURL *)URL
+                escalation:(LXYVideoStallEscalation)escalation
+                  waitTime:(NSTimeInterval)waitTime
+                throughput:(double)throughput;
+
 @end
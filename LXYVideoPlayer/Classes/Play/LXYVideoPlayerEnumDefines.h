@@ -57,4 +57,17 @@ typedef NS_ENUM(NSInteger, LXYVideoRotateType)
     LXYVideoRotateType270,
 };
 
+/// step taken when loading requests of the player wait too long for data
+typedef NS_ENUM(NSInteger, LXYVideoStallEscalation)
+{
+    /// no escalation
+    LXYVideoStallEscalationNone = 0,
+    /// the play download gets the highest network priority
+    LXYVideoStallEscalationRaisePriority,
+    /// prefetches are paused until the loading requests are fed again
+    LXYVideoStallEscalationPausePrefetch,
+    /// the missing range is requested again on a fresh connection
+    LXYVideoStallEscalationReissue,
+};
+
 #endif /* LXYVideoPlayerEnumDefines_h */
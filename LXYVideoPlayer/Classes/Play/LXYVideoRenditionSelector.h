@@ -0,0 +1,77 @@
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * one rendition of a video: a URL and the bitrate declared for it
+ */
+@interface LXYVideoRendition : NSObject
+
+/// video URL string
+@property (nonatomic, copy, readonly) NSString *URLString;
+
+/// declared bitrate. bit/s
+@property (nonatomic, assign, readonly) NSUInteger bitrate;
+
++ (instancetype)renditionWithURLString:(NSString *)URLString bitrate:(NSUInteger)bitrate;
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
++ (instancetype)new UNAVAILABLE_ATTRIBUTE;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * picks the rendition to start playing from a bitrate ladder.
+ * a pure policy: the bandwidth estimate and the cached bytes are given by the caller.
+ *
+ * 1) a rendition with cached bytes is preferred, if it can start within @startupBudget.
+ *    the highest bitrate of them is picked.
+ * 2) otherwise the highest bitrate sustainable by @bandwidthFraction of the bandwidth.
+ * 3) otherwise, or if the bandwidth is unknown, the lowest bitrate.
+ */
+@interface LXYVideoRenditionSelector : NSObject
+
+/// the longest acceptable startup time. second. 1 by default
+@property (nonatomic, assign) NSTimeInterval startupBudget;
+
+/// seconds of video to buffer before playing. 2 by default
+@property (nonatomic, assign) NSTimeInterval startupBufferDuration;
+
+/// the part of the bandwidth a rendition may use. 0.75 by default
+@property (nonatomic, assign) double bandwidthFraction;
+
+/**
+ * @brief the index of the rendition to start with. NSNotFound if @renditions is empty
+ *
+ * @param renditions        the bitrate ladder, in any order
+ * @param cachedLengths     contiguous cached bytes from the beginning, for each of @renditions
+ * @param bandwidth         bandwidth estimate. Byte/s. 0 if unknown
+ */
+- (NSUInteger)indexOfRenditionToStartFrom:(NSArray<LXYVideoRendition *> *)renditions
+                            cachedLengths:(NSArray<NSNumber *> *)cachedLengths
+                                bandwidth:(double)bandwidth;
+
+/**
+ * @brief the order to try @renditions in: the one at @index first, then lower bitrates from high to low,
+ *        then higher bitrates from low to high
+ */
+- (NSArray<LXYVideoRendition *> *)failoverOrderOfRenditions:(NSArray<LXYVideoRendition *> *)renditions
+                                             startingAtIndex:(NSUInteger)index;
+
+/**
+ * @brief seconds to buffer @rendition before playing. 0 if enough is cached, DBL_MAX if it can not be estimated
+ *
+ * @param rendition     the rendition
+ * @param cachedLength  contiguous cached bytes from the beginning
+ * @param bandwidth     bandwidth estimate. Byte/s. 0 if unknown
+ */
+- (NSTimeInterval)startupTimeOfRendition:(LXYVideoRendition *)rendition
+                            cachedLength:(NSUInteger)cachedLength
+                               bandwidth:(double)bandwidth;
+
+@end
+
+NS_ASSUME_NONNULL_END
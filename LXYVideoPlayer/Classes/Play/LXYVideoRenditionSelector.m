@@ -0,0 +1,152 @@
+
+#import "LXYVideoRenditionSelector.h"
+
+@interface LXYVideoRendition ()
+
+@property (nonatomic, copy) NSString *URLString;
+
+@property (nonatomic, assign) NSUInteger bitrate;
+
+@end
+
+@implementation LXYVideoRendition
+
++ (instancetype)renditionWithURLString:(NSString *)URLString bitrate:(NSUInteger)bitrate
+{
+    LXYVideoRendition *rendition = [[LXYVideoRendition alloc] initWithURLString:URLString bitrate:bitrate];
+    
+    return rendition;
+}
+
+- (instancetype)initWithURLString:(NSString *)URLString bitrate:(NSUInteger)bitrate
+{
+    self = [super init];
+    if (self) {
+        _URLString = [URLString copy];
+        _bitrate = bitrate;
+    }
+    
+    return self;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"{ url:%@, bitrate:%@ }", self.URLString, @(self.bitrate)];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation LXYVideoRenditionSelector
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _startupBudget = 1.0;
+        _startupBufferDuration = 2.0;
+        _bandwidthFraction = 0.75;
+    }
+    
+    return self;
+}
+
+#pragma mark - Public
+
+- (NSUInteger)indexOfRenditionToStartFrom:(NSArray<LXYVideoRendition *> *)renditions
+                            cachedLengths:(NSArray<NSNumber *> *)cachedLengths
+                                bandwidth:(double)bandwidth
+{
+    if (renditions.count == 0) {
+        return NSNotFound;
+    }
+    
+    NSUInteger cachedIndex = NSNotFound;
+    NSUInteger sustainableIndex = NSNotFound;
+    NSUInteger lowestIndex = 0;
+    double usableBitrate = bandwidth * 8 * self.bandwidthFraction;
+    
+    for (NSUInteger i = 0; i < renditions.count; ++i) {
+        LXYVideoRendition *rendition = renditions[i];
+        NSUInteger cachedLength = i < cachedLengths.count ? cachedLengths[i].unsignedIntegerValue : 0;
+        
+        if (rendition.bitrate < renditions[lowestIndex].bitrate) {
+            lowestIndex = i;
+        }
+        
+        if (   cachedLength > 0
+            && [self startupTimeOfRendition:rendition cachedLength:cachedLength bandwidth:bandwidth] <= self.startupBudget
+            && (cachedIndex == NSNotFound || rendition.bitrate > renditions[cachedIndex].bitrate)) {
+            cachedIndex = i;
+        }
+        
+        if (   bandwidth > 0
+            && rendition.bitrate <= usableBitrate
+            && (sustainableIndex == NSNotFound || rendition.bitrate > renditions[sustainableIndex].bitrate)) {
+            sustainableIndex = i;
+        }
+    }
+    
+    if (cachedIndex != NSNotFound) {
+        return cachedIndex;
+    }
+    if (sustainableIndex != NSNotFound) {
+        return sustainableIndex;
+    }
+    
+    return lowestIndex;
+}
+
+- (NSArray<LXYVideoRendition *> *)failoverOrderOfRenditions:(NSArray<LXYVideoRendition *> *)renditions
+                                             startingAtIndex:(NSUInteger)index
+{
+    if (index >= renditions.count) {
+        return renditions;
+    }
+    
+    LXYVideoRendition *first = renditions[index];
+    NSMutableArray<LXYVideoRendition *> *lower = [NSMutableArray array];
+    NSMutableArray<LXYVideoRendition *> *higher = [NSMutableArray array];
+    [renditions enumerateObjectsUsingBlock:^(LXYVideoRendition * _Nonnull rendition, NSUInteger idx, BOOL * _Nonnull stop) {
+        if (idx == index) {
+            return;
+        }
+        if (rendition.bitrate <= first.bitrate) {
+            [lower addObject:rendition];
+        } else {
+            [higher addObject:rendition];
+        }
+    }];
+    
+    [lower sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(LXYVideoRendition * _Nonnull obj1, LXYVideoRendition * _Nonnull obj2) {
+        return obj1.bitrate == obj2.bitrate ? NSOrderedSame : (obj1.bitrate > obj2.bitrate ? NSOrderedAscending : NSOrderedDescending);
+    }];
+    [higher sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(LXYVideoRendition * _Nonnull obj1, LXYVideoRendition * _Nonnull obj2) {
+        return obj1.bitrate == obj2.bitrate ? NSOrderedSame : (obj1.bitrate < obj2.bitrate ? NSOrderedAscending : NSOrderedDescending);
+    }];
+    
+    NSMutableArray<LXYVideoRendition *> *order = [NSMutableArray arrayWithObject:first];
+    [order addObjectsFromArray:lower];
+    [order addObjectsFromArray:higher];
+    
+    return order;
+}
+
+- (NSTimeInterval)startupTimeOfRendition:(LXYVideoRendition *)rendition
+                            cachedLength:(NSUInteger)cachedLength
+                               bandwidth:(double)bandwidth
+{
+    double startupLength = rendition.bitrate / 8.0 * self.startupBufferDuration;
+    if (cachedLength >= startupLength) {
+        return 0;
+    }
+    
+    if (bandwidth <= 0) {
+        return DBL_MAX;
+    }
+    
+    return (startupLength - cachedLength) / bandwidth;
+}
+
+@end
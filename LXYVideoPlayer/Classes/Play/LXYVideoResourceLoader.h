@@ -38,6 +38,12 @@ NS_ASSUME_NONNULL_BEGIN
 /// error
 @property (nonatomic, strong) NSError *error;
 
+/// seconds to download ahead of the playback position. the network request is suspended beyond. 0 for no limit, by default
+@property (nonatomic, assign) NSTimeInterval readAheadDuration;
+
+/// bytes to download ahead of the playback position. the larger window of the two applies. 0 for no limit, by default
+@property (nonatomic, assign) NSUInteger readAheadLength;
+
 /**
  * @brief create an instance.
  *
@@ -59,6 +65,14 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)getCacheLengthWithCompletion:(void(^)(long long))completion;
 
+/**
+ * @brief report the playback position, which moves the read-ahead window
+ *
+ * @param time          current playback time
+ * @param duration      video duration. 0 if unknown
+ */
+- (void)updatePlaybackTime:(NSTimeInterval)time duration:(NSTimeInterval)duration;
+
 /**
  * @brief stop loading
  */
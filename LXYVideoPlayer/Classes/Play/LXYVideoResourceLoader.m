@@ -7,6 +7,39 @@
 #import "LXYVideoPlayerDefines.h"
 #import "LXYVideoDiskCacheConfiguration.h"
 #import "LXYVideoURLTransformer.h"
+#import "LXYVideoLoadingRequestIndex.h"
+#import "LXYVideoTimeIndex.h"
+#import "LXYVideoStallWatchdog.h"
+#import "LXYVideoPrefetchTaskManager.h"
+#import "LXYVideoPlaybackMetrics+Private.h"
+#import "LXYVideoTraceRecorder.h"
+
+// bytes read from disk for each respondWithData:
+static const NSUInteger kLXYLoaderChunkSize = 256 * 1024;
+// bytes delivered to one loading request in one pass, so that a full-file request never holds up the others
+static const NSUInteger kLXYLoaderPassBudget = 1024 * 1024;
+// the smallest delivery worth a disk read, unless the request ends within it
+static const NSUInteger kLXYLoaderMinChunkSize = 10 * 1024;
+// a loading request further than this ahead of the running downloads starts a range download of its own
+static const NSUInteger kLXYLoaderSeekDistance = 1024 * 1024;
+// a suspended download resumes once less than this part of the read-ahead window is left
+static const double kLXYLoaderReadAheadResumeRatio = 0.5;
+// second. a download suspended longer than this is requested again instead of resumed: the CDN may have dropped the idle connection
+static const NSTimeInterval kLXYLoaderMaxSuspendInterval = 15.0;
+// second. how often a missing time index is looked up again
+static const NSTimeInterval kLXYLoaderTimeIndexRetryInterval = 2.0;
+// second. how often the stall watchdog looks at the loading requests
+static const NSTimeInterval kLXYLoaderWatchdogInterval = 0.5;
+// head bytes persisted for the first-bytes milestone of the playback timeline
+static const NSUInteger kLXYLoaderMetricsLength = 100 * 1024;
+
+@interface LXYVideoPrefetchTaskManager ()
+
++ (void)pauseForPlayStall;
+
++ (void)resumeFromPlayStall;
+
+@end
 
 @interface LXYVideoResourceLoader () <LXYVideoCacheRequestTaskDelegate>
 
@@ -16,12 +49,58 @@
 // request URL key
 @property (nonatomic, copy) NSString *requestURLKey;
 
-// AVAssetResourceLoaderDelegate的loadingRequest sent by AVPlayer
-@property (nonatomic, strong) NSMutableArray<AVAssetResourceLoadingRequest *> *requestList;
+// AVAssetResourceLoaderDelegate的loadingRequest sent by AVPlayer, indexed by the next byte they need
+@property (nonatomic, strong) LXYVideoLoadingRequestIndex *requestIndex;
+
+// a pass is scheduled to deliver bytes left over by the pass budget
+@property (nonatomic, assign) BOOL needsProcessRequestList;
 
-// play request task
+// play request task. the linear download from the cached head, which also provides the meta
 @property (nonatomic, strong) LXYVideoCachePlayTask *playTask;
 
+// range request task for a seek point, or for the holes left behind by seeks
+@property (nonatomic, strong) LXYVideoCachePlayTask *rangeTask;
+
+// the bytes @rangeTask was started for
+@property (nonatomic, assign) NSRange rangeTaskRange;
+
+// range tasks replaced by a newer one, readable until their writes on the fly are adopted by @playTask
+@property (nonatomic, strong) NSMutableArray<LXYVideoCachePlayTask *> *retiredTasks;
+
+// the offset of the latest loading request
+@property (nonatomic, assign) long long playheadOffset;
+
+// finishCacheForKey has been called
+@property (nonatomic, assign) BOOL cacheFinished;
+
+// the latest playback position reported by the player
+@property (nonatomic, assign) NSTimeInterval playbackTime;
+@property (nonatomic, assign) NSTimeInterval playbackDuration;
+
+// play time to bytes index, for the read-ahead window
+@property (nonatomic, strong) LXYVideoTimeIndex *timeIndex;
+
+// when the time index was looked up last time
+@property (nonatomic, assign) NSTimeInterval timeIndexLookupTime;
+
+// escalation policy for starved loading requests
+@property (nonatomic, strong) LXYVideoStallWatchdog *watchdog;
+
+// watchdog timer on @taskQueue
+@property (nonatomic, strong) dispatch_source_t watchdogTimer;
+
+// bytes received from network by all the download tasks
+@property (nonatomic, assign) NSUInteger receivedLength;
+
+// @receivedLength at the last watchdog check
+@property (nonatomic, assign) NSUInteger watchdogReceivedLength;
+
+// prefetching is paused by this loader
+@property (nonatomic, assign) BOOL prefetchPaused;
+
+// timeline of the playback session. nil if metrics are disabled
+@property (nonatomic, strong) LXYVideoMetricsTimeline *timeline;
+
 // LXYVideoResourceLoader's queue
 @property (nonatomic, strong) dispatch_queue_t taskQueue;
 
@@ -52,21 +131,37 @@
 {
     self = [super init];
     if (self) {
-        NSLog(@" LXYVideoResourceLoader initWithURL url = %@ ",URL.absoluteString);
-        self.requestList = [NSMutableArray array];
+        self.requestIndex = [LXYVideoLoadingRequestIndex new];
+        self.retiredTasks = [NSMutableArray array];
         self.requestURL = URL;
         self.requestURLKey = LXYVideoURLStringToCacheKey(URL.absoluteString);
         self.taskQueue = queue;
         self.stopped = NO;
         self.internalDelegate = internalDelegate;
+        self.timeline = [LXYVideoMetricsTimeline timelineWithName:@"playback" key:self.requestURLKey];
         //
         self.playTask = [LXYVideoCachePlayTask taskWithURL:URL queue:queue internalDelegate:internalDelegate];
         self.playTask.delegate = self;
+        //
+        self.watchdog = [LXYVideoStallWatchdog new];
+        [self startWatchdog];
     }
     return self;
     
 }
 
+- (void)dealloc
+{
+    if (_watchdogTimer) {
+        dispatch_source_cancel(_watchdogTimer);
+    }
+    
+    // released without stopLoading
+    if (_prefetchPaused) {
+        [LXYVideoPrefetchTaskManager resumeFromPlayStall];
+    }
+}
+
 - (void)getCacheLengthWithCompletion:(void(^)(long long))completion
 {
     dispatch_async(self.taskQueue, ^{
@@ -77,6 +172,16 @@
     });
 }
 
+- (void)updatePlaybackTime:(NSTimeInterval)time duration:(NSTimeInterval)duration
+{
+    dispatch_async(self.taskQueue, ^{
+        self.playbackTime = MAX(time, 0);
+        self.playbackDuration = MAX(duration, 0);
+        
+        [self updateReadAhead];
+    });
+}
+
 - (void)stopLoading
 {
     LXY_VIDEO_DEBUG(@"%@ stopLoading: self = %p", self.requestURLKey, self);
@@ -84,6 +189,13 @@
     
     dispatch_async(self.taskQueue, ^{
         [self.playTask cancelNetworkRequest];
+        [self.rangeTask cancelNetworkRequest];
+        
+        [self stopWatchdog];
+        
+        [self.timeline markEvent:LXYVideoMetricsEventStopped];
+        [[LXYVideoPlaybackMetrics sharedInstance] finishTimeline:self.timeline];
+        self.timeline = nil;
     });
 }
 
@@ -108,6 +220,11 @@
 //                   @(self.playTask.cacheLength),
 //                   [self dataRequestDescription:loadingRequest.dataRequest]);
     
+    LXY_VIDEO_TRACE_RECORD(loadingRequest.contentInformationRequest ? LXYVideoTraceOpContentInfoRequest : LXYVideoTraceOpLoadingRequest,
+                           self.requestURLKey,
+                           loadingRequest.dataRequest.requestedOffset,
+                           loadingRequest.dataRequest.requestedLength);
+    
     if (self.error) {
         return NO;
     } else {
@@ -118,6 +235,10 @@
 
 - (void)resourceLoader:(AVAssetResourceLoader *)resourceLoader didCancelLoadingRequest:(AVAssetResourceLoadingRequest *)loadingRequest
 {
+    LXY_VIDEO_TRACE_RECORD(LXYVideoTraceOpLoadingRequestCancel,
+                           self.requestURLKey,
+                           loadingRequest.dataRequest.requestedOffset,
+                           loadingRequest.dataRequest.requestedLength);
     [self removeLoadingRequest:loadingRequest];
 }
 
@@ -126,25 +247,69 @@
 - (void)requestTask:(LXYVideoCacheRequestTask *)task didReceiveData:(NSData *)data
 {
     // process cached loading request whenever new data is received
-    [self processRequestList];
+    if (task) {
+        if (task == self.playTask) {
+            [self handOverPlayTaskIfNeeded];
+        }
+        [self processRequestList];
+        [self updateReadAhead];
+    } else {
+        // meta loaded: content information may be answered
+        [self.timeline markEvent:LXYVideoMetricsEventMetaLoaded];
+        [self processAllRequests];
+    }
+    
+    if (self.timeline && self.playTask.cacheLength >= kLXYLoaderMetricsLength) {
+        [self.timeline markEvent:LXYVideoMetricsEventFirst100KBPersisted];
+    }
     
     if (self.delegate && [self.delegate respondsToSelector:@selector(loader:cacheProgress:)]) {
-        CGFloat cacheProgress = (CGFloat)self.playTask.cacheLength / self.playTask.fileLength;
+        // the file length is 0 until the response
+        NSUInteger fileLength = self.playTask.fileLength;
+        CGFloat cacheProgress = fileLength > 0 ? (CGFloat)[self persistedRanges].count / fileLength : 0;
         [self.delegate loader:self cacheProgress:cacheProgress];
     }
 }
 
+- (void)requestTask:(LXYVideoCacheRequestTask *)task didReceiveWiredData:(NSData *)data
+{
+    self.receivedLength += data.length;
+    
+    // serve from the staged bytes, without waiting for the disk sync
+    [self processRequestList];
+}
+
 - (void)requestTask:(LXYVideoCacheRequestTask *)task didReceiveResponse:(NSHTTPURLResponse *)response
 {
-    // do nothing
+    [self.timeline markEvent:LXYVideoMetricsEventResponse];
+    
+    // the first play of a video learns its content information from the response
+    [self processAllRequests];
 }
 
 - (void)requestTaskDidFinishLoading:(LXYVideoCacheRequestTask *)task
 {
+    if (task != self.playTask && task != self.rangeTask) {
+        return;
+    }
+    
+    // seeks may have left holes: keep downloading before the consistency check
+    NSUInteger fileLength = self.playTask.fileLength;
+    if (fileLength > 0 && ![[self persistedRanges] containsIndexesInRange:NSMakeRange(0, fileLength)]) {
+        [self startRangeDownloadForNextHole];
+        return;
+    }
+    
+    if (self.cacheFinished) {
+        return;
+    }
+    self.cacheFinished = YES;
+    
     [LXYVideoDiskCache finishCacheForKey:self.requestURLKey originURLString:self.requestURL.absoluteString completion:^(NSError *error, NSString *extra) {
         if (error) {
             dispatch_async(self.taskQueue, ^{
-                [self requestTask:task didFailWithError:error];
+                // a failed consistency check fails the playback, whichever task finished last
+                [self requestTask:self.playTask didFailWithError:error];
                 //
                 if (LXY_Reporter) {
 //                    LXY_Reporter(LXYReporterLabel_CacheDataCorrupted, self.requestURL.absoluteString, extra);
@@ -161,117 +326,670 @@
 }
 
 - (void)requestTask:(LXYVideoCacheRequestTask *)task didFailWithError:(NSError *)error
-{    
+{
+    // the connection was likely dropped while the read-ahead held it idle: download the rest on a new one
+    if (   (task == self.playTask || task == self.rangeTask)
+        && task.resumedFromSuspension
+        && !self.stopped
+        && self.playTask.fileLength > 0) {
+        LXY_VIDEO_INFO(@"%@ resumed download failed, request again: task = %p, error = %@", self.requestURLKey, task, error);
+        
+        if (task == self.rangeTask) {
+            [self retireRangeTask];
+        }
+        [self startRangeDownloadForNextHole];
+        return;
+    }
+    
+    // e.g. 416 near the end: only the loading requests waiting on the range fail, the playback goes on
+    if (task == self.rangeTask) {
+        [self failRangeTaskWithError:error];
+        return;
+    }
+    if (task != self.playTask) {
+        return;
+    }
+    
     self.error = error;
     
     if (!self.stopped) {
-        [self.requestList enumerateObjectsUsingBlock:^(AVAssetResourceLoadingRequest * _Nonnull loadingRequest, NSUInteger idx, BOOL * _Nonnull stop) {
+        for (LXYVideoLoadingRequestCursor *cursor in [self.requestIndex allCursors]) {
+            AVAssetResourceLoadingRequest *loadingRequest = cursor.loadingRequest;
             if (!loadingRequest.isFinished && !loadingRequest.isCancelled) {
                 [loadingRequest finishLoadingWithError:error];
             }
-        }];
+        }
     }
 
-    self.requestList = [NSMutableArray array];
+    [self.requestIndex removeAllCursors];
 }
 
 #pragma mark - 处理LoadingRequest
 
 - (void)addLoadingRequest:(AVAssetResourceLoadingRequest *)loadingRequest
 {
-    [self.requestList addObject:loadingRequest];
+    LXYVideoLoadingRequestCursor *cursor = [[LXYVideoLoadingRequestCursor alloc] initWithLoadingRequest:loadingRequest];
+    [self.requestIndex addCursor:cursor];
     
-    if ([self requestedDataCached:loadingRequest]) {
-        [self processRequestList];
+    if (!self.stopped) {
+        self.playheadOffset = cursor.offset;
+        [self processCursor:cursor];
+        
+        if ([self.requestIndex cursorForLoadingRequest:loadingRequest]) {
+            [self startRangeDownloadIfNeededForCursor:cursor];
+            // the player waits for data: resume a suspended download
+            [self updateReadAhead];
+        }
     }
 }
 
 - (void)removeLoadingRequest:(AVAssetResourceLoadingRequest *)loadingRequest
 {
-    if ([self.requestList containsObject:loadingRequest]) {
-        [self.requestList removeObject:loadingRequest];
+    LXYVideoLoadingRequestCursor *cursor = [self.requestIndex cursorForLoadingRequest:loadingRequest];
+    if (cursor) {
+        [self.requestIndex removeCursor:cursor];
     }
 }
 
-- (BOOL)requestedDataCached:(AVAssetResourceLoadingRequest *)loadingRequest
-{
-    long long requestedOffset = loadingRequest.dataRequest.requestedOffset;
-    long long requestedLength = loadingRequest.dataRequest.requestedLength;
-    if (requestedOffset + requestedLength > self.playTask.cacheLength) {
-        return NO;
-    }
-
-    return YES;
-}
-
+// wake only the loading requests waiting inside readable bytes
 - (void)processRequestList
 {
+    self.needsProcessRequestList = NO;
+    
     if (self.stopped) {
-        self.requestList = [NSMutableArray array];
+        [self.requestIndex removeAllCursors];
         return;
     }
     
-    // clear loading requests which are finished or cancelled
-    NSMutableArray *finishedRequestList = [NSMutableArray array];
-    [self.requestList enumerateObjectsUsingBlock:^(AVAssetResourceLoadingRequest * _Nonnull loadingRequest, NSUInteger idx, BOOL * _Nonnull stop) {
-        if (loadingRequest.isFinished || loadingRequest.isCancelled) {
-            [finishedRequestList addObject:loadingRequest];
+    [[self readableRanges] enumerateRangesUsingBlock:^(NSRange range, BOOL * _Nonnull stop) {
+        for (LXYVideoLoadingRequestCursor *cursor in [self.requestIndex cursorsWithOffsetInRange:range]) {
+            [self processCursor:cursor];
         }
     }];
-    [self.requestList removeObjectsInArray:finishedRequestList];
+}
 
-    [self.requestList enumerateObjectsUsingBlock:^(AVAssetResourceLoadingRequest * _Nonnull loadingRequest, NSUInteger idx, BOOL * _Nonnull stop) {
-        [self finishLoadingWithLoadingRequest:loadingRequest];
-    }];
+// content information may be answered without any data
+- (void)processAllRequests
+{
+    if (self.stopped) {
+        [self.requestIndex removeAllCursors];
+        return;
+    }
+    
+    for (LXYVideoLoadingRequestCursor *cursor in [self.requestIndex allCursors]) {
+        [self processCursor:cursor];
+    }
 }
 
-- (void)finishLoadingWithLoadingRequest:(AVAssetResourceLoadingRequest *)loadingRequest
+- (void)processCursor:(LXYVideoLoadingRequestCursor *)cursor
 {
-    // information
-    CFStringRef contentType = UTTypeCreatePreferredIdentifierForTag(kUTTagClassMIMEType, (__bridge CFStringRef)(self.playTask.mimeType), NULL);
-    loadingRequest.contentInformationRequest.contentType = CFBridgingRelease(contentType);
-    loadingRequest.contentInformationRequest.byteRangeAccessSupported = YES;
-    loadingRequest.contentInformationRequest.contentLength = self.playTask.fileLength;
-    
-    // data range
-    long long requestedOffset = 0;
-    long long requestedLength = 0;
-    if (loadingRequest.dataRequest.currentOffset != 0) {
-        requestedOffset = loadingRequest.dataRequest.currentOffset;
-        requestedLength = loadingRequest.dataRequest.requestedLength + loadingRequest.dataRequest.requestedOffset - loadingRequest.dataRequest.currentOffset;
+    if ([self deliverDataWithCursor:cursor]) {
+        [self.requestIndex updateCursor:cursor];
     } else {
-        requestedOffset = loadingRequest.dataRequest.requestedOffset;
-        requestedLength = loadingRequest.dataRequest.requestedLength;
+        // finished or cancelled
+        [self.requestIndex removeCursor:cursor];
+    }
+}
+
+// schedule one more pass for the bytes which are available but over the pass budget
+- (void)setNeedsProcessRequestList
+{
+    if (self.needsProcessRequestList) {
+        return;
+    }
+    self.needsProcessRequestList = YES;
+    
+    dispatch_async(self.taskQueue, ^{
+        if (self.needsProcessRequestList) {
+            [self processRequestList];
+        }
+    });
+}
+
+- (void)fillContentInformationWithCursor:(LXYVideoLoadingRequestCursor *)cursor
+{
+    AVAssetResourceLoadingContentInformationRequest *contentInformationRequest = cursor.loadingRequest.contentInformationRequest;
+    if (cursor.contentInformationFilled || !contentInformationRequest || self.playTask.fileLength == 0) {
+        return;
     }
+    
+    CFStringRef contentType = UTTypeCreatePreferredIdentifierForTag(kUTTagClassMIMEType, (__bridge CFStringRef)(self.playTask.mimeType), NULL);
+    contentInformationRequest.contentType = CFBridgingRelease(contentType);
+    contentInformationRequest.byteRangeAccessSupported = YES;
+    contentInformationRequest.contentLength = self.playTask.fileLength;
+    cursor.contentInformationFilled = YES;
+}
 
-    // read cache，fill data
-    BOOL haveValidData = requestedOffset + MIN(10240, requestedLength) <= self.playTask.cacheLength;
-    if (haveValidData) {
+/*
+ * answer the content information from meta, then respond the bytes from @cursor.offset which have been cached since the last delivery,
+ * in chunks of kLXYLoaderChunkSize, at most kLXYLoaderPassBudget in one pass.
+ * return NO if the loading request is done with.
+ */
+- (BOOL)deliverDataWithCursor:(LXYVideoLoadingRequestCursor *)cursor
+{
+    AVAssetResourceLoadingRequest *loadingRequest = cursor.loadingRequest;
+    if (loadingRequest.isFinished || loadingRequest.isCancelled) {
+        return NO;
+    }
+    
+    [self fillContentInformationWithCursor:cursor];
+    
+    if (!loadingRequest.dataRequest) {
+        if (cursor.contentInformationFilled) {
+            [loadingRequest finishLoading];
+            return NO;
+        }
+        return YES;
+    }
+    
+    // requestsAllDataToEndOfResource may ask beyond the file
+    long long endOffset = cursor.endOffset;
+    if (self.playTask.fileLength > 0) {
+        endOffset = MIN(endOffset, (long long)self.playTask.fileLength);
+    }
+    
+    NSUInteger deliveredLength = 0;
+    while (cursor.offset < endOffset) {
+        // never read past the cached bytes: the file may have holes
+        long long remainingLength = endOffset - cursor.offset;
+        long long availableLength = MIN([self availableLengthFromOffset:(NSUInteger)cursor.offset], remainingLength);
+        if (availableLength <= 0 || availableLength < MIN(kLXYLoaderMinChunkSize, remainingLength)) {
+            return YES;
+        }
+        
+        if (deliveredLength >= kLXYLoaderPassBudget) {
+            [self setNeedsProcessRequestList];
+            return YES;
+        }
+        
         NSError *error = nil;
-        NSData *subdata = [self.playTask subdataWithRange:NSMakeRange((NSUInteger)requestedOffset, (NSUInteger)requestedLength) error:&error];
+        NSUInteger readLength = (NSUInteger)MIN(availableLength, kLXYLoaderChunkSize);
+        NSData *subdata = [self subdataWithRange:NSMakeRange((NSUInteger)cursor.offset, readLength) error:&error];
         if (!subdata || subdata.length == 0 || error) {
             if (LXY_Reporter) {
 //                LXY_Reporter(LXYReporterLabel_ReadFileFail, self.requestURL.absoluteString, [NSString stringWithFormat:@"%@", error]);
             }
+            return YES;
+        }
+        
+        [loadingRequest.dataRequest respondWithData:subdata];
+        cursor.offset += subdata.length;
+        cursor.lastDeliveryTime = [[NSDate date] timeIntervalSince1970];
+        deliveredLength += subdata.length;
+    }
+    
+//    LXY_VIDEO_INFO(@"%@ loadingRequest finished: self = %p, %@",
+//                   self.requestURLKey,
+//                   self,
+//                   [self dataRequestDescription:loadingRequest.dataRequest]);
+    [loadingRequest finishLoading];
+    
+    if (self.timeline) {
+        double elapsed = [self.timeline markEvent:LXYVideoMetricsEventFirstLoadingRequestFinished];
+        if (elapsed >= 0) {
+            [[LXYVideoPlaybackMetrics sharedInstance].timeToFirstLoadingRequestFinishedHistogram recordValue:(uint64_t)elapsed];
+        }
+    }
+    
+    return NO;
+}
+
+#pragma mark - Range Download
+
+// the linear play task, the range task if any, and the range tasks retired with writes on the fly
+- (NSArray<LXYVideoCachePlayTask *> *)downloadTasks
+{
+    NSMutableArray<LXYVideoCachePlayTask *> *tasks = [NSMutableArray arrayWithObject:self.playTask];
+    if (self.rangeTask) {
+        [tasks addObject:self.rangeTask];
+    }
+    [tasks addObjectsFromArray:self.retiredTasks];
+    
+    return tasks;
+}
+
+- (NSIndexSet *)readableRanges
+{
+    NSMutableIndexSet *readableRanges = [NSMutableIndexSet indexSet];
+    for (LXYVideoCachePlayTask *task in [self downloadTasks]) {
+        [readableRanges addIndexes:[task readableRanges]];
+    }
+    
+    return readableRanges;
+}
+
+- (NSIndexSet *)persistedRanges
+{
+    NSMutableIndexSet *persistedRanges = [NSMutableIndexSet indexSet];
+    for (LXYVideoCachePlayTask *task in [self downloadTasks]) {
+        [persistedRanges addIndexes:[task persistedRanges]];
+    }
+    
+    return persistedRanges;
+}
+
+- (NSUInteger)availableLengthFromOffset:(NSUInteger)offset
+{
+    __block NSUInteger length = 0;
+    [[self readableRanges] enumerateRangesUsingBlock:^(NSRange range, BOOL * _Nonnull stop) {
+        if (NSLocationInRange(offset, range)) {
+            length = NSMaxRange(range) - offset;
+            *stop = YES;
+        } else if (range.location > offset) {
+            *stop = YES;
+        }
+    }];
+    
+    return length;
+}
+
+// read from the task holding the most bytes at @range.location. the result may be shorter than @range
+- (NSData *)subdataWithRange:(NSRange)range error:(NSError * __autoreleasing *)error
+{
+    LXYVideoCachePlayTask *readTask = self.playTask;
+    NSUInteger readableLength = 0;
+    for (LXYVideoCachePlayTask *task in [self downloadTasks]) {
+        NSUInteger length = [task availableLengthFromOffset:range.location];
+        if (length > readableLength) {
+            readTask = task;
+            readableLength = length;
+        }
+    }
+    
+    range.length = MIN(range.length, readableLength);
+    if (range.length == 0) {
+        return nil;
+    }
+    
+    return [readTask subdataWithRange:range error:error];
+}
+
+/*
+ * a loading request which no running download will reach soon, e.g. after a seek,
+ * gets a range download from the first missing byte it needs. the linear download is cancelled then,
+ * unless the seek is a short forward one: the holes are filled later, starting from the playhead.
+ */
+- (void)startRangeDownloadIfNeededForCursor:(LXYVideoLoadingRequestCursor *)cursor
+{
+    NSUInteger fileLength = self.playTask.fileLength;
+    if (self.error || fileLength == 0 || !cursor.loadingRequest.dataRequest) {
+        return;
+    }
+    
+    NSUInteger offset = (NSUInteger)cursor.offset;
+    offset += [self availableLengthFromOffset:offset];
+    if (offset >= MIN(cursor.endOffset, (long long)fileLength)) {
+        return;
+    }
+    
+    for (LXYVideoCachePlayTask *task in [self downloadTasks]) {
+        NSRange pendingRange = [task pendingRange];
+        if (   pendingRange.length > 0
+            && offset >= pendingRange.location
+            && offset < MIN(NSMaxRange(pendingRange), pendingRange.location + kLXYLoaderSeekDistance)) {
             return;
         }
-        //
+    }
+    
+    LXY_VIDEO_BINARY_INFO(LXYVideoLogEventSeekRangeDownload,
+                          LXY_VIDEO_BINARY_PTR(self), offset, self.playTask.cacheLength);
+    
+    if (![self shouldKeepPlayTaskForSeekOffset:offset]) {
+        [self.playTask cancelNetworkRequest];
+    }
+    [self startRangeDownloadFromOffset:offset persistedRanges:[self persistedRanges]];
+}
+
+// the linear download would reach @offset within the read-ahead window, or the seek distance if there is none
+- (BOOL)shouldKeepPlayTaskForSeekOffset:(NSUInteger)offset
+{
+    NSRange pendingRange = [self.playTask pendingRange];
+    if (pendingRange.length == 0 || offset < pendingRange.location) {
+        return NO;
+    }
+    
+    return offset - pendingRange.location < MAX(kLXYLoaderSeekDistance, [self readAheadWindow].length);
+}
+
+// a linear download kept on a seek stops where the range download has been: the range downloads fill the holes from there
+- (void)handOverPlayTaskIfNeeded
+{
+    NSRange pendingRange = [self.playTask pendingRange];
+    if (pendingRange.length > 0 && [[self.rangeTask readableRanges] containsIndex:pendingRange.location]) {
+        [self.playTask cancelNetworkRequest];
+    }
+}
+
+// download the first hole from the playhead, or from the beginning if there is none behind it
+- (void)startRangeDownloadForNextHole
+{
+    NSIndexSet *persistedRanges = [self persistedRanges];
+    NSUInteger fileLength = self.playTask.fileLength;
+    
+    NSUInteger offset = [self firstMissingOffsetFrom:(NSUInteger)MAX(self.playheadOffset, 0) inRanges:persistedRanges];
+    if (offset >= fileLength) {
+        offset = [self firstMissingOffsetFrom:0 inRanges:persistedRanges];
+    }
+    if (offset >= fileLength) {
+        return;
+    }
+    
+    [self startRangeDownloadFromOffset:offset persistedRanges:persistedRanges];
+}
+
+- (void)startRangeDownloadFromOffset:(NSUInteger)offset persistedRanges:(NSIndexSet *)persistedRanges
+{
+    if (self.stopped) {
+        return;
+    }
+    
+    // up to the next persisted byte
+    NSUInteger fileLength = self.playTask.fileLength;
+    NSUInteger nextPersistedOffset = [persistedRanges indexGreaterThanIndex:offset];
+    NSUInteger endOffset = nextPersistedOffset == NSNotFound ? fileLength : MIN(nextPersistedOffset, fileLength);
+    if (offset >= endOffset) {
+        return;
+    }
+    
+    LXYVideoCachePlayTask *rangeTask = [LXYVideoCachePlayTask rangeTaskWithPlayTask:self.playTask cachedRanges:persistedRanges];
+    rangeTask.delegate = self;
+    NSRange range = NSMakeRange(offset, endOffset - offset);
+    if ([rangeTask startWithAbsoluteRange:range]) {
+        [self retireRangeTask];
+        self.rangeTask = rangeTask;
+        self.rangeTaskRange = range;
+    }
+}
+
+// cancel the range task. its writes on the fly stay readable until the play task takes their ranges over
+- (void)retireRangeTask
+{
+    LXYVideoCachePlayTask *rangeTask = self.rangeTask;
+    if (!rangeTask) {
+        return;
+    }
+    self.rangeTask = nil;
+    self.rangeTaskRange = NSMakeRange(0, 0);
+    
+    [rangeTask cancelNetworkRequest];
+    [self.retiredTasks addObject:rangeTask];
+    [self.playTask adoptPersistedRangesOfTask:rangeTask completion:^{
+        [self.retiredTasks removeObjectIdenticalTo:rangeTask];
+    }];
+}
+
+// fail the loading requests waiting inside the failed range. the others are served by the rest of the downloads
+- (void)failRangeTaskWithError:(NSError *)error
+{
+    NSRange range = self.rangeTaskRange;
+    [self retireRangeTask];
+    
+    LXY_VIDEO_WARN(@"%@ range download failed: range = (%@, %@), error = %@",
+                   self.requestURLKey, @(range.location), @(range.length), error);
+    
+    for (LXYVideoLoadingRequestCursor *cursor in [self.requestIndex allCursors]) {
+        if (!NSLocationInRange((NSUInteger)cursor.offset, range)) {
+            continue;
+        }
+        
+        AVAssetResourceLoadingRequest *loadingRequest = cursor.loadingRequest;
         if (!self.stopped && !loadingRequest.isFinished && !loadingRequest.isCancelled) {
-            [loadingRequest.dataRequest respondWithData:subdata];
+            [loadingRequest finishLoadingWithError:error];
+        }
+        [self.requestIndex removeCursor:cursor];
+    }
+}
+
+- (NSUInteger)firstMissingOffsetFrom:(NSUInteger)offset inRanges:(NSIndexSet *)ranges
+{
+    __block NSUInteger missingOffset = offset;
+    [ranges enumerateRangesUsingBlock:^(NSRange range, BOOL * _Nonnull stop) {
+        if (NSLocationInRange(missingOffset, range)) {
+            missingOffset = NSMaxRange(range);
+        } else if (range.location > missingOffset) {
+            *stop = YES;
+        }
+    }];
+    
+    return missingOffset;
+}
+
+#pragma mark - Read Ahead
+
+/*
+ * keep the downloads no further than the read-ahead window past the playback position:
+ * a download is suspended at the window end, and resumed when playback has used up part of the window,
+ * or at once if a loading request is waiting for bytes nobody has.
+ */
+- (void)updateReadAhead
+{
+    NSArray<LXYVideoCachePlayTask *> *tasks = [self downloadTasks];
+    
+    NSRange window = [self readAheadWindow];
+    if (self.stopped || window.length == 0) {
+        for (LXYVideoCachePlayTask *task in tasks) {
+            [task resumeNetworkRequest];
+        }
+        return;
+    }
+    
+    BOOL starving = NO;
+    for (LXYVideoLoadingRequestCursor *cursor in [self.requestIndex allCursors]) {
+        if (   cursor.loadingRequest.dataRequest
+            && cursor.offset < (long long)self.playTask.fileLength
+            && [self availableLengthFromOffset:(NSUInteger)cursor.offset] == 0) {
+            starving = YES;
+            break;
+        }
+    }
+    
+    NSUInteger resumeOffset = window.location + (NSUInteger)(window.length * kLXYLoaderReadAheadResumeRatio);
+    NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+    for (LXYVideoCachePlayTask *task in tasks) {
+        NSRange pendingRange = [task pendingRange];
+        if (pendingRange.length == 0) {
+            continue;
         }
         
-        long long requestOffsetNext = requestedOffset + subdata.length;
-        long long requestOffsetEnd = loadingRequest.dataRequest.requestedOffset + loadingRequest.dataRequest.requestedLength;
-        if (requestOffsetNext >= requestOffsetEnd) {
-//            LXY_VIDEO_INFO(@"%@ loadingRequest finished: self = %p, %@",
-//                           self.requestURLKey,
-//                           self,
-//                           [self dataRequestDescription:loadingRequest.dataRequest]);
-            //
-            if (!self.stopped && !loadingRequest.isFinished && !loadingRequest.isCancelled) {
-                [loadingRequest finishLoading];
+        if (task.suspended) {
+            if (starving || pendingRange.location < resumeOffset) {
+                LXY_VIDEO_BINARY_DEBUG(LXYVideoLogEventReadAheadResume,
+                                       LXY_VIDEO_BINARY_PTR(self), pendingRange.location, NSMaxRange(window));
+                if (now - task.suspendTime > kLXYLoaderMaxSuspendInterval) {
+                    // a range download from where it stopped, on a new connection
+                    if (task == self.playTask) {
+                        [task cancelNetworkRequest];
+                    } else {
+                        [self retireRangeTask];
+                    }
+                    [self startRangeDownloadFromOffset:pendingRange.location persistedRanges:[self persistedRanges]];
+                } else {
+                    [task resumeNetworkRequest];
+                }
             }
+        } else if (!starving && pendingRange.location >= NSMaxRange(window)) {
+            LXY_VIDEO_BINARY_DEBUG(LXYVideoLogEventReadAheadSuspend,
+                                   LXY_VIDEO_BINARY_PTR(self), pendingRange.location, NSMaxRange(window));
+            [task suspendNetworkRequest];
+        }
+    }
+}
+
+// the bytes from the playback position to the end of the read-ahead window. length 0 if there is no limit
+- (NSRange)readAheadWindow
+{
+    NSUInteger fileLength = self.playTask.fileLength;
+    if (fileLength == 0 || (self.readAheadDuration <= 0 && self.readAheadLength == 0)) {
+        return NSMakeRange(0, 0);
+    }
+    
+    [self loadTimeIndexIfNeeded];
+    
+    // the playback position in bytes: from the time index, or in proportion to the duration
+    NSUInteger playbackOffset = 0;
+    NSUInteger endOffset = 0;
+    if (self.timeIndex) {
+        NSTimeInterval duration = MAX(self.readAheadDuration, self.timeIndex.interval);
+        NSRange byteRange = [self.timeIndex byteRangeFromTime:self.playbackTime duration:duration];
+        if (byteRange.length == 0) {
+            return NSMakeRange(0, 0);
+        }
+        playbackOffset = byteRange.location;
+        if (self.readAheadDuration > 0) {
+            endOffset = NSMaxRange(byteRange);
+        }
+    } else {
+        if (self.playbackDuration <= 0) {
+            return NSMakeRange(0, 0);
+        }
+        double bytesPerSecond = fileLength / self.playbackDuration;
+        playbackOffset = (NSUInteger)(MIN(self.playbackTime, self.playbackDuration) * bytesPerSecond);
+        if (self.readAheadDuration > 0) {
+            endOffset = playbackOffset + (NSUInteger)(self.readAheadDuration * bytesPerSecond);
+        }
+    }
+    
+    if (self.readAheadLength > 0) {
+        endOffset = MAX(endOffset, playbackOffset + self.readAheadLength);
+    }
+    endOffset = MIN(endOffset, fileLength);
+    if (endOffset <= playbackOffset) {
+        return NSMakeRange(0, 0);
+    }
+    
+    return NSMakeRange(playbackOffset, endOffset - playbackOffset);
+}
+
+- (void)loadTimeIndexIfNeeded
+{
+    NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+    if (self.timeIndex || now - self.timeIndexLookupTime < kLXYLoaderTimeIndexRetryInterval) {
+        return;
+    }
+    self.timeIndexLookupTime = now;
+    
+    [LXYVideoDiskCache timeIndexForKey:self.requestURLKey completion:^(LXYVideoTimeIndex * _Nullable timeIndex, NSIndexSet * _Nullable cachedRanges) {
+        if (!timeIndex) {
+            return;
         }
+        dispatch_async(self.taskQueue, ^{
+            self.timeIndex = timeIndex;
+        });
+    }];
+}
+
+#pragma mark - Stall Watchdog
+
+- (void)startWatchdog
+{
+    self.watchdogTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.taskQueue);
+    dispatch_source_set_timer(self.watchdogTimer,
+                              dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kLXYLoaderWatchdogInterval * NSEC_PER_SEC)),
+                              (uint64_t)(kLXYLoaderWatchdogInterval * NSEC_PER_SEC),
+                              (uint64_t)(0.1 * NSEC_PER_SEC));
+    
+    __weak typeof(self) weakSelf = self;
+    dispatch_source_set_event_handler(self.watchdogTimer, ^{
+        [weakSelf checkStall];
+    });
+    dispatch_resume(self.watchdogTimer);
+}
+
+- (void)stopWatchdog
+{
+    if (self.watchdogTimer) {
+        dispatch_source_cancel(self.watchdogTimer);
+        self.watchdogTimer = nil;
+    }
+    
+    if (self.prefetchPaused) {
+        self.prefetchPaused = NO;
+        [LXYVideoPrefetchTaskManager resumeFromPlayStall];
+    }
+}
+
+/*
+ * escalate step by step while the loading requests wait for bytes nobody has:
+ * raise the play download over prefetches, pause prefetches, then request the missing range again on a fresh connection.
+ */
+- (void)checkStall
+{
+    if (self.stopped || self.error) {
+        return;
+    }
+    
+    double throughput = (self.receivedLength - self.watchdogReceivedLength) / kLXYLoaderWatchdogInterval;
+    self.watchdogReceivedLength = self.receivedLength;
+    
+    // the starved loading request which has waited the longest
+    NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+    NSUInteger fileLength = self.playTask.fileLength;
+    LXYVideoLoadingRequestCursor *starvedCursor = nil;
+    for (LXYVideoLoadingRequestCursor *cursor in [self.requestIndex allCursors]) {
+        if (   cursor.loadingRequest.dataRequest
+            && (fileLength == 0 || cursor.offset < (long long)fileLength)
+            && [self availableLengthFromOffset:(NSUInteger)cursor.offset] == 0
+            && (!starvedCursor || cursor.lastDeliveryTime < starvedCursor.lastDeliveryTime)) {
+            starvedCursor = cursor;
+        }
+    }
+    NSTimeInterval waitTime = starvedCursor ? MAX(now - starvedCursor.lastDeliveryTime, 0.001) : 0;
+    
+    LXYVideoStallEscalation escalation = [self.watchdog escalationForWaitTime:waitTime throughput:throughput];
+    if (!starvedCursor && self.prefetchPaused) {
+        self.prefetchPaused = NO;
+        [LXYVideoPrefetchTaskManager resumeFromPlayStall];
+    }
+    if (escalation == LXYVideoStallEscalationNone) {
+        return;
+    }
+    
+    LXY_VIDEO_INFO(@"%@ loading stall: escalation = %@, waitTime = %.2f, throughput = %.0f, offset = %@",
+                   self.requestURLKey, @(escalation), waitTime, throughput, @(starvedCursor.offset));
+    
+    switch (escalation) {
+        case LXYVideoStallEscalationRaisePriority: {
+            float priority = 0.75;
+            if (@available(iOS 8.0, *)) {
+                priority = NSURLSessionTaskPriorityHigh;
+            }
+            for (LXYVideoCachePlayTask *task in [self downloadTasks]) {
+                [task setNetworkPriority:priority];
+            }
+            break;
+        }
+            
+        case LXYVideoStallEscalationPausePrefetch: {
+            if (!self.prefetchPaused) {
+                self.prefetchPaused = YES;
+                [LXYVideoPrefetchTaskManager pauseForPlayStall];
+            }
+            break;
+        }
+            
+        case LXYVideoStallEscalationReissue: {
+            // the same range of the same URL: a new session makes a new connection
+            [self.playTask cancelNetworkRequest];
+            if (fileLength > 0) {
+                [self startRangeDownloadFromOffset:(NSUInteger)starvedCursor.offset persistedRanges:[self persistedRanges]];
+            } else {
+                // no response yet: start over, meta lookup included. the old task may still be waiting on its lookup
+                self.playTask.delegate = nil;
+                self.playTask = [LXYVideoCachePlayTask taskWithURL:self.requestURL queue:self.taskQueue internalDelegate:self.internalDelegate];
+                self.playTask.delegate = self;
+            }
+            break;
+        }
+            
+        default:
+            break;
+    }
+    
+    if (self.internalDelegate && [self.internalDelegate respondsToSelector:@selector(loadingStallForURL:escalation:waitTime:throughput:)]) {
+        NSURL *URL = self.requestURL;
+        dispatch_async_on_main_queue(^{
+            [self.internalDelegate loadingStallForURL:URL escalation:escalation waitTime:waitTime throughput:throughput];
+        });
     }
 }
 
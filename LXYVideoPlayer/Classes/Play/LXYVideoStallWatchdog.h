@@ -0,0 +1,49 @@
+
+#import <Foundation/Foundation.h>
+#import "LXYVideoPlayerEnumDefines.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * escalation policy for loading requests starved of data.
+ * fed periodically with how long the oldest starved loading request has waited, and the recent throughput,
+ * it answers the next step to take, one step at a time:
+ *
+ *      wait >= @raisePriorityWaitTime                  -> RaisePriority
+ *      wait >= @pausePrefetchWaitTime                  -> PausePrefetch
+ *      wait >= @reissueWaitTime * n, throughput low    -> Reissue, at most @maxReissueCount times
+ *
+ * a wait of 0 means the requests are fed again, and the escalation starts over.
+ * NOT thread safe.
+ */
+@interface LXYVideoStallWatchdog : NSObject
+
+/// second. 1 by default
+@property (nonatomic, assign) NSTimeInterval raisePriorityWaitTime;
+
+/// second. 2.5 by default
+@property (nonatomic, assign) NSTimeInterval pausePrefetchWaitTime;
+
+/// second. 5 by default
+@property (nonatomic, assign) NSTimeInterval reissueWaitTime;
+
+/// a request is reissued only below this throughput. Byte/s. 32KB/s by default
+@property (nonatomic, assign) double reissueMaxThroughput;
+
+/// 3 by default
+@property (nonatomic, assign) NSUInteger maxReissueCount;
+
+/// the highest step taken since the requests were fed last time
+@property (nonatomic, assign, readonly) LXYVideoStallEscalation escalation;
+
+/**
+ * @brief the next step to take. LXYVideoStallEscalationNone if nothing is to be done
+ *
+ * @param waitTime      how long the oldest starved loading request has waited. 0 if there is none. second
+ * @param throughput    recent download throughput. Byte/s
+ */
+- (LXYVideoStallEscalation)escalationForWaitTime:(NSTimeInterval)waitTime throughput:(double)throughput;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,68 @@
+
+#import "LXYVideoStallWatchdog.h"
+
+@interface LXYVideoStallWatchdog ()
+
+@property (nonatomic, assign) LXYVideoStallEscalation escalation;
+
+// reissues since the requests were fed last time
+@property (nonatomic, assign) NSUInteger reissueCount;
+
+@end
+
+@implementation LXYVideoStallWatchdog
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _raisePriorityWaitTime = 1.0;
+        _pausePrefetchWaitTime = 2.5;
+        _reissueWaitTime = 5.0;
+        _reissueMaxThroughput = 32 * 1024;
+        _maxReissueCount = 3;
+        _escalation = LXYVideoStallEscalationNone;
+    }
+    
+    return self;
+}
+
+#pragma mark - Public
+
+- (LXYVideoStallEscalation)escalationForWaitTime:(NSTimeInterval)waitTime throughput:(double)throughput
+{
+    if (waitTime <= 0) {
+        self.escalation = LXYVideoStallEscalationNone;
+        self.reissueCount = 0;
+        return LXYVideoStallEscalationNone;
+    }
+    
+    if (self.escalation < LXYVideoStallEscalationRaisePriority) {
+        if (waitTime >= self.raisePriorityWaitTime) {
+            self.escalation = LXYVideoStallEscalationRaisePriority;
+            return LXYVideoStallEscalationRaisePriority;
+        }
+        return LXYVideoStallEscalationNone;
+    }
+    
+    if (self.escalation < LXYVideoStallEscalationPausePrefetch) {
+        if (waitTime >= self.pausePrefetchWaitTime) {
+            self.escalation = LXYVideoStallEscalationPausePrefetch;
+            return LXYVideoStallEscalationPausePrefetch;
+        }
+        return LXYVideoStallEscalationNone;
+    }
+    
+    // data flowing elsewhere will reach the request by itself
+    if (   self.reissueCount < self.maxReissueCount
+        && waitTime >= self.reissueWaitTime * (self.reissueCount + 1)
+        && throughput < self.reissueMaxThroughput) {
+        self.escalation = LXYVideoStallEscalationReissue;
+        ++self.reissueCount;
+        return LXYVideoStallEscalationReissue;
+    }
+    
+    return LXYVideoStallEscalationNone;
+}
+
+@end
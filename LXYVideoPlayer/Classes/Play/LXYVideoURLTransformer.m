@@ -1,5 +1,6 @@
 
 #import "LXYVideoURLTransformer.h"
+#import "LXYVideoLockProfiler.h"
 
 @interface LXYVideoURLTransformer ()
 
@@ -51,8 +52,14 @@
         return nil;
     }
     
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
+    
     @synchronized(self)
     {
+    
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoURLTransformer", waitStart);
+    
+        
         NSURLComponents *components = [[NSURLComponents alloc] initWithURL:originURL resolvingAgainstBaseURL:NO];
         components.scheme = customScheme;
         NSURL *customURL = [components URL];
@@ -64,8 +71,11 @@
 
 - (NSURL *)_originURLForCustomURL:(NSURL *)customURL
 {
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
     @synchronized(self)
     {
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoURLTransformer", waitStart);
+        
         NSURL *originURL = nil;
         
         if ([self.urlMap objectForKey:customURL]) {
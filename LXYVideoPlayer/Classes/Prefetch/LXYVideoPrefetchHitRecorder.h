@@ -1,5 +1,6 @@
 
 #import <Foundation/Foundation.h>
+#import "LXYVideoHistogram.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -28,22 +29,63 @@ NS_ASSUME_NONNULL_BEGIN
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * aggregated prefetch statistics
+ */
+@interface LXYVideoPrefetchHitStatistics : NSObject
+
+/// number of prefetched videos which are played
+@property (nonatomic, assign, readonly) uint64_t hitCount;
+
+/// number of prefetched videos which expired before being played
+@property (nonatomic, assign, readonly) uint64_t missCount;
+
+/// prefetched bytes of each prefetched video, hit or miss. Byte
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *prefetchedBytes;
+
+/// prefetched bytes of each played video. Byte
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *consumedBytes;
+
+/// prefetched bytes of each expired video. Byte
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *wastedBytes;
+
+/// time from the prefetch start to the play start. ms
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *prefetchToPlayTime;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /**
  * the prefetch hit rate monitoring
  */
 @interface LXYVideoPrefetchHitRecorder : NSObject
 
-/// LXYVideoPrefetchHitDelegate
+/// LXYVideoPrefetchHitDelegate. hits are reported on the play task queue, misses on a private queue.
 @property (nonatomic, weak) id<LXYVideoPrefetchHitDelegate> delegate;
 
-/// the max life time for prefetched video
-@property (nonatomic, assign) NSUInteger lifeTimeMax;
+/// the max life time for prefetched video, counted by plays. ignored with a warning, see lifeTimeInterval
+@property (nonatomic, assign) NSUInteger lifeTimeMax __deprecated_msg("Prefetched videos are expired by time now. Use lifeTimeInterval instead.");
+
+/// the max life time for prefetched video. A prefetched video is a miss if it is not played during this time. second. default to 5 min
+@property (nonatomic, assign) NSTimeInterval lifeTimeInterval;
 
 /**
  * @brief singleton
  */
 + (instancetype)sharedInstance;
 
+/**
+ * @brief get the aggregated statistics since launch or the last reset.
+ *        It can be called on any thread, and never blocks the download path.
+ */
+- (LXYVideoPrefetchHitStatistics *)statistics;
+
+/**
+ * @brief reset the aggregated statistics
+ */
+- (void)resetStatistics;
+
 @end
 
 NS_ASSUME_NONNULL_END
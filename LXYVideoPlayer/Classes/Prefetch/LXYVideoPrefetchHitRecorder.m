@@ -3,13 +3,20 @@
 #import "LXYVideoObjectPool.h"
 #import "LXYVideoPlayerDefines.h"
 #import "LXYVideoLogger.h"
+#import "LXYVideoTimerWheel.h"
+#import "LXYVideoLockProfiler.h"
+
+#import <pthread.h>
+
+#define LXY_HIT_RECORDER_SHARD_COUNT        16
+#define LXY_HIT_RECORDER_WHEEL_SLOT_COUNT   64
 
 @interface LXYVideoPrefetchHitStatus : NSObject
 
 // cache size
 @property (nonatomic, assign) NSUInteger size;
-// cache life time
-@property (nonatomic, assign) NSUInteger lifeTime;
+// prefetch start time
+@property (nonatomic, assign) NSTimeInterval startTime;
 
 @end
 
@@ -20,9 +27,9 @@
     self = [super init];
     if (self) {
         self.size = 0;
-        self.lifeTime = 0;
+        self.startTime = 0;
     }
-    
+
     return self;
 }
 
@@ -30,14 +37,51 @@
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+@interface LXYVideoPrefetchHitStatistics ()
+
+@property (nonatomic, assign, readwrite) uint64_t hitCount;
+@property (nonatomic, assign, readwrite) uint64_t missCount;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *prefetchedBytes;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *consumedBytes;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *wastedBytes;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *prefetchToPlayTime;
+
+@end
+
+@implementation LXYVideoPrefetchHitStatistics
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"hit = %@, miss = %@, prefetched = { %@ }, consumed = { %@ }, wasted = { %@ }, prefetchToPlay = { %@ }",
+            @(self.hitCount), @(self.missCount),
+            self.prefetchedBytes, self.consumedBytes, self.wastedBytes, self.prefetchToPlayTime];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 @interface LXYVideoPrefetchHitRecorder ()
+{
+    // one lock for each status shard
+    pthread_mutex_t _shardLocks[LXY_HIT_RECORDER_SHARD_COUNT];
+}
 
-// statuc dict
-@property (nonatomic, strong) NSMutableDictionary<NSString *, LXYVideoPrefetchHitStatus *> *statusDict;
+// status shards. <key, status> each
+@property (nonatomic, strong) NSArray<NSMutableDictionary<NSString *, LXYVideoPrefetchHitStatus *> *> *statusShards;
 
 // status pool
 @property (nonatomic, strong) LXYVideoObjectPool<LXYVideoPrefetchHitStatus *> *statusPool;
 
+// expire prefetched keys by time
+@property (nonatomic, strong) LXYVideoTimerWheel *expireWheel;
+
+// statistics
+@property (nonatomic, strong) LXYVideoHistogram *prefetchedBytesHistogram;
+@property (nonatomic, strong) LXYVideoHistogram *consumedBytesHistogram;
+@property (nonatomic, strong) LXYVideoHistogram *wastedBytesHistogram;
+@property (nonatomic, strong) LXYVideoHistogram *prefetchToPlayTimeHistogram;
+
 - (void)startPrefetchWithKey:(NSString *)key;
 
 - (void)prefetchingWithKey:(NSString *)key size:(NSUInteger)size;
@@ -52,15 +96,47 @@
 {
     self = [super init];
     if (self) {
-        self.lifeTimeMax = 5;
+        self.lifeTimeInterval = 5 * 60;
         //
-        self.statusDict = [NSMutableDictionary dictionary];
+        NSMutableArray *statusShards = [NSMutableArray arrayWithCapacity:LXY_HIT_RECORDER_SHARD_COUNT];
+        for (NSUInteger i = 0; i < LXY_HIT_RECORDER_SHARD_COUNT; ++i) {
+            pthread_mutex_init(&_shardLocks[i], NULL);
+            [statusShards addObject:[NSMutableDictionary dictionary]];
+        }
+        self.statusShards = [statusShards copy];
         self.statusPool = [[LXYVideoObjectPool alloc] initWithClass:[LXYVideoPrefetchHitStatus class] maxCount:100];
+        //
+        self.prefetchedBytesHistogram = [LXYVideoHistogram new];
+        self.consumedBytesHistogram = [LXYVideoHistogram new];
+        self.wastedBytesHistogram = [LXYVideoHistogram new];
+        self.prefetchToPlayTimeHistogram = [LXYVideoHistogram new];
+        //
+        __weak typeof(self) weakSelf = self;
+        self.expireWheel = [[LXYVideoTimerWheel alloc] initWithTickInterval:1
+                                                                  slotCount:LXY_HIT_RECORDER_WHEEL_SLOT_COUNT
+                                                                expireBlock:^(NSArray *keys) {
+            [weakSelf _expireKeys:keys];
+        }];
     }
-    
+
     return self;
 }
 
+- (void)dealloc
+{
+    for (NSUInteger i = 0; i < LXY_HIT_RECORDER_SHARD_COUNT; ++i) {
+        pthread_mutex_destroy(&_shardLocks[i]);
+    }
+}
+
+- (void)setLifeTimeMax:(NSUInteger)lifeTimeMax
+{
+    _lifeTimeMax = lifeTimeMax;
+    // no play count maps onto a time, so the setting is kept but not applied
+    LXY_VIDEO_WARN(@"LXYVideoPrefetchHitRecorder.lifeTimeMax = %@ is ignored: prefetched videos expire after lifeTimeInterval = %@s",
+                   @(lifeTimeMax), @(self.lifeTimeInterval));
+}
+
 + (instancetype)sharedInstance
 {
     static LXYVideoPrefetchHitRecorder *instance = nil;
@@ -68,84 +144,157 @@
     dispatch_once(&onceToken, ^{
         instance = [LXYVideoPrefetchHitRecorder new];
     });
-    
+
     return instance;
 }
 
+#pragma mark - Statistics
+
+- (LXYVideoPrefetchHitStatistics *)statistics
+{
+    LXYVideoPrefetchHitStatistics *statistics = [LXYVideoPrefetchHitStatistics new];
+    statistics.consumedBytes = [self.consumedBytesHistogram snapshot];
+    statistics.wastedBytes = [self.wastedBytesHistogram snapshot];
+    statistics.prefetchedBytes = [self.prefetchedBytesHistogram snapshot];
+    statistics.prefetchToPlayTime = [self.prefetchToPlayTimeHistogram snapshot];
+    statistics.hitCount = statistics.consumedBytes.totalCount;
+    statistics.missCount = statistics.wastedBytes.totalCount;
+
+    return statistics;
+}
+
+- (void)resetStatistics
+{
+    [self.prefetchedBytesHistogram reset];
+    [self.consumedBytesHistogram reset];
+    [self.wastedBytesHistogram reset];
+    [self.prefetchToPlayTimeHistogram reset];
+}
+
 #pragma mark - Record
 
+#define SHARD_INDEX(_key_)      ((_key_).hash % LXY_HIT_RECORDER_SHARD_COUNT)
+
 - (void)startPrefetchWithKey:(NSString *)key
 {
-    if (LXYVideo_isEmptyString(key) || !self.delegate) {
+    if (LXYVideo_isEmptyString(key)) {
         return;
     }
-    
-    @synchronized(self)
+
+    NSUInteger shardIndex = SHARD_INDEX(key);
+    LXYVideoPrefetchHitStatus *newStatus = [self.statusPool getObject];
+
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
+    pthread_mutex_lock(&_shardLocks[shardIndex]);
     {
-        LXYVideoPrefetchHitStatus *status = nil;
-        
-        if ([self.statusDict objectForKey:key]) {
-            status = [self.statusDict objectForKey:key];
-        } else {
-            status = [self.statusPool getObject];
-            [self.statusDict setObject:status forKey:key];
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoPrefetchHitRecorder.shard", waitStart);
+
+        NSMutableDictionary<NSString *, LXYVideoPrefetchHitStatus *> *shard = self.statusShards[shardIndex];
+        LXYVideoPrefetchHitStatus *status = shard[key];
+        if (!status) {
+            status = newStatus;
+            newStatus = nil;
+            shard[key] = status;
         }
-        
+
         status.size = 0;
-        status.lifeTime = 0;
+        status.startTime = [[NSDate date] timeIntervalSince1970];
+    }
+    pthread_mutex_unlock(&_shardLocks[shardIndex]);
+
+    if (newStatus) {
+        [self.statusPool returnObject:newStatus];
     }
+
+    [self.expireWheel scheduleKey:key afterInterval:self.lifeTimeInterval];
 }
 
 - (void)prefetchingWithKey:(NSString *)key size:(NSUInteger)size
 {
-    if (LXYVideo_isEmptyString(key) || !self.delegate) {
+    if (LXYVideo_isEmptyString(key)) {
         return;
     }
-    
-    @synchronized(self)
+
+    NSUInteger shardIndex = SHARD_INDEX(key);
+
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
+    pthread_mutex_lock(&_shardLocks[shardIndex]);
     {
-        if ([self.statusDict objectForKey:key]) {
-            LXYVideoPrefetchHitStatus *status = [self.statusDict objectForKey:key];
-            //
-            status.size += size;
-        }
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoPrefetchHitRecorder.shard", waitStart);
+
+        self.statusShards[shardIndex][key].size += size;
     }
+    pthread_mutex_unlock(&_shardLocks[shardIndex]);
 }
 
 - (void)startPlayWithKey:(NSString *)playKey
 {
-    if (LXYVideo_isEmptyString(playKey) || !self.delegate) {
+    if (LXYVideo_isEmptyString(playKey)) {
         return;
     }
-    
-    @synchronized(self)
-    {
-        NSMutableArray<NSString *> *deleteKeyArray = [NSMutableArray array];
+
+    LXYVideoPrefetchHitStatus *status = [self _removeStatusForKey:playKey];
+    if (!status) {
+        return;
+    }
+
+    [self.expireWheel cancelKey:playKey];
+
+    NSUInteger size = status.size;
+    NSTimeInterval prefetchToPlayTime = [[NSDate date] timeIntervalSince1970] - status.startTime;
+    [self.statusPool returnObject:status];
+
+    [self.prefetchedBytesHistogram recordValue:size];
+    [self.consumedBytesHistogram recordValue:size];
+    [self.prefetchToPlayTimeHistogram recordValue:(uint64_t)MAX(prefetchToPlayTime * 1000, 0)];
+
+    [self.delegate videoPrefetch:playKey didHitWithSize:size];
+    //
+    LXY_VIDEO_INFO(@"prefetch did hit, size=%@", @(size));
+}
+
+#pragma mark - Private
+
+// executed on the expire wheel's queue
+- (void)_expireKeys:(NSArray<NSString *> *)keys
+{
+    for (NSString *key in keys) {
+        LXYVideoPrefetchHitStatus *status = [self _removeStatusForKey:key];
+        if (!status) {
+            continue;
+        }
+
+        NSUInteger size = status.size;
+        [self.statusPool returnObject:status];
+
+        [self.prefetchedBytesHistogram recordValue:size];
+        [self.wastedBytesHistogram recordValue:size];
+
+        [self.delegate videoPrefetch:key didMissWithSize:size];
         //
-        [self.statusDict enumerateKeysAndObjectsUsingBlock:^(NSString * _Nonnull key, LXYVideoPrefetchHitStatus * _Nonnull obj, BOOL * _Nonnull stop) {
-            if ([playKey isEqualToString:key]) {
-                [self.delegate videoPrefetch:key didHitWithSize:obj.size];
-                [deleteKeyArray addObject:key];
-                //
-                LXY_VIDEO_INFO(@"prefetch did hit, size=%@", @(obj.size));
-            } else {
-                if (obj.lifeTime < self.lifeTimeMax) {
-                    ++obj.lifeTime;
-                } else {
-                    [self.delegate videoPrefetch:key didMissWithSize:obj.size];
-                    [deleteKeyArray addObject:key];
-                    //
-//                    LXY_VIDEO_INFO(@"prefetch did miss, size=%@", @(obj.size));
-                }
-            }
-        }];
+//        LXY_VIDEO_INFO(@"prefetch did miss, size=%@", @(size));
+    }
+}
 
-        [deleteKeyArray enumerateObjectsUsingBlock:^(NSString * _Nonnull obj, NSUInteger idx, BOOL * _Nonnull stop) {
-            [self.statusPool returnObject:self.statusDict[obj]];
-        }];
+- (LXYVideoPrefetchHitStatus *)_removeStatusForKey:(NSString *)key
+{
+    NSUInteger shardIndex = SHARD_INDEX(key);
+    LXYVideoPrefetchHitStatus *status = nil;
 
-        [self.statusDict removeObjectsForKeys:deleteKeyArray];
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
+    pthread_mutex_lock(&_shardLocks[shardIndex]);
+    {
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoPrefetchHitRecorder.shard", waitStart);
+
+        NSMutableDictionary<NSString *, LXYVideoPrefetchHitStatus *> *shard = self.statusShards[shardIndex];
+        status = shard[key];
+        if (status) {
+            [shard removeObjectForKey:key];
+        }
     }
+    pthread_mutex_unlock(&_shardLocks[shardIndex]);
+
+    return status;
 }
 
 @end
@@ -0,0 +1,58 @@
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * a pending prefetch task, as persisted on disk
+ */
+@interface LXYVideoPrefetchQueueRecord : NSObject
+
+/// request URL string
+@property (nonatomic, copy) NSString *urlString;
+
+/// task group
+@property (nonatomic, copy) NSString *group;
+
+/// prefetch target size
+@property (nonatomic, assign) NSUInteger size;
+
+/// prefetch target play duration. 0 for size based prefetch
+@property (nonatomic, assign) NSTimeInterval duration;
+
+/// network priority
+@property (nonatomic, assign) float priority;
+
+/// the time when the task was enqueued. timeIntervalSince1970
+@property (nonatomic, assign) NSTimeInterval enqueueTime;
+
+@end
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * durable storage for the prefetch queue, in a compact binary form.
+ * NOT thread safe. should be run on the prefetch queue.
+ */
+@interface LXYVideoPrefetchQueueStore : NSObject
+
+/**
+ * @param path  the file path to store the queue
+ */
+- (instancetype)initWithPath:(NSString *)path;
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
+
+/**
+ * @brief read all records. corrupted or missing files result in an empty list.
+ */
+- (NSArray<LXYVideoPrefetchQueueRecord *> *)loadRecords;
+
+/**
+ * @brief replace the stored queue with @records
+ */
+- (BOOL)saveRecords:(NSArray<LXYVideoPrefetchQueueRecord *> *)records;
+
+@end
+
+NS_ASSUME_NONNULL_END
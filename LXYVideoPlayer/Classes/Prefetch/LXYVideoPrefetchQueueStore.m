@@ -0,0 +1,236 @@
+
+#import "LXYVideoPrefetchQueueStore.h"
+#import "LXYVideoLogger.h"
+
+@implementation LXYVideoPrefetchQueueRecord
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"url = %@, group = %@, size = %@, duration = %.1f, priority = %.2f, enqueueTime = %.0f",
+            self.urlString, self.group, @(self.size), self.duration, self.priority, self.enqueueTime];
+}
+
+@end
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * file layout, little endian:
+ *
+ *  header:  magic(u32) version(u16) count(u32)
+ *  record:  size(u64) doneBytes(u64) enqueueTime(f64) priority(f32) urlLength(u16) url groupLength(u16) group
+ *           duration(f64)                  -- version 2
+ *
+ *  version 3 drops doneBytes: a restored task resumes from whatever the disk cache holds.
+ */
+static const uint32_t kLXYPrefetchQueueMagic = 0x5159584C;     // "LXYQ"
+static const uint16_t kLXYPrefetchQueueVersion = 3;
+
+static void p_appendUInt16(NSMutableData *data, uint16_t value)
+{
+    value = CFSwapInt16HostToLittle(value);
+    [data appendBytes:&value length:sizeof(value)];
+}
+
+static void p_appendUInt32(NSMutableData *data, uint32_t value)
+{
+    value = CFSwapInt32HostToLittle(value);
+    [data appendBytes:&value length:sizeof(value)];
+}
+
+static void p_appendUInt64(NSMutableData *data, uint64_t value)
+{
+    value = CFSwapInt64HostToLittle(value);
+    [data appendBytes:&value length:sizeof(value)];
+}
+
+static void p_appendString(NSMutableData *data, NSString *string)
+{
+    NSData *stringData = [string dataUsingEncoding:NSUTF8StringEncoding] ? : [NSData data];
+    uint16_t length = (uint16_t)MIN(stringData.length, UINT16_MAX);
+    p_appendUInt16(data, length);
+    [data appendBytes:stringData.bytes length:length];
+}
+
+// bounds-checked reader. all reads fail once the data is exhausted
+typedef struct {
+    const uint8_t *bytes;
+    NSUInteger length;
+    NSUInteger offset;
+    BOOL failed;
+} LXYPrefetchQueueReader;
+
+static const void *p_read(LXYPrefetchQueueReader *reader, NSUInteger length)
+{
+    if (reader->failed || reader->length - reader->offset < length) {
+        reader->failed = YES;
+        return NULL;
+    }
+
+    const void *pointer = reader->bytes + reader->offset;
+    reader->offset += length;
+    return pointer;
+}
+
+static uint16_t p_readUInt16(LXYPrefetchQueueReader *reader)
+{
+    uint16_t value = 0;
+    const void *pointer = p_read(reader, sizeof(value));
+    if (pointer) {
+        memcpy(&value, pointer, sizeof(value));
+    }
+    return CFSwapInt16LittleToHost(value);
+}
+
+static uint32_t p_readUInt32(LXYPrefetchQueueReader *reader)
+{
+    uint32_t value = 0;
+    const void *pointer = p_read(reader, sizeof(value));
+    if (pointer) {
+        memcpy(&value, pointer, sizeof(value));
+    }
+    return CFSwapInt32LittleToHost(value);
+}
+
+static uint64_t p_readUInt64(LXYPrefetchQueueReader *reader)
+{
+    uint64_t value = 0;
+    const void *pointer = p_read(reader, sizeof(value));
+    if (pointer) {
+        memcpy(&value, pointer, sizeof(value));
+    }
+    return CFSwapInt64LittleToHost(value);
+}
+
+static double p_readDouble(LXYPrefetchQueueReader *reader)
+{
+    uint64_t bits = p_readUInt64(reader);
+    double value = 0;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void p_appendDouble(NSMutableData *data, double value)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    p_appendUInt64(data, bits);
+}
+
+static NSString *p_readString(LXYPrefetchQueueReader *reader)
+{
+    uint16_t length = p_readUInt16(reader);
+    const void *pointer = p_read(reader, length);
+    if (!pointer) {
+        return nil;
+    }
+
+    return [[NSString alloc] initWithBytes:pointer length:length encoding:NSUTF8StringEncoding];
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoPrefetchQueueStore ()
+
+// file path
+@property (nonatomic, copy) NSString *path;
+
+@end
+
+@implementation LXYVideoPrefetchQueueStore
+
+- (instancetype)initWithPath:(NSString *)path
+{
+    self = [super init];
+    if (self) {
+        _path = [path copy];
+    }
+
+    return self;
+}
+
+- (NSArray<LXYVideoPrefetchQueueRecord *> *)loadRecords
+{
+    NSData *data = [NSData dataWithContentsOfFile:self.path options:NSDataReadingMappedIfSafe error:NULL];
+    if (data.length == 0) {
+        return @[];
+    }
+
+    LXYPrefetchQueueReader reader = { data.bytes, data.length, 0, NO };
+    uint32_t magic = p_readUInt32(&reader);
+    uint16_t version = p_readUInt16(&reader);
+    if (magic != kLXYPrefetchQueueMagic || version == 0 || version > kLXYPrefetchQueueVersion) {
+        LXY_VIDEO_ERROR(@"loadRecords error: unknown prefetch queue format");
+        return @[];
+    }
+
+    uint32_t count = p_readUInt32(&reader);
+    NSMutableArray<LXYVideoPrefetchQueueRecord *> *records = [NSMutableArray arrayWithCapacity:MIN(count, 1024)];
+    for (uint32_t i = 0; i < count && !reader.failed; ++i) {
+        LXYVideoPrefetchQueueRecord *record = [LXYVideoPrefetchQueueRecord new];
+        record.size = (NSUInteger)MIN(p_readUInt64(&reader), (uint64_t)NSUIntegerMax);
+        if (version < 3) {
+            p_readUInt64(&reader);      // doneBytes
+        }
+
+        record.enqueueTime = p_readDouble(&reader);
+
+        uint32_t priorityBits = p_readUInt32(&reader);
+        float priority = 0;
+        memcpy(&priority, &priorityBits, sizeof(priority));
+        record.priority = priority;
+
+        record.urlString = p_readString(&reader);
+        record.group = p_readString(&reader);
+        if (version >= 2) {
+            record.duration = p_readDouble(&reader);
+        }
+
+        if (!reader.failed && record.urlString.length > 0 && record.group) {
+            [records addObject:record];
+        }
+    }
+
+    if (reader.failed) {
+        LXY_VIDEO_ERROR(@"loadRecords error: prefetch queue truncated, %@ of %@ records restored", @(records.count), @(count));
+    }
+
+    return records;
+}
+
+- (BOOL)saveRecords:(NSArray<LXYVideoPrefetchQueueRecord *> *)records
+{
+    if (records.count == 0) {
+        [[NSFileManager defaultManager] removeItemAtPath:self.path error:NULL];
+        return YES;
+    }
+
+    NSMutableData *data = [NSMutableData dataWithCapacity:64 * records.count];
+    p_appendUInt32(data, kLXYPrefetchQueueMagic);
+    p_appendUInt16(data, kLXYPrefetchQueueVersion);
+    p_appendUInt32(data, (uint32_t)records.count);
+
+    for (LXYVideoPrefetchQueueRecord *record in records) {
+        p_appendUInt64(data, record.size);
+
+        p_appendDouble(data, record.enqueueTime);
+
+        float priority = record.priority;
+        uint32_t priorityBits = 0;
+        memcpy(&priorityBits, &priority, sizeof(priorityBits));
+        p_appendUInt32(data, priorityBits);
+
+        p_appendString(data, record.urlString);
+        p_appendString(data, record.group ? : @"");
+        p_appendDouble(data, record.duration);
+    }
+
+    BOOL succeed = [data writeToFile:self.path atomically:YES];
+    if (!succeed) {
+        LXY_VIDEO_ERROR(@"saveRecords error: write %@ records failed", @(records.count));
+    }
+
+    return succeed;
+}
+
+@end
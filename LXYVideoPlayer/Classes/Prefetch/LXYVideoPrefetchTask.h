@@ -79,6 +79,19 @@ typedef NS_ENUM(NSInteger, LXYVideoPrefetchTaskState)
 /// prefetch size
 @property (nonatomic, assign) NSUInteger prefetchSize;
 
+/// prefetch the moov box and the samples of the first @prefetchDuration seconds. second.
+/// 0 to prefetch by @prefetchSize, which is also the fallback for resources that are not MP4
+@property (nonatomic, assign) NSTimeInterval prefetchDuration;
+
+/// task group
+@property (nonatomic, copy) NSString *group;
+
+/// network priority. NSURLSessionTaskPriorityLow by default
+@property (nonatomic, assign) float priority;
+
+/// the time when the task was enqueued. timeIntervalSince1970
+@property (nonatomic, assign) NSTimeInterval enqueueTime;
+
 /// prefetch state
 @property (nonatomic, assign) LXYVideoPrefetchTaskState state;
 
@@ -3,8 +3,11 @@
 #import "LXYVideoPrefetchHitRecorder.h"
 #import "LXYVideoPlayerDefines.h"
 #import "LXYVideoDiskCache.h"
+#import "LXYVideoDiskCache+Private.h"
+#import "LXYVideoTimeIndex.h"
 #import "LXYVideoDiskCacheDeleteManager.h"
 #import "LXYVideoPrefetchTaskManager.h"
+#import "LXYVideoMP4Parser.h"
 
 #import <pthread.h>
 #import <arpa/inet.h>
@@ -81,6 +84,47 @@ static BOOL s_isNetworkWifiConnected()
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 
+// bytes requested for each box header probe
+static const NSUInteger kLXYPrefetchBoxProbeSize = 64 * 1024;
+// max box header probes for one video
+static const NSUInteger kLXYPrefetchBoxProbeMax = 8;
+
+/// box-aware prefetch phase
+typedef NS_ENUM(NSInteger, LXYVideoPrefetchPhase)
+{
+    /// locating moov by walking the top-level boxes
+    LXYVideoPrefetchPhaseLocateMoov = 0,
+    /// loading moov
+    LXYVideoPrefetchPhaseLoadMoov,
+    /// loading the samples, or [0, prefetchSize) as fallback. the last phase
+    LXYVideoPrefetchPhaseSamples,
+};
+
+@interface LXYVideoPrefetchTask ()
+
+// the queue on which request tasks are executed
+@property (nonatomic, strong) dispatch_queue_t taskQueue;
+
+// box-aware prefetch phase
+@property (nonatomic, assign) LXYVideoPrefetchPhase phase;
+
+// file offset of the next top-level box to scan
+@property (nonatomic, assign) uint64_t boxScanOffset;
+
+// box header probes made
+@property (nonatomic, assign) NSUInteger boxProbeCount;
+
+// file range of moov. length 0 if not located yet
+@property (nonatomic, assign) NSRange moovRange;
+
+// whether any response has been received
+@property (nonatomic, assign) BOOL hasReceivedResponse;
+
+// lease on the cache item while running
+@property (nonatomic, strong) LXYVideoDiskCacheLease *cacheLease;
+
+@end
+
 @implementation LXYVideoPrefetchTask
 
 - (instancetype)init
@@ -88,6 +132,12 @@ static BOOL s_isNetworkWifiConnected()
     self = [super init];
     if (self) {
         _prefetchSize = NSUIntegerMax;
+        _group = @"default";
+        _priority = 0.3;
+        if (@available(iOS 8.0, *)) {
+            _priority = NSURLSessionTaskPriorityLow;
+        }
+        _enqueueTime = [[NSDate date] timeIntervalSince1970];
         _state = LXYVideoPrefetchTaskStateUnknown;
     }
     
@@ -107,6 +157,7 @@ static BOOL s_isNetworkWifiConnected()
     self.prefetchSize = size;
     self.videoURL = [NSURL URLWithString:urlString];
     self.videoURLKey = LXYVideoURLStringToCacheKey(urlString);
+    self.taskQueue = queue;
     
     self.requestTask = [LXYVideoCachePrefetchTask taskWithURL:self.videoURL queue:queue];
     self.requestTask.delegate = self;
@@ -126,15 +177,26 @@ static BOOL s_isNetworkWifiConnected()
         return NO;
     }
     
+    // resume from what is on disk already, e.g. a task restored after relaunch
+    [self.requestTask loadCacheMetaSync];
+    
 //    LXY_VIDEO_INFO(@"%@ startPrefetch", self.videoURLKey);
-    BOOL succeed = [self.requestTask startWithSize:self.prefetchSize];
+    BOOL succeed = NO;
+    if (self.prefetchDuration > 0) {
+        self.phase = LXYVideoPrefetchPhaseLocateMoov;
+        succeed = [self _startNextBoxAwareRequest];
+    } else {
+        self.phase = LXYVideoPrefetchPhaseSamples;
+        succeed = [self.requestTask startWithSize:self.prefetchSize priority:self.priority];
+    }
     if (!succeed) {
         return NO;
     }
     
     self.state = LXYVideoPrefetchTaskStateRunning;
     
-    [LXYVideoDiskCacheDeleteManager startUseCacheForKey:self.videoURLKey];
+    [self.cacheLease invalidate];
+    self.cacheLease = [LXYVideoDiskCacheDeleteManager leaseCacheForKey:self.videoURLKey];
     
     self.prefetchBeginTime = [[NSDate date] timeIntervalSince1970];
     
@@ -153,7 +215,138 @@ static BOOL s_isNetworkWifiConnected()
         self.state = LXYVideoPrefetchTaskStateCanceled;
     }
     
-    [LXYVideoDiskCacheDeleteManager endUseCacheForKey:self.videoURLKey];
+    [self.cacheLease invalidate];
+    self.cacheLease = nil;
+}
+
+#pragma mark - Box-aware Prefetch
+
+/*
+ * walk the top-level boxes to locate moov, probing box headers from network when they are not cached,
+ * then load moov, and finally prefetch [0, end of the samples of the first prefetchDuration seconds).
+ * every network request is a new request task, which resumes from what has been cached.
+ * return YES if a network request is started, NO if there is nothing more to load.
+ */
+- (BOOL)_startNextBoxAwareRequest
+{
+    LXYVideoCachePrefetchTask *requestTask = self.requestTask;
+    
+    // moov has been parsed before, the index tells the bytes of the first seconds directly
+    LXYVideoTimeIndex *timeIndex = requestTask.timeIndex;
+    if (self.phase == LXYVideoPrefetchPhaseLocateMoov && timeIndex) {
+        self.phase = LXYVideoPrefetchPhaseSamples;
+        NSRange byteRange = [timeIndex byteRangeFromTime:0 duration:self.prefetchDuration];
+        return [requestTask startWithSize:NSMaxRange(byteRange) priority:self.priority];
+    }
+    
+    while (self.phase == LXYVideoPrefetchPhaseLocateMoov) {
+        uint64_t scanOffset = self.boxScanOffset;
+        if (requestTask.fileLength != 0 && scanOffset >= requestTask.fileLength) {
+            return [self _startFallbackRequest];
+        }
+        
+        NSUInteger availableLength = [requestTask availableLengthFromOffset:(NSUInteger)scanOffset];
+        if (availableLength < 16) {
+            if (self.boxProbeCount >= kLXYPrefetchBoxProbeMax) {
+                return [self _startFallbackRequest];
+            }
+            ++self.boxProbeCount;
+            
+            if (scanOffset == 0) {
+                return [requestTask startWithSize:kLXYPrefetchBoxProbeSize priority:self.priority];
+            }
+            
+            // the file length is known once the head has been loaded
+            NSUInteger probeLength = (NSUInteger)MIN(kLXYPrefetchBoxProbeSize, requestTask.fileLength - scanOffset);
+            return [requestTask startWithAbsoluteRange:NSMakeRange((NSUInteger)scanOffset, probeLength) priority:self.priority];
+        }
+        
+        NSData *data = [requestTask cachedDataWithRange:NSMakeRange((NSUInteger)scanOffset, MIN(availableLength, kLXYPrefetchBoxProbeSize))];
+        NSRange moovRange = NSMakeRange(0, 0);
+        uint64_t nextBoxOffset = scanOffset;
+        LXYVideoMP4ScanResult result = [LXYVideoMP4Parser scanTopLevelBoxesInData:data ? : [NSData data]
+                                                                       dataOffset:scanOffset
+                                                                       fileLength:requestTask.fileLength
+                                                                        moovRange:&moovRange
+                                                                    nextBoxOffset:&nextBoxOffset];
+        if (!data || result == LXYVideoMP4ScanResultInvalid) {
+            LXY_VIDEO_INFO(@"%@ prefetch: not MP4, fallback to %@ bytes", self.videoURLKey, @(self.prefetchSize));
+            return [self _startFallbackRequest];
+        }
+        
+        if (result == LXYVideoMP4ScanResultFoundMoov) {
+            self.moovRange = moovRange;
+            self.phase = LXYVideoPrefetchPhaseLoadMoov;
+        } else {
+            self.boxScanOffset = nextBoxOffset;
+        }
+    }
+    
+    if (self.phase == LXYVideoPrefetchPhaseLoadMoov) {
+        NSRange moovRange = self.moovRange;
+        NSUInteger cachedLength = MIN([requestTask availableLengthFromOffset:moovRange.location], moovRange.length);
+        if (cachedLength < moovRange.length) {
+            NSRange missingRange = NSMakeRange(moovRange.location + cachedLength, moovRange.length - cachedLength);
+            return [requestTask startWithAbsoluteRange:missingRange priority:self.priority];
+        }
+        
+        NSError *error = nil;
+        NSData *moovData = [requestTask cachedDataWithRange:moovRange];
+        LXYVideoMP4Movie *movie = moovData ? [LXYVideoMP4Parser movieWithMoovData:moovData error:&error] : nil;
+        if (!movie) {
+            LXY_VIDEO_INFO(@"%@ prefetch: bad moov %@, fallback to %@ bytes", self.videoURLKey, error, @(self.prefetchSize));
+            return [self _startFallbackRequest];
+        }
+        
+        [LXYVideoDiskCache setTimeIndex:[LXYVideoTimeIndex indexWithMovie:movie] forKey:self.videoURLKey];
+        
+        // a moov in front has to be loaded as part of the head anyway
+        uint64_t byteEnd = [movie byteEndForPlayDuration:self.prefetchDuration];
+        if (moovRange.location < byteEnd) {
+            byteEnd = MAX(byteEnd, NSMaxRange(moovRange));
+        }
+        
+        LXY_VIDEO_INFO(@"%@ prefetch: moov = (%@, %@), %.1f s in %@ bytes",
+                       self.videoURLKey, @(moovRange.location), @(moovRange.length), self.prefetchDuration, @(byteEnd));
+        
+        self.phase = LXYVideoPrefetchPhaseSamples;
+        return [requestTask startWithSize:(NSUInteger)byteEnd priority:self.priority];
+    }
+    
+    return NO;
+}
+
+- (BOOL)_startFallbackRequest
+{
+    self.phase = LXYVideoPrefetchPhaseSamples;
+    return [self.requestTask startWithSize:self.prefetchSize priority:self.priority];
+}
+
+// a request task serves a single request
+- (void)_renewRequestTask
+{
+    self.requestTask.delegate = nil;
+    
+    self.requestTask = [LXYVideoCachePrefetchTask taskWithURL:self.videoURL queue:self.taskQueue];
+    self.requestTask.delegate = self;
+    [self.requestTask loadCacheMetaSync];
+}
+
+- (void)_finishPrefetch
+{
+    LXY_VIDEO_INFO(@"%@ finishPrefetch: %@ byte, %.0f ms",
+                   self.videoURLKey,
+                   @(self.requestTask.cacheLength),
+                   ([[NSDate date] timeIntervalSince1970] - self.prefetchBeginTime) * 1000);
+    
+    self.state = LXYVideoPrefetchTaskStateFinished;
+    
+    [self.cacheLease invalidate];
+    self.cacheLease = nil;
+    
+    if (self.delegate) {
+        [self.delegate requestTaskDidFinishLoading:self];
+    }
 }
 
 #pragma mark - LXYVideoCacheRequestTaskDelegate
@@ -176,23 +369,27 @@ static BOOL s_isNetworkWifiConnected()
         [self.delegate requestTaskDidReceiveResponse:self];
     }
     
-    [[LXYVideoPrefetchHitRecorder sharedInstance] startPrefetchWithKey:task.requestURL.absoluteString];
+    // a box-aware prefetch makes several requests
+    if (!self.hasReceivedResponse) {
+        self.hasReceivedResponse = YES;
+        [[LXYVideoPrefetchHitRecorder sharedInstance] startPrefetchWithKey:task.requestURL.absoluteString];
+    }
 }
 
 - (void)requestTaskDidFinishLoading:(LXYVideoCacheRequestTask *)task
 {
-    LXY_VIDEO_INFO(@"%@ finishPrefetch: %@ byte, %.0f ms",
-                   self.videoURLKey,
-                   @(self.requestTask.cacheLength),
-                   ([[NSDate date] timeIntervalSince1970] - self.prefetchBeginTime) * 1000);
-    
-    self.state = LXYVideoPrefetchTaskStateFinished;
-    
-    [LXYVideoDiskCacheDeleteManager endUseCacheForKey:self.videoURLKey];
+    if (self.state != LXYVideoPrefetchTaskStateRunning) {
+        return;
+    }
     
-    if (self.delegate) {
-        [self.delegate requestTaskDidFinishLoading:self];
+    if (self.phase != LXYVideoPrefetchPhaseSamples) {
+        [self _renewRequestTask];
+        if ([self _startNextBoxAwareRequest]) {
+            return;
+        }
     }
+    
+    [self _finishPrefetch];
 }
 
 - (void)requestTask:(LXYVideoCacheRequestTask *)task didFailWithError:(NSError *)error
@@ -201,7 +398,8 @@ static BOOL s_isNetworkWifiConnected()
     
     self.state = LXYVideoPrefetchTaskStateFinishedError;
     
-    [LXYVideoDiskCacheDeleteManager endUseCacheForKey:self.videoURLKey];
+    [self.cacheLease invalidate];
+    self.cacheLease = nil;
     
     if (self.delegate) {
         [self.delegate requestTask:self didFailWithError:error];
@@ -18,6 +18,17 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (void)prefetchWithURLString:(NSString *)urlString size:(NSUInteger)size group:(NSString * _Nullable)group;
 
+/**
+ * @brief create an LXYVideoPrefetchTask which prefetches exactly what is needed to play the first @duration seconds of an MP4:
+ *        the moov box wherever it is, and the samples of the first @duration seconds.
+ *        resources that are not MP4 fall back to the whole video length.
+ *
+ * @param urlString LXYVideoPrefetchTask's urlString
+ * @param duration  play duration to prefetch. second
+ * @param group     tasks with the same group can be operated by batch. nil, empty will fall into default group
+ */
++ (void)prefetchWithURLString:(NSString *)urlString duration:(NSTimeInterval)duration group:(NSString * _Nullable)group;
+
 /**
  * @brief create an LXYVideoPrefetchTask, of which the life circle is managed by LXYVideoPrefetchTaskManager.
  *        All LXYVideoPrefetchTask will be executed serially.
@@ -69,6 +80,23 @@ NS_ASSUME_NONNULL_BEGIN
 + (void)clear;
 
 
+/**
+ * @brief restore the pending tasks persisted by the last launch.
+ *        tasks are restored lazily the first time the manager is used; call this at launch to warm up earlier.
+ *        tasks older than persistedTaskMaxAge are dropped, the others resume from the bytes already on disk.
+ */
++ (void)restorePersistedTasks;
+
+/**
+ * @brief the max age of a persisted task to be restored. second. default to 24 hours
+ */
++ (NSTimeInterval)persistedTaskMaxAge;
+
+/**
+ * @brief set the max age of a persisted task to be restored. <= 0 drops all persisted tasks
+ */
++ (void)setPersistedTaskMaxAge:(NSTimeInterval)maxAge;
+
 /**
  @brief get prefetch option
  @return prefetch option
@@ -2,9 +2,34 @@
 #import "LXYVideoPrefetchTaskManager.h"
 
 #import "LXYVideoPrefetchTask.h"
+#import "LXYVideoPrefetchQueueStore.h"
 #import "LXYVideoDiskCache.h"
 #import "LXYVideoDiskCache+Private.h"
 #import "LXYVideoPlayerDefines.h"
+#import "LXYVideoLogger.h"
+#import "LXYVideoTraceRecorder.h"
+#import "LXYVideoLockProfiler.h"
+#import "LXYVideoStorageMonitor.h"
+
+#import <UIKit/UIKit.h>
+
+// persist the queue at most once per interval. second
+static const NSTimeInterval kLXYPrefetchPersistInterval = 2;
+
+// max age of a persisted task. second
+static NSTimeInterval s_persistedTaskMaxAge = 24 * 60 * 60;
+
+// the serial prefetch queue, profiled
+static inline void p_prefetchQueueAsync(dispatch_queue_t queue, dispatch_block_t block)
+{
+    dispatch_async(queue, LXYVideoLockProfilerWrapBlock(LXY_VIDEO_LOCK_PROFILE(@"LXYVideoPrefetchTaskManager.dispatchQueue"), block));
+}
+
+// the same video prefetched in different groups is cancelled separately
+static inline NSString *p_pendingTaskKey(NSString *urlString, NSString *group)
+{
+    return [NSString stringWithFormat:@"%@\n%@", group, urlString];
+}
 
 @interface NSMutableArray (LXYVideoPrefetch_QueueAdditions)
 
@@ -54,6 +79,9 @@
 // FIFO queue
 @property (nonatomic, strong) NSMutableArray<LXYVideoPrefetchTask *> *taskQueue;
 
+// <group + url, prefetchTask>: the queued and running tasks, to merge a repeated prefetch
+@property (nonatomic, strong) NSMutableDictionary<NSString *, LXYVideoPrefetchTask *> *pendingTaskDict;
+
 // execute queue for all tasks
 @property (nonatomic, strong) dispatch_queue_t dispatchQueue;
 
@@ -63,6 +91,18 @@
 // prefetch option: default is YES
 @property (nonatomic, assign) BOOL enablePrefetchWIFIOnly;
 
+// durable storage of pending tasks
+@property (nonatomic, strong) LXYVideoPrefetchQueueStore *queueStore;
+
+// whether tasks persisted by the last launch have been restored
+@property (nonatomic, assign) BOOL hasRestored;
+
+// whether a coalesced persist is scheduled
+@property (nonatomic, assign) BOOL persistScheduled;
+
+// number of stalled plays which have paused prefetching
+@property (nonatomic, assign) NSInteger playStallCount;
+
 @end
 
 @implementation LXYVideoPrefetchTaskManager
@@ -89,7 +129,29 @@
         _dispatchQueue = dispatch_queue_create("com.LXYVideoPlayer.LXYVideoPrefetch", attr);
         _runningTaskDict = [NSMutableDictionary dictionary];
         _taskQueue = [NSMutableArray array];
+        _pendingTaskDict = [NSMutableDictionary dictionary];
         _enablePrefetchWIFIOnly = YES;
+        
+        NSString *queuePath = [[LXYVideoDiskCache cachePath] stringByAppendingPathComponent:@"PrefetchQueue"];
+        _queueStore = [[LXYVideoPrefetchQueueStore alloc] initWithPath:queuePath];
+        
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(_applicationDidEnterBackground:)
+                                                     name:UIApplicationDidEnterBackgroundNotification
+                                                   object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(_applicationDidEnterBackground:)
+                                                     name:UIApplicationWillTerminateNotification
+                                                   object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(_storagePressureDidChange:)
+                                                     name:LXYVideoStoragePressureDidChangeNotification
+                                                   object:nil];
+        
+        // restore lazily: the first time the manager is used
+        p_prefetchQueueAsync(_dispatchQueue, ^{
+            [self _restoreIfNeeded];
+        });
     }
     
     return self;
@@ -97,11 +159,13 @@
 
 - (void)dealloc
 {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
 }
 
 + (void)clear
 {
-    dispatch_async([LXYVideoPrefetchTaskManager sharedInstance].dispatchQueue, ^{
+    LXY_VIDEO_TRACE_RECORD(LXYVideoTraceOpPrefetchCancel, nil, 0, 0);
+    p_prefetchQueueAsync([LXYVideoPrefetchTaskManager sharedInstance].dispatchQueue, ^{
         [[LXYVideoPrefetchTaskManager sharedInstance] _clear];
     });
 }
@@ -117,7 +181,10 @@
     
     self.runningTaskDict = [NSMutableDictionary dictionary];
     self.taskQueue = [NSMutableArray array];
+    self.pendingTaskDict = [NSMutableDictionary dictionary];
     self.runningTask = nil;
+    
+    [self _setNeedsPersist];
 }
 
 + (void)prefetchWithURLString:(NSString *)urlString size:(NSUInteger)size
@@ -136,35 +203,70 @@
 }
 
 + (void)prefetchWithURLString:(NSString *)urlString size:(NSUInteger)size group:(NSString *)group
+{
+    [self _prefetchWithURLString:urlString size:size duration:0 group:group];
+}
+
++ (void)prefetchWithURLString:(NSString *)urlString duration:(NSTimeInterval)duration group:(NSString *)group
+{
+    [self _prefetchWithURLString:urlString size:NSUIntegerMax duration:MAX(duration, 0) group:group];
+}
+
++ (void)_prefetchWithURLString:(NSString *)urlString size:(NSUInteger)size duration:(NSTimeInterval)duration group:(NSString *)group
 {
     if (LXYVideo_isEmptyString(urlString)) {
         return;
     }
     
+    LXY_VIDEO_TRACE_RECORD(LXYVideoTraceOpPrefetchEnqueue, LXYVideoURLStringToCacheKey(urlString), 0, duration > 0 ? 0 : size);
+    
     group = group ? : @"default";
     [LXYVideoDiskCache hasCacheForURLString:urlString completion:^(BOOL hasCache) {
-        if (!hasCache) {
-            dispatch_async([LXYVideoPrefetchTaskManager sharedInstance].dispatchQueue, ^{
-                [[LXYVideoPrefetchTaskManager sharedInstance] _prefetchWithURLString:urlString size:size group:group];
+        // a box-aware prefetch may follow a partial one, e.g. moov is cached but not the samples
+        if (!hasCache || duration > 0) {
+            p_prefetchQueueAsync([LXYVideoPrefetchTaskManager sharedInstance].dispatchQueue, ^{
+                [[LXYVideoPrefetchTaskManager sharedInstance] _prefetchWithURLString:urlString size:size duration:duration group:group];
             });
         }
     }];
 }
 
-- (void)_prefetchWithURLString:(NSString * _Nonnull)urlString size:(NSUInteger)size group:(NSString *)group
+- (void)_prefetchWithURLString:(NSString * _Nonnull)urlString size:(NSUInteger)size duration:(NSTimeInterval)duration group:(NSString *)group
+{
+    // the same video may have been restored from the last launch
+    LXYVideoPrefetchTask *pendingTask = [self _pendingTaskForURLString:urlString group:group];
+    if (pendingTask) {
+        if (pendingTask.state == LXYVideoPrefetchTaskStateInitialized) {
+            pendingTask.prefetchSize = MAX(pendingTask.prefetchSize, size);
+            pendingTask.prefetchDuration = MAX(pendingTask.prefetchDuration, duration);
+        }
+        return;
+    }
+    
+    LXYVideoPrefetchTask *task = [self _enqueueTaskWithURLString:urlString size:size group:group];
+    task.prefetchDuration = duration;
+    
+    [self _setNeedsPersist];
+
+    // 触发prefetch
+    [self startPrefetchIfNeeded];
+}
+
+- (LXYVideoPrefetchTask *)_enqueueTaskWithURLString:(NSString * _Nonnull)urlString size:(NSUInteger)size group:(NSString *)group
 {
     LXYVideoPrefetchTask *task = [LXYVideoPrefetchTask taskWithURLString:urlString size:size queue:self.dispatchQueue];
+    task.group = group;
     task.delegate = self;
     
     [self.taskQueue enqueue:task];
+    self.pendingTaskDict[p_pendingTaskKey(task.videoURL.absoluteString, group)] = task;
     //
     if (!self.runningTaskDict[group]) {
         self.runningTaskDict[group] = [NSMutableArray array];
     }
     [self.runningTaskDict[group] addObject:task];
-
-    // 触发prefetch
-    [self startPrefetchIfNeeded];
+    
+    return task;
 }
 
 + (void)cancel
@@ -174,9 +276,11 @@
 
 + (void)cancelForGroup:(NSString *)group
 {
+    LXY_VIDEO_TRACE_RECORD(LXYVideoTraceOpPrefetchCancel, nil, 0, 0);
+    
     group = group ? : @"default";
     
-    dispatch_async([LXYVideoPrefetchTaskManager sharedInstance].dispatchQueue, ^{
+    p_prefetchQueueAsync([LXYVideoPrefetchTaskManager sharedInstance].dispatchQueue, ^{
         [[LXYVideoPrefetchTaskManager sharedInstance] _cancelForGroup:group];
     });
 }
@@ -186,6 +290,7 @@
     NSMutableArray<LXYVideoPrefetchTask *> *taskArray = self.runningTaskDict[group];
     [taskArray enumerateObjectsUsingBlock:^(LXYVideoPrefetchTask * _Nonnull obj, NSUInteger idx, BOOL * _Nonnull stop) {
         [obj cancelPrefetch];
+        [self _removePendingTask:obj];
         if (obj == self.runningTask) {
             self.runningTask = nil;
         }
@@ -193,13 +298,17 @@
     
     self.runningTaskDict[group] = [NSMutableArray array];
     
+    [self _setNeedsPersist];
+    
     // trigger prefetch next
     [self startPrefetchIfNeeded];
 }
 
 + (void)cancelForURLString:(NSString *)urlString
 {
-    dispatch_async([LXYVideoPrefetchTaskManager sharedInstance].dispatchQueue, ^{
+    LXY_VIDEO_TRACE_RECORD(LXYVideoTraceOpPrefetchCancel, LXYVideoURLStringToCacheKey(urlString), 0, 0);
+    
+    p_prefetchQueueAsync([LXYVideoPrefetchTaskManager sharedInstance].dispatchQueue, ^{
         [[LXYVideoPrefetchTaskManager sharedInstance] _cancelForURLString:urlString];
     });
 }
@@ -209,26 +318,38 @@
     [self.taskQueue enumerateObjectsUsingBlock:^(LXYVideoPrefetchTask * _Nonnull obj, NSUInteger idx, BOOL * _Nonnull stop) {
         if ([obj.videoURL.absoluteString isEqualToString:urlString]) {
             [obj cancelPrefetch];
-            if (obj == self.runningTask) {
-                self.runningTask = nil;
-            }
+            [self _removePendingTask:obj];
         }
     }];
     
+    // the running task has been dequeued already
+    if ([self.runningTask.videoURL.absoluteString isEqualToString:urlString]) {
+        [self.runningTask cancelPrefetch];
+        [self _removePendingTask:self.runningTask];
+        self.runningTask = nil;
+    }
+    
+    [self _setNeedsPersist];
+    
     // trigger prefetch next
     [self startPrefetchIfNeeded];
 }
 
 - (void)startPrefetchIfNeeded
 {
-    dispatch_async(self.dispatchQueue, ^{
+    p_prefetchQueueAsync(self.dispatchQueue, ^{
         [self _startPrefetchIfNeeded];
     });
 }
 
 - (void)_startPrefetchIfNeeded
 {
-    if (self.runningTask) {
+    if (self.runningTask || self.playStallCount > 0) {
+        return;
+    }
+    
+    // leave the space to playback. the tasks stay queued until the pressure is relieved
+    if ([LXYVideoStorageMonitor sharedInstance].pressure != LXYVideoStoragePressureNone) {
         return;
     }
     
@@ -239,10 +360,189 @@
             break;
         }
         
+        // dropped, the same as before it was persisted
+        [self _removePendingTask:task];
         task =[self.taskQueue dequeue];
     };
 }
 
+#pragma mark - Persistence
+
++ (void)restorePersistedTasks
+{
+    p_prefetchQueueAsync([LXYVideoPrefetchTaskManager sharedInstance].dispatchQueue, ^{
+        [[LXYVideoPrefetchTaskManager sharedInstance] _restoreIfNeeded];
+    });
+}
+
++ (NSTimeInterval)persistedTaskMaxAge
+{
+    return s_persistedTaskMaxAge;
+}
+
++ (void)setPersistedTaskMaxAge:(NSTimeInterval)maxAge
+{
+    s_persistedTaskMaxAge = maxAge;
+}
+
+- (void)_restoreIfNeeded
+{
+    if (self.hasRestored) {
+        return;
+    }
+    self.hasRestored = YES;
+    
+    NSTimeInterval maxAge = s_persistedTaskMaxAge;
+    NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+    NSArray<LXYVideoPrefetchQueueRecord *> *records = [self.queueStore loadRecords];
+    
+    NSUInteger restoredCount = 0;
+    for (LXYVideoPrefetchQueueRecord *record in records) {
+        NSTimeInterval age = now - record.enqueueTime;
+        if (maxAge <= 0 || age < 0 || age > maxAge) {
+            continue;
+        }
+        
+        NSString *group = record.group.length > 0 ? record.group : @"default";
+        if ([self _pendingTaskForURLString:record.urlString group:group]) {
+            continue;
+        }
+        
+        // no hasCache check: a partly cached video resumes from disk when started
+        LXYVideoPrefetchTask *task = [self _enqueueTaskWithURLString:record.urlString
+                                                                size:record.size
+                                                               group:group];
+        task.priority = record.priority;
+        task.enqueueTime = record.enqueueTime;
+        task.prefetchDuration = record.duration;
+        ++restoredCount;
+    }
+    
+    if (records.count > 0) {
+        LXY_VIDEO_INFO(@"restore prefetch queue: %@ restored, %@ expired", @(restoredCount), @(records.count - restoredCount));
+        
+        // drop the expired ones from disk
+        [self _setNeedsPersist];
+        [self _startPrefetchIfNeeded];
+    }
+}
+
+- (void)_setNeedsPersist
+{
+    if (self.persistScheduled) {
+        return;
+    }
+    self.persistScheduled = YES;
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kLXYPrefetchPersistInterval * NSEC_PER_SEC)), self.dispatchQueue, ^{
+        [self _persist];
+    });
+}
+
+- (void)_persist
+{
+    self.persistScheduled = NO;
+    
+    NSMutableArray<LXYVideoPrefetchQueueRecord *> *records = [NSMutableArray array];
+    for (LXYVideoPrefetchTask *task in [self _pendingTasks]) {
+        LXYVideoPrefetchQueueRecord *record = [LXYVideoPrefetchQueueRecord new];
+        record.urlString = task.videoURL.absoluteString;
+        record.group = task.group;
+        record.size = task.prefetchSize;
+        record.duration = task.prefetchDuration;
+        record.priority = task.priority;
+        record.enqueueTime = task.enqueueTime;
+        [records addObject:record];
+    }
+    
+    [self.queueStore saveRecords:records];
+}
+
+// running task first, then the queued ones in order
+- (NSArray<LXYVideoPrefetchTask *> *)_pendingTasks
+{
+    NSMutableArray<LXYVideoPrefetchTask *> *pendingTasks = [NSMutableArray arrayWithCapacity:self.taskQueue.count + 1];
+    if (self.runningTask.state == LXYVideoPrefetchTaskStateRunning) {
+        [pendingTasks addObject:self.runningTask];
+    }
+    
+    for (LXYVideoPrefetchTask *task in self.taskQueue) {
+        if (task.state == LXYVideoPrefetchTaskStateInitialized) {
+            [pendingTasks addObject:task];
+        }
+    }
+    
+    return pendingTasks;
+}
+
+- (LXYVideoPrefetchTask *)_pendingTaskForURLString:(NSString *)urlString group:(NSString *)group
+{
+    LXYVideoPrefetchTask *task = self.pendingTaskDict[p_pendingTaskKey(urlString, group)];
+    if (task.state != LXYVideoPrefetchTaskStateInitialized && task.state != LXYVideoPrefetchTaskStateRunning) {
+        return nil;
+    }
+    
+    return task;
+}
+
+- (void)_removePendingTask:(LXYVideoPrefetchTask *)task
+{
+    NSString *key = p_pendingTaskKey(task.videoURL.absoluteString, task.group);
+    if (self.pendingTaskDict[key] == task) {
+        [self.pendingTaskDict removeObjectForKey:key];
+    }
+}
+
+- (void)_applicationDidEnterBackground:(NSNotification *)notification
+{
+    // the process may be suspended before the coalesced persist fires
+    p_prefetchQueueAsync(self.dispatchQueue, ^{
+        if (self.hasRestored) {
+            [self _persist];
+        }
+    });
+}
+
+#pragma mark - Storage Pressure
+
+- (void)_storagePressureDidChange:(NSNotification *)notification
+{
+    if ([LXYVideoStorageMonitor sharedInstance].pressure == LXYVideoStoragePressureNone) {
+        [self startPrefetchIfNeeded];
+    }
+}
+
+#pragma mark - Play Stall
+
+/*
+ * a stalled play takes the bandwidth of prefetching: the running prefetch stops receiving data,
+ * and no new one starts, until every stalled play has resumed prefetching.
+ */
++ (void)pauseForPlayStall
+{
+    LXYVideoPrefetchTaskManager *manager = [LXYVideoPrefetchTaskManager sharedInstance];
+    p_prefetchQueueAsync(manager.dispatchQueue, ^{
+        if (++manager.playStallCount == 1) {
+            [manager.runningTask.requestTask suspendNetworkRequest];
+        }
+    });
+}
+
++ (void)resumeFromPlayStall
+{
+    LXYVideoPrefetchTaskManager *manager = [LXYVideoPrefetchTaskManager sharedInstance];
+    p_prefetchQueueAsync(manager.dispatchQueue, ^{
+        if (manager.playStallCount <= 0 || --manager.playStallCount > 0) {
+            return;
+        }
+        
+        [manager.runningTask.requestTask resumeNetworkRequest];
+        [manager _startPrefetchIfNeeded];
+    });
+}
+
+#pragma mark - Option
+
 + (BOOL)enablePrefetchWIFIOnly
 {
     return [LXYVideoPrefetchTaskManager sharedInstance].enablePrefetchWIFIOnly;
@@ -267,9 +567,10 @@
 
 - (void)requestTaskDidFinishLoading:(LXYVideoPrefetchTask *)task
 {
-    dispatch_async(self.dispatchQueue, ^{
+    p_prefetchQueueAsync(self.dispatchQueue, ^{
         self.runningTask = nil;
         [self freeTask:task];
+        [self _setNeedsPersist];
         
         [self _startPrefetchIfNeeded];
     });
@@ -277,9 +578,10 @@
 
 - (void)requestTask:(LXYVideoPrefetchTask *)task didFailWithError:(NSError *)error
 {
-    dispatch_async(self.dispatchQueue, ^{
+    p_prefetchQueueAsync(self.dispatchQueue, ^{
         self.runningTask = nil;
         [self freeTask:task];
+        [self _setNeedsPersist];
         
         [self _startPrefetchIfNeeded];
     });
@@ -288,6 +590,8 @@
 
 - (void)freeTask:(LXYVideoPrefetchTask *)task
 {
+    [self _removePendingTask:task];
+    
     [self.runningTaskDict enumerateKeysAndObjectsUsingBlock:^(NSString * _Nonnull key, NSMutableArray<LXYVideoPrefetchTask *> * _Nonnull obj, BOOL * _Nonnull stop) {
         NSMutableArray<LXYVideoPrefetchTask *> *taskArray = obj;
         [taskArray enumerateObjectsUsingBlock:^(LXYVideoPrefetchTask * _Nonnull taskIn, NSUInteger idx, BOOL * _Nonnull stopIn) {
@@ -0,0 +1,65 @@
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * immutable copy of a histogram at some point in time
+ */
+@interface LXYVideoHistogramSnapshot : NSObject
+
+/// number of recorded values
+@property (nonatomic, assign, readonly) uint64_t totalCount;
+
+/// sum of recorded values
+@property (nonatomic, assign, readonly) uint64_t sum;
+
+/// max recorded value
+@property (nonatomic, assign, readonly) uint64_t max;
+
+/// mean of recorded values
+@property (nonatomic, assign, readonly) double mean;
+
+/**
+ * @brief the value at @percentile, with the bucket precision of the histogram
+ *
+ * @param percentile    0 ~ 100
+ */
+- (uint64_t)valueAtPercentile:(double)percentile;
+
+/**
+ * @brief non-empty buckets, ordered by value
+ *
+ * @param block     block with the bucket lower bound and the count in the bucket
+ */
+- (void)enumerateBucketsUsingBlock:(void(^)(uint64_t lowerBound, uint64_t count))block;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * fixed-bucket histogram of unsigned values.
+ * every power of 2 is split into 8 linear sub-buckets, so a recorded value is off by at most 12.5%.
+ * recording is lock-free, and can be done on any thread.
+ */
+@interface LXYVideoHistogram : NSObject
+
+/**
+ * @brief record @value
+ */
+- (void)recordValue:(uint64_t)value;
+
+/**
+ * @brief get a snapshot, without blocking recording threads
+ */
+- (LXYVideoHistogramSnapshot *)snapshot;
+
+/**
+ * @brief clear all recorded values
+ */
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,161 @@
+
+#import "LXYVideoHistogram.h"
+#import <stdatomic.h>
+
+#define LXY_HISTOGRAM_SUB_BUCKET_BITS       3
+#define LXY_HISTOGRAM_SUB_BUCKET_COUNT      (1 << LXY_HISTOGRAM_SUB_BUCKET_BITS)
+#define LXY_HISTOGRAM_BUCKET_COUNT          ((64 - LXY_HISTOGRAM_SUB_BUCKET_BITS + 1) * LXY_HISTOGRAM_SUB_BUCKET_COUNT)
+
+static inline NSUInteger p_bucketIndexForValue(uint64_t value)
+{
+    if (value < LXY_HISTOGRAM_SUB_BUCKET_COUNT) {
+        return (NSUInteger)value;
+    }
+
+    int exponent = 63 - __builtin_clzll(value);
+    uint64_t subBucket = (value >> (exponent - LXY_HISTOGRAM_SUB_BUCKET_BITS)) & (LXY_HISTOGRAM_SUB_BUCKET_COUNT - 1);
+
+    return (NSUInteger)((exponent - LXY_HISTOGRAM_SUB_BUCKET_BITS + 1) * LXY_HISTOGRAM_SUB_BUCKET_COUNT + subBucket);
+}
+
+static inline uint64_t p_lowerBoundForBucketIndex(NSUInteger index)
+{
+    if (index < LXY_HISTOGRAM_SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    NSUInteger exponent = index / LXY_HISTOGRAM_SUB_BUCKET_COUNT + LXY_HISTOGRAM_SUB_BUCKET_BITS - 1;
+    uint64_t subBucket = index % LXY_HISTOGRAM_SUB_BUCKET_COUNT;
+
+    return (LXY_HISTOGRAM_SUB_BUCKET_COUNT + subBucket) << (exponent - LXY_HISTOGRAM_SUB_BUCKET_BITS);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoHistogramSnapshot ()
+
+// uint64_t[LXY_HISTOGRAM_BUCKET_COUNT]
+@property (nonatomic, strong) NSData *counts;
+
+@property (nonatomic, assign, readwrite) uint64_t totalCount;
+@property (nonatomic, assign, readwrite) uint64_t sum;
+@property (nonatomic, assign, readwrite) uint64_t max;
+
+@end
+
+@implementation LXYVideoHistogramSnapshot
+
+- (double)mean
+{
+    return self.totalCount > 0 ? (double)self.sum / self.totalCount : 0;
+}
+
+- (uint64_t)valueAtPercentile:(double)percentile
+{
+    if (self.totalCount == 0) {
+        return 0;
+    }
+
+    percentile = MIN(MAX(percentile, 0), 100);
+    uint64_t targetCount = (uint64_t)ceil(self.totalCount * percentile / 100);
+    targetCount = MAX(targetCount, 1);
+
+    const uint64_t *counts = self.counts.bytes;
+    uint64_t accumulated = 0;
+    for (NSUInteger i = 0; i < LXY_HISTOGRAM_BUCKET_COUNT; ++i) {
+        accumulated += counts[i];
+        if (accumulated >= targetCount) {
+            return MIN(p_lowerBoundForBucketIndex(i), self.max);
+        }
+    }
+
+    return self.max;
+}
+
+- (void)enumerateBucketsUsingBlock:(void(^)(uint64_t lowerBound, uint64_t count))block
+{
+    if (!block) {
+        return;
+    }
+
+    const uint64_t *counts = self.counts.bytes;
+    for (NSUInteger i = 0; i < LXY_HISTOGRAM_BUCKET_COUNT; ++i) {
+        if (counts[i] > 0) {
+            block(p_lowerBoundForBucketIndex(i), counts[i]);
+        }
+    }
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"count = %@, mean = %.1f, p50 = %@, p99 = %@, max = %@",
+            @(self.totalCount),
+            self.mean,
+            @([self valueAtPercentile:50]),
+            @([self valueAtPercentile:99]),
+            @(self.max)];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation LXYVideoHistogram
+{
+    atomic_ullong _counts[LXY_HISTOGRAM_BUCKET_COUNT];
+    atomic_ullong _sum;
+    atomic_ullong _max;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        [self reset];
+    }
+
+    return self;
+}
+
+- (void)recordValue:(uint64_t)value
+{
+    atomic_fetch_add_explicit(&_counts[p_bucketIndexForValue(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_sum, value, memory_order_relaxed);
+
+    unsigned long long max = atomic_load_explicit(&_max, memory_order_relaxed);
+    while (value > max
+           && !atomic_compare_exchange_weak_explicit(&_max, &max, value, memory_order_relaxed, memory_order_relaxed)) {
+        // retry with the updated max
+    }
+}
+
+- (LXYVideoHistogramSnapshot *)snapshot
+{
+    NSMutableData *counts = [NSMutableData dataWithLength:sizeof(uint64_t) * LXY_HISTOGRAM_BUCKET_COUNT];
+    uint64_t *countsBytes = counts.mutableBytes;
+    uint64_t totalCount = 0;
+    for (NSUInteger i = 0; i < LXY_HISTOGRAM_BUCKET_COUNT; ++i) {
+        countsBytes[i] = atomic_load_explicit(&_counts[i], memory_order_relaxed);
+        totalCount += countsBytes[i];
+    }
+
+    // buckets are the source of truth for percentiles, even if a recording is in progress
+    LXYVideoHistogramSnapshot *snapshot = [LXYVideoHistogramSnapshot new];
+    snapshot.counts = counts;
+    snapshot.totalCount = totalCount;
+    snapshot.sum = atomic_load_explicit(&_sum, memory_order_relaxed);
+    snapshot.max = atomic_load_explicit(&_max, memory_order_relaxed);
+
+    return snapshot;
+}
+
+- (void)reset
+{
+    for (NSUInteger i = 0; i < LXY_HISTOGRAM_BUCKET_COUNT; ++i) {
+        atomic_store_explicit(&_counts[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&_sum, 0, memory_order_relaxed);
+    atomic_store_explicit(&_max, 0, memory_order_relaxed);
+}
+
+@end
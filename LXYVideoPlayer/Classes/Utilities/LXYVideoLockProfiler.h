@@ -0,0 +1,141 @@
+
+#import <Foundation/Foundation.h>
+
+#import "LXYVideoHistogram.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * wait and hold counters of one lock or queue. made by LXY_VIDEO_LOCK_PROFILE, and never released
+ */
+@interface LXYVideoLockProfile : NSObject
+
+/// name of the primitive, e.g. "LXYVideoObjectPool"
+@property (nonatomic, copy, readonly) NSString *name;
+
+@end
+
+/**
+ * contention of one lock or queue, in a report of LXYVideoLockProfiler
+ */
+@interface LXYVideoLockContention : NSObject
+
+/// name of the primitive
+@property (nonatomic, copy, readonly) NSString *name;
+
+/// number of acquisitions, or of blocks run for a queue
+@property (nonatomic, assign, readonly) uint64_t acquisitionCount;
+
+/// time from the lock call, or the dispatch, to the acquisition. us
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *waitTime;
+
+/// time in the critical section, or in the block. us
+@property (nonatomic, strong, readonly) LXYVideoHistogramSnapshot *holdTime;
+
+/**
+ * @brief plain values for JSON
+ */
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * wait-time and hold-time counters of the locks and queues of the player.
+ * the instrumented call sites cost a flag test when profiling is disabled, by default.
+ */
+@interface LXYVideoLockProfiler : NSObject
+
+/// profile or not. default to NO
+@property (nonatomic, assign) BOOL enabled;
+
+/**
+ * @brief singleton
+ */
++ (instancetype)sharedInstance;
+
+/**
+ * @brief the contention of every primitive acquired since enabled or reset, the worst tail wait first
+ */
+- (NSArray<LXYVideoLockContention *> *)report;
+
+/**
+ * @brief @report as a table, one primitive per line
+ */
+- (NSString *)reportDescription;
+
+/**
+ * @brief clear all the counters
+ */
+- (void)reset;
+
+@end
+
+/**
+ * @brief whether profiling is enabled. read without a lock by the instrumented call sites
+ */
+FOUNDATION_EXTERN BOOL LXYVideoLockProfiling;
+
+/**
+ * @brief the profile named @name, made on first use. USE LXY_VIDEO_LOCK_PROFILE INSTEAD
+ */
+FOUNDATION_EXTERN LXYVideoLockProfile *LXYVideoLockProfileNamed(NSString *name);
+
+/**
+ * @brief monotonic timestamp for the profiler. ns. 0 if profiling is disabled
+ */
+FOUNDATION_EXTERN uint64_t LXYVideoLockProfilerTimestamp(void);
+
+/**
+ * @brief record one acquisition. timestamps of LXYVideoLockProfilerTimestamp
+ */
+FOUNDATION_EXTERN void LXYVideoLockProfileRecord(LXYVideoLockProfile *profile, uint64_t waitStart, uint64_t acquired, uint64_t released);
+
+/**
+ * @brief @block recording its queue wait and its run time into @profile. @block itself if profiling is disabled
+ */
+FOUNDATION_EXTERN dispatch_block_t LXYVideoLockProfilerWrapBlock(LXYVideoLockProfile *profile, dispatch_block_t block);
+
+/**
+ * the critical section of a lock, ended by the scope
+ */
+typedef struct {
+    __unsafe_unretained LXYVideoLockProfile * _Nullable profile;
+    uint64_t waitStart;
+    uint64_t acquired;
+} LXYVideoLockHold;
+
+/**
+ * @brief record @hold. USE LXY_VIDEO_LOCK_HELD INSTEAD
+ */
+FOUNDATION_EXTERN void LXYVideoLockHoldEnd(LXYVideoLockHold *hold);
+
+// the profile of @NAME, looked up once for each call site
+#define LXY_VIDEO_LOCK_PROFILE(NAME)                                                \
+    ({                                                                              \
+        static LXYVideoLockProfile *__lxy_profile = nil;                            \
+        static dispatch_once_t __lxy_profileOnce;                                   \
+        dispatch_once(&__lxy_profileOnce, ^{                                        \
+            __lxy_profile = LXYVideoLockProfileNamed(NAME);                         \
+        });                                                                         \
+        __lxy_profile;                                                              \
+    })
+
+/*
+ * first statement of a critical section. the hold ends with the scope:
+ *
+ *      uint64_t waitStart = LXYVideoLockProfilerTimestamp();
+ *      @synchronized (self) {
+ *          LXY_VIDEO_LOCK_HELD(@"LXYVideoObjectPool", waitStart);
+ *          ...
+ *      }
+ */
+#define LXY_VIDEO_LOCK_HELD(NAME, WAIT_START)                                                                    \
+    LXYVideoLockHold __lxy_lockHold __attribute__((cleanup(LXYVideoLockHoldEnd), unused)) = {                    \
+        (WAIT_START) ? LXY_VIDEO_LOCK_PROFILE(NAME) : nil,                                                      \
+        (WAIT_START),                                                                                           \
+        (WAIT_START) ? LXYVideoLockProfilerTimestamp() : 0                                                      \
+    }
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,235 @@
+
+#import "LXYVideoLockProfiler.h"
+
+#include <time.h>
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#endif
+
+BOOL LXYVideoLockProfiling = NO;
+
+static inline uint64_t p_nanoseconds(void)
+{
+#if defined(__APPLE__)
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return (uint64_t)now.tv_sec * NSEC_PER_SEC + (uint64_t)now.tv_nsec;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoLockProfile ()
+
+@property (nonatomic, copy, readwrite) NSString *name;
+@property (nonatomic, strong) LXYVideoHistogram *waitHistogram;
+@property (nonatomic, strong) LXYVideoHistogram *holdHistogram;
+
+@end
+
+@implementation LXYVideoLockProfile
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoLockContention ()
+
+@property (nonatomic, copy, readwrite) NSString *name;
+@property (nonatomic, assign, readwrite) uint64_t acquisitionCount;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *waitTime;
+@property (nonatomic, strong, readwrite) LXYVideoHistogramSnapshot *holdTime;
+
+@end
+
+@implementation LXYVideoLockContention
+
+- (NSDictionary<NSString *, id> *)dictionaryRepresentation
+{
+    return @{@"name"         : self.name,
+             @"acquisitions" : @(self.acquisitionCount),
+             @"waitUs"       : @{@"total" : @(self.waitTime.sum),
+                                 @"p50"   : @([self.waitTime valueAtPercentile:50]),
+                                 @"p99"   : @([self.waitTime valueAtPercentile:99]),
+                                 @"p999"  : @([self.waitTime valueAtPercentile:99.9]),
+                                 @"max"   : @(self.waitTime.max)},
+             @"holdUs"       : @{@"total" : @(self.holdTime.sum),
+                                 @"p50"   : @([self.holdTime valueAtPercentile:50]),
+                                 @"p99"   : @([self.holdTime valueAtPercentile:99]),
+                                 @"max"   : @(self.holdTime.max)}};
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"%-48s %10llu  wait p50 %8llu p99 %8llu p999 %8llu total %10llu  hold p50 %8llu p99 %8llu",
+            self.name.UTF8String, self.acquisitionCount,
+            [self.waitTime valueAtPercentile:50], [self.waitTime valueAtPercentile:99], [self.waitTime valueAtPercentile:99.9], self.waitTime.sum,
+            [self.holdTime valueAtPercentile:50], [self.holdTime valueAtPercentile:99]];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoLockProfiler ()
+
+// <name, profile>
+@property (nonatomic, strong) NSMutableDictionary<NSString *, LXYVideoLockProfile *> *profiles;
+
+@end
+
+@implementation LXYVideoLockProfiler
+
++ (instancetype)sharedInstance
+{
+    static LXYVideoLockProfiler *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instance = [LXYVideoLockProfiler new];
+    });
+    
+    return instance;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _profiles = [NSMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+#pragma mark - Public
+
+- (BOOL)enabled
+{
+    return LXYVideoLockProfiling;
+}
+
+- (void)setEnabled:(BOOL)enabled
+{
+    LXYVideoLockProfiling = enabled;
+}
+
+- (NSArray<LXYVideoLockContention *> *)report
+{
+    NSArray<LXYVideoLockProfile *> *profiles = nil;
+    @synchronized (self.profiles) {
+        profiles = self.profiles.allValues;
+    }
+    
+    NSMutableArray<LXYVideoLockContention *> *report = [NSMutableArray arrayWithCapacity:profiles.count];
+    for (LXYVideoLockProfile *profile in profiles) {
+        LXYVideoLockContention *contention = [LXYVideoLockContention new];
+        contention.name = profile.name;
+        contention.waitTime = [profile.waitHistogram snapshot];
+        contention.holdTime = [profile.holdHistogram snapshot];
+        contention.acquisitionCount = contention.waitTime.totalCount;
+        if (contention.acquisitionCount > 0) {
+            [report addObject:contention];
+        }
+    }
+    
+    // the tail decides the stalls. the total wait breaks the ties of the coarse buckets
+    [report sortUsingComparator:^NSComparisonResult(LXYVideoLockContention *left, LXYVideoLockContention *right) {
+        uint64_t leftTail = [left.waitTime valueAtPercentile:99];
+        uint64_t rightTail = [right.waitTime valueAtPercentile:99];
+        if (leftTail != rightTail) {
+            return leftTail > rightTail ? NSOrderedAscending : NSOrderedDescending;
+        }
+        if (left.waitTime.sum != right.waitTime.sum) {
+            return left.waitTime.sum > right.waitTime.sum ? NSOrderedAscending : NSOrderedDescending;
+        }
+        return [left.name compare:right.name];
+    }];
+    
+    return report;
+}
+
+- (NSString *)reportDescription
+{
+    NSMutableString *description = [NSMutableString stringWithFormat:@"%-48s %10s  (us)\n", "primitive", "acquired"];
+    for (LXYVideoLockContention *contention in [self report]) {
+        [description appendFormat:@"%@\n", contention];
+    }
+    
+    return description;
+}
+
+- (void)reset
+{
+    @synchronized (self.profiles) {
+        for (LXYVideoLockProfile *profile in self.profiles.allValues) {
+            [profile.waitHistogram reset];
+            [profile.holdHistogram reset];
+        }
+    }
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+LXYVideoLockProfile *LXYVideoLockProfileNamed(NSString *name)
+{
+    LXYVideoLockProfiler *profiler = [LXYVideoLockProfiler sharedInstance];
+    @synchronized (profiler.profiles) {
+        LXYVideoLockProfile *profile = profiler.profiles[name];
+        if (!profile) {
+            profile = [LXYVideoLockProfile new];
+            profile.name = name;
+            profile.waitHistogram = [LXYVideoHistogram new];
+            profile.holdHistogram = [LXYVideoHistogram new];
+            profiler.profiles[name] = profile;
+        }
+        
+        return profile;
+    }
+}
+
+uint64_t LXYVideoLockProfilerTimestamp(void)
+{
+    return LXYVideoLockProfiling ? p_nanoseconds() : 0;
+}
+
+void LXYVideoLockProfileRecord(LXYVideoLockProfile *profile, uint64_t waitStart, uint64_t acquired, uint64_t released)
+{
+    if (!profile || waitStart == 0 || acquired < waitStart || released < acquired) {
+        return;
+    }
+    
+    [profile.waitHistogram recordValue:(acquired - waitStart) / NSEC_PER_USEC];
+    [profile.holdHistogram recordValue:(released - acquired) / NSEC_PER_USEC];
+}
+
+dispatch_block_t LXYVideoLockProfilerWrapBlock(LXYVideoLockProfile *profile, dispatch_block_t block)
+{
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
+    if (waitStart == 0) {
+        return block;
+    }
+    
+    return ^{
+        uint64_t acquired = p_nanoseconds();
+        block();
+        LXYVideoLockProfileRecord(profile, waitStart, acquired, p_nanoseconds());
+    };
+}
+
+void LXYVideoLockHoldEnd(LXYVideoLockHold *hold)
+{
+    if (hold->profile) {
+        LXYVideoLockProfileRecord(hold->profile, hold->waitStart, hold->acquired, p_nanoseconds());
+    }
+}
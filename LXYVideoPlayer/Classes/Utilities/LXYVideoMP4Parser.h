@@ -0,0 +1,101 @@
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// result of scanning the top-level boxes of an MP4 file
+typedef NS_ENUM(NSInteger, LXYVideoMP4ScanResult)
+{
+    /// the next box header lies beyond the scanned data
+    LXYVideoMP4ScanResultNeedMoreData = 0,
+    /// moov box located
+    LXYVideoMP4ScanResultFoundMoov,
+    /// not an ISO-BMFF file, or corrupted
+    LXYVideoMP4ScanResultInvalid,
+};
+
+/**
+ * a video or audio track, parsed from the sample tables in moov
+ */
+@interface LXYVideoMP4Track : NSObject
+
+/// handler type. 'vide' or 'soun'
+@property (nonatomic, copy, readonly) NSString *handlerType;
+
+/// media timescale
+@property (nonatomic, assign, readonly) uint32_t timescale;
+
+/// media duration. second
+@property (nonatomic, assign, readonly) NSTimeInterval duration;
+
+/// number of samples
+@property (nonatomic, assign, readonly) NSUInteger sampleCount;
+
+/**
+ * @brief enumerate samples in decode order
+ *
+ * @param block     offset: file offset of the sample. decodeTime: second. isSync: key frame
+ */
+- (void)enumerateSamplesUsingBlock:(void(^)(uint64_t offset, uint32_t size, NSTimeInterval decodeTime, BOOL isSync, BOOL *stop))block;
+
+/**
+ * @brief the file offset (exclusive) up to which the samples of the first @duration seconds are stored.
+ *        for video, the first key frame is always included.
+ */
+- (uint64_t)byteEndForPlayDuration:(NSTimeInterval)duration;
+
+@end
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * the movie described by a moov box
+ */
+@interface LXYVideoMP4Movie : NSObject
+
+/// video and audio tracks
+@property (nonatomic, copy, readonly) NSArray<LXYVideoMP4Track *> *tracks;
+
+/// movie duration. second
+@property (nonatomic, assign, readonly) NSTimeInterval duration;
+
+/**
+ * @brief the file offset (exclusive) up to which the samples of the first @duration seconds of all tracks are stored
+ */
+- (uint64_t)byteEndForPlayDuration:(NSTimeInterval)duration;
+
+@end
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * minimal ISO-BMFF (MP4) parser. only what the cache needs to map play time to bytes is parsed.
+ */
+@interface LXYVideoMP4Parser : NSObject
+
+/**
+ * @brief walk the top-level boxes in @data to locate moov
+ *
+ * @param data          file data, which must begin at a box boundary
+ * @param dataOffset    the file offset of @data
+ * @param fileLength    the file length. 0 if unknown
+ * @param moovRange     the file range of moov if found
+ * @param nextBoxOffset the file offset of the first box whose header is not in @data. resume the scan from here
+ */
++ (LXYVideoMP4ScanResult)scanTopLevelBoxesInData:(NSData *)data
+                                      dataOffset:(uint64_t)dataOffset
+                                      fileLength:(uint64_t)fileLength
+                                       moovRange:(NSRange * _Nullable)moovRange
+                                   nextBoxOffset:(uint64_t * _Nullable)nextBoxOffset;
+
+/**
+ * @brief parse the sample tables in a complete moov box
+ *
+ * @param data      the moov box, header included
+ * @param error     LXYVideoCacheErrorMP4Invalid if malformed
+ */
++ (LXYVideoMP4Movie * _Nullable)movieWithMoovData:(NSData *)data error:(NSError * __autoreleasing *)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
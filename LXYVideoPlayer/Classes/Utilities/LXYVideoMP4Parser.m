@@ -0,0 +1,533 @@
+
+#import "LXYVideoMP4Parser.h"
+#import "LXYVideoPlayerDefines.h"
+
+#define LXY_FOURCC(a, b, c, d)  ((uint32_t)(((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d)))
+
+static const uint32_t kBoxMoov = LXY_FOURCC('m', 'o', 'o', 'v');
+static const uint32_t kBoxMvhd = LXY_FOURCC('m', 'v', 'h', 'd');
+static const uint32_t kBoxTrak = LXY_FOURCC('t', 'r', 'a', 'k');
+static const uint32_t kBoxMdia = LXY_FOURCC('m', 'd', 'i', 'a');
+static const uint32_t kBoxMdhd = LXY_FOURCC('m', 'd', 'h', 'd');
+static const uint32_t kBoxHdlr = LXY_FOURCC('h', 'd', 'l', 'r');
+static const uint32_t kBoxMinf = LXY_FOURCC('m', 'i', 'n', 'f');
+static const uint32_t kBoxStbl = LXY_FOURCC('s', 't', 'b', 'l');
+static const uint32_t kBoxStts = LXY_FOURCC('s', 't', 't', 's');
+static const uint32_t kBoxStss = LXY_FOURCC('s', 't', 's', 's');
+static const uint32_t kBoxStsc = LXY_FOURCC('s', 't', 's', 'c');
+static const uint32_t kBoxStsz = LXY_FOURCC('s', 't', 's', 'z');
+static const uint32_t kBoxStz2 = LXY_FOURCC('s', 't', 'z', '2');
+static const uint32_t kBoxStco = LXY_FOURCC('s', 't', 'c', 'o');
+static const uint32_t kBoxCo64 = LXY_FOURCC('c', 'o', '6', '4');
+static const uint32_t kHandlerVideo = LXY_FOURCC('v', 'i', 'd', 'e');
+static const uint32_t kHandlerSound = LXY_FOURCC('s', 'o', 'u', 'n');
+
+#pragma mark - Box
+
+static inline uint16_t p_be16(const uint8_t *p)
+{
+    return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+static inline uint32_t p_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline uint64_t p_be64(const uint8_t *p)
+{
+    return ((uint64_t)p_be32(p) << 32) | p_be32(p + 4);
+}
+
+/*
+ * read the box header at *cursor, and move *cursor to the next box.
+ * size == 1 means a 64 bit largesize follows, size == 0 means the box extends to @end.
+ * return NO if there is no complete box header before @end, or the box is malformed.
+ */
+static BOOL p_nextBox(const uint8_t *bytes, uint64_t end, uint64_t *cursor, uint32_t *type, uint64_t *payloadOffset, uint64_t *payloadEnd)
+{
+    uint64_t offset = *cursor;
+    if (offset > end || end - offset < 8) {
+        return NO;
+    }
+
+    uint64_t size = p_be32(bytes + offset);
+    uint64_t headerSize = 8;
+    if (size == 1) {
+        if (end - offset < 16) {
+            return NO;
+        }
+        size = p_be64(bytes + offset + 8);
+        headerSize = 16;
+    } else if (size == 0) {
+        size = end - offset;
+    }
+
+    if (size < headerSize || size > end - offset) {
+        return NO;
+    }
+
+    *type = p_be32(bytes + offset + 4);
+    *payloadOffset = offset + headerSize;
+    *payloadEnd = offset + size;
+    *cursor = offset + size;
+    return YES;
+}
+
+#pragma mark - Sample Table
+
+// raw sample tables of a track. all pointers point into the moov data, right after the entry count
+typedef struct {
+    uint32_t handler;
+    uint32_t timescale;
+    uint64_t duration;
+
+    const uint8_t *stts;            // (sample_count, sample_delta)
+    uint32_t sttsCount;
+    const uint8_t *stss;            // sample_number, 1 based. NULL means every sample is a sync sample
+    uint32_t stssCount;
+    const uint8_t *stsc;            // (first_chunk, samples_per_chunk, sample_description_index)
+    uint32_t stscCount;
+    const uint8_t *stsz;            // entry sizes, NULL if all samples have stszConstantSize
+    uint32_t stszConstantSize;
+    uint32_t stszFieldSize;         // bits per entry: 32 for stsz, 4 / 8 / 16 for stz2
+    uint32_t sampleCount;
+    const uint8_t *stco;            // chunk offsets
+    uint32_t chunkOffsetSize;       // 4 for stco, 8 for co64
+    uint32_t chunkCount;
+} LXYMP4SampleTable;
+
+// return NO to stop
+typedef BOOL (*LXYMP4SampleCallback)(void *context, uint64_t offset, uint32_t size, uint64_t decodeTime, BOOL isSync);
+
+// full box payload: version(1) flags(3) entry_count(4) entries. return the entries with @entrySize validated
+static const uint8_t *p_tableEntries(const uint8_t *bytes, uint64_t payloadOffset, uint64_t payloadEnd, uint64_t entrySize, uint32_t *count)
+{
+    if (payloadEnd - payloadOffset < 8) {
+        return NULL;
+    }
+
+    uint32_t entryCount = p_be32(bytes + payloadOffset + 4);
+    if ((payloadEnd - payloadOffset - 8) / entrySize < entryCount) {
+        return NULL;
+    }
+
+    *count = entryCount;
+    return bytes + payloadOffset + 8;
+}
+
+static BOOL p_parseStbl(const uint8_t *bytes, uint64_t start, uint64_t end, LXYMP4SampleTable *table)
+{
+    uint64_t cursor = start, payloadOffset = 0, payloadEnd = 0;
+    uint32_t type = 0;
+    while (p_nextBox(bytes, end, &cursor, &type, &payloadOffset, &payloadEnd)) {
+        uint64_t payloadLength = payloadEnd - payloadOffset;
+        if (type == kBoxStts) {
+            table->stts = p_tableEntries(bytes, payloadOffset, payloadEnd, 8, &table->sttsCount);
+            if (!table->stts) {
+                return NO;
+            }
+        } else if (type == kBoxStss) {
+            table->stss = p_tableEntries(bytes, payloadOffset, payloadEnd, 4, &table->stssCount);
+            if (!table->stss) {
+                return NO;
+            }
+        } else if (type == kBoxStsc) {
+            table->stsc = p_tableEntries(bytes, payloadOffset, payloadEnd, 12, &table->stscCount);
+            if (!table->stsc) {
+                return NO;
+            }
+        } else if (type == kBoxStco || type == kBoxCo64) {
+            table->chunkOffsetSize = (type == kBoxStco) ? 4 : 8;
+            table->stco = p_tableEntries(bytes, payloadOffset, payloadEnd, table->chunkOffsetSize, &table->chunkCount);
+            if (!table->stco) {
+                return NO;
+            }
+        } else if (type == kBoxStsz || type == kBoxStz2) {
+            // version(1) flags(3) sample_size(4) | reserved(3) field_size(1), sample_count(4)
+            if (payloadLength < 12) {
+                return NO;
+            }
+            table->sampleCount = p_be32(bytes + payloadOffset + 8);
+            if (type == kBoxStsz) {
+                table->stszConstantSize = p_be32(bytes + payloadOffset + 4);
+                table->stszFieldSize = 32;
+            } else {
+                table->stszConstantSize = 0;
+                table->stszFieldSize = bytes[payloadOffset + 7];
+                if (table->stszFieldSize != 4 && table->stszFieldSize != 8 && table->stszFieldSize != 16) {
+                    return NO;
+                }
+            }
+            if (table->stszConstantSize == 0) {
+                if ((payloadLength - 12) * 8 / table->stszFieldSize < table->sampleCount) {
+                    return NO;
+                }
+                table->stsz = bytes + payloadOffset + 12;
+            }
+        }
+    }
+
+    return table->stsc && table->stco && table->sampleCount > 0;
+}
+
+static BOOL p_parseTrak(const uint8_t *bytes, uint64_t start, uint64_t end, LXYMP4SampleTable *table)
+{
+    uint64_t cursor = start, payloadOffset = 0, payloadEnd = 0;
+    uint32_t type = 0;
+    BOOL hasTables = NO;
+    while (p_nextBox(bytes, end, &cursor, &type, &payloadOffset, &payloadEnd)) {
+        if (type == kBoxMdia || type == kBoxMinf) {
+            // containers
+            hasTables = p_parseTrak(bytes, payloadOffset, payloadEnd, table) || hasTables;
+        } else if (type == kBoxMdhd) {
+            uint64_t payloadLength = payloadEnd - payloadOffset;
+            if (payloadLength >= 24 && bytes[payloadOffset] == 0) {
+                table->timescale = p_be32(bytes + payloadOffset + 12);
+                table->duration = p_be32(bytes + payloadOffset + 16);
+            } else if (payloadLength >= 36 && bytes[payloadOffset] == 1) {
+                table->timescale = p_be32(bytes + payloadOffset + 20);
+                table->duration = p_be64(bytes + payloadOffset + 24);
+            }
+        } else if (type == kBoxHdlr) {
+            if (payloadEnd - payloadOffset >= 12) {
+                table->handler = p_be32(bytes + payloadOffset + 8);
+            }
+        } else if (type == kBoxStbl) {
+            hasTables = p_parseStbl(bytes, payloadOffset, payloadEnd, table);
+        }
+    }
+
+    return hasTables;
+}
+
+static inline uint32_t p_sampleSize(const LXYMP4SampleTable *table, uint32_t index)
+{
+    if (!table->stsz) {
+        return table->stszConstantSize;
+    }
+
+    switch (table->stszFieldSize) {
+        case 32:
+            return p_be32(table->stsz + 4 * (uint64_t)index);
+        case 16:
+            return p_be16(table->stsz + 2 * (uint64_t)index);
+        case 8:
+            return table->stsz[index];
+        default: {
+            uint8_t byte = table->stsz[index / 2];
+            return (index % 2 == 0) ? (byte >> 4) : (byte & 0x0F);
+        }
+    }
+}
+
+static inline uint64_t p_chunkOffset(const LXYMP4SampleTable *table, uint32_t chunk)
+{
+    if (table->chunkOffsetSize == 8) {
+        return p_be64(table->stco + 8 * (uint64_t)chunk);
+    }
+    return p_be32(table->stco + 4 * (uint64_t)chunk);
+}
+
+// walk chunks (stco + stsc), sizes (stsz), times (stts) and sync samples (stss) side by side
+static void p_enumerateSamples(const LXYMP4SampleTable *table, LXYMP4SampleCallback callback, void *context)
+{
+    uint32_t sampleIndex = 0;
+    uint32_t stscEntry = 0;
+    uint32_t sttsEntry = 0;
+    uint32_t sttsRemaining = table->sttsCount > 0 ? p_be32(table->stts) : 0;
+    uint32_t stssEntry = 0;
+    uint64_t decodeTime = 0;
+
+    for (uint32_t chunk = 0; chunk < table->chunkCount && sampleIndex < table->sampleCount; ++chunk) {
+        while (stscEntry + 1 < table->stscCount && p_be32(table->stsc + 12 * (stscEntry + 1)) <= chunk + 1) {
+            ++stscEntry;
+        }
+        uint32_t samplesPerChunk = table->stscCount > 0 ? p_be32(table->stsc + 12 * stscEntry + 4) : 0;
+
+        uint64_t offset = p_chunkOffset(table, chunk);
+        for (uint32_t i = 0; i < samplesPerChunk && sampleIndex < table->sampleCount; ++i) {
+            uint32_t size = p_sampleSize(table, sampleIndex);
+
+            while (sttsRemaining == 0 && sttsEntry + 1 < table->sttsCount) {
+                ++sttsEntry;
+                sttsRemaining = p_be32(table->stts + 8 * sttsEntry);
+            }
+            uint32_t delta = sttsRemaining > 0 ? p_be32(table->stts + 8 * sttsEntry + 4) : 0;
+
+            BOOL isSync = YES;
+            if (table->stss) {
+                while (stssEntry < table->stssCount && p_be32(table->stss + 4 * stssEntry) < sampleIndex + 1) {
+                    ++stssEntry;
+                }
+                isSync = stssEntry < table->stssCount && p_be32(table->stss + 4 * stssEntry) == sampleIndex + 1;
+            }
+
+            if (!callback(context, offset, size, decodeTime, isSync)) {
+                return;
+            }
+
+            decodeTime += delta;
+            if (sttsRemaining > 0) {
+                --sttsRemaining;
+            }
+            offset += size;
+            ++sampleIndex;
+        }
+    }
+}
+
+typedef struct {
+    uint64_t timeLimit;             // in the track timescale
+    BOOL needsSync;                 // keep going until a sync sample is included
+    uint64_t byteEnd;
+} LXYMP4ByteEndContext;
+
+static BOOL p_byteEndCallback(void *context, uint64_t offset, uint32_t size, uint64_t decodeTime, BOOL isSync)
+{
+    LXYMP4ByteEndContext *byteEndContext = (LXYMP4ByteEndContext *)context;
+    if (decodeTime >= byteEndContext->timeLimit && !byteEndContext->needsSync) {
+        return NO;
+    }
+
+    if (isSync) {
+        byteEndContext->needsSync = NO;
+    }
+    byteEndContext->byteEnd = MAX(byteEndContext->byteEnd, offset + size);
+    return YES;
+}
+
+static uint64_t p_byteEndForDuration(const LXYMP4SampleTable *table, double seconds)
+{
+    LXYMP4ByteEndContext context = {0};
+    double timeLimit = seconds * table->timescale;
+    context.timeLimit = timeLimit >= (double)UINT64_MAX ? UINT64_MAX : (uint64_t)ceil(timeLimit);
+    context.needsSync = (table->handler == kHandlerVideo);
+    context.byteEnd = 0;
+
+    p_enumerateSamples(table, p_byteEndCallback, &context);
+    return context.byteEnd;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoMP4Track ()
+{
+    LXYMP4SampleTable _table;
+}
+
+// the moov data which _table points into
+@property (nonatomic, strong) NSData *moovData;
+
+- (instancetype)initWithMoovData:(NSData *)moovData table:(LXYMP4SampleTable)table;
+
+@end
+
+@implementation LXYVideoMP4Track
+
+- (instancetype)initWithMoovData:(NSData *)moovData table:(LXYMP4SampleTable)table
+{
+    self = [super init];
+    if (self) {
+        _moovData = moovData;
+        _table = table;
+    }
+
+    return self;
+}
+
+- (NSString *)handlerType
+{
+    return _table.handler == kHandlerVideo ? @"vide" : @"soun";
+}
+
+- (uint32_t)timescale
+{
+    return _table.timescale;
+}
+
+- (NSTimeInterval)duration
+{
+    return _table.timescale > 0 ? (NSTimeInterval)_table.duration / _table.timescale : 0;
+}
+
+- (NSUInteger)sampleCount
+{
+    return _table.sampleCount;
+}
+
+- (uint64_t)byteEndForPlayDuration:(NSTimeInterval)duration
+{
+    return p_byteEndForDuration(&_table, duration);
+}
+
+typedef void(^LXYMP4SampleBlock)(uint64_t offset, uint32_t size, NSTimeInterval decodeTime, BOOL isSync, BOOL *stop);
+
+typedef struct {
+    __unsafe_unretained LXYMP4SampleBlock block;
+    double timescale;
+} LXYMP4BlockContext;
+
+static BOOL p_blockCallback(void *context, uint64_t offset, uint32_t size, uint64_t decodeTime, BOOL isSync)
+{
+    LXYMP4BlockContext *blockContext = (LXYMP4BlockContext *)context;
+    BOOL stop = NO;
+    blockContext->block(offset, size, decodeTime / blockContext->timescale, isSync, &stop);
+    return !stop;
+}
+
+- (void)enumerateSamplesUsingBlock:(LXYMP4SampleBlock)block
+{
+    if (!block || _table.timescale == 0) {
+        return;
+    }
+
+    LXYMP4BlockContext context = { block, (double)_table.timescale };
+    p_enumerateSamples(&_table, p_blockCallback, &context);
+}
+
+@end
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoMP4Movie ()
+
+@property (nonatomic, copy, readwrite) NSArray<LXYVideoMP4Track *> *tracks;
+@property (nonatomic, assign, readwrite) NSTimeInterval duration;
+
+@end
+
+@implementation LXYVideoMP4Movie
+
+- (uint64_t)byteEndForPlayDuration:(NSTimeInterval)duration
+{
+    uint64_t byteEnd = 0;
+    for (LXYVideoMP4Track *track in self.tracks) {
+        byteEnd = MAX(byteEnd, [track byteEndForPlayDuration:duration]);
+    }
+
+    return byteEnd;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"duration = %.3f, tracks = %@", self.duration, @(self.tracks.count)];
+}
+
+@end
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation LXYVideoMP4Parser
+
++ (LXYVideoMP4ScanResult)scanTopLevelBoxesInData:(NSData *)data
+                                      dataOffset:(uint64_t)dataOffset
+                                      fileLength:(uint64_t)fileLength
+                                       moovRange:(NSRange *)moovRange
+                                   nextBoxOffset:(uint64_t *)nextBoxOffset
+{
+    const uint8_t *bytes = data.bytes;
+    uint64_t length = data.length;
+    uint64_t cursor = 0;
+
+    while (YES) {
+        if (nextBoxOffset) {
+            *nextBoxOffset = dataOffset + cursor;
+        }
+        if (length - cursor < 8) {
+            return LXYVideoMP4ScanResultNeedMoreData;
+        }
+
+        // the box itself may extend beyond @data, so only the header is read here
+        uint64_t size = p_be32(bytes + cursor);
+        uint32_t type = p_be32(bytes + cursor + 4);
+        uint64_t headerSize = 8;
+        if (size == 1) {
+            if (length - cursor < 16) {
+                return LXYVideoMP4ScanResultNeedMoreData;
+            }
+            size = p_be64(bytes + cursor + 8);
+            headerSize = 16;
+        } else if (size == 0) {
+            if (fileLength == 0) {
+                return LXYVideoMP4ScanResultInvalid;
+            }
+            size = fileLength - (dataOffset + cursor);
+        }
+
+        if (size < headerSize || (fileLength != 0 && dataOffset + cursor + size > fileLength)) {
+            return LXYVideoMP4ScanResultInvalid;
+        }
+
+        if (type == kBoxMoov) {
+            if (moovRange) {
+                *moovRange = NSMakeRange((NSUInteger)(dataOffset + cursor), (NSUInteger)size);
+            }
+            return LXYVideoMP4ScanResultFoundMoov;
+        }
+
+        if (size > length - cursor) {
+            if (nextBoxOffset) {
+                *nextBoxOffset = dataOffset + cursor + size;
+            }
+            return LXYVideoMP4ScanResultNeedMoreData;
+        }
+        cursor += size;
+    }
+}
+
++ (LXYVideoMP4Movie *)movieWithMoovData:(NSData *)data error:(NSError * __autoreleasing *)error
+{
+    const uint8_t *bytes = data.bytes;
+    uint64_t cursor = 0, payloadOffset = 0, payloadEnd = 0;
+    uint32_t type = 0;
+    if (!p_nextBox(bytes, data.length, &cursor, &type, &payloadOffset, &payloadEnd) || type != kBoxMoov) {
+        if (error) {
+            *error = LXYError(LXYVideoCacheErrorMP4Invalid, @"moov box not found");
+        }
+        return nil;
+    }
+
+    NSTimeInterval duration = 0;
+    NSMutableArray<LXYVideoMP4Track *> *tracks = [NSMutableArray array];
+
+    cursor = payloadOffset;
+    uint64_t moovEnd = payloadEnd;
+    while (p_nextBox(bytes, moovEnd, &cursor, &type, &payloadOffset, &payloadEnd)) {
+        if (type == kBoxMvhd) {
+            // version(1) flags(3) creation modification timescale(4) duration
+            uint64_t payloadLength = payloadEnd - payloadOffset;
+            if (payloadLength >= 20 && bytes[payloadOffset] == 0 && p_be32(bytes + payloadOffset + 12) > 0) {
+                duration = (NSTimeInterval)p_be32(bytes + payloadOffset + 16) / p_be32(bytes + payloadOffset + 12);
+            } else if (payloadLength >= 32 && bytes[payloadOffset] == 1 && p_be32(bytes + payloadOffset + 20) > 0) {
+                duration = (NSTimeInterval)p_be64(bytes + payloadOffset + 24) / p_be32(bytes + payloadOffset + 20);
+            }
+        } else if (type == kBoxTrak) {
+            LXYMP4SampleTable table;
+            memset(&table, 0, sizeof(table));
+            if (   p_parseTrak(bytes, payloadOffset, payloadEnd, &table)
+                && table.timescale > 0
+                && (table.handler == kHandlerVideo || table.handler == kHandlerSound)) {
+                [tracks addObject:[[LXYVideoMP4Track alloc] initWithMoovData:data table:table]];
+            }
+        }
+    }
+
+    if (tracks.count == 0) {
+        if (error) {
+            *error = LXYError(LXYVideoCacheErrorMP4Invalid, @"no playable track in moov");
+        }
+        return nil;
+    }
+
+    LXYVideoMP4Movie *movie = [LXYVideoMP4Movie new];
+    movie.tracks = tracks;
+    movie.duration = duration;
+    for (LXYVideoMP4Track *track in tracks) {
+        movie.duration = MAX(movie.duration, track.duration);
+    }
+
+    return movie;
+}
+
+@end
@@ -1,5 +1,6 @@
 
 #import "LXYVideoObjectPool.h"
+#import "LXYVideoLockProfiler.h"
 
 @interface LXYVideoObjectPool<__covariant ObjectType> ()
 
@@ -31,8 +32,11 @@
 
 - (id)getObject
 {
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
     @synchronized(self)
     {
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoObjectPool", waitStart);
+        
         if (self.pool.count > 0) {
             id object = self.pool.lastObject;
             [self.pool removeLastObject];
@@ -45,8 +49,11 @@
 
 - (void)returnObject:(id)object
 {
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
     @synchronized(self)
     {
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoObjectPool", waitStart);
+        
         if (self.pool.count < self.maxCount) {
             [self.pool addObject:object];
         }
@@ -35,6 +35,8 @@ typedef NS_ENUM(NSInteger, LXYVideoPlayerError) {
     LXYVideoPlayerErrorAssetNil,
     /// playback error
     LXYVideoPlayerErrorPlaybackError,
+    /// range request not honored by server
+    LXYVideoPlayerErrorRangeNotSatisfied,
     
     /// cache check failed
     LXYVideoCacheErrorCheckFailed = 6000,
@@ -56,9 +58,29 @@ typedef NS_ENUM(NSInteger, LXYVideoPlayerError) {
     LXYVideoCacheErrorReadFileMetaNotExist,
     /// cache read file failed
     LXYVideoCacheErrorReadFileFailed,
+    /// malformed MP4 box
+    LXYVideoCacheErrorMP4Invalid,
+    /// malformed cache pack
+    LXYVideoCacheErrorPackInvalid,
+    /// cache file extent not reserved
+    LXYVideoCacheErrorReserveFailed,
+    
+    /// trace create file failed
+    LXYVideoTraceErrorCreateFileFailed = 7000,
+    /// malformed trace
+    LXYVideoTraceErrorInvalid,
 };
 
+/// cache key of a play url string: URLStringToCacheKey of LXYVideoDiskCacheConfiguration, then LXYVideoCacheKeyWithString().
+/// interned, so that the same url is hashed once
 FOUNDATION_EXPORT NSString * LXYVideoURLStringToCacheKey(NSString *urlString);
+/// 128-bit MurmurHash3 of the UTF-8 string, in 32 hex digits. not interned
+FOUNDATION_EXPORT NSString * LXYVideoCacheKeyWithString(NSString *str);
+/// the string an interned cache key was hashed from: the url string, mapped by URLStringToCacheKey. nil if @key is not interned
+FOUNDATION_EXPORT NSString * LXYVideoCacheKeySourceString(NSString *key);
+/// drop the interned cache keys, e.g. when URLStringToCacheKey changes
+FOUNDATION_EXPORT void LXYVideoPurgeInternedCacheKeys(void);
+/// MD5 in 32 hex digits, which the cache keys were before the key version 2
 FOUNDATION_EXPORT NSString * LXY_MD5(NSString *str);
 FOUNDATION_EXPORT NSError * LXYError(NSInteger code, NSString *desc);
 
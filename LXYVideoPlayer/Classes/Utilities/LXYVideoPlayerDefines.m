@@ -1,6 +1,7 @@
 
 #import "LXYVideoPlayerDefines.h"
 #import "LXYVideoDiskCacheConfiguration.h"
+#import "LXYVideoLockProfiler.h"
 #import <CommonCrypto/CommonDigest.h>
 
 NSString * const LXYVideoPlayerErrorDomain           = @"LXYVideoPlayerErrorDomain";
@@ -32,14 +33,214 @@ NSString * LXY_MD5(NSString *str)
             ];
 }
 
+static inline uint64_t p_rotl64(uint64_t x, int8_t r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t p_fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// MurmurHash3_x64_128 of Austin Appleby, public domain. blocks are read little endian, as on arm64 and x86_64
+static void p_murmurHash3_x64_128(const uint8_t *data, size_t length, uint32_t seed, uint64_t out[2])
+{
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+    
+    size_t blockCount = length / 16;
+    for (size_t i = 0; i < blockCount; ++i) {
+        uint64_t k1, k2;
+        memcpy(&k1, data + i * 16, sizeof(k1));
+        memcpy(&k2, data + i * 16 + 8, sizeof(k2));
+        
+        k1 *= c1; k1 = p_rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = p_rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+        
+        k2 *= c2; k2 = p_rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = p_rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+    
+    const uint8_t *tail = data + blockCount * 16;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    switch (length & 15) {
+        case 15: k2 ^= (uint64_t)tail[14] << 48;    // fall through
+        case 14: k2 ^= (uint64_t)tail[13] << 40;    // fall through
+        case 13: k2 ^= (uint64_t)tail[12] << 32;    // fall through
+        case 12: k2 ^= (uint64_t)tail[11] << 24;    // fall through
+        case 11: k2 ^= (uint64_t)tail[10] << 16;    // fall through
+        case 10: k2 ^= (uint64_t)tail[9] << 8;      // fall through
+        case 9:
+            k2 ^= (uint64_t)tail[8];
+            k2 *= c2; k2 = p_rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+            // fall through
+        case 8: k1 ^= (uint64_t)tail[7] << 56;      // fall through
+        case 7: k1 ^= (uint64_t)tail[6] << 48;      // fall through
+        case 6: k1 ^= (uint64_t)tail[5] << 40;      // fall through
+        case 5: k1 ^= (uint64_t)tail[4] << 32;      // fall through
+        case 4: k1 ^= (uint64_t)tail[3] << 24;      // fall through
+        case 3: k1 ^= (uint64_t)tail[2] << 16;      // fall through
+        case 2: k1 ^= (uint64_t)tail[1] << 8;       // fall through
+        case 1:
+            k1 ^= (uint64_t)tail[0];
+            k1 *= c1; k1 = p_rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+            break;
+        default:
+            break;
+    }
+    
+    h1 ^= length;
+    h2 ^= length;
+    h1 += h2;
+    h2 += h1;
+    h1 = p_fmix64(h1);
+    h2 = p_fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+    
+    out[0] = h1;
+    out[1] = h2;
+}
+
+NSString * LXYVideoCacheKeyWithString(NSString *str)
+{
+    if (LXYVideo_isEmptyString(str)) {
+        return str;
+    }
+    
+    const char *cStr = [str UTF8String];
+    uint64_t hash[2];
+    p_murmurHash3_x64_128((const uint8_t *)cStr, strlen(cStr), 0, hash);
+    
+    // the bytes of h1 then h2, little endian, as the reference implementation outputs them
+    static const char kHexDigits[] = "0123456789abcdef";
+    char hex[32];
+    for (NSUInteger i = 0; i < 16; ++i) {
+        uint8_t byte = (uint8_t)(hash[i / 8] >> (i % 8 * 8));
+        hex[i * 2] = kHexDigits[byte >> 4];
+        hex[i * 2 + 1] = kHexDigits[byte & 0x0F];
+    }
+    
+    return [[NSString alloc] initWithBytes:hex length:sizeof(hex) encoding:NSASCIIStringEncoding];
+}
+
+// the interned keys: two generations of <url string, key>. a hit in the old one is moved to the young one, and
+// the old one is dropped when the young one is full, so that the table is bounded and keeps the recent urls
+static const NSUInteger kLXYCacheKeyInternCapacity = 512;
+static pthread_mutex_t s_internMutex = PTHREAD_MUTEX_INITIALIZER;
+static NSMutableDictionary<NSString *, NSString *> *s_internYoung = nil;
+static NSMutableDictionary<NSString *, NSString *> *s_internOld = nil;
+// <key, source string> of the keys in the generation of the same age
+static NSMutableDictionary<NSString *, NSString *> *s_internSourceYoung = nil;
+static NSMutableDictionary<NSString *, NSString *> *s_internSourceOld = nil;
+
+// @sourceString: what @key was hashed from, if @key is given
+static NSString * p_internCacheKey(NSString *urlString, NSString *key, NSString *sourceString)
+{
+    NSString *internedKey = nil;
+    
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
+    pthread_mutex_lock(&s_internMutex);
+    {
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoCacheKeyIntern", waitStart);
+        
+        internedKey = s_internYoung[urlString];
+        if (!internedKey) {
+            internedKey = s_internOld[urlString];
+            if (internedKey) {
+                sourceString = s_internSourceOld[internedKey];
+            } else {
+                internedKey = key;
+            }
+            
+            if (internedKey) {
+                if (s_internYoung.count >= kLXYCacheKeyInternCapacity) {
+                    s_internOld = s_internYoung;
+                    s_internSourceOld = s_internSourceYoung;
+                    s_internYoung = nil;
+                    s_internSourceYoung = nil;
+                }
+                if (!s_internYoung) {
+                    s_internYoung = [NSMutableDictionary dictionaryWithCapacity:kLXYCacheKeyInternCapacity];
+                    s_internSourceYoung = [NSMutableDictionary dictionaryWithCapacity:kLXYCacheKeyInternCapacity];
+                }
+                s_internYoung[urlString] = internedKey;
+                s_internSourceYoung[internedKey] = sourceString;
+            }
+        }
+    }
+    pthread_mutex_unlock(&s_internMutex);
+    
+    return internedKey;
+}
+
+void LXYVideoPurgeInternedCacheKeys(void)
+{
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
+    pthread_mutex_lock(&s_internMutex);
+    {
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoCacheKeyIntern", waitStart);
+        
+        s_internYoung = nil;
+        s_internOld = nil;
+        s_internSourceYoung = nil;
+        s_internSourceOld = nil;
+    }
+    pthread_mutex_unlock(&s_internMutex);
+}
+
+NSString * LXYVideoCacheKeySourceString(NSString *key)
+{
+    if (LXYVideo_isEmptyString(key)) {
+        return nil;
+    }
+    
+    NSString *sourceString = nil;
+    
+    uint64_t waitStart = LXYVideoLockProfilerTimestamp();
+    pthread_mutex_lock(&s_internMutex);
+    {
+        LXY_VIDEO_LOCK_HELD(@"LXYVideoCacheKeyIntern", waitStart);
+        
+        sourceString = s_internSourceYoung[key] ? : s_internSourceOld[key];
+    }
+    pthread_mutex_unlock(&s_internMutex);
+    
+    return sourceString;
+}
+
 NSString * LXYVideoURLStringToCacheKey(NSString *urlString)
 {
+    if (LXYVideo_isEmptyString(urlString)) {
+        return urlString;
+    }
+    
+    NSString *key = p_internCacheKey(urlString, nil, nil);
+    if (key) {
+        return key;
+    }
+    
     NSString *cacheKey = urlString;
     if ([LXYVideoDiskCacheConfiguration sharedInstance].URLStringToCacheKey) {
         cacheKey = [LXYVideoDiskCacheConfiguration sharedInstance].URLStringToCacheKey(urlString);
     }
     
-    return LXY_MD5(cacheKey);
+    key = LXYVideoCacheKeyWithString(cacheKey);
+    if (LXYVideo_isEmptyString(key)) {
+        return key;
+    }
+    
+    // the key interned by a concurrent miss wins. the source is kept for the key migration of the disk cache
+    return p_internCacheKey(urlString, key, cacheKey);
 }
 
 NSError * LXYError(NSInteger code, NSString *desc)
@@ -0,0 +1,36 @@
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * hashed timer wheel for expiring a large number of keys at coarse granularity.
+ * schedule / cancel are O(1), and the timer only runs while there are keys scheduled.
+ * all methods can be called on any thread. @expireBlock is executed on the wheel's private queue.
+ */
+@interface LXYVideoTimerWheel : NSObject
+
+/**
+ * @param tickInterval  the wheel granularity. second
+ * @param slotCount     number of slots. deadlines beyond tickInterval * slotCount take extra rounds
+ * @param expireBlock   block to execute with the expired keys
+ */
+- (instancetype)initWithTickInterval:(NSTimeInterval)tickInterval
+                           slotCount:(NSUInteger)slotCount
+                         expireBlock:(void(^)(NSArray *keys))expireBlock;
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
+
+/**
+ * @brief expire @key after @interval. reschedule if @key is scheduled already.
+ */
+- (void)scheduleKey:(id<NSCopying>)key afterInterval:(NSTimeInterval)interval;
+
+/**
+ * @brief remove @key from the wheel without expiring it
+ */
+- (void)cancelKey:(id<NSCopying>)key;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,188 @@
+
+#import "LXYVideoTimerWheel.h"
+
+@interface LXYVideoTimerWheelEntry : NSObject
+
+// slot index in the wheel
+@property (nonatomic, assign) NSUInteger slot;
+// remaining full rounds before expiring
+@property (nonatomic, assign) NSUInteger rounds;
+
+@end
+
+@implementation LXYVideoTimerWheelEntry
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoTimerWheel ()
+
+// wheel granularity
+@property (nonatomic, assign) NSTimeInterval tickInterval;
+
+// keys in each slot
+@property (nonatomic, strong) NSArray<NSMutableSet *> *slots;
+
+// <key, entry>
+@property (nonatomic, strong) NSMutableDictionary<id, LXYVideoTimerWheelEntry *> *entries;
+
+// current slot
+@property (nonatomic, assign) NSUInteger cursor;
+
+// the serial queue on which the wheel is operated
+@property (nonatomic, strong) dispatch_queue_t queue;
+
+// tick timer. only exists when there are keys scheduled
+@property (nonatomic, strong) dispatch_source_t _Nullable timer;
+
+// expire callback
+@property (nonatomic, copy) void (^expireBlock)(NSArray *keys);
+
+@end
+
+@implementation LXYVideoTimerWheel
+
+- (instancetype)initWithTickInterval:(NSTimeInterval)tickInterval
+                           slotCount:(NSUInteger)slotCount
+                         expireBlock:(void(^)(NSArray *keys))expireBlock
+{
+    self = [super init];
+    if (self) {
+        _tickInterval = MAX(tickInterval, 0.01);
+
+        NSMutableArray<NSMutableSet *> *slots = [NSMutableArray arrayWithCapacity:MAX(slotCount, 1)];
+        for (NSUInteger i = 0; i < MAX(slotCount, 1); ++i) {
+            [slots addObject:[NSMutableSet set]];
+        }
+        _slots = [slots copy];
+        _entries = [NSMutableDictionary dictionary];
+        _cursor = 0;
+        _expireBlock = [expireBlock copy];
+        _queue = dispatch_queue_create("com.LXYVideoPlayer.LXYVideoTimerWheel", DISPATCH_QUEUE_SERIAL);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_timer) {
+        dispatch_source_cancel(_timer);
+        _timer = nil;
+    }
+}
+
+#pragma mark - Public
+
+- (void)scheduleKey:(id<NSCopying>)key afterInterval:(NSTimeInterval)interval
+{
+    if (!key) {
+        return;
+    }
+
+    dispatch_async(self.queue, ^{
+        [self _scheduleKey:key afterInterval:interval];
+    });
+}
+
+- (void)cancelKey:(id<NSCopying>)key
+{
+    if (!key) {
+        return;
+    }
+
+    dispatch_async(self.queue, ^{
+        [self _cancelKey:key];
+    });
+}
+
+#pragma mark - Private
+
+- (void)_scheduleKey:(id<NSCopying>)key afterInterval:(NSTimeInterval)interval
+{
+    [self _cancelKey:key];
+
+    NSUInteger slotCount = self.slots.count;
+    NSUInteger ticks = MAX((NSUInteger)ceil(interval / self.tickInterval), 1);
+
+    LXYVideoTimerWheelEntry *entry = [LXYVideoTimerWheelEntry new];
+    entry.slot = (self.cursor + ticks) % slotCount;
+    entry.rounds = (ticks - 1) / slotCount;
+
+    [self.slots[entry.slot] addObject:key];
+    self.entries[key] = entry;
+
+    [self _startTimerIfNeeded];
+}
+
+- (void)_cancelKey:(id<NSCopying>)key
+{
+    LXYVideoTimerWheelEntry *entry = self.entries[key];
+    if (!entry) {
+        return;
+    }
+
+    [self.slots[entry.slot] removeObject:key];
+    [self.entries removeObjectForKey:key];
+
+    if (self.entries.count == 0) {
+        [self _stopTimer];
+    }
+}
+
+- (void)_tick
+{
+    self.cursor = (self.cursor + 1) % self.slots.count;
+
+    NSMutableSet *slot = self.slots[self.cursor];
+    NSMutableArray *expiredKeys = [NSMutableArray array];
+    for (id key in slot) {
+        LXYVideoTimerWheelEntry *entry = self.entries[key];
+        if (entry.rounds == 0) {
+            [expiredKeys addObject:key];
+        } else {
+            --entry.rounds;
+        }
+    }
+
+    if (expiredKeys.count == 0) {
+        return;
+    }
+
+    [slot minusSet:[NSSet setWithArray:expiredKeys]];
+    [self.entries removeObjectsForKeys:expiredKeys];
+
+    if (self.entries.count == 0) {
+        [self _stopTimer];
+    }
+
+    !self.expireBlock ? : self.expireBlock(expiredKeys);
+}
+
+- (void)_startTimerIfNeeded
+{
+    if (self.timer) {
+        return;
+    }
+
+    uint64_t interval = (uint64_t)(self.tickInterval * NSEC_PER_SEC);
+    self.timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.queue);
+    dispatch_source_set_timer(self.timer, dispatch_time(DISPATCH_TIME_NOW, interval), interval, interval / 10);
+
+    __weak typeof(self) weakSelf = self;
+    dispatch_source_set_event_handler(self.timer, ^{
+        [weakSelf _tick];
+    });
+    dispatch_resume(self.timer);
+}
+
+- (void)_stopTimer
+{
+    if (self.timer) {
+        dispatch_source_cancel(self.timer);
+        self.timer = nil;
+    }
+}
+
+@end
@@ -0,0 +1,98 @@
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * operations in a trace. the meaning of offset and length of each follows
+ */
+typedef NS_ENUM(uint8_t, LXYVideoTraceOp)
+{
+    LXYVideoTraceOpLoadingRequest = 1,      // data request of AVFoundation: requested offset, requested length
+    LXYVideoTraceOpContentInfoRequest,      // data request with a content information request: requested offset, requested length
+    LXYVideoTraceOpLoadingRequestCancel,    // cancelled data request: requested offset, requested length
+    LXYVideoTraceOpPrefetchEnqueue,         // prefetch: -, size. 0 for a duration prefetch
+    LXYVideoTraceOpPrefetchCancel,          // prefetch cancel. no key for a group or all: -, -
+    LXYVideoTraceOpCacheAppend,             // disk cache append: offset, length
+    LXYVideoTraceOpCacheRead,               // disk cache read: offset, length
+    LXYVideoTraceOpCacheTrim,               // disk cache trim: -, size
+    LXYVideoTraceOpCacheClear,              // disk cache clear. no key for all: -, -
+    LXYVideoTraceOpCount,
+};
+
+/**
+ * an operation read from a trace
+ */
+@interface LXYVideoTraceEvent : NSObject
+
+/// the operation
+@property (nonatomic, assign, readonly) LXYVideoTraceOp op;
+
+/// cache key. nil if the operation is not of one video
+@property (nonatomic, copy, readonly, nullable) NSString *key;
+
+/// time since the trace start. second
+@property (nonatomic, assign, readonly) NSTimeInterval timestamp;
+
+/// byte offset, see LXYVideoTraceOp
+@property (nonatomic, assign, readonly) uint64_t offset;
+
+/// byte length, see LXYVideoTraceOp
+@property (nonatomic, assign, readonly) uint64_t length;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * records loading requests, prefetches and disk cache operations into a compact binary trace,
+ * for replay by LXYVideoTraceReplayer of the Benchmark subspec.
+ *
+ * a record is a few varints encoded into a memory buffer under a lock, flushed to the file in background.
+ * a cache key is written once, and referred by index afterwards. nothing is done when not recording.
+ */
+@interface LXYVideoTraceRecorder : NSObject
+
+/// recording or not
+@property (nonatomic, assign, readonly, getter=isRecording) BOOL recording;
+
+/**
+ * @brief singleton
+ */
++ (instancetype)sharedInstance;
+
+/**
+ * @brief start recording into a new file at @path. the file is replaced if it exists
+ */
+- (BOOL)startRecordingToPath:(NSString *)path error:(NSError * __autoreleasing *)error;
+
+/**
+ * @brief flush and close the trace. It returns when the file is complete
+ */
+- (void)stopRecording;
+
+/**
+ * @brief decode the trace at @path. nil if it is not a trace
+ */
++ (NSArray<LXYVideoTraceEvent *> * _Nullable)eventsWithContentsOfFile:(NSString *)path error:(NSError * __autoreleasing *)error;
+
+@end
+
+/**
+ * @brief whether a trace is being recorded. read by LXY_VIDEO_TRACE_RECORD without a lock
+ */
+FOUNDATION_EXTERN BOOL LXYVideoTraceRecording;
+
+/**
+ * @brief record an operation. USE MACRO INSTEAD
+ */
+FOUNDATION_EXTERN void LXYVideoTraceRecord(LXYVideoTraceOp op, NSString * _Nullable key, uint64_t offset, uint64_t length);
+
+#define LXY_VIDEO_TRACE_RECORD(OP, KEY, OFFSET, LENGTH)                                     \
+    do {                                                                                    \
+        if (LXYVideoTraceRecording) {                                                       \
+            LXYVideoTraceRecord((OP), (KEY), (uint64_t)(OFFSET), (uint64_t)(LENGTH));      \
+        }                                                                                   \
+    } while (0)
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,292 @@
+
+#import "LXYVideoTraceRecorder.h"
+#import "LXYVideoPlayerDefines.h"
+
+/*
+ * trace file:
+ *      header: magic "LXYTRACE", version uint32 little endian, reserved uint32
+ *      records: op uint8, then varints
+ *          key definition (op 0): key index, UTF-8 length, UTF-8 bytes
+ *          operation: key index (0 for none), us since the previous operation, offset, length
+ */
+
+static const char kLXYTraceMagic[8] = {'L', 'X', 'Y', 'T', 'R', 'A', 'C', 'E'};
+static const uint32_t kLXYTraceVersion = 1;
+static const NSUInteger kLXYTraceHeaderLength = 16;
+static const uint8_t kLXYTraceOpKey = 0;
+// flushed to the file once the buffer reaches it
+static const NSUInteger kLXYTraceFlushLength = 64 * 1024;
+
+BOOL LXYVideoTraceRecording = NO;
+
+static pthread_mutex_t s_traceMutex = PTHREAD_MUTEX_INITIALIZER;
+static NSMutableData *s_traceBuffer = nil;
+static NSMutableDictionary<NSString *, NSNumber *> *s_traceKeyIndexes = nil;
+static NSTimeInterval s_traceLastTime = 0;
+static NSFileHandle *s_traceFileHandle = nil;
+static dispatch_queue_t s_traceWriteQueue = nil;
+
+static inline void p_appendVarint(NSMutableData *data, uint64_t value)
+{
+    uint8_t bytes[10];
+    NSUInteger count = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        bytes[count++] = value ? (byte | 0x80) : byte;
+    } while (value);
+    [data appendBytes:bytes length:count];
+}
+
+static inline BOOL p_readVarint(const uint8_t *bytes, NSUInteger length, NSUInteger *cursor, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (NSUInteger shift = 0; shift < 64 && *cursor < length; shift += 7) {
+        uint8_t byte = bytes[(*cursor)++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return YES;
+        }
+    }
+    
+    return NO;
+}
+
+// Attention: with s_traceMutex held
+static void p_flushBuffer(void)
+{
+    if (s_traceBuffer.length == 0 || !s_traceFileHandle) {
+        return;
+    }
+    
+    NSData *data = s_traceBuffer;
+    NSFileHandle *fileHandle = s_traceFileHandle;
+    s_traceBuffer = [NSMutableData dataWithCapacity:kLXYTraceFlushLength + 64];
+    dispatch_async(s_traceWriteQueue, ^{
+        @try {
+            [fileHandle writeData:data];
+        } @catch (NSException *exception) {
+            LXY_VIDEO_ERROR(@"trace write failed: %@", exception);
+        }
+    });
+}
+
+void LXYVideoTraceRecord(LXYVideoTraceOp op, NSString *key, uint64_t offset, uint64_t length)
+{
+    NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+    
+    pthread_mutex_lock(&s_traceMutex);
+    if (s_traceBuffer) {
+        uint64_t keyIndex = 0;
+        if (key) {
+            NSNumber *index = s_traceKeyIndexes[key];
+            if (!index) {
+                index = @(s_traceKeyIndexes.count + 1);
+                s_traceKeyIndexes[key] = index;
+                
+                NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+                [s_traceBuffer appendBytes:&kLXYTraceOpKey length:1];
+                p_appendVarint(s_traceBuffer, index.unsignedLongLongValue);
+                p_appendVarint(s_traceBuffer, keyData.length);
+                [s_traceBuffer appendData:keyData];
+            }
+            keyIndex = index.unsignedLongLongValue;
+        }
+        
+        // the callers race for the lock, keep the time monotonic
+        uint64_t delta = now > s_traceLastTime ? (uint64_t)((now - s_traceLastTime) * USEC_PER_SEC) : 0;
+        s_traceLastTime += delta / (double)USEC_PER_SEC;
+        
+        uint8_t opByte = op;
+        [s_traceBuffer appendBytes:&opByte length:1];
+        p_appendVarint(s_traceBuffer, keyIndex);
+        p_appendVarint(s_traceBuffer, delta);
+        p_appendVarint(s_traceBuffer, offset);
+        p_appendVarint(s_traceBuffer, length);
+        
+        if (s_traceBuffer.length >= kLXYTraceFlushLength) {
+            p_flushBuffer();
+        }
+    }
+    pthread_mutex_unlock(&s_traceMutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@interface LXYVideoTraceEvent ()
+
+@property (nonatomic, assign, readwrite) LXYVideoTraceOp op;
+@property (nonatomic, copy, readwrite, nullable) NSString *key;
+@property (nonatomic, assign, readwrite) NSTimeInterval timestamp;
+@property (nonatomic, assign, readwrite) uint64_t offset;
+@property (nonatomic, assign, readwrite) uint64_t length;
+
+@end
+
+@implementation LXYVideoTraceEvent
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"%.6f op = %@, key = %@, offset = %@, length = %@",
+            self.timestamp, @(self.op), self.key ?: @"-", @(self.offset), @(self.length)];
+}
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+@implementation LXYVideoTraceRecorder
+
++ (instancetype)sharedInstance
+{
+    static LXYVideoTraceRecorder *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instance = [LXYVideoTraceRecorder new];
+        s_traceWriteQueue = dispatch_queue_create("com.LXYVideoPlayer.LXYVideoTraceRecorder", DISPATCH_QUEUE_SERIAL);
+    });
+    
+    return instance;
+}
+
+#pragma mark - Public
+
+- (BOOL)isRecording
+{
+    return LXYVideoTraceRecording;
+}
+
+- (BOOL)startRecordingToPath:(NSString *)path error:(NSError * __autoreleasing *)error
+{
+    [self stopRecording];
+    
+    NSMutableData *header = [NSMutableData dataWithBytes:kLXYTraceMagic length:sizeof(kLXYTraceMagic)];
+    // version, then the reserved uint32
+    uint8_t version[8] = {kLXYTraceVersion & 0xFF, (kLXYTraceVersion >> 8) & 0xFF, (kLXYTraceVersion >> 16) & 0xFF, kLXYTraceVersion >> 24};
+    [header appendBytes:version length:sizeof(version)];
+    
+    if (![header writeToFile:path atomically:NO]) {
+        if (error) {
+            *error = LXYError(LXYVideoTraceErrorCreateFileFailed, path);
+        }
+        return NO;
+    }
+    
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:path];
+    if (!fileHandle) {
+        if (error) {
+            *error = LXYError(LXYVideoTraceErrorCreateFileFailed, path);
+        }
+        return NO;
+    }
+    [fileHandle seekToEndOfFile];
+    
+    pthread_mutex_lock(&s_traceMutex);
+    s_traceFileHandle = fileHandle;
+    s_traceBuffer = [NSMutableData dataWithCapacity:kLXYTraceFlushLength + 64];
+    s_traceKeyIndexes = [NSMutableDictionary dictionary];
+    s_traceLastTime = [NSProcessInfo processInfo].systemUptime;
+    LXYVideoTraceRecording = YES;
+    pthread_mutex_unlock(&s_traceMutex);
+    
+    LXY_VIDEO_INFO(@"trace recording started: %@", path);
+    
+    return YES;
+}
+
+- (void)stopRecording
+{
+    pthread_mutex_lock(&s_traceMutex);
+    if (!s_traceBuffer) {
+        pthread_mutex_unlock(&s_traceMutex);
+        return;
+    }
+    
+    LXYVideoTraceRecording = NO;
+    p_flushBuffer();
+    NSFileHandle *fileHandle = s_traceFileHandle;
+    s_traceFileHandle = nil;
+    s_traceBuffer = nil;
+    s_traceKeyIndexes = nil;
+    pthread_mutex_unlock(&s_traceMutex);
+    
+    dispatch_sync(s_traceWriteQueue, ^{
+        [fileHandle synchronizeFile];
+        [fileHandle closeFile];
+    });
+    
+    LXY_VIDEO_INFO(@"trace recording stopped");
+}
+
++ (NSArray<LXYVideoTraceEvent *> *)eventsWithContentsOfFile:(NSString *)path error:(NSError * __autoreleasing *)error
+{
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:error];
+    if (!data) {
+        return nil;
+    }
+    
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    uint32_t version = 0;
+    if (length >= kLXYTraceHeaderLength) {
+        const uint8_t *versionBytes = bytes + sizeof(kLXYTraceMagic);
+        version = versionBytes[0] | versionBytes[1] << 8 | versionBytes[2] << 16 | (uint32_t)versionBytes[3] << 24;
+    }
+    if (   length < kLXYTraceHeaderLength
+        || memcmp(bytes, kLXYTraceMagic, sizeof(kLXYTraceMagic)) != 0
+        || version != kLXYTraceVersion) {
+        if (error) {
+            *error = LXYError(LXYVideoTraceErrorInvalid, path);
+        }
+        return nil;
+    }
+    
+    NSMutableArray<LXYVideoTraceEvent *> *events = [NSMutableArray array];
+    NSMutableDictionary<NSNumber *, NSString *> *keys = [NSMutableDictionary dictionary];
+    NSTimeInterval timestamp = 0;
+    NSUInteger cursor = kLXYTraceHeaderLength;
+    while (cursor < length) {
+        uint8_t op = bytes[cursor++];
+        BOOL valid = YES;
+        if (op == kLXYTraceOpKey) {
+            uint64_t index = 0, keyLength = 0;
+            valid = (   p_readVarint(bytes, length, &cursor, &index)
+                     && p_readVarint(bytes, length, &cursor, &keyLength)
+                     && keyLength <= length - cursor);
+            if (valid) {
+                NSString *key = [[NSString alloc] initWithBytes:bytes + cursor length:(NSUInteger)keyLength encoding:NSUTF8StringEncoding];
+                keys[@(index)] = key ?: @"";
+                cursor += (NSUInteger)keyLength;
+            }
+        } else {
+            uint64_t keyIndex = 0, delta = 0, offset = 0, eventLength = 0;
+            valid = (   op < LXYVideoTraceOpCount
+                     && p_readVarint(bytes, length, &cursor, &keyIndex)
+                     && p_readVarint(bytes, length, &cursor, &delta)
+                     && p_readVarint(bytes, length, &cursor, &offset)
+                     && p_readVarint(bytes, length, &cursor, &eventLength));
+            if (valid) {
+                timestamp += delta / (double)USEC_PER_SEC;
+                
+                LXYVideoTraceEvent *event = [LXYVideoTraceEvent new];
+                event.op = op;
+                event.key = keyIndex ? keys[@(keyIndex)] : nil;
+                event.timestamp = timestamp;
+                event.offset = offset;
+                event.length = eventLength;
+                [events addObject:event];
+            }
+        }
+        
+        // a trace cut by a crash keeps the records before the cut
+        if (!valid) {
+            LXY_VIDEO_ERROR(@"trace truncated at %@: %@", @(cursor), path);
+            break;
+        }
+    }
+    
+    return events;
+}
+
+@end